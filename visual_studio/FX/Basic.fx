@@ -5,6 +5,7 @@
 //=============================================================================
 
 #include "LightHelper.fx"
+#include "PortalLevels.fx"
 
 
 SamplerState samAnisotropic
@@ -77,13 +78,15 @@ VertexOut VS(VertexIn vin)
 	return vout;
 }
  
-float4 PS(VertexOut pin, uniform bool gClipWithPlane,
-			uniform int gLightCount, uniform bool gUseTexture) : SV_Target
+// shared by PS and PS_Level, which get their lights and clip plane from different places
+float4 ShadeBasic(VertexOut pin, DirectionalLight Lights[3],
+			float3 ClipPlanePosition, float3 ClipPlaneNormal, float ClipPlaneOffset, bool gClipWithPlane,
+			int gLightCount, bool gUseTexture)
 {
 	// clip everything that's behind the clip plane, offset towards its normal direction by some amount.
 	if (gClipWithPlane)
 	{
-		clip( dot(pin.PosW-gClipPlanePosition, gClipPlaneNormal) - gClipPlaneOffset );
+		clip( dot(pin.PosW-ClipPlanePosition, ClipPlaneNormal) - ClipPlaneOffset );
 	}
 
 
@@ -124,7 +127,7 @@ float4 PS(VertexOut pin, uniform bool gClipWithPlane,
 		for(int i = 0; i < gLightCount; ++i)
 		{
 			float4 A, D, S;
-			ComputeDirectionalLight(gMaterial, gDirLights[i], pin.NormalW, toEye, 
+			ComputeDirectionalLight(gMaterial, Lights[i], pin.NormalW, toEye, 
 				A, D, S);
 
 			ambient += A;
@@ -149,6 +152,67 @@ float4 PS(VertexOut pin, uniform bool gClipWithPlane,
     return litColor;
 }
 
+float4 PS(VertexOut pin, uniform bool gClipWithPlane,
+			uniform int gLightCount, uniform bool gUseTexture) : SV_Target
+{
+	return ShadeBasic(pin, gDirLights, gClipPlanePosition, gClipPlaneNormal, gClipPlaneOffset, gClipWithPlane,
+				gLightCount, gUseTexture);
+}
+
+
+
+// LEVELS ******************************************************************************
+
+struct VertexOut_Level
+{
+	float4 PosH    : SV_POSITION;
+    float3 PosW    : POSITION;
+    float3 NormalW : NORMAL;
+	float2 Tex     : TEXCOORD;
+
+	nointerpolation uint Slot : LEVELSLOT;
+};
+
+VertexOut_Level VS_Level(VertexIn_Level vin)
+{
+	VertexOut_Level vout;
+	LevelSlot Slot = gLevelSlots[vin.Slot];
+
+	// virtualizing only rotates, translates and scales uniformly, so World can transform normals too
+	float4x4 World = mul(gLevelObjectWorld, Slot.WorldToVirtual);
+	vout.PosW    = mul(float4(vin.PosL, 1.0f), World).xyz;
+	vout.NormalW = mul(vin.NormalL, (float3x3)World);
+
+	vout.PosH = mul(float4(vout.PosW, 1.0f), Slot.ViewProj);
+	vout.Tex = mul(float4(vin.Tex, 0.0f, 1.0f), gTexTransform).xy;
+
+	vout.Slot = vin.Slot;
+
+	return vout;
+}
+
+float4 PS_Level(VertexOut_Level pin, uniform bool gClipWithPlane) : SV_Target
+{
+	LevelSlot Slot = gLevelSlots[pin.Slot];
+
+	DirectionalLight Lights[3];
+	[unroll]
+	for (int i = 0; i < 3; ++i)
+	{
+		Lights[i] = gDirLights[i];
+		Lights[i].Direction = Slot.LightDirections[i];
+	}
+
+	VertexOut v;
+	v.PosH = pin.PosH;
+	v.PosW = pin.PosW;
+	v.NormalW = pin.NormalW;
+	v.Tex = pin.Tex;
+
+	return ShadeBasic(v, Lights, Slot.ClipPlanePosition, Slot.ClipPlaneNormal, Slot.ClipPlaneOffset, gClipWithPlane,
+				3, true);
+}
+
 
 
 technique11 Light3
@@ -191,6 +255,32 @@ technique11 Light3TexClip
     }
 }
 
+technique11 Light3TexLevel
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_5_0, VS_Level() ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS_Level(false) ) );
+
+		SetRasterizerState(0);
+		SetBlendState(0, float4(0,0,0,0), 0xffffffff);
+    }
+}
+
+technique11 Light3TexClipLevel
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_5_0, VS_Level() ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS_Level(true) ) );
+
+		SetRasterizerState(0);
+		SetBlendState(0, float4(0,0,0,0), 0xffffffff);
+    }
+}
+
 
 
 // WIREFRAME ***************************************************************************
@@ -5,6 +5,7 @@
 //=============================================================================
 
 #include "LightHelper.fx"
+#include "PortalLevels.fx"
 
 
 SamplerState samAnisotropic
@@ -80,6 +81,50 @@ float4 PS_Box(VertexOut_Box pin, uniform bool gClipWithPlane) : SV_TARGET
 	//return float4(0,0,1,1);
 }
 
+
+// PORTAL BOX LEVELS ***************************************************************************************
+
+struct VertexOut_BoxLevel
+{
+	float4 PosH    : SV_POSITION;
+	float3 PosW    : POSITION;
+	nointerpolation uint Slot : LEVELSLOT;
+};
+
+// the box of slot Slot, seen through slot Slot's ViewProj.  the depth-clearing box always uses slot 0's ViewProj,
+// since it must cover everything inside the portal regardless of the realm's near plane
+VertexOut_BoxLevel VS_BoxLevel(VertexIn_Level vin, uniform bool gClearDepth)
+{
+	VertexOut_BoxLevel vout;
+	LevelSlot Slot = gLevelSlots[vin.Slot];
+
+	vout.PosW = mul(float4(vin.PosL, 1.0f), Slot.PortalBoxWorld).xyz;
+
+	if (gClearDepth)
+	{
+		vout.PosH = mul(float4(vout.PosW, 1.0f), gLevelSlots[0].ViewProj);
+		vout.PosH.z = vout.PosH.w;
+	}
+	else
+	{
+		vout.PosH = mul(float4(vout.PosW, 1.0f), Slot.ViewProj);
+	}
+
+	vout.Slot = vin.Slot;
+
+	return vout;
+}
+
+float4 PS_BoxLevel(VertexOut_BoxLevel pin, uniform bool gClipWithPlane) : SV_TARGET
+{
+	if (gClipWithPlane)
+	{
+		LevelSlot Slot = gLevelSlots[pin.Slot];
+		clip( dot(pin.PosW-Slot.ClipPlanePosition, Slot.ClipPlaneNormal) - Slot.ClipPlaneOffset );
+	}
+	return FOG_COLOR;
+}
+
 /*
 // FOR TESTINH!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 float4 PS_Box2(VertexOut_Box pin, uniform bool gClipWithPlane) : SV_TARGET
@@ -127,6 +172,45 @@ technique11 PortalBoxClearDepth
 		SetGeometryShader( NULL );
         SetPixelShader( CompileShader( ps_4_0, PS_Box(false) ) );
 
+		SetRasterizerState(0);	// no depthbias since all pixels will have max depth
+		SetBlendState(0, float4(0,0,0,0), 0xffffffff);	
+	}
+}
+
+technique11 PortalBoxLevel
+{
+	pass P0
+	{
+		SetVertexShader( CompileShader( vs_5_0, VS_BoxLevel(false) ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS_BoxLevel(false) ) );
+
+		SetRasterizerState(DepthBiasRS);
+		SetBlendState(0, float4(0,0,0,0), 0xffffffff);	
+	}
+}
+
+technique11 PortalBoxClipLevel
+{
+	pass P0
+	{
+		SetVertexShader( CompileShader( vs_5_0, VS_BoxLevel(false) ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS_BoxLevel(true) ) );
+
+		SetRasterizerState(DepthBiasRS);
+		SetBlendState(0, float4(0,0,0,0), 0xffffffff);	
+	}
+}
+
+technique11 PortalBoxClearDepthLevel
+{
+	pass P0
+	{
+		SetVertexShader( CompileShader( vs_5_0, VS_BoxLevel(true) ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS_BoxLevel(false) ) );
+
 		SetRasterizerState(0);	// no depthbias since all pixels will have max depth
 		SetBlendState(0, float4(0,0,0,0), 0xffffffff);	
 	}
@@ -0,0 +1,37 @@
+//=============================================================================
+// PortalLevels.fx
+//
+// Per-realm constants for drawing the levels of a portal's insides.  every
+// realm's matrices, lights and clip plane are uploaded once per portal into
+// gLevelSlots, and each draw picks its realm with a per-instance slot index
+// instead of updating cbuffers.  LevelSlot must match RenderBackend::LevelSlot.
+//=============================================================================
+
+
+struct LevelSlot
+{
+	row_major float4x4 WorldToVirtual;
+	row_major float4x4 ViewProj;		// may have an oblique near plane, except in slot 0
+	row_major float4x4 PortalBoxWorld;	// box of the portal leading out of this realm
+	float3 LightDirections[3];
+	float3 ClipPlanePosition;
+	float ClipPlaneOffset;
+	float3 ClipPlaneNormal;
+	float Pad;
+};
+
+StructuredBuffer<LevelSlot> gLevelSlots;
+
+cbuffer cbLevelObject
+{
+	float4x4 gLevelObjectWorld;			// object to real world transform, before virtualizing
+};
+
+
+struct VertexIn_Level
+{
+	float3 PosL    : POSITION;
+	float3 NormalL : NORMAL;
+	float2 Tex     : TEXCOORD;
+	uint Slot      : LEVELSLOT;
+};
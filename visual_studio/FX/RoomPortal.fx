@@ -5,6 +5,7 @@
 //=============================================================================
 
 #include "LightHelper.fx"
+#include "PortalLevels.fx"
 
 
 SamplerState samAnisotropic
@@ -109,14 +110,16 @@ VertexOut VS(VertexIn vin)
 	return vout;
 }
  
-float4 PS(VertexOut pin, uniform bool gClipWithPlane, 
-		uniform bool gDrawPortalA, uniform bool gDrawPortalB, uniform bool gDrawHoles,
-		uniform int gLightCount, uniform bool gUseTexture) : SV_Target
+// shared by PS and PS_Level, which get their lights and clip plane from different places
+float4 ShadeRoom(VertexOut pin, DirectionalLight Lights[3], 
+		float3 ClipPlanePosition, float3 ClipPlaneNormal, float ClipPlaneOffset, bool gClipWithPlane, 
+		bool gDrawPortalA, bool gDrawPortalB, bool gDrawHoles,
+		int gLightCount, bool gUseTexture)
 {
 	// clip everything that's behind the clip plane, offset towards its normal direction by some amount.
 	if (gClipWithPlane)
 	{
-		clip( dot(pin.PosW-gClipPlanePosition, gClipPlaneNormal) - gClipPlaneOffset );
+		clip( dot(pin.PosW-ClipPlanePosition, ClipPlaneNormal) - ClipPlaneOffset );
 	}
 
 	// the room color will be blended with this using PortalColor's alpha right before fogging.
@@ -190,7 +193,7 @@ float4 PS(VertexOut pin, uniform bool gClipWithPlane,
 		for(int i = 0; i < gLightCount; ++i)
 		{
 			float4 A, D, S;
-			ComputeDirectionalLight(gMaterial, gDirLights[i], pin.NormalW, toEye, 
+			ComputeDirectionalLight(gMaterial, Lights[i], pin.NormalW, toEye, 
 				A, D, S);
 
 			ambient += A;
@@ -221,6 +224,79 @@ float4 PS(VertexOut pin, uniform bool gClipWithPlane,
     return litColor;
 }
 
+float4 PS(VertexOut pin, uniform bool gClipWithPlane, 
+		uniform bool gDrawPortalA, uniform bool gDrawPortalB, uniform bool gDrawHoles,
+		uniform int gLightCount, uniform bool gUseTexture) : SV_Target
+{
+	return ShadeRoom(pin, gDirLights, gClipPlanePosition, gClipPlaneNormal, gClipPlaneOffset, gClipWithPlane,
+				gDrawPortalA, gDrawPortalB, gDrawHoles, gLightCount, gUseTexture);
+}
+
+
+
+// LEVELS ******************************************************************************
+
+struct VertexOut_Level
+{
+	float4 PosH    : SV_POSITION;
+    float3 PosW    : POSITION;
+    float3 NormalW : NORMAL;
+	float2 Tex     : TEXCOORD0;
+	
+	float3 PosPA	: POSITION1;
+	float3 PosPB	: POSITION2;
+
+	nointerpolation uint Slot : LEVELSLOT;
+};
+
+VertexOut_Level VS_Level(VertexIn_Level vin)
+{
+	VertexOut_Level vout;
+	LevelSlot Slot = gLevelSlots[vin.Slot];
+
+	// virtualizing only rotates, translates and scales uniformly, so World can transform normals too
+	float4x4 World = mul(gLevelObjectWorld, Slot.WorldToVirtual);
+	vout.PosW    = mul(float4(vin.PosL, 1.0f), World).xyz;
+	vout.NormalW = mul(vin.NormalL, (float3x3)World);
+
+	vout.PosH = mul(float4(vout.PosW, 1.0f), Slot.ViewProj);
+	vout.Tex = mul(float4(vin.Tex, 0.0f, 1.0f), gTexTransform).xy;
+
+	float4 PosP;
+	PosP = mul(float4(vin.PosL, 1.0f), gPortalA);
+	vout.PosPA = PosP.xyz / PosP.w;
+	PosP = mul(float4(vin.PosL, 1.0f), gPortalB);
+	vout.PosPB = PosP.xyz / PosP.w;
+
+	vout.Slot = vin.Slot;
+
+	return vout;
+}
+
+float4 PS_Level(VertexOut_Level pin, uniform bool gClipWithPlane) : SV_Target
+{
+	LevelSlot Slot = gLevelSlots[pin.Slot];
+
+	DirectionalLight Lights[3];
+	[unroll]
+	for (int i = 0; i < 3; ++i)
+	{
+		Lights[i] = gDirLights[i];
+		Lights[i].Direction = Slot.LightDirections[i];
+	}
+
+	VertexOut v;
+	v.PosH = pin.PosH;
+	v.PosW = pin.PosW;
+	v.NormalW = pin.NormalW;
+	v.Tex = pin.Tex;
+	v.PosPA = pin.PosPA;
+	v.PosPB = pin.PosPB;
+
+	return ShadeRoom(v, Lights, Slot.ClipPlanePosition, Slot.ClipPlaneNormal, Slot.ClipPlaneOffset, gClipWithPlane,
+				true, true, true, 3, true);
+}
+
 
 
 
@@ -284,6 +360,32 @@ technique11 Light3TexPortalAPortalBNoHoles
 		SetGeometryShader( NULL );
         SetPixelShader( CompileShader( ps_4_0, PS(false, true, true, false, 3, true) ) );
 
+		SetRasterizerState(0);
+		SetBlendState(0, float4(0,0,0,0), 0xffffffff);
+    }
+}
+
+technique11 Light3TexPortalAPortalBLevel
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_5_0, VS_Level() ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS_Level(false) ) );
+
+		SetRasterizerState(0);
+		SetBlendState(0, float4(0,0,0,0), 0xffffffff);
+    }
+}
+
+technique11 Light3TexPortalAPortalBClipLevel
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_5_0, VS_Level() ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS_Level(true) ) );
+
 		SetRasterizerState(0);
 		SetBlendState(0, float4(0,0,0,0), 0xffffffff);
     }
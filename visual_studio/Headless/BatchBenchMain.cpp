@@ -0,0 +1,204 @@
+//***************************************************************************************
+// Headless/BatchBenchMain.cpp
+//
+// Compares Room::SpherePathCollisionBatch with one Room::SpherePathCollision call per
+// query.  Random player-sized paths start anywhere in the room's bounds, like many bots
+// moving at once, or with -cluster in groups of that many within a few radii of each
+// other, like bots moving together; each batch is run both ways and every result of the batch has to be
+// the same, bit for bit, as its single query's.  Reports the time per query both ways,
+// the wall edges each query was given, and how many results differed.  Returns 1 if any
+// did, so it doubles as the batch's equivalence test.
+//
+// Without a room file a level with -columns columns is generated with RoomGenerator.
+//
+// usage: portals_batch_bench [room file] [-columns n] [-queries n] [-batch n] [-cluster n]
+//                            [-repeat n] [-seed n]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Room.h"
+#include "Portal.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "RoomFile.h"
+#include "RoomGenerator.h"
+#include <stdio.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static double MicrosecondsSince(Clock::time_point Start)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - Start).count();
+}
+
+static float RandomRange(float Lo, float Hi)
+{
+	return Lo + (Hi - Lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// T and TNormal are only set when the path hits something
+static bool SameResult(const Room::SpherePathResult &A, const Room::SpherePathResult &B, float MoveDist)
+{
+	bool Same = (memcmp(&A.X, &B.X, sizeof(XMFLOAT3)) == 0
+				&& memcmp(&A.XDist, &B.XDist, sizeof(float)) == 0
+				&& memcmp(&A.RedirectRatio, &B.RedirectRatio, sizeof(float)) == 0
+				&& memcmp(&A.RedirectDir, &B.RedirectDir, sizeof(XMFLOAT3)) == 0);
+	if (Same && A.XDist < MoveDist)
+	{
+		Same = (memcmp(&A.T, &B.T, sizeof(XMFLOAT3)) == 0
+				&& memcmp(&A.TNormal, &B.TNormal, sizeof(XMFLOAT3)) == 0);
+	}
+	return Same;
+}
+
+int main(int argc, char **argv)
+{
+	const char *RoomPath = NULL;
+	UINT Columns = 10000;
+	UINT QueryCount = 200000;
+	UINT BatchSize = 500;
+	UINT ClusterSize = 1;
+	UINT Repeat = 5;
+	UINT Seed = 1;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-columns" && i+1<argc)
+			Columns = (UINT)atoi(argv[++i]);
+		else if (Arg=="-queries" && i+1<argc)
+			QueryCount = (UINT)atoi(argv[++i]);
+		else if (Arg=="-batch" && i+1<argc)
+			BatchSize = max((UINT)atoi(argv[++i]), 1u);
+		else if (Arg=="-cluster" && i+1<argc)
+			ClusterSize = max((UINT)atoi(argv[++i]), 1u);
+		else if (Arg=="-repeat" && i+1<argc)
+			Repeat = max((UINT)atoi(argv[++i]), 1u);
+		else if (Arg=="-seed" && i+1<argc)
+			Seed = (UINT)atoi(argv[++i]);
+		else if (Arg[0]!='-' && !RoomPath)
+			RoomPath = argv[i];
+		else
+			Usage = true;
+	}
+	if (Usage)
+	{
+		fprintf(stderr, "usage: %s [room file] [-columns n] [-queries n] [-batch n] [-cluster n] [-repeat n] [-seed n]\n", argv[0]);
+		return 1;
+	}
+
+	Camera LeftCamera;
+	FirstPersonObject Player;
+	Portal OrangePortal;
+	Portal BluePortal;
+	Room Level;
+	if (RoomPath)
+	{
+		if (!RoomFile::Load(RoomPath, LeftCamera, Player, OrangePortal, BluePortal, Level))
+		{
+			fprintf(stderr, "can't open room file %s\n", RoomPath);
+			return 1;
+		}
+	}
+	else
+	{
+		RoomGenerator::Options Opts;
+		Opts.Seed = Seed;
+		Opts.Columns = Columns;
+		RoomGenerator::Level Generated;
+		RoomGenerator::Generate(Opts, Generated);
+		RoomGenerator::Load(Generated, LeftCamera, Player, OrangePortal, BluePortal, Level);
+	}
+
+	// the room's bounds
+	float MinX = std::numeric_limits<float>::infinity(), MaxX = -MinX, MinZ = MinX, MaxZ = -MinX;
+	UINT Edges = 0;
+	const std::vector<std::vector<XMFLOAT2>> &Polygons = Level.GetBoundaryPolygons();
+	for (unsigned int i=0; i<Polygons.size(); ++i)
+	{
+		Edges += Polygons[i].size();
+		for (unsigned int j=0; j<Polygons[i].size(); ++j)
+		{
+			MinX = min(MinX, Polygons[i][j].x);
+			MaxX = max(MaxX, Polygons[i][j].x);
+			MinZ = min(MinZ, Polygons[i][j].y);
+			MaxZ = max(MaxZ, Polygons[i][j].y);
+		}
+	}
+
+	srand(Seed);
+	float Radius = Player.GetBoundingSphereRadius();
+	std::vector<Room::SpherePathQuery> Queries(QueryCount);
+	XMFLOAT3 ClusterCenter;
+	for (UINT i=0; i<QueryCount; ++i)
+	{
+		if (i % ClusterSize == 0)
+			ClusterCenter = XMFLOAT3(RandomRange(MinX, MaxX), Player.GetPosition().y, RandomRange(MinZ, MaxZ));
+
+		Room::SpherePathQuery &Q = Queries[i];
+		Q.S = ClusterCenter;
+		if (ClusterSize > 1)
+			Q.S = Q.S + XMFLOAT3(RandomRange(-2.0f*Radius, 2.0f*Radius), 0.0f, RandomRange(-2.0f*Radius, 2.0f*Radius));
+		Q.Dir = XMFloat3Normalize(XMFLOAT3(RandomRange(-1.0f, 1.0f), RandomRange(-0.1f, 0.1f), RandomRange(-1.0f, 1.0f)));
+		Q.MoveDist = RandomRange(0.0f, 2.0f * Radius);
+		Q.SphereRadius = Radius;
+	}
+
+
+	// each batch one query at a time, then all at once
+	double SingleMicroseconds = 0.0;
+	double BatchMicroseconds = 0.0;
+	unsigned int SingleQueries, SingleGridEdges, SingleElements;
+	unsigned int BatchQueries, BatchGridEdges, BatchElements;
+	UINT Differences = 0;
+
+	std::vector<Room::SpherePathQuery> Batch;
+	std::vector<Room::SpherePathResult> Single;
+	std::vector<Room::SpherePathResult> Batched;
+	for (UINT r=0; r<Repeat; ++r)
+	{
+		for (UINT First=0; First<QueryCount; First+=BatchSize)
+		{
+			Batch.assign(Queries.begin() + First, Queries.begin() + min(First + BatchSize, QueryCount));
+			Single.resize(Batch.size());
+
+			Level.ResetWallQueryCounters();
+			Clock::time_point Start = Clock::now();
+			for (unsigned int i=0; i<Batch.size(); ++i)
+			{
+				const Room::SpherePathQuery &Q = Batch[i];
+				Room::SpherePathResult &R = Single[i];
+				R.X = Level.SpherePathCollision(Q.SphereRadius, Q.S, Q.Dir, Q.MoveDist,
+												&R.XDist, &R.RedirectRatio, &R.RedirectDir, &R.T, &R.TNormal);
+			}
+			SingleMicroseconds += MicrosecondsSince(Start);
+			Level.GetWallQueryCounters(&SingleQueries, &SingleGridEdges, &SingleElements);
+
+			Level.ResetWallQueryCounters();
+			Start = Clock::now();
+			Level.SpherePathCollisionBatch(Batch, Batched);
+			BatchMicroseconds += MicrosecondsSince(Start);
+			Level.GetWallQueryCounters(&BatchQueries, &BatchGridEdges, &BatchElements);
+
+			for (unsigned int i=0; i<Batch.size(); ++i)
+			{
+				if (!SameResult(Single[i], Batched[i], Batch[i].MoveDist))
+					++Differences;
+			}
+		}
+	}
+
+	double Total = (double)QueryCount * Repeat;
+	printf("room         %s, %u edges\n", RoomPath ? RoomPath : "generated", Edges);
+	printf("queries      %u x %u in batches of %u, clusters of %u\n", QueryCount, Repeat, BatchSize, ClusterSize);
+	printf("single us    %.3f per query, %.1f grid edges\n", Total > 0 ? SingleMicroseconds / Total : 0.0,
+			SingleQueries ? (double)SingleGridEdges / SingleQueries : 0.0);
+	printf("batch us     %.3f per query, %.1f cached edges\n", Total > 0 ? BatchMicroseconds / Total : 0.0,
+			BatchQueries ? (double)BatchGridEdges / BatchQueries : 0.0);
+	printf("differences  %u\n", Differences);
+
+	return Differences == 0 ? 0 : 1;
+}
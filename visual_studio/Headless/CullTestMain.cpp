@@ -0,0 +1,249 @@
+//***************************************************************************************
+// Headless/CullTestMain.cpp
+//
+// Checks Room::CullWalls against a brute force test of every wall.  For random cameras
+// and random portal placements in a room, plans both portals' levels the way
+// PortalSceneRenderer does, culls them, and then takes each wall's 4 corners into the
+// level's virtual space and tests them against its cull planes directly.  A wall that
+// has a corner inside every plane must be in the level's ranges, and one with all its
+// corners outside the same plane must not; walls within a hair of a plane may go either
+// way.  The ranges themselves must be whole walls, in order, and merged where adjacent.
+// Levels that have taken the room out of float range are only counted.  Prints counts;
+// returns 1 on any mismatch.
+//
+// usage: portals_cull_test [room file] [-cameras n] [-seed n]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "MathFunctions.h"
+#include "Room.h"
+#include "Portal.h"
+#include "PortalPair.h"
+#include "PortalSet.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "RoomFile.h"
+#include "GeometryGenerator.h"
+#include "PortalRecursionPlanner.h"
+#include <stdio.h>
+#include <limits>
+#include <algorithm>
+
+#define CULL_TEST_VIEWPORT_WIDTH 1280.0f
+#define CULL_TEST_VIEWPORT_HEIGHT 720.0f
+
+// a corner closer to a plane than this, times its distance from the origin plus 1, could be on either side
+// of it after rounding.  deep levels scale and move the room far away, and walls in a portal's plane are
+// right on it
+#define CULL_TEST_EPSILON 1e-4f
+
+// portals of different sizes scale every level by the same factor, so deep levels can move the room far
+// enough for the planes in room space to overflow.  such a level is far past the far plane, so it's skipped
+#define CULL_TEST_MAX_COORDINATE 1e6f
+
+static float RandomRange(float Lo, float Hi)
+{
+	return Lo + (Hi - Lo) * (float)rand() / (float)RAND_MAX;
+}
+
+int main(int argc, char **argv)
+{
+	const char *RoomPath = ROOM_FILE_PATH;
+	UINT CameraCount = 2000;
+	UINT Seed = 1;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-cameras" && i+1<argc)
+			CameraCount = (UINT)atoi(argv[++i]);
+		else if (Arg=="-seed" && i+1<argc)
+			Seed = (UINT)atoi(argv[++i]);
+		else if (Arg[0] != '-')
+			RoomPath = argv[i];
+		else
+			Usage = true;
+	}
+	if (Usage)
+	{
+		fprintf(stderr, "usage: %s [room file] [-cameras n] [-seed n]\n", argv[0]);
+		return 1;
+	}
+
+	Camera Cam;
+	FirstPersonObject Player;
+	Portal OrangePortal;
+	Portal BluePortal;
+	Room Level;
+	if (!RoomFile::Load(RoomPath, Cam, Player, OrangePortal, BluePortal, Level))
+	{
+		fprintf(stderr, "can't open room file %s\n", RoomPath);
+		return 1;
+	}
+	Cam.SetLens(0.01f, 500.0f, PI/4.0f);
+	Cam.SetAspect(CULL_TEST_VIEWPORT_WIDTH / CULL_TEST_VIEWPORT_HEIGHT);
+	PortalRecursionPlanner::ScreenRect Viewport(0.0f, 0.0f, CULL_TEST_VIEWPORT_WIDTH, CULL_TEST_VIEWPORT_HEIGHT);
+
+	PortalPair Portals(OrangePortal, BluePortal);
+	PortalSet AllPortals;
+	AllPortals.AddPair(Portals);
+	AllPortals.Refresh();
+
+	// the wall corners, 4 per wall in the order BuildMeshData adds them
+	GeometryGenerator::MeshData RoomMesh;
+	UINT WallsIndexCount, WallsIBOffset, WallsVBOffset;
+	UINT FloorIndexCount, FloorIBOffset, FloorVBOffset;
+	UINT CeilingIndexCount, CeilingIBOffset, CeilingVBOffset;
+	Level.BuildMeshData(RoomMesh, &WallsIndexCount, &WallsIBOffset, &WallsVBOffset,
+						&FloorIndexCount, &FloorIBOffset, &FloorVBOffset,
+						&CeilingIndexCount, &CeilingIBOffset, &CeilingVBOffset);
+	const UINT WallCount = WallsIndexCount / 6;
+
+	// cameras go anywhere in the room's bounding box, between the floor and the ceiling
+	float MinX = std::numeric_limits<float>::infinity();
+	float MaxX = -MinX;
+	float MinZ = MinX;
+	float MaxZ = -MinX;
+	const std::vector<std::vector<XMFLOAT2>> &Polygons = Level.GetBoundaryPolygons();
+	for (UINT i=0; i<Polygons.size(); ++i)
+	{
+		for (UINT j=0; j<Polygons[i].size(); ++j)
+		{
+			MinX = min(MinX, Polygons[i][j].x);
+			MaxX = max(MaxX, Polygons[i][j].x);
+			MinZ = min(MinZ, Polygons[i][j].y);
+			MaxZ = max(MaxZ, Polygons[i][j].y);
+		}
+	}
+
+	srand(Seed);
+	UINT Levels = 0;
+	UINT OutOfRange = 0;
+	UINT WallTests = 0;
+	UINT Culled = 0;
+	UINT Failures = 0;
+	std::vector<PortalRecursionPlanner::Level> Plan;
+	std::vector<Room::IndexRange> WallRanges;
+	std::vector<bool> InRanges(WallCount);
+	for (UINT c=0; c<CameraCount; ++c)
+	{
+		XMFLOAT3 Eye(RandomRange(MinX, MaxX), RandomRange(Level.GetFloorY(), Level.GetCeilingY()), RandomRange(MinZ, MaxZ));
+		Cam.SetPosition(Eye);
+
+		// shoot one of the portals somewhere new every few cameras.  a shot that can't place it leaves it where it was
+		if (c % 4 == 0)
+		{
+			XMFLOAT3 Dir = XMFloat3Normalize(XMFLOAT3(RandomRange(-1.0f, 1.0f), RandomRange(-0.3f, 0.3f), RandomRange(-1.0f, 1.0f)));
+			Level.PortalRelocate(Eye, Dir, (c/4) % 2 == 0 ? OrangePortal : BluePortal, AllPortals);
+			AllPortals.Refresh();
+		}
+
+		// look at a portal most of the time, so there are levels to cull
+		const Portal &Target = (rand() % 2 == 0) ? OrangePortal : BluePortal;
+		XMFLOAT3 Jitter(RandomRange(-2.0f, 2.0f), RandomRange(-1.0f, 1.0f), RandomRange(-2.0f, 2.0f));
+		Cam.LookAtAndLevel(rand() % 4 == 0 ? Eye + Jitter : Target.GetPosition() + 0.5f*Jitter);
+		XMMATRIX ViewProj = Cam.GetViewMatrix() * Cam.GetProjMatrix();
+
+		for (int p=0; p<2; ++p)
+		{
+			const Portal &LookThru = (p == 0) ? OrangePortal : BluePortal;
+			PortalRecursionPlanner::Plan(Portals, LookThru, 0, p == 0 ? ORANGE_STENCIL_REF : BLUE_STENCIL_REF,
+										PORTAL_ITERATIONS, Eye, ViewProj, Viewport, Plan);
+			PortalRecursionPlanner::Cull(Level, Player.GetPosition(), Player.GetBoundingSphereRadius(), Plan, WallRanges);
+
+			for (UINT l=0; l<Plan.size(); ++l)
+			{
+				const PortalRecursionPlanner::Level &L = Plan[l];
+				++Levels;
+
+				bool InRange = true;
+				for (int r=0; r<4; ++r)
+					for (int k=0; k<4; ++k)
+						InRange = InRange && (fabsf(L.WorldToVirtual(r,k)) < CULL_TEST_MAX_COORDINATE);
+				if (!InRange)
+				{
+					++OutOfRange;
+					continue;
+				}
+
+				// the ranges must be whole walls, in order, with a gap between one and the next
+				std::fill(InRanges.begin(), InRanges.end(), false);
+				UINT End = 0;
+				for (UINT r=L.WallRangeStart; r<L.WallRangeStart + L.WallRangeCount; ++r)
+				{
+					const Room::IndexRange &Range = WallRanges[r];
+					bool Bad = (Range.Start % 6 != 0 || Range.Count % 6 != 0 || Range.Count == 0 ||
+								Range.Start + Range.Count > WallsIndexCount || (r > L.WallRangeStart && Range.Start <= End));
+					if (Bad)
+					{
+						if (Failures < 10)
+							printf("camera %u portal %d level %u: bad range [%u, %u) after %u\n", c, p, l,
+									Range.Start, Range.Start + Range.Count, End);
+						++Failures;
+						continue;
+					}
+					for (UINT i=Range.Start/6; i<(Range.Start + Range.Count)/6; ++i)
+						InRanges[i] = true;
+					End = Range.Start + Range.Count;
+				}
+
+				// the corners, drawn at P*WorldToVirtual, against the planes as they are, normalized so
+				// the distances are in world units
+				XMMATRIX WorldToVirtual = XMLoadFloat4x4(&L.WorldToVirtual);
+				for (UINT i=0; i<WallCount; ++i)
+				{
+					bool SomeCornerInsideAll = false;
+					bool AllCornersOutsideOne = false;
+					XMFLOAT3 Corners[4];
+					float Tolerance[4];
+					float Inside[4];
+					for (int k=0; k<4; ++k)
+					{
+						Corners[k] = XMFloat3TransformCoord(RoomMesh.Vertices[WallsVBOffset + 4*i + k].Position, WorldToVirtual);
+						Tolerance[k] = CULL_TEST_EPSILON * (1.0f + XMFloat3Length(Corners[k]));
+						Inside[k] = std::numeric_limits<float>::infinity();
+					}
+					for (UINT q=0; q<L.CullPlaneCount; ++q)
+					{
+						const XMFLOAT4 &Plane = L.CullPlanes[q];
+						float Scale = 1.0f / XMFloat3Length(XMFLOAT3(Plane.x, Plane.y, Plane.z));
+						bool AllOutside = true;
+						for (int k=0; k<4; ++k)
+						{
+							const XMFLOAT3 &P = Corners[k];
+							float d = Scale * (Plane.x*P.x + Plane.y*P.y + Plane.z*P.z + Plane.w);
+							Inside[k] = min(Inside[k], d - Tolerance[k]);
+							AllOutside = AllOutside && (d < -Tolerance[k]);
+						}
+						AllCornersOutsideOne = AllCornersOutsideOne || AllOutside;
+					}
+					for (int k=0; k<4; ++k)
+						SomeCornerInsideAll = SomeCornerInsideAll || (Inside[k] > 0.0f);
+
+					++WallTests;
+					if (!InRanges[i])
+						++Culled;
+					if ((SomeCornerInsideAll && !InRanges[i]) || (AllCornersOutsideOne && InRanges[i]))
+					{
+						if (Failures < 10)
+							printf("camera %u portal %d level %u: wall %u %s\n", c, p, l, i,
+									InRanges[i] ? "kept but entirely outside a plane" : "culled but partly visible");
+						++Failures;
+					}
+				}
+			}
+		}
+	}
+
+	printf("room         %s\n", RoomPath);
+	printf("walls        %u\n", WallCount);
+	printf("levels       %u\n", Levels);
+	printf("out of range %u\n", OutOfRange);
+	printf("wall tests   %u\n", WallTests);
+	printf("culled       %u\n", Culled);
+	printf("failures     %u\n", Failures);
+
+	return (Failures == 0 && Levels > 0 && Culled > 0) ? 0 : 1;
+}
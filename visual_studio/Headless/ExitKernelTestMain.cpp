@@ -0,0 +1,175 @@
+//***************************************************************************************
+// Headless/ExitKernelTestMain.cpp
+//
+// Checks that Room's two exit kernels, FindFirstExit and FindFirstExitSSE, agree.  Random
+// player-sized paths are run thru Room::SpherePathCollision once with EXIT_KERNEL_SCALAR
+// and once with EXIT_KERNEL_SSE, and X, XDist and the redirect have to be the same, bit
+// for bit; T and TNormal too when the path hits something.  Half the paths start anywhere
+// in the room's bounds, and half start next to a random wall vertex so most of them reach
+// a wall.  Reports how many paths hit a wall and how many results differed, and returns 1
+// if any did.
+//
+// Without a room file a level with -columns columns is generated with RoomGenerator.
+//
+// usage: portals_exit_kernel_test [room file] [-columns n] [-paths n] [-seed n]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Room.h"
+#include "Portal.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "RoomFile.h"
+#include "RoomGenerator.h"
+#include <stdio.h>
+
+static float RandomRange(float Lo, float Hi)
+{
+	return Lo + (Hi - Lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// T and TNormal are only set when the path hits something
+static bool SameResult(const Room::SpherePathResult &A, const Room::SpherePathResult &B, float MoveDist)
+{
+	bool Same = (memcmp(&A.X, &B.X, sizeof(XMFLOAT3)) == 0
+				&& memcmp(&A.XDist, &B.XDist, sizeof(float)) == 0
+				&& memcmp(&A.RedirectRatio, &B.RedirectRatio, sizeof(float)) == 0
+				&& memcmp(&A.RedirectDir, &B.RedirectDir, sizeof(XMFLOAT3)) == 0);
+	if (Same && A.XDist < MoveDist)
+	{
+		Same = (memcmp(&A.T, &B.T, sizeof(XMFLOAT3)) == 0
+				&& memcmp(&A.TNormal, &B.TNormal, sizeof(XMFLOAT3)) == 0);
+	}
+	return Same;
+}
+
+static Room::SpherePathResult RunPath(const Room &Level, const Room::SpherePathQuery &Q, Room::ExitKernel Kernel)
+{
+	Room::SetExitKernel(Kernel);
+	Room::SpherePathResult R;
+	R.X = Level.SpherePathCollision(Q.SphereRadius, Q.S, Q.Dir, Q.MoveDist,
+									&R.XDist, &R.RedirectRatio, &R.RedirectDir, &R.T, &R.TNormal);
+	return R;
+}
+
+int main(int argc, char **argv)
+{
+	const char *RoomPath = NULL;
+	UINT Columns = 1000;
+	UINT PathCount = 50000;
+	UINT Seed = 1;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-columns" && i+1<argc)
+			Columns = (UINT)atoi(argv[++i]);
+		else if (Arg=="-paths" && i+1<argc)
+			PathCount = (UINT)atoi(argv[++i]);
+		else if (Arg=="-seed" && i+1<argc)
+			Seed = (UINT)atoi(argv[++i]);
+		else if (Arg[0]!='-' && !RoomPath)
+			RoomPath = argv[i];
+		else
+			Usage = true;
+	}
+	if (Usage)
+	{
+		fprintf(stderr, "usage: %s [room file] [-columns n] [-paths n] [-seed n]\n", argv[0]);
+		return 1;
+	}
+
+	Camera LeftCamera;
+	FirstPersonObject Player;
+	Portal OrangePortal;
+	Portal BluePortal;
+	Room Level;
+	if (RoomPath)
+	{
+		if (!RoomFile::Load(RoomPath, LeftCamera, Player, OrangePortal, BluePortal, Level))
+		{
+			fprintf(stderr, "can't open room file %s\n", RoomPath);
+			return 1;
+		}
+	}
+	else
+	{
+		RoomGenerator::Options Opts;
+		Opts.Seed = Seed;
+		Opts.Columns = Columns;
+		RoomGenerator::Level Generated;
+		RoomGenerator::Generate(Opts, Generated);
+		RoomGenerator::Load(Generated, LeftCamera, Player, OrangePortal, BluePortal, Level);
+	}
+
+	// the room's bounds and vertices
+	float MinX = std::numeric_limits<float>::infinity(), MaxX = -MinX, MinZ = MinX, MaxZ = -MinX;
+	std::vector<XMFLOAT2> Vertices;
+	const std::vector<std::vector<XMFLOAT2>> &Polygons = Level.GetBoundaryPolygons();
+	for (unsigned int i=0; i<Polygons.size(); ++i)
+	{
+		for (unsigned int j=0; j<Polygons[i].size(); ++j)
+		{
+			MinX = min(MinX, Polygons[i][j].x);
+			MaxX = max(MaxX, Polygons[i][j].x);
+			MinZ = min(MinZ, Polygons[i][j].y);
+			MaxZ = max(MaxZ, Polygons[i][j].y);
+			Vertices.push_back(Polygons[i][j]);
+		}
+	}
+	if (Vertices.empty())
+	{
+		fprintf(stderr, "the room has no walls\n");
+		return 1;
+	}
+
+	srand(Seed);
+	float Radius = Player.GetBoundingSphereRadius();
+	Room::ExitKernel StartKernel = Room::GetExitKernel();
+	UINT WallHits = 0;
+	UINT Differences = 0;
+	for (UINT i=0; i<PathCount; ++i)
+	{
+		Room::SpherePathQuery Q;
+		if (i % 2 == 0)
+		{
+			Q.S = XMFLOAT3(RandomRange(MinX, MaxX), Player.GetPosition().y, RandomRange(MinZ, MaxZ));
+		}
+		else
+		{
+			const XMFLOAT2 &V = Vertices[rand() % Vertices.size()];
+			Q.S = XMFLOAT3(V.x + RandomRange(-3.0f*Radius, 3.0f*Radius), Player.GetPosition().y,
+							V.y + RandomRange(-3.0f*Radius, 3.0f*Radius));
+		}
+		Q.Dir = XMFloat3Normalize(XMFLOAT3(RandomRange(-1.0f, 1.0f), RandomRange(-0.1f, 0.1f), RandomRange(-1.0f, 1.0f)));
+		Q.MoveDist = RandomRange(0.0f, 4.0f * Radius);
+		Q.SphereRadius = Radius;
+
+		Room::SpherePathResult Scalar = RunPath(Level, Q, Room::EXIT_KERNEL_SCALAR);
+		Room::SpherePathResult SSE = RunPath(Level, Q, Room::EXIT_KERNEL_SSE);
+		if (Scalar.XDist < Q.MoveDist && Scalar.TNormal.y == 0.0f)
+			++WallHits;
+		if (!SameResult(Scalar, SSE, Q.MoveDist))
+		{
+			if (Differences < 10)
+			{
+				printf("differs: S=(%f, %f, %f) Dir=(%f, %f, %f) MoveDist=%f\n", Q.S.x, Q.S.y, Q.S.z,
+						Q.Dir.x, Q.Dir.y, Q.Dir.z, Q.MoveDist);
+				printf("  scalar X=(%f, %f, %f) XDist=%f RedirectRatio=%f\n", Scalar.X.x, Scalar.X.y, Scalar.X.z,
+						Scalar.XDist, Scalar.RedirectRatio);
+				printf("  sse    X=(%f, %f, %f) XDist=%f RedirectRatio=%f\n", SSE.X.x, SSE.X.y, SSE.X.z,
+						SSE.XDist, SSE.RedirectRatio);
+			}
+			++Differences;
+		}
+	}
+	Room::SetExitKernel(StartKernel);
+
+	printf("room         %s, %u edges\n", RoomPath ? RoomPath : "generated", (UINT)Vertices.size());
+	printf("paths        %u, %u hit a wall\n", PathCount, WallHits);
+	printf("differences  %u\n", Differences);
+
+	return Differences == 0 ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+//***************************************************************************************
+// Headless/ObliqueTestMain.cpp
+//
+// Checks Camera::CalculateObliqueProjMatrix against the planes it is built from.  For a
+// few fields of view and aspect ratios, picks random view space planes with the eye
+// behind them, finds points of the plane inside the frustum, and projects points just in
+// front of and just behind each one.  Points in front must end up with z/w in [0,1] and
+// points behind with z/w outside it, so the rasterizer's near clip does what the
+// clip() in the pixel shader used to.  Prints counts; returns 1 if any point fails.
+//
+// usage: portals_oblique_test [-planes n] [-seed n]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "MathFunctions.h"
+#include "Camera.h"
+#include <stdio.h>
+
+static float RandomRange(float Lo, float Hi)
+{
+	return Lo + (Hi - Lo) * (float)rand() / (float)RAND_MAX;
+}
+
+int main(int argc, char **argv)
+{
+	UINT PlaneCount = 2000;
+	UINT Seed = 1;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-planes" && i+1<argc)
+			PlaneCount = (UINT)atoi(argv[++i]);
+		else if (Arg=="-seed" && i+1<argc)
+			Seed = (UINT)atoi(argv[++i]);
+		else
+			Usage = true;
+	}
+	if (Usage)
+	{
+		fprintf(stderr, "usage: %s [-planes n] [-seed n]\n", argv[0]);
+		return 1;
+	}
+
+	// fovs in degrees, and the lenses they are tried with
+	const float Fovs[] = { 30.0f, 60.0f, 90.0f, 120.0f };
+	const float Aspects[] = { 1.0f, 16.0f/9.0f };
+	const float Nears[] = { 0.01f, 0.5f };
+	const float Fars[] = { 1000.0f, 50.0f };
+
+	srand(Seed);
+	UINT Points = 0;
+	UINT Failures = 0;
+	for (UINT f=0; f<sizeof(Fovs)/sizeof(Fovs[0]); ++f)
+	{
+		for (UINT a=0; a<sizeof(Aspects)/sizeof(Aspects[0]); ++a)
+		{
+			for (UINT l=0; l<sizeof(Nears)/sizeof(Nears[0]); ++l)
+			{
+				Camera Cam;
+				Cam.SetAspect(Aspects[a]);
+				Cam.SetLens(Nears[l], Fars[l], Fovs[f] * PI / 180.0f);
+				XMMATRIX Proj = Cam.GetProjMatrix();
+				float XScale = XMVectorGetX(Proj.r[0]);
+				float YScale = XMVectorGetY(Proj.r[1]);
+
+				for (UINT p=0; p<PlaneCount; ++p)
+				{
+					// random plane with the eye at least Near behind it, like GetObliqueProjMatrix requires
+					XMFLOAT3 n = XMFloat3Normalize(XMFLOAT3(RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f),
+														RandomRange(-1.0f, 1.0f)));
+					float d = -Nears[l] - RandomRange(0.0f, 0.2f * Fars[l]);
+					XMMATRIX Oblique = Camera::CalculateObliqueProjMatrix(Proj, XMFLOAT4(n.x, n.y, n.z, d));
+
+					// points of the plane along rays through random pixels
+					for (UINT r=0; r<8; ++r)
+					{
+						XMFLOAT3 Ray(RandomRange(-1.0f, 1.0f) / XScale, RandomRange(-1.0f, 1.0f) / YScale, 1.0f);
+						float RayDotN = XMFloat3Dot(Ray, n);
+						if (RayDotN <= 0.0f)
+							continue;
+						XMFLOAT3 X = (-d / RayDotN) * Ray;
+						if (X.z < Nears[l] || X.z > Fars[l])
+							continue;
+
+						float Offset = 1e-3f * (1.0f + XMFloat3Length(X));
+						for (int Side=0; Side<2; ++Side)
+						{
+							XMFLOAT3 V = Side==0 ? X + Offset*n : X - Offset*n;
+							XMVECTOR Clip = XMVector4Transform(XMVectorSet(V.x, V.y, V.z, 1.0f), Oblique);
+							float w = XMVectorGetW(Clip);
+							float z = XMVectorGetZ(Clip) / w;
+							bool Inside = (w > 0.0f && z >= 0.0f && z <= 1.0f);
+							if (Inside != (Side==0))
+							{
+								if (Failures < 10)
+									printf("fov %g aspect %g near %g: plane (%g %g %g %g), point (%g %g %g) %s gives z/w %g\n",
+											Fovs[f], Aspects[a], Nears[l], n.x, n.y, n.z, d, V.x, V.y, V.z,
+											Side==0 ? "in front" : "behind", z);
+								++Failures;
+							}
+							++Points;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	printf("points       %u\n", Points);
+	printf("failures     %u\n", Failures);
+
+	return (Failures == 0 && Points > 0) ? 0 : 1;
+}
@@ -0,0 +1,450 @@
+//***************************************************************************************
+// Headless/RenderBenchMain.cpp
+//
+// Draws every frame of an input script (or a random one) the way PortalsApp::DrawScene
+// does, but into a NullRenderBackend, and reports the draws, state changes, constant
+// bytes and triangles per frame along with the CPU time spent building the frame.
+//
+// With -software the frames are rasterized by a SoftwareRenderBackend instead.  -dump
+// writes every n-th frame (-every n) as a PPM, and -golden compares them against PPMs
+// written earlier, failing if more than a few pixels differ.
+//
+// usage: portals_render_bench [room file] [-input script.txt] [-random frames] [-seed n]
+//                             [-software] [-threads n] [-dump dir] [-golden dir] [-every n]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Room.h"
+#include "Portal.h"
+#include "PortalPair.h"
+#include "PortalSet.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "SpherePath.h"
+#include "RoomFile.h"
+#include "InputScript.h"
+#include "GeometryGenerator.h"
+#include "NullRenderBackend.h"
+#include "SoftwareRenderBackend.h"
+#include "PortalSceneRenderer.h"
+#include <stdio.h>
+#include <chrono>
+
+// same as PortalsApp's default window: two viewports side by side
+#define BENCH_VIEWPORT_WIDTH 1280.0f
+#define BENCH_VIEWPORT_HEIGHT 720.0f
+
+// a golden image comparison fails if more pixels than this differ by more than BENCH_GOLDEN_TOLERANCE in a channel
+#define BENCH_GOLDEN_MAX_PIXELS 16
+#define BENCH_GOLDEN_TOLERANCE 2
+
+// random walk over the keys and mouse, one frame at 60fps each
+static void GenerateRandomFrames(unsigned int FrameCount, unsigned int Seed, std::vector<InputFrame> &Frames)
+{
+	srand(Seed);
+	Frames.clear();
+
+	InputFrame Frame;
+	Frame.dt = 1.0f / 60.0f;
+	for (unsigned int i=0; i<FrameCount; ++i)
+	{
+		if (rand() % 30 == 0)
+		{
+			Frame.ForwardSteps = (float)(rand()%3 - 1);
+			Frame.RightSteps = (float)(rand()%3 - 1);
+			Frame.UpSteps = (rand()%4==0) ? (float)(rand()%3 - 1) : 0.0f;
+			Frame.Sprint = (rand()%4 == 0);
+		}
+		if (rand() % 600 == 0)
+			Frame.Camera = 1 - Frame.Camera;
+
+		Frame.RotateRight = XMConvertToRadians(0.25f * (rand()%21 - 10));
+		Frame.RotateUp = XMConvertToRadians(0.25f * (rand()%11 - 5));
+
+		Frames.push_back(Frame);
+	}
+}
+
+// running average and max of one per-frame counter
+struct Tally
+{
+	double Sum;
+	UINT Max;
+
+	Tally() : Sum(0.0), Max(0) {}
+	void Add(UINT Value)
+	{
+		Sum += Value;
+		if (Value > Max)
+			Max = Value;
+	}
+	void Print(const char *Name, unsigned int Frames)const
+	{
+		printf("%-16s avg %10.1f  max %8u\n", Name, Frames > 0 ? Sum / Frames : 0.0, Max);
+	}
+};
+
+// pixels of A that differ from B by more than BENCH_GOLDEN_TOLERANCE in any channel
+static UINT CountDifferentPixels(const std::vector<UINT> &A, const std::vector<UINT> &B)
+{
+	UINT Count = 0;
+	for (UINT i=0; i<A.size(); ++i)
+	{
+		for (UINT Shift=0; Shift<24; Shift+=8)
+		{
+			int a = (A[i] >> Shift) & 0xff;
+			int b = (B[i] >> Shift) & 0xff;
+			if (abs(a - b) > BENCH_GOLDEN_TOLERANCE)
+			{
+				++Count;
+				break;
+			}
+		}
+	}
+	return Count;
+}
+
+int main(int argc, char **argv)
+{
+	const char *RoomPath = ROOM_FILE_PATH;
+	const char *InputPath = NULL;
+	unsigned int RandomFrames = 2000;
+	unsigned int Seed = 1;
+	bool Software = false;
+	unsigned int Threads = 0;
+	const char *DumpDir = NULL;
+	const char *GoldenDir = NULL;
+	unsigned int Every = 60;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-input" && i+1<argc)
+			InputPath = argv[++i];
+		else if (Arg=="-random" && i+1<argc)
+			RandomFrames = (unsigned int)atoi(argv[++i]);
+		else if (Arg=="-seed" && i+1<argc)
+			Seed = (unsigned int)atoi(argv[++i]);
+		else if (Arg=="-software")
+			Software = true;
+		else if (Arg=="-threads" && i+1<argc)
+			Threads = (unsigned int)atoi(argv[++i]);
+		else if (Arg=="-dump" && i+1<argc)
+			DumpDir = argv[++i];
+		else if (Arg=="-golden" && i+1<argc)
+			GoldenDir = argv[++i];
+		else if (Arg=="-every" && i+1<argc)
+			Every = std::max(1, atoi(argv[++i]));
+		else if (Arg[0]!='-')
+			RoomPath = argv[i];
+		else
+		{
+			fprintf(stderr, "usage: %s [room file] [-input script.txt] [-random frames] [-seed n]\n"
+							"       [-software] [-threads n] [-dump dir] [-golden dir] [-every n]\n", argv[0]);
+			return 1;
+		}
+	}
+	if ((DumpDir || GoldenDir) && !Software)
+	{
+		fprintf(stderr, "-dump and -golden need -software\n");
+		return 1;
+	}
+
+
+	// set up the level the same way PortalsApp::Init does
+	Camera LeftCamera;
+	Camera RightCamera;
+	FirstPersonObject Player;
+	Portal OrangePortal;
+	Portal BluePortal;
+	Room Level;
+	if (!RoomFile::Load(RoomPath, LeftCamera, Player, OrangePortal, BluePortal, Level))
+	{
+		fprintf(stderr, "can't open room file %s\n", RoomPath);
+		return 1;
+	}
+	LeftCamera.SetLens(0.01f, 500.0f, PI/4.0f);
+	RightCamera.SetLens(0.01f, 500.0f, PI/4.0f);
+	LeftCamera.SetAspect(BENCH_VIEWPORT_WIDTH / BENCH_VIEWPORT_HEIGHT);
+	RightCamera.SetAspect(BENCH_VIEWPORT_WIDTH / BENCH_VIEWPORT_HEIGHT);
+	RightCamera.AttachToObject(&Player);
+	OrangePortal.SetTextureRadiusRatio(1.22f);
+	BluePortal.SetTextureRadiusRatio(1.22f);
+
+	PortalPair Portals(OrangePortal, BluePortal);
+	PortalSet AllPortals;
+	AllPortals.AddPair(Portals);
+	AllPortals.Refresh();
+
+	// the room files keep both portals outside the room.  shoot them at the walls around the camera, like the
+	// right mouse button does, so there's something to look through
+	XMFLOAT3 ShootDirs[4] = { LeftCamera.GetLook(), -LeftCamera.GetLook(), LeftCamera.GetRight(), -LeftCamera.GetRight() };
+	Portal *ShootPortals[2] = { &OrangePortal, &BluePortal };
+	for (int p=0, d=0; p<2 && d<4; ++d)
+	{
+		unsigned int Version = ShootPortals[p]->GetVersion();
+		Level.PortalRelocate(LeftCamera.GetPosition(), ShootDirs[d], *ShootPortals[p], AllPortals);
+		AllPortals.Refresh();
+		if (ShootPortals[p]->GetVersion() != Version)
+			++p;
+	}
+	LeftCamera.LookAtAndLevel(OrangePortal.GetPosition());
+
+	const XMFLOAT3 LightDirections[3] = { XMFLOAT3(0.57735f, -0.57735f, 0.57735f),
+											XMFLOAT3(-0.57735f, -0.57735f, 0.57735f),
+											XMFLOAT3(0.0f, -0.707f, -0.707f) };
+
+	PortalRecursionPlanner::ScreenRect Viewport(0.0f, 0.0f, BENCH_VIEWPORT_WIDTH, BENCH_VIEWPORT_HEIGHT);
+
+
+	// the null backend only needs the index counts of the meshes PortalsApp builds.  the software one draws them,
+	// with PortalsApp's materials and stand-ins for its textures
+	GeometryGenerator::MeshData RoomMesh, PlayerMesh, PortalBoxMesh;
+	UINT WallsIndexCount, WallsIBOffset, WallsVBOffset;
+	UINT FloorIndexCount, FloorIBOffset, FloorVBOffset;
+	UINT CeilingIndexCount, CeilingIBOffset, CeilingVBOffset;
+	Level.BuildMeshData(RoomMesh, &WallsIndexCount, &WallsIBOffset, &WallsVBOffset,
+					&FloorIndexCount, &FloorIBOffset, &FloorVBOffset,
+					&CeilingIndexCount, &CeilingIBOffset, &CeilingVBOffset);
+	UINT PlayerIndexCount;
+	GeometryGenerator::GenerateSphere(PlayerMesh, 1.0f, 3, &PlayerIndexCount);
+	UINT PortalBoxIndexCount;
+	Portal::BuildMeshData(PortalBoxMesh, &PortalBoxIndexCount);
+
+	NullRenderBackend NullBackend;
+	NullBackend.SetIndexCount(RenderBackend::MESH_WALLS, WallsIndexCount);
+	NullBackend.SetIndexCount(RenderBackend::MESH_FLOOR, FloorIndexCount);
+	NullBackend.SetIndexCount(RenderBackend::MESH_CEILING, CeilingIndexCount);
+	NullBackend.SetIndexCount(RenderBackend::MESH_PLAYER, PlayerIndexCount);
+	NullBackend.SetIndexCount(RenderBackend::MESH_PORTAL_BOX, PortalBoxIndexCount);
+	NullBackend.SetIndexCount(RenderBackend::MESH_PORTAL_BOX_CLEAR_DEPTH, PortalBoxIndexCount);
+
+	SoftwareRenderBackend SoftwareBackend;
+	SoftwareRenderBackend::Texture FloorTexture, StoneTexture, OrangePortalTexture, BluePortalTexture;
+	if (Software)
+	{
+		SoftwareBackend.Init(2 * (UINT)BENCH_VIEWPORT_WIDTH, (UINT)BENCH_VIEWPORT_HEIGHT, Threads);
+
+		SoftwareRenderBackend::BuildCheckerTexture(FloorTexture, 256, 8, XMFLOAT4(0.9f, 0.9f, 0.9f, 1.0f),
+													XMFLOAT4(0.6f, 0.6f, 0.65f, 1.0f));
+		SoftwareRenderBackend::BuildCheckerTexture(StoneTexture, 64, 4, XMFLOAT4(0.7f, 0.6f, 0.5f, 1.0f),
+													XMFLOAT4(0.5f, 0.45f, 0.4f, 1.0f));
+		SoftwareRenderBackend::BuildRingTexture(OrangePortalTexture, 256, 1.0f / 1.22f, XMFLOAT4(1.0f, 0.5f, 0.0f, 1.0f));
+		SoftwareRenderBackend::BuildRingTexture(BluePortalTexture, 256, 1.0f / 1.22f, XMFLOAT4(0.0f, 0.5f, 1.0f, 1.0f));
+
+		Material Mat;
+		Mat.Ambient  = XMFLOAT4(0.8f, 0.8f, 0.8f, 1.0f);
+		Mat.Diffuse  = XMFLOAT4(0.8f, 0.8f, 0.8f, 1.0f);
+		Mat.Specular = XMFLOAT4(0.8f, 0.8f, 0.8f, 16.0f);
+		Mat.Reflect  = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		SoftwareRenderBackend::MeshDesc Desc;
+		Desc.Data = &RoomMesh;
+		Desc.Mat = Mat;
+		XMStoreFloat4x4(&Desc.TexTransform, XMMatrixScaling(0.25f, 0.25f, 1.0f));
+		Desc.DiffuseMap = &FloorTexture;
+		Desc.IndexCount = WallsIndexCount;
+		Desc.IBOffset = WallsIBOffset;
+		Desc.VBOffset = WallsVBOffset;
+		SoftwareBackend.SetMesh(RenderBackend::MESH_WALLS, Desc);
+		Desc.IndexCount = FloorIndexCount;
+		Desc.IBOffset = FloorIBOffset;
+		Desc.VBOffset = FloorVBOffset;
+		SoftwareBackend.SetMesh(RenderBackend::MESH_FLOOR, Desc);
+		Desc.IndexCount = CeilingIndexCount;
+		Desc.IBOffset = CeilingIBOffset;
+		Desc.VBOffset = CeilingVBOffset;
+		SoftwareBackend.SetMesh(RenderBackend::MESH_CEILING, Desc);
+
+		Desc.Data = &PlayerMesh;
+		XMStoreFloat4x4(&Desc.TexTransform, XMMatrixIdentity());
+		Desc.DiffuseMap = &StoneTexture;
+		Desc.IndexCount = PlayerIndexCount;
+		Desc.IBOffset = 0;
+		Desc.VBOffset = 0;
+		SoftwareBackend.SetMesh(RenderBackend::MESH_PLAYER, Desc);
+
+		Desc.Data = &PortalBoxMesh;
+		Desc.DiffuseMap = NULL;
+		Desc.IndexCount = PortalBoxIndexCount;
+		SoftwareBackend.SetMesh(RenderBackend::MESH_PORTAL_BOX, Desc);
+		SoftwareBackend.SetMesh(RenderBackend::MESH_PORTAL_BOX_CLEAR_DEPTH, Desc);
+
+		DirectionalLight DirLights[3];
+		const float LightColors[3][3] = { { 0.2f, 0.5f, 0.5f }, { 0.0f, 0.2f, 0.25f }, { 0.0f, 0.2f, 0.0f } };
+		for (int l=0; l<3; ++l)
+		{
+			DirLights[l].Ambient = XMFLOAT4(LightColors[l][0], LightColors[l][0], LightColors[l][0], 1.0f);
+			DirLights[l].Diffuse = XMFLOAT4(LightColors[l][1], LightColors[l][1], LightColors[l][1], 1.0f);
+			DirLights[l].Specular = XMFLOAT4(LightColors[l][2], LightColors[l][2], LightColors[l][2], 1.0f);
+			DirLights[l].Direction = LightDirections[l];
+		}
+		SoftwareBackend.SetDirLights(DirLights);
+		SoftwareBackend.SetPortalTextures(&OrangePortalTexture, &BluePortalTexture);
+	}
+	RenderBackend &Backend = Software ? (RenderBackend&)SoftwareBackend : (RenderBackend&)NullBackend;
+
+
+	// get the input
+	std::vector<InputFrame> Frames;
+	if (InputPath)
+	{
+		if (!InputScript::Load(InputPath, Frames))
+		{
+			fprintf(stderr, "can't open input script %s\n", InputPath);
+			return 1;
+		}
+	}
+	else
+		GenerateRandomFrames(RandomFrames, Seed, Frames);
+
+
+	// replay it, drawing every frame and timing only the drawing
+	typedef std::chrono::steady_clock Clock;
+	PortalSceneRenderer SceneRenderer;
+	Tally Draws, Triangles, StencilChanges, ScissorChanges, ShaderChanges, MeshChanges, ConstantUpdates,
+		ConstantBytes, SlotUploads, Levels;
+	Tally ClippedTriangles, RasterTriangles, PixelsTested, PixelsWritten;
+	UINT Errors = 0;
+	UINT GoldenImages = 0, GoldenFailures = 0;
+	double FrameMicroseconds = 0.0;
+	double MaxFrameMicroseconds = 0.0;
+
+	for (unsigned int i=0; i<Frames.size(); ++i)
+	{
+		const InputFrame &Frame = Frames[i];
+		Camera &Cam = (Frame.Camera==1 ? RightCamera : LeftCamera);
+
+		AllPortals.Refresh();
+
+		Cam.RotateUp(Frame.RotateUp);
+		Cam.RotateRight(Frame.RotateRight);
+		Cam.Orthonormalize();
+
+		XMFLOAT3 Dir = 	Frame.ForwardSteps*Cam.GetLook() +
+						Frame.RightSteps*Cam.GetRight() +
+						Frame.UpSteps*Cam.GetBodyUp();
+		if (XMFloat3LengthSq(Dir)!=0.0f)
+		{
+			float speed = CAMERA_MOVEMENT_SPEED;
+			if (Frame.Sprint)
+				speed *= CAMERA_MOVEMENT_SPRINT_MULTIPLIER;
+			SpherePath::MoveCameraAlongPathIterative(Cam, XMFloat3Normalize(Dir), speed*Frame.dt, Level, AllPortals);
+		}
+
+		// same buffer as PortalsApp::UpdateScene
+		bool PlayerIntersectOrange = OrangePortal.DiscIntersectSphere(Player.GetPosition(),
+																	Player.GetBoundingSphereRadius()+0.01f);
+		bool PlayerIntersectBlue = BluePortal.DiscIntersectSphere(Player.GetPosition(),
+																	Player.GetBoundingSphereRadius()+0.01f);
+
+		Clock::time_point FrameStart = Clock::now();
+		Backend.BeginFrame();
+		if (Software)
+		{
+			SoftwareBackend.Clear(XMFLOAT4(0.7f, 0.7f, 0.7f, 1.0f));
+			SoftwareBackend.SetViewport(0.0f, 0.0f, BENCH_VIEWPORT_WIDTH, BENCH_VIEWPORT_HEIGHT);
+		}
+		SceneRenderer.RenderPortalView(Level, Portals, Player, PlayerIntersectOrange, PlayerIntersectBlue,
+						LeftCamera, Viewport, LightDirections, Backend);
+		if (Software)
+			SoftwareBackend.SetViewport(BENCH_VIEWPORT_WIDTH, 0.0f, BENCH_VIEWPORT_WIDTH, BENCH_VIEWPORT_HEIGHT);
+		SceneRenderer.RenderOverview(Portals, RightCamera, LightDirections, Backend);
+		if (Software)
+			SoftwareBackend.Flush();
+		double Microseconds = std::chrono::duration<double, std::micro>(Clock::now() - FrameStart).count();
+
+		FrameMicroseconds += Microseconds;
+		if (Microseconds > MaxFrameMicroseconds)
+			MaxFrameMicroseconds = Microseconds;
+
+		Levels.Add((UINT)(SceneRenderer.GetOrangePortalPlan().size() + SceneRenderer.GetBluePortalPlan().size()));
+		if (!Software)
+		{
+			const NullRenderBackend::FrameStats &Stats = NullBackend.GetFrameStats();
+			Draws.Add(Stats.Draws);
+			Triangles.Add(Stats.Triangles);
+			StencilChanges.Add(Stats.StencilChanges);
+			ScissorChanges.Add(Stats.ScissorChanges);
+			ShaderChanges.Add(Stats.ShaderChanges);
+			MeshChanges.Add(Stats.MeshChanges);
+			ConstantUpdates.Add(Stats.ConstantUpdates);
+			ConstantBytes.Add(Stats.ConstantBytes);
+			SlotUploads.Add(Stats.SlotUploads);
+			Errors += NullBackend.GetErrorCount();
+			continue;
+		}
+
+		const SoftwareRenderBackend::FrameStats &Stats = SoftwareBackend.GetFrameStats();
+		Triangles.Add(Stats.Triangles);
+		ClippedTriangles.Add(Stats.ClippedTriangles);
+		RasterTriangles.Add(Stats.RasterTriangles);
+		PixelsTested.Add(Stats.PixelsTested);
+		PixelsWritten.Add(Stats.PixelsWritten);
+
+		if (i % Every != 0)
+			continue;
+		char Name[64];
+		sprintf(Name, "/frame%05u.ppm", i);
+		if (DumpDir && !SoftwareBackend.WritePPM((std::string(DumpDir) + Name).c_str()))
+		{
+			fprintf(stderr, "can't write %s%s\n", DumpDir, Name);
+			return 1;
+		}
+		if (GoldenDir)
+		{
+			std::string GoldenPath = std::string(GoldenDir) + Name;
+			UINT GoldenWidth, GoldenHeight;
+			std::vector<UINT> Golden;
+			++GoldenImages;
+			if (!SoftwareRenderBackend::LoadPPM(GoldenPath.c_str(), &GoldenWidth, &GoldenHeight, Golden) ||
+				GoldenWidth != SoftwareBackend.GetWidth() || GoldenHeight != SoftwareBackend.GetHeight())
+			{
+				fprintf(stderr, "can't read golden image %s\n", GoldenPath.c_str());
+				++GoldenFailures;
+				continue;
+			}
+			UINT Different = CountDifferentPixels(SoftwareBackend.GetColorBuffer(), Golden);
+			if (Different > BENCH_GOLDEN_MAX_PIXELS)
+			{
+				fprintf(stderr, "frame %u: %u pixels differ from %s\n", i, Different, GoldenPath.c_str());
+				++GoldenFailures;
+			}
+		}
+	}
+
+
+	// report
+	unsigned int FrameCount = (unsigned int)Frames.size();
+	printf("room             %s\n", RoomPath);
+	printf("frames           %u\n", FrameCount);
+	Levels.Print("portal levels", FrameCount);
+	if (!Software)
+	{
+		Draws.Print("draws", FrameCount);
+		Triangles.Print("triangles", FrameCount);
+		StencilChanges.Print("stencil changes", FrameCount);
+		ScissorChanges.Print("scissor changes", FrameCount);
+		ShaderChanges.Print("shader changes", FrameCount);
+		MeshChanges.Print("mesh changes", FrameCount);
+		ConstantUpdates.Print("const updates", FrameCount);
+		ConstantBytes.Print("const bytes", FrameCount);
+		SlotUploads.Print("slot uploads", FrameCount);
+	}
+	else
+	{
+		Triangles.Print("triangles", FrameCount);
+		ClippedTriangles.Print("clipped tris", FrameCount);
+		RasterTriangles.Print("raster tris", FrameCount);
+		PixelsTested.Print("pixels tested", FrameCount);
+		PixelsWritten.Print("pixels written", FrameCount);
+	}
+	printf("cpu us/frame     avg %10.3f  max %8.3f\n", FrameCount > 0 ? FrameMicroseconds / FrameCount : 0.0,
+		MaxFrameMicroseconds);
+	printf("errors           %u\n", Errors);
+	if (GoldenDir)
+		printf("golden failures  %u of %u\n", GoldenFailures, GoldenImages);
+
+	return (Errors > 0 || GoldenFailures > 0) ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+//***************************************************************************************
+// Headless/RingBenchMain.cpp
+//
+// Compares Portal's two root solvers on the ring quartic.  Random sphere paths near a
+// portal are kept if Portal::SpherePathCollision has to solve the quartic for them, and
+// each one is then run with ROOT_SOLVER_REGULA_FALSI and ROOT_SOLVER_ILLINOIS.  Reports
+// for each solver the latency of SpherePathCollision (p50/p99/max), and the error of the
+// t it finds against a double-precision root of the same quartic; and between the two,
+// the largest |dt| and how many paths one solver hits and the other doesn't.
+//
+// Spheres are kept smaller than the ring, since larger ones can be caught by the check
+// for slipping thru the ring's pit instead of by the quartic.
+//
+// usage: portals_ring_bench [-paths n] [-seed n]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Portal.h"
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+struct RingPath
+{
+	float PortalRadius;
+	float SphereRadius;
+	XMFLOAT3 S;
+	XMFLOAT3 Dir;
+	float MoveDist;
+};
+
+static float RandomRange(float Lo, float Hi)
+{
+	return Lo + (Hi - Lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static double Percentile(const std::vector<double> &Sorted, double p)
+{
+	if (Sorted.empty())
+		return 0.0;
+	return Sorted[(size_t)(p * (Sorted.size() - 1))];
+}
+
+static double Quartic(const double coeffs[5], double t)
+{
+	return (((coeffs[0]*t + coeffs[1])*t + coeffs[2])*t + coeffs[3])*t + coeffs[4];
+}
+
+// the first t in [m,n] where the path enters the torus, found in double precision by sampling the
+// quartic for a sign change and bisecting it.  returns n if there's none
+static double ReferenceRoot(const Portal &P, const RingPath &Path, double m, double n)
+{
+	XMMATRIX M = P.GetPortalMatrix();
+	XMFLOAT3 Spf = XMFloat3TransformCoord(Path.S, M);
+	XMFLOAT3 Dirpf = XMFloat3TransformNormal(Path.Dir, M);
+	double Sp[3] = { Spf.x, Spf.y, Spf.z };
+	double Dirp[3] = { Dirpf.x, Dirpf.y, Dirpf.z };
+
+	double R_sq = (double)P.GetPhysicalRadius() * P.GetPhysicalRadius();
+	double r_sq = (double)Path.SphereRadius * Path.SphereRadius;
+	double beta = 2.0 * (Sp[0]*Dirp[0] + Sp[1]*Dirp[1] + Sp[2]*Dirp[2]);
+	double gamma = Sp[0]*Sp[0] + Sp[1]*Sp[1] + Sp[2]*Sp[2] - r_sq - R_sq;
+	double coeffs[5];
+	coeffs[0] = 1.0;
+	coeffs[1] = 2.0*beta;
+	coeffs[2] = beta*beta + 2.0*gamma + 4.0*R_sq*Dirp[2]*Dirp[2];
+	coeffs[3] = 2.0*beta*gamma + 8.0*R_sq*Sp[2]*Dirp[2];
+	coeffs[4] = gamma*gamma + 4.0*R_sq*(Sp[2]*Sp[2] - r_sq);
+
+	const int Samples = 4096;
+	double Lo = m;
+	double fLo = Quartic(coeffs, Lo);
+	for (int i=1; i<=Samples; ++i)
+	{
+		double Hi = m + (n - m) * i / Samples;
+		double fHi = Quartic(coeffs, Hi);
+		if (fLo > 0.0 && fHi <= 0.0)
+		{
+			for (int k=0; k<60; ++k)
+			{
+				double Mid = 0.5 * (Lo + Hi);
+				if (Quartic(coeffs, Mid) > 0.0)
+					Lo = Mid;
+				else
+					Hi = Mid;
+			}
+			return 0.5 * (Lo + Hi);
+		}
+		Lo = Hi;
+		fLo = fHi;
+	}
+	return n;
+}
+
+static void SetUpPortal(Portal &P, const RingPath &Path)
+{
+	P.SetIntendedPhysicalRadius(Path.PortalRadius);
+}
+
+int main(int argc, char **argv)
+{
+	UINT PathCount = 200000;
+	UINT Seed = 1;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-paths" && i+1<argc)
+			PathCount = (UINT)atoi(argv[++i]);
+		else if (Arg=="-seed" && i+1<argc)
+			Seed = (UINT)atoi(argv[++i]);
+		else
+			Usage = true;
+	}
+	if (Usage)
+	{
+		fprintf(stderr, "usage: %s [-paths n] [-seed n]\n", argv[0]);
+		return 1;
+	}
+
+	// keep the random paths that reach the quartic
+	srand(Seed);
+	Portal P;
+	std::vector<RingPath> Paths;
+	Paths.reserve(PathCount);
+	while (Paths.size() < PathCount)
+	{
+		RingPath Path;
+		Path.PortalRadius = RandomRange(1.0f, 3.0f);
+		Path.SphereRadius = RandomRange(0.2f, 0.95f) * Path.PortalRadius;
+		float Reach = 2.0f * Path.PortalRadius;
+		Path.S = XMFLOAT3(RandomRange(-Reach, Reach), RandomRange(-Reach, Reach), RandomRange(-Reach, Reach));
+		Path.Dir = XMFloat3Normalize(XMFLOAT3(RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f)));
+		Path.MoveDist = RandomRange(0.0f, 2.0f * Reach);
+
+		SetUpPortal(P, Path);
+		unsigned int Solved, Skipped;
+		Portal::ResetRingQuarticCounters();
+		float XDist, RedirectRatio;
+		XMFLOAT3 RedirectDir;
+		P.SpherePathCollision(Path.SphereRadius, Path.S, Path.Dir, Path.MoveDist, &XDist, &RedirectRatio, &RedirectDir);
+		Portal::GetRingQuarticCounters(&Solved, &Skipped);
+		if (Solved > 0)
+			Paths.push_back(Path);
+	}
+
+
+	// run every path with each solver
+	const char *Names[2] = { "regula falsi", "illinois" };
+	Portal::RootSolver Solvers[2] = { Portal::ROOT_SOLVER_REGULA_FALSI, Portal::ROOT_SOLVER_ILLINOIS };
+	std::vector<float> Ts[2];
+	std::vector<double> Nanoseconds[2];
+	for (int s=0; s<2; ++s)
+	{
+		Portal::SetRootSolver(Solvers[s]);
+		Ts[s].resize(Paths.size());
+		Nanoseconds[s].resize(Paths.size());
+		for (unsigned int i=0; i<Paths.size(); ++i)
+		{
+			const RingPath &Path = Paths[i];
+			SetUpPortal(P, Path);
+
+			float XDist, RedirectRatio;
+			XMFLOAT3 RedirectDir;
+			Clock::time_point Start = Clock::now();
+			P.SpherePathCollision(Path.SphereRadius, Path.S, Path.Dir, Path.MoveDist, &XDist, &RedirectRatio, &RedirectDir);
+			Nanoseconds[s][i] = std::chrono::duration<double, std::nano>(Clock::now() - Start).count();
+			Ts[s][i] = XDist;
+		}
+		std::sort(Nanoseconds[s].begin(), Nanoseconds[s].end());
+	}
+
+
+	// compare with the reference roots and with each other
+	std::vector<double> Errors[2];
+	UINT Hits[2] = { 0, 0 };
+	UINT Missed[2] = { 0, 0 };		// reference root, but the solver found none
+	UINT Extra[2] = { 0, 0 };		// the solver found a root the reference didn't
+	UINT HitDisagreements = 0;
+	double MaxDt = 0.0;
+	for (unsigned int i=0; i<Paths.size(); ++i)
+	{
+		const RingPath &Path = Paths[i];
+		SetUpPortal(P, Path);
+		double Reference = ReferenceRoot(P, Path, -T_THRESHOLD, Path.MoveDist);
+		bool ReferenceHit = (Reference < Path.MoveDist);
+
+		bool Hit[2];
+		for (int s=0; s<2; ++s)
+		{
+			Hit[s] = (Ts[s][i] != Path.MoveDist);
+			if (Hit[s])
+				++Hits[s];
+			if (Hit[s] && ReferenceHit)
+				Errors[s].push_back(fabs(Ts[s][i] - Reference));
+			else if (ReferenceHit)
+				++Missed[s];
+			else if (Hit[s])
+				++Extra[s];
+		}
+
+		if (Hit[0] != Hit[1])
+			++HitDisagreements;
+		else if (Hit[0])
+			MaxDt = max(MaxDt, (double)fabsf(Ts[0][i] - Ts[1][i]));
+	}
+
+	printf("paths        %u that solve the ring quartic\n", (UINT)Paths.size());
+	printf("%-13s %8s %8s %8s %8s %6s %6s %10s %10s %10s\n", "solver", "p50 ns", "p99 ns", "max ns", "hits",
+			"missed", "extra", "err p50", "err p99", "err max");
+	for (int s=0; s<2; ++s)
+	{
+		std::sort(Errors[s].begin(), Errors[s].end());
+		printf("%-13s %8.0f %8.0f %8.0f %8u %6u %6u %10.2e %10.2e %10.2e\n", Names[s],
+				Percentile(Nanoseconds[s], 0.5), Percentile(Nanoseconds[s], 0.99),
+				Nanoseconds[s].empty() ? 0.0 : Nanoseconds[s].back(), Hits[s], Missed[s], Extra[s],
+				Percentile(Errors[s], 0.5), Percentile(Errors[s], 0.99), Errors[s].empty() ? 0.0 : Errors[s].back());
+	}
+	printf("between      max |dt| %.2e, %u paths hit by one solver only\n", MaxDt, HitDisagreements);
+
+	return 0;
+}
@@ -0,0 +1,186 @@
+//***************************************************************************************
+// Headless/RoomConvMain.cpp
+//
+// Converts room.txt levels into the binary .bin format of RoomBinary.  Each input is
+// written next to itself with .txt replaced by .bin, unless -o names the output (one
+// input only).  The converted file is opened again and checked against the text level:
+// same start state, same collision index and mesh, and the same answers from
+// SpherePathCollision for a set of random paths.  The text and binary load times are
+// reported for each level.
+//
+// usage: portals_roomconv room.txt [room.txt ...] [-o out.bin] [-paths n]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Room.h"
+#include "Portal.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "RoomFile.h"
+#include "RoomBinary.h"
+#include <stdio.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static bool SameFloat3(const XMFLOAT3 &A, const XMFLOAT3 &B)
+{
+	return (A.x==B.x && A.y==B.y && A.z==B.z);
+}
+
+// loads the level at Path, timing it
+static bool TimedLoad(const char *Path, Camera &LeftCamera, FirstPersonObject &Player,
+						Portal &OrangePortal, Portal &BluePortal, Room &Level, double *Microseconds_ptr)
+{
+	Clock::time_point Start = Clock::now();
+	bool Loaded = RoomFile::Load(Path, LeftCamera, Player, OrangePortal, BluePortal, Level);
+	*Microseconds_ptr = std::chrono::duration<double, std::micro>(Clock::now() - Start).count();
+	return Loaded;
+}
+
+// number of random paths whose SpherePathCollision result differs between the two rooms
+static unsigned int CompareCollisions(const Room &A, const Room &B, FirstPersonObject &Player, unsigned int Paths)
+{
+	srand(1);
+	XMFLOAT3 Center = Player.GetPosition();
+	unsigned int Mismatches = 0;
+	for (unsigned int i=0; i<Paths; ++i)
+	{
+		XMFLOAT3 S = Center + XMFLOAT3((float)(rand()%2001 - 1000) / 100.0f, (float)(rand()%401 - 200) / 100.0f,
+										(float)(rand()%2001 - 1000) / 100.0f);
+		XMFLOAT3 Dir = XMFloat3Normalize(XMFLOAT3((float)(rand()%201 - 100), (float)(rand()%41 - 20),
+													(float)(rand()%201 - 100) + 0.5f));
+		float MoveDist = (float)(rand()%1000) / 50.0f;
+		float Radius = Player.GetBoundingSphereRadius();
+
+		float XDist[2], RedirectRatio[2];
+		XMFLOAT3 X[2], RedirectDir[2], T[2], TNormal[2];
+		const Room *Rooms[] = { &A, &B };
+		for (int r=0; r<2; ++r)
+			X[r] = Rooms[r]->SpherePathCollision(Radius, S, Dir, MoveDist, &XDist[r], &RedirectRatio[r],
+												&RedirectDir[r], &T[r], &TNormal[r]);
+		if (!SameFloat3(X[0], X[1]) || XDist[0]!=XDist[1] || RedirectRatio[0]!=RedirectRatio[1]
+			|| !SameFloat3(RedirectDir[0], RedirectDir[1]))
+			++Mismatches;
+	}
+	return Mismatches;
+}
+
+static bool Convert(const char *InPath, const std::string &OutPath, unsigned int Paths)
+{
+	Camera LeftCamera;
+	FirstPersonObject Player;
+	Portal OrangePortal;
+	Portal BluePortal;
+	Room Level;
+	double TextMicroseconds;
+	if (!TimedLoad(InPath, LeftCamera, Player, OrangePortal, BluePortal, Level, &TextMicroseconds))
+	{
+		fprintf(stderr, "can't open room file %s\n", InPath);
+		return false;
+	}
+	if (!RoomBinary::Write(OutPath.c_str(), LeftCamera, Player, OrangePortal, BluePortal, Level))
+	{
+		fprintf(stderr, "can't write %s\n", OutPath.c_str());
+		return false;
+	}
+
+	// load it back, and check it against the text level
+	Camera BinaryLeftCamera;
+	FirstPersonObject BinaryPlayer;
+	Portal BinaryOrangePortal;
+	Portal BinaryBluePortal;
+	Room BinaryLevel;
+	double BinaryMicroseconds;
+	if (!TimedLoad(OutPath.c_str(), BinaryLeftCamera, BinaryPlayer, BinaryOrangePortal, BinaryBluePortal, BinaryLevel,
+					&BinaryMicroseconds))
+	{
+		fprintf(stderr, "%s doesn't load back\n", OutPath.c_str());
+		return false;
+	}
+
+	bool SameStart = SameFloat3(LeftCamera.GetPosition(), BinaryLeftCamera.GetPosition())
+					&& SameFloat3(Player.GetPosition(), BinaryPlayer.GetPosition())
+					&& Player.GetBoundingSphereRadius()==BinaryPlayer.GetBoundingSphereRadius()
+					&& SameFloat3(OrangePortal.GetPosition(), BinaryOrangePortal.GetPosition())
+					&& SameFloat3(OrangePortal.GetNormal(), BinaryOrangePortal.GetNormal())
+					&& SameFloat3(BluePortal.GetPosition(), BinaryBluePortal.GetPosition())
+					&& SameFloat3(BluePortal.GetNormal(), BinaryBluePortal.GetNormal());
+
+	// the stored mesh has to match what the loaded room builds
+	RoomBinary Binary;
+	Binary.Open(OutPath.c_str());
+	GeometryGenerator::MeshData Mesh;
+	UINT Counts[9];
+	BinaryLevel.BuildMeshData(Mesh, &Counts[0], &Counts[1], &Counts[2], &Counts[3], &Counts[4], &Counts[5],
+								&Counts[6], &Counts[7], &Counts[8]);
+	const RoomBinary::Header &H = Binary.GetHeader();
+	bool SameMesh = (Mesh.Vertices.size()==H.MeshVertexCount && Mesh.Indices.size()==H.MeshIndexCount
+					&& Counts[0]==H.WallsIndexCount && Counts[3]==H.FloorIndexCount && Counts[6]==H.CeilingIndexCount);
+	for (unsigned int i=0; i<Mesh.Indices.size() && SameMesh; ++i)
+		SameMesh = (Mesh.Indices[i] == Binary.GetMeshIndices()[i]);
+	for (unsigned int i=0; i<Mesh.Vertices.size() && SameMesh; ++i)
+		SameMesh = SameFloat3(Mesh.Vertices[i].Position, Binary.GetMeshVertices()[i].Position);
+
+	unsigned int Mismatches = CompareCollisions(Level, BinaryLevel, Player, Paths);
+
+	printf("%s -> %s\n", InPath, OutPath.c_str());
+	printf("  polygons %u, edges %u, grid %dx%d, mesh %u vertices, %u bytes\n", H.PolygonCount, H.VertexCount,
+			H.GridCellsX, H.GridCellsZ, H.MeshVertexCount, H.FileSize);
+	printf("  load us  text %.1f  binary %.1f\n", TextMicroseconds, BinaryMicroseconds);
+	printf("  check    start %s, mesh %s, collisions %u/%u differ\n", SameStart ? "ok" : "DIFFERS",
+			SameMesh ? "ok" : "DIFFERS", Mismatches, Paths);
+
+	return (SameStart && SameMesh && Mismatches==0);
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<const char*> InPaths;
+	const char *OutPath = NULL;
+	unsigned int Paths = 10000;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-o" && i+1<argc)
+			OutPath = argv[++i];
+		else if (Arg=="-paths" && i+1<argc)
+			Paths = (unsigned int)atoi(argv[++i]);
+		else if (Arg[0]!='-')
+			InPaths.push_back(argv[i]);
+		else
+			Usage = true;
+	}
+	if (Usage || InPaths.empty() || (OutPath && InPaths.size() > 1))
+	{
+		fprintf(stderr, "usage: %s room.txt [room.txt ...] [-o out.bin] [-paths n]\n", argv[0]);
+		return 1;
+	}
+
+	bool AllOk = true;
+	for (unsigned int i=0; i<InPaths.size(); ++i)
+	{
+		std::string Out;
+		if (OutPath)
+			Out = OutPath;
+		else
+		{
+			Out = InPaths[i];
+			size_t Dot = Out.find_last_of('.');
+			if (Dot != std::string::npos && Out.find_first_of("/\\", Dot) == std::string::npos)
+				Out.erase(Dot);
+			Out += ".bin";
+		}
+		if (RoomBinary::IsBinaryPath(InPaths[i]))
+		{
+			fprintf(stderr, "%s is already binary\n", InPaths[i]);
+			AllOk = false;
+			continue;
+		}
+		AllOk = Convert(InPaths[i], Out, Paths) && AllOk;
+	}
+	return AllOk ? 0 : 1;
+}
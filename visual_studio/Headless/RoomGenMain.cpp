@@ -0,0 +1,87 @@
+//***************************************************************************************
+// Headless/RoomGenMain.cpp
+//
+// Writes random stress levels in the room.txt format with RoomGenerator.  With -corpus the
+// output path is a directory, and one level is written to it for each column count of the
+// scaling corpus (stress_10.txt to stress_100000.txt) instead of a single level.
+//
+// usage: portals_roomgen out.txt [-columns n] [-perimeter n] [-jitter f] [-cell f] [-thin f]
+//                        [-seed n] [-wallportals] [-corpus]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "RoomGenerator.h"
+#include <stdio.h>
+
+static const UINT CORPUS_COLUMNS[] = { 10, 100, 1000, 10000, 100000 };
+
+static bool WriteLevel(const std::string &Path, const RoomGenerator::Options &Opts)
+{
+	RoomGenerator::Level Level;
+	RoomGenerator::Generate(Opts, Level);
+	if (!RoomGenerator::Write(Path.c_str(), Level))
+	{
+		fprintf(stderr, "can't write %s\n", Path.c_str());
+		return false;
+	}
+
+	UINT Edges = 0;
+	for (unsigned int i=0; i<Level.Polygons.size(); ++i)
+		Edges += Level.Polygons[i].size();
+	printf("%s: %u columns, %u polygons, %u edges, %.0f x %.0f\n", Path.c_str(), Opts.Columns,
+			(UINT)Level.Polygons.size(), Edges, 2.0f*Level.InteriorHalfWidth, 2.0f*Level.InteriorHalfWidth);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	RoomGenerator::Options Opts;
+	const char *OutPath = NULL;
+	bool Corpus = false;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-columns" && i+1<argc)
+			Opts.Columns = (UINT)atoi(argv[++i]);
+		else if (Arg=="-perimeter" && i+1<argc)
+			Opts.PerimeterVertices = (UINT)atoi(argv[++i]);
+		else if (Arg=="-jitter" && i+1<argc)
+			Opts.PerimeterJitter = (float)atof(argv[++i]);
+		else if (Arg=="-cell" && i+1<argc)
+			Opts.CellSize = (float)atof(argv[++i]);
+		else if (Arg=="-thin" && i+1<argc)
+			Opts.ThinWallFraction = (float)atof(argv[++i]);
+		else if (Arg=="-seed" && i+1<argc)
+			Opts.Seed = (UINT)atoi(argv[++i]);
+		else if (Arg=="-wallportals")
+			Opts.PortalsOnWalls = true;
+		else if (Arg=="-corpus")
+			Corpus = true;
+		else if (Arg[0]!='-' && !OutPath)
+			OutPath = argv[i];
+		else
+			Usage = true;
+	}
+	if (Usage || !OutPath)
+	{
+		fprintf(stderr, "usage: %s out.txt [-columns n] [-perimeter n] [-jitter f] [-cell f] [-thin f]\n"
+						"       [-seed n] [-wallportals] [-corpus]\n", argv[0]);
+		return 1;
+	}
+
+	if (!Corpus)
+		return WriteLevel(OutPath, Opts) ? 0 : 1;
+
+	for (unsigned int i=0; i<sizeof(CORPUS_COLUMNS)/sizeof(CORPUS_COLUMNS[0]); ++i)
+	{
+		Opts.Columns = CORPUS_COLUMNS[i];
+		char Name[64];
+		sprintf(Name, "/stress_%u.txt", CORPUS_COLUMNS[i]);
+		if (!WriteLevel(std::string(OutPath) + Name, Opts))
+			return 1;
+	}
+	return 0;
+}
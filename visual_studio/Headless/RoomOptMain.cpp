@@ -0,0 +1,171 @@
+//***************************************************************************************
+// Headless/RoomOptMain.cpp
+//
+// Runs RoomOptimizer over a level's polygons and reports what it removed.  The optimized
+// room is checked against the original with random SpherePathCollision queries: the
+// largest distance between their collision points, how many differ by more than the
+// tolerances, and the boundary elements each query had to test before and after.
+// -o writes the optimized level, as text or, for a .bin path, as a RoomBinary.
+//
+// usage: portals_roomopt room.txt [-o out.txt|out.bin] [-weld f] [-collinear f] [-minarea f]
+//                        [-paths n]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Room.h"
+#include "Portal.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "RoomFile.h"
+#include "RoomBinary.h"
+#include "RoomOptimizer.h"
+#include <stdio.h>
+
+static float RandomRange(float Lo, float Hi)
+{
+	return Lo + (Hi - Lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// true if a disc of Radius at P is inside the room and touches none of its walls
+static bool IsFreeDisc(const std::vector<std::vector<XMFLOAT2>> &Polygons, XMFLOAT2 P, float Radius)
+{
+	// even-odd crossings: inside the perimeter and outside every column
+	bool Inside = false;
+	for (unsigned int i=0; i<Polygons.size(); ++i)
+	{
+		for (unsigned int j=0; j<Polygons[i].size(); ++j)
+		{
+			XMFLOAT2 U = Polygons[i][j];
+			XMFLOAT2 V = Polygons[i][(j+1) % Polygons[i].size()];
+			if ((U.y > P.y) != (V.y > P.y) && P.x < U.x + (P.y - U.y) / (V.y - U.y) * (V.x - U.x))
+				Inside = !Inside;
+
+			XMFLOAT2 UV = V - U;
+			float t = min(max(XMFloat2Dot(P - U, UV) / XMFloat2LengthSq(UV), 0.0f), 1.0f);
+			if (XMFloat2Length(P - (U + t*UV)) <= Radius)
+				return false;
+		}
+	}
+	return Inside;
+}
+
+int main(int argc, char **argv)
+{
+	const char *InPath = NULL;
+	const char *OutPath = NULL;
+	RoomOptimizer::Options Opts;
+	unsigned int Paths = 20000;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-o" && i+1<argc)
+			OutPath = argv[++i];
+		else if (Arg=="-weld" && i+1<argc)
+			Opts.WeldDistance = (float)atof(argv[++i]);
+		else if (Arg=="-collinear" && i+1<argc)
+			Opts.CollinearTolerance = (float)atof(argv[++i]);
+		else if (Arg=="-minarea" && i+1<argc)
+			Opts.MinArea = (float)atof(argv[++i]);
+		else if (Arg=="-paths" && i+1<argc)
+			Paths = (unsigned int)atoi(argv[++i]);
+		else if (Arg[0]!='-' && !InPath)
+			InPath = argv[i];
+		else
+			Usage = true;
+	}
+	if (Usage || !InPath)
+	{
+		fprintf(stderr, "usage: %s room.txt [-o out.txt|out.bin] [-weld f] [-collinear f] [-minarea f] [-paths n]\n", argv[0]);
+		return 1;
+	}
+
+	Camera LeftCamera;
+	FirstPersonObject Player;
+	Portal OrangePortal;
+	Portal BluePortal;
+	Room Original;
+	if (!RoomFile::Load(InPath, LeftCamera, Player, OrangePortal, BluePortal, Original))
+	{
+		fprintf(stderr, "can't open room file %s\n", InPath);
+		return 1;
+	}
+
+	std::vector<std::vector<XMFLOAT2>> Polygons = Original.GetBoundaryPolygons();
+	RoomOptimizer::Report Report;
+	RoomOptimizer::Optimize(Polygons, Opts, &Report);
+
+	Room Optimized;
+	Optimized.SetFloorAndCeiling(Original.GetFloorY(), Original.GetCeilingY());
+	Optimized.SetTopography(Polygons);
+
+
+	// random paths that start clear of the walls
+	float MinX = std::numeric_limits<float>::infinity(), MaxX = -MinX, MinZ = MinX, MaxZ = -MinX;
+	const std::vector<std::vector<XMFLOAT2>> &OriginalPolygons = Original.GetBoundaryPolygons();
+	for (unsigned int i=0; i<OriginalPolygons.size(); ++i)
+	{
+		for (unsigned int j=0; j<OriginalPolygons[i].size(); ++j)
+		{
+			MinX = min(MinX, OriginalPolygons[i][j].x);
+			MaxX = max(MaxX, OriginalPolygons[i][j].x);
+			MinZ = min(MinZ, OriginalPolygons[i][j].y);
+			MaxZ = max(MaxZ, OriginalPolygons[i][j].y);
+		}
+	}
+
+	srand(1);
+	float Radius = Player.GetBoundingSphereRadius();
+	float Tolerance = Opts.WeldDistance + Opts.CollinearTolerance + T_BUMP;
+	float MaxDeviation = 0.0f;
+	unsigned int Deviations = 0;
+	for (unsigned int i=0; i<Paths; ++i)
+	{
+		XMFLOAT3 S;
+		do
+			S = XMFLOAT3(RandomRange(MinX, MaxX), Player.GetPosition().y, RandomRange(MinZ, MaxZ));
+		while (!IsFreeDisc(OriginalPolygons, XMFLOAT2(S.x, S.z), Radius));
+		XMFLOAT3 Dir = XMFloat3Normalize(XMFLOAT3(RandomRange(-1.0f, 1.0f), RandomRange(-0.1f, 0.1f), RandomRange(-1.0f, 1.0f)));
+		float MoveDist = RandomRange(0.0f, 10.0f * Radius);
+
+		float XDist, RedirectRatio;
+		XMFLOAT3 RedirectDir, T, TNormal;
+		XMFLOAT3 X0 = Original.SpherePathCollision(Radius, S, Dir, MoveDist, &XDist, &RedirectRatio, &RedirectDir, &T, &TNormal);
+		XMFLOAT3 X1 = Optimized.SpherePathCollision(Radius, S, Dir, MoveDist, &XDist, &RedirectRatio, &RedirectDir, &T, &TNormal);
+		float Deviation = XMFloat3Length(X1 - X0);
+		MaxDeviation = max(MaxDeviation, Deviation);
+		if (Deviation > Tolerance)
+			++Deviations;
+	}
+
+	unsigned int Queries[2], GridEdges[2], Elements[2];
+	Original.GetWallQueryCounters(&Queries[0], &GridEdges[0], &Elements[0]);
+	Optimized.GetWallQueryCounters(&Queries[1], &GridEdges[1], &Elements[1]);
+
+
+	printf("room          %s\n", InPath);
+	printf("polygons      %u -> %u (%u dropped)\n", Report.PolygonsIn, Report.PolygonsOut, Report.DroppedPolygons);
+	printf("vertices      %u -> %u (%u welded, %u merged, %u in dropped polygons)\n", Report.VerticesIn,
+			Report.VerticesOut, Report.WeldedVertices, Report.MergedVertices, Report.DroppedVertices);
+	printf("per query     grid edges %.2f -> %.2f, elements tested %.2f -> %.2f\n",
+			Queries[0] ? (double)GridEdges[0] / Queries[0] : 0.0, Queries[1] ? (double)GridEdges[1] / Queries[1] : 0.0,
+			Queries[0] ? (double)Elements[0] / Queries[0] : 0.0, Queries[1] ? (double)Elements[1] / Queries[1] : 0.0);
+	printf("collisions    max deviation %f, %u/%u paths beyond %f\n", MaxDeviation, Deviations, Paths, Tolerance);
+
+	if (OutPath)
+	{
+		bool Written = RoomBinary::IsBinaryPath(OutPath)
+						? RoomBinary::Write(OutPath, LeftCamera, Player, OrangePortal, BluePortal, Optimized)
+						: RoomFile::Write(OutPath, LeftCamera, Player, OrangePortal, BluePortal, Optimized);
+		if (!Written)
+		{
+			fprintf(stderr, "can't write %s\n", OutPath);
+			return 1;
+		}
+		printf("written to    %s\n", OutPath);
+	}
+
+	return 0;
+}
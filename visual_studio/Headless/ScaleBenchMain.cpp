@@ -0,0 +1,239 @@
+//***************************************************************************************
+// Headless/ScaleBenchMain.cpp
+//
+// Measures how Room scales with level size.  For each column count it generates a level
+// with RoomGenerator and times:
+//   topography  Room::SetTopography
+//   mesh        Room::BuildMeshData
+//   collision   Room::SpherePathCollision for random player-sized paths
+//   relocate    Room::PortalRelocate for rays that hit the walls, and for rays that hit
+//               the floor, which also measure the distance to the nearest wall
+// and prints them against the edge count.  -csv writes the table, and -plot writes a
+// gnuplot script that plots the csv on log-log axes.
+//
+// usage: portals_scale_bench [-sizes 10,100,...] [-queries n] [-perimeter n] [-jitter f]
+//                            [-thin f] [-seed n] [-csv out.csv] [-plot out.gp]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Room.h"
+#include "Portal.h"
+#include "PortalPair.h"
+#include "PortalSet.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "RoomGenerator.h"
+#include <stdio.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+struct ScaleResult
+{
+	UINT Columns;
+	UINT Edges;
+	double TopographyMs;
+	double MeshMs;
+	double CollisionUs;
+	double WallRelocateUs;
+	double FloorRelocateUs;
+};
+
+static double MicrosecondsSince(Clock::time_point Start)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - Start).count();
+}
+
+static float RandomRange(float Lo, float Hi)
+{
+	return Lo + (Hi - Lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static ScaleResult RunSize(RoomGenerator::Options Opts, UINT Columns, UINT Queries)
+{
+	ScaleResult Result;
+	Result.Columns = Columns;
+	Opts.Columns = Columns;
+
+	RoomGenerator::Level Generated;
+	RoomGenerator::Generate(Opts, Generated);
+	Result.Edges = 0;
+	for (unsigned int i=0; i<Generated.Polygons.size(); ++i)
+		Result.Edges += Generated.Polygons[i].size();
+
+	Camera LeftCamera;
+	FirstPersonObject Player;
+	Portal OrangePortal;
+	Portal BluePortal;
+	Room Level;
+
+	Clock::time_point Start = Clock::now();
+	RoomGenerator::Load(Generated, LeftCamera, Player, OrangePortal, BluePortal, Level);
+	Result.TopographyMs = MicrosecondsSince(Start) * 1e-3;
+
+	GeometryGenerator::MeshData Mesh;
+	UINT Counts[9];
+	Start = Clock::now();
+	Level.BuildMeshData(Mesh, &Counts[0], &Counts[1], &Counts[2], &Counts[3], &Counts[4], &Counts[5],
+						&Counts[6], &Counts[7], &Counts[8]);
+	Result.MeshMs = MicrosecondsSince(Start) * 1e-3;
+
+	OrangePortal.SetTextureRadiusRatio(1.22f);
+	BluePortal.SetTextureRadiusRatio(1.22f);
+	PortalPair Portals(OrangePortal, BluePortal);
+	PortalSet AllPortals;
+	AllPortals.AddPair(Portals);
+	AllPortals.Refresh();
+
+	// paths start anywhere in the column grid, at player height, and move up to a cell and a half
+	srand(Opts.Seed);
+	float Half = Generated.InteriorHalfWidth;
+	float Radius = Generated.PlayerRadius;
+	float MidY = 0.5f * (Generated.FloorY + Generated.CeilingY);
+	std::vector<XMFLOAT3> Starts(Queries);
+	std::vector<XMFLOAT3> Dirs(Queries);
+	std::vector<float> Dists(Queries);
+	for (UINT i=0; i<Queries; ++i)
+	{
+		Starts[i] = XMFLOAT3(RandomRange(-Half, Half), Generated.PlayerPosition.y, RandomRange(-Half, Half));
+		Dirs[i] = XMFloat3Normalize(XMFLOAT3(RandomRange(-1.0f, 1.0f), RandomRange(-0.1f, 0.1f), RandomRange(-1.0f, 1.0f)));
+		Dists[i] = RandomRange(0.0f, 1.5f * Opts.CellSize);
+	}
+
+	Start = Clock::now();
+	for (UINT i=0; i<Queries; ++i)
+	{
+		float XDist, RedirectRatio;
+		XMFLOAT3 RedirectDir, T, TNormal;
+		Level.SpherePathCollision(Radius, Starts[i], Dirs[i], Dists[i], &XDist, &RedirectRatio, &RedirectDir, &T, &TNormal);
+	}
+	Result.CollisionUs = MicrosecondsSince(Start) / max(Queries, 1u);
+
+	// portal shots from mid height: level ones end on walls, steep downward ones on the floor
+	for (int Floor=0; Floor<2; ++Floor)
+	{
+		double Microseconds = 0.0;
+		for (UINT i=0; i<Queries; ++i)
+		{
+			XMFLOAT3 S(Starts[i].x, MidY, Starts[i].z);
+			XMFLOAT3 Dir = Floor ? XMFloat3Normalize(XMFLOAT3(Dirs[i].x, -4.0f, Dirs[i].z))
+								: XMFloat3Normalize(XMFLOAT3(Dirs[i].x, 0.0f, Dirs[i].z));
+			Start = Clock::now();
+			Level.PortalRelocate(S, Dir, OrangePortal, AllPortals);
+			Microseconds += MicrosecondsSince(Start);
+			AllPortals.Refresh();
+		}
+		if (Floor)
+			Result.FloorRelocateUs = Microseconds / max(Queries, 1u);
+		else
+			Result.WallRelocateUs = Microseconds / max(Queries, 1u);
+	}
+
+	return Result;
+}
+
+int main(int argc, char **argv)
+{
+	RoomGenerator::Options Opts;
+	std::vector<UINT> Sizes;
+	UINT Queries = 20000;
+	const char *CsvPath = NULL;
+	const char *PlotPath = NULL;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-sizes" && i+1<argc)
+		{
+			std::stringstream ss(argv[++i]);
+			std::string Size;
+			while (std::getline(ss, Size, ','))
+				Sizes.push_back((UINT)atoi(Size.c_str()));
+		}
+		else if (Arg=="-queries" && i+1<argc)
+			Queries = (UINT)atoi(argv[++i]);
+		else if (Arg=="-perimeter" && i+1<argc)
+			Opts.PerimeterVertices = (UINT)atoi(argv[++i]);
+		else if (Arg=="-jitter" && i+1<argc)
+			Opts.PerimeterJitter = (float)atof(argv[++i]);
+		else if (Arg=="-thin" && i+1<argc)
+			Opts.ThinWallFraction = (float)atof(argv[++i]);
+		else if (Arg=="-seed" && i+1<argc)
+			Opts.Seed = (UINT)atoi(argv[++i]);
+		else if (Arg=="-csv" && i+1<argc)
+			CsvPath = argv[++i];
+		else if (Arg=="-plot" && i+1<argc)
+			PlotPath = argv[++i];
+		else
+			Usage = true;
+	}
+	if (Usage || (PlotPath && !CsvPath))
+	{
+		fprintf(stderr, "usage: %s [-sizes 10,100,...] [-queries n] [-perimeter n] [-jitter f]\n"
+						"       [-thin f] [-seed n] [-csv out.csv] [-plot out.gp]   (-plot needs -csv)\n", argv[0]);
+		return 1;
+	}
+	if (Sizes.empty())
+	{
+		UINT Default[] = { 10, 100, 1000, 10000, 100000 };
+		Sizes.assign(Default, Default + sizeof(Default)/sizeof(Default[0]));
+	}
+
+	std::vector<ScaleResult> Results;
+	printf("%8s %8s %14s %10s %14s %14s %14s\n", "columns", "edges", "topography ms", "mesh ms",
+			"collision us", "relocate us", "floor reloc us");
+	for (unsigned int i=0; i<Sizes.size(); ++i)
+	{
+		ScaleResult R = RunSize(Opts, Sizes[i], Queries);
+		printf("%8u %8u %14.3f %10.3f %14.3f %14.3f %14.3f\n", R.Columns, R.Edges, R.TopographyMs, R.MeshMs,
+				R.CollisionUs, R.WallRelocateUs, R.FloorRelocateUs);
+		fflush(stdout);
+		Results.push_back(R);
+	}
+
+	if (CsvPath)
+	{
+		FILE *Csv = fopen(CsvPath, "w");
+		if (!Csv)
+		{
+			fprintf(stderr, "can't write %s\n", CsvPath);
+			return 1;
+		}
+		fprintf(Csv, "columns,edges,topography_ms,mesh_ms,collision_us,relocate_us,floor_relocate_us\n");
+		for (unsigned int i=0; i<Results.size(); ++i)
+		{
+			const ScaleResult &R = Results[i];
+			fprintf(Csv, "%u,%u,%.6f,%.6f,%.6f,%.6f,%.6f\n", R.Columns, R.Edges, R.TopographyMs, R.MeshMs,
+					R.CollisionUs, R.WallRelocateUs, R.FloorRelocateUs);
+		}
+		fclose(Csv);
+	}
+
+	if (PlotPath)
+	{
+		FILE *Plot = fopen(PlotPath, "w");
+		if (!Plot)
+		{
+			fprintf(stderr, "can't write %s\n", PlotPath);
+			return 1;
+		}
+		fprintf(Plot, "set datafile separator ','\n"
+						"set logscale xy\n"
+						"set xlabel 'wall edges'\n"
+						"set ylabel 'time'\n"
+						"set key top left\n"
+						"set terminal pngcairo size 1000,700\n"
+						"set output '%s.png'\n"
+						"plot '%s' using 2:3 skip 1 with linespoints title 'topography (ms)', \\\n"
+						"     '' using 2:4 skip 1 with linespoints title 'mesh (ms)', \\\n"
+						"     '' using 2:5 skip 1 with linespoints title 'collision (us/query)', \\\n"
+						"     '' using 2:6 skip 1 with linespoints title 'relocate, wall (us/shot)', \\\n"
+						"     '' using 2:7 skip 1 with linespoints title 'relocate, floor (us/shot)'\n",
+						PlotPath, CsvPath);
+		fclose(Plot);
+	}
+
+	return 0;
+}
@@ -0,0 +1,403 @@
+//***************************************************************************************
+// Headless/SimMain.cpp
+//
+// Runs the movement code without a window: loads a room file, replays an input script (or
+// generates a random one) through SpherePath::MoveCameraAlongPathIterative as fast as it
+// can, and reports steps/sec and per-step latency percentiles.
+//
+// With -threaded the frames run on a simulation thread that publishes a SceneSnapshot after
+// each one through a TripleBuffer, like PortalsApp's, while this thread reads and interpolates
+// them as fast as it can and checks that every snapshot it gets is whole and newer than the last.
+//
+// With -fixed the frames' dt are fed through a FixedTimestep instead, and the movement runs in
+// ticks of 1/SIMULATION_TICK_RATE s like PortalsApp's simulation thread, each split into
+// -substeps sweeps.  The state hash at the end is the same for every run of the same input.
+//
+// Each camera moves with its own Room::CandidateCache, and their hit rate is reported; -nocache
+// moves them without, which has to end in the same state hash.
+//
+// usage: portals_sim [room file] [-input script.txt] [-random frames] [-seed n] [-repeat n] [-threaded]
+//                    [-fixed] [-substeps n] [-nocache]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Room.h"
+#include "Portal.h"
+#include "PortalPair.h"
+#include "PortalSet.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "SpherePath.h"
+#include "RoomFile.h"
+#include "InputScript.h"
+#include "SceneSnapshot.h"
+#include "SceneInterpolator.h"
+#include "TripleBuffer.h"
+#include "FixedTimestep.h"
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+
+// random walk over the keys and mouse, one frame at 60fps each
+static void GenerateRandomFrames(unsigned int FrameCount, unsigned int Seed, std::vector<InputFrame> &Frames)
+{
+	srand(Seed);
+	Frames.clear();
+
+	InputFrame Frame;
+	Frame.dt = 1.0f / 60.0f;
+	for (unsigned int i=0; i<FrameCount; ++i)
+	{
+		// change keys every so often, like a player would
+		if (rand() % 30 == 0)
+		{
+			Frame.ForwardSteps = (float)(rand()%3 - 1);
+			Frame.RightSteps = (float)(rand()%3 - 1);
+			Frame.UpSteps = (rand()%4==0) ? (float)(rand()%3 - 1) : 0.0f;
+			Frame.Sprint = (rand()%4 == 0);
+		}
+		if (rand() % 600 == 0)
+			Frame.Camera = 1 - Frame.Camera;
+
+		Frame.RotateRight = XMConvertToRadians(0.25f * (rand()%21 - 10));
+		Frame.RotateUp = XMConvertToRadians(0.25f * (rand()%11 - 5));
+
+		Frames.push_back(Frame);
+	}
+}
+
+static double Percentile(const std::vector<double> &Sorted, double p)
+{
+	if (Sorted.empty())
+		return 0.0;
+	size_t i = (size_t)(p * (Sorted.size() - 1) + 0.5);
+	return Sorted[i];
+}
+
+// FNV-1a over the parts of a snapshot that change, so a snapshot read while it was being written shows up
+static unsigned long long HashSnapshot(const SceneSnapshot &Snapshot)
+{
+	float Values[] = { Snapshot.LeftCamera.GetPosition().x, Snapshot.LeftCamera.GetPosition().y,
+						Snapshot.LeftCamera.GetPosition().z, Snapshot.LeftCamera.GetLook().x,
+						Snapshot.LeftCamera.GetLook().y, Snapshot.LeftCamera.GetLook().z,
+						Snapshot.LeftCamera.GetViewScale(),
+						Snapshot.RightCamera.GetPosition().x, Snapshot.RightCamera.GetPosition().y,
+						Snapshot.RightCamera.GetPosition().z, Snapshot.RightCamera.GetLook().x,
+						Snapshot.RightCamera.GetLook().y, Snapshot.RightCamera.GetLook().z,
+						Snapshot.RightCamera.GetViewScale(),
+						Snapshot.OrangePortal.GetPosition().x, Snapshot.OrangePortal.GetPosition().y,
+						Snapshot.OrangePortal.GetPosition().z, Snapshot.BluePortal.GetPosition().x,
+						Snapshot.BluePortal.GetPosition().y, Snapshot.BluePortal.GetPosition().z };
+
+	unsigned long long Hash = 14695981039346656037ULL;
+	const unsigned char *Bytes = (const unsigned char*)Values;
+	for (unsigned int i=0; i<sizeof(Values); ++i)
+		Hash = (Hash ^ Bytes[i]) * 1099511628211ULL;
+	Hash = (Hash ^ Snapshot.Tick) * 1099511628211ULL;
+	return Hash;
+}
+
+// FNV-1a over the bits of the cameras' whole frames, for comparing runs exactly
+static unsigned long long HashCameras(const Camera &LeftCamera, const Camera &RightCamera)
+{
+	const Camera *Cams[] = { &LeftCamera, &RightCamera };
+	unsigned long long Hash = 14695981039346656037ULL;
+	for (int c=0; c<2; ++c)
+	{
+		XMFLOAT3 Vectors[] = { Cams[c]->GetPosition(), Cams[c]->GetRight(), Cams[c]->GetUp(), Cams[c]->GetLook(),
+								Cams[c]->GetBodyUp() };
+		float ViewScale = Cams[c]->GetViewScale();
+		const unsigned char *Bytes = (const unsigned char*)Vectors;
+		for (unsigned int i=0; i<sizeof(Vectors); ++i)
+			Hash = (Hash ^ Bytes[i]) * 1099511628211ULL;
+		Bytes = (const unsigned char*)&ViewScale;
+		for (unsigned int i=0; i<sizeof(ViewScale); ++i)
+			Hash = (Hash ^ Bytes[i]) * 1099511628211ULL;
+	}
+	return Hash;
+}
+
+int main(int argc, char **argv)
+{
+	const char *RoomPath = ROOM_FILE_PATH;
+	const char *InputPath = NULL;
+	unsigned int RandomFrames = 100000;
+	unsigned int Seed = 1;
+	unsigned int Repeat = 1;
+	bool Threaded = false;
+	bool Fixed = false;
+	unsigned int Substeps = SIMULATION_SUBSTEPS;
+	bool UseCache = true;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-input" && i+1<argc)
+			InputPath = argv[++i];
+		else if (Arg=="-random" && i+1<argc)
+			RandomFrames = (unsigned int)atoi(argv[++i]);
+		else if (Arg=="-seed" && i+1<argc)
+			Seed = (unsigned int)atoi(argv[++i]);
+		else if (Arg=="-repeat" && i+1<argc)
+			Repeat = (unsigned int)atoi(argv[++i]);
+		else if (Arg=="-threaded")
+			Threaded = true;
+		else if (Arg=="-fixed")
+			Fixed = true;
+		else if (Arg=="-substeps" && i+1<argc)
+			Substeps = std::max(1, atoi(argv[++i]));
+		else if (Arg=="-nocache")
+			UseCache = false;
+		else if (Arg[0]!='-')
+			RoomPath = argv[i];
+		else
+		{
+			fprintf(stderr, "usage: %s [room file] [-input script.txt] [-random frames] [-seed n] [-repeat n] [-threaded]"
+					" [-fixed] [-substeps n] [-nocache]\n", argv[0]);
+			return 1;
+		}
+	}
+
+
+	// set up the level the same way PortalsApp::Init does
+	Camera LeftCamera;
+	Camera RightCamera;
+	FirstPersonObject Player;
+	Portal OrangePortal;
+	Portal BluePortal;
+	Room Level;
+	if (!RoomFile::Load(RoomPath, LeftCamera, Player, OrangePortal, BluePortal, Level))
+	{
+		fprintf(stderr, "can't open room file %s\n", RoomPath);
+		return 1;
+	}
+	LeftCamera.SetLens(0.01f, 500.0f, PI/4.0f);
+	RightCamera.SetLens(0.01f, 500.0f, PI/4.0f);
+	RightCamera.AttachToObject(&Player);
+	OrangePortal.SetTextureRadiusRatio(1.22f);
+	BluePortal.SetTextureRadiusRatio(1.22f);
+
+	PortalPair Portals(OrangePortal, BluePortal);
+	PortalSet AllPortals;
+	AllPortals.AddPair(Portals);
+	AllPortals.Refresh();
+
+
+	// get the input
+	std::vector<InputFrame> Frames;
+	if (InputPath)
+	{
+		if (!InputScript::Load(InputPath, Frames))
+		{
+			fprintf(stderr, "can't open input script %s\n", InputPath);
+			return 1;
+		}
+	}
+	else
+		GenerateRandomFrames(RandomFrames, Seed, Frames);
+
+
+	// replay it, timing each tick's movement.  without -fixed every frame is one tick of its own dt.  when
+	// threaded, this runs on its own thread and publishes a snapshot after every frame that ran a tick, recording
+	// each one's hash first so the reader can check it
+	typedef std::chrono::steady_clock Clock;
+	std::vector<double> StepMicroseconds;
+	StepMicroseconds.reserve(Frames.size() * Repeat);
+
+	const double TickStep = 1.0 / SIMULATION_TICK_RATE;
+	FixedTimestep Ticker(TickStep, SIMULATION_MAX_TICKS_PER_ADVANCE);
+
+	unsigned int TickCount = (unsigned int)Frames.size() * Repeat;
+	if (Fixed)
+	{
+		FixedTimestep DryRun(TickStep, SIMULATION_MAX_TICKS_PER_ADVANCE);
+		for (unsigned int r=0; r<Repeat; ++r)
+			for (unsigned int i=0; i<Frames.size(); ++i)
+				DryRun.Advance(Frames[i].dt);
+		TickCount = DryRun.GetTicks();
+	}
+	std::vector<unsigned long long> TickHashes(Threaded ? TickCount + 1 : 0);
+	TripleBuffer<SceneSnapshot> Snapshots;
+	Room::CandidateCache Caches[2];
+
+	// one tick of PortalsApp::StepSimulation for Frame's input
+	auto StepTick = [&](const InputFrame &Frame, float RotateUp, float RotateRight, float dt)
+	{
+		Camera &Cam = (Frame.Camera==1 ? RightCamera : LeftCamera);
+		Room::CandidateCache *Cache = (UseCache ? &Caches[Frame.Camera==1 ? 1 : 0] : NULL);
+
+		AllPortals.Refresh();
+
+		Cam.RotateUp(RotateUp);
+		Cam.RotateRight(RotateRight);
+		Cam.Orthonormalize();
+
+		if (Frame.ForwardSteps==0.0f && Frame.RightSteps==0.0f && Frame.UpSteps==0.0f)
+			return;
+
+		float speed = CAMERA_MOVEMENT_SPEED;
+		if (Frame.Sprint)
+			speed *= CAMERA_MOVEMENT_SPRINT_MULTIPLIER;
+
+		Clock::time_point StepStart = Clock::now();
+		UINT Sweeps = SpherePath::MoveCameraSubstepped(Cam, Frame.ForwardSteps, Frame.RightSteps, Frame.UpSteps,
+													speed*dt, Substeps, Level, AllPortals, Cache);
+		Clock::time_point StepEnd = Clock::now();
+
+		double Microseconds = std::chrono::duration<double, std::micro>(StepEnd - StepStart).count();
+		StepMicroseconds.push_back(Microseconds);
+		Ticker.RecordTick(Microseconds, Sweeps);
+	};
+
+	float PendingRotateUp = 0.0f, PendingRotateRight = 0.0f;
+	auto RunFrames = [&]()
+	{
+		unsigned int Tick = 0;
+		for (unsigned int r=0; r<Repeat; ++r)
+		{
+			for (unsigned int i=0; i<Frames.size(); ++i)
+			{
+				const InputFrame &Frame = Frames[i];
+
+				// the mouse moves once per frame, so its rotation goes into the frame's first tick, like the
+				// pending rotation PortalsApp's simulation thread picks up
+				double Time;
+				if (Fixed)
+				{
+					PendingRotateUp += Frame.RotateUp;
+					PendingRotateRight += Frame.RotateRight;
+
+					UINT Ticks = Ticker.Advance(Frame.dt);
+					for (UINT t=0; t<Ticks; ++t)
+					{
+						StepTick(Frame, PendingRotateUp, PendingRotateRight, (float)TickStep);
+						PendingRotateUp = PendingRotateRight = 0.0f;
+					}
+					if (Ticks==0)
+						continue;
+					Tick = Ticker.GetTicks();
+					Time = Ticker.GetTime();
+				}
+				else
+				{
+					StepTick(Frame, Frame.RotateUp, Frame.RotateRight, Frame.dt);
+					++Tick;
+					Time = Tick * (double)Frame.dt;
+				}
+
+				if (Threaded)
+				{
+					SceneSnapshot &Snapshot = Snapshots.GetWriteSlot();
+					Snapshot.Capture(Tick, Time, LeftCamera, RightCamera, Player,
+									OrangePortal, BluePortal, false, false);
+					TickHashes[Tick] = HashSnapshot(Snapshot);
+					Snapshots.Publish();
+				}
+			}
+		}
+	};
+
+	// what the render thread would do: take every new snapshot, check it, and interpolate towards it
+	unsigned int SnapshotsRead = 0, SnapshotsTorn = 0, SnapshotsOutOfOrder = 0, LastTickRead = 0;
+	bool SimulationDone = false;
+	auto ReadSnapshots = [&]()
+	{
+		double FrameTime = Fixed ? TickStep : Frames[0].dt;
+		SceneInterpolator Interpolator;
+		Interpolator.SetAspect(16.0f / 9.0f);
+		for (;;)
+		{
+			bool Done = __atomic_load_n(&SimulationDone, __ATOMIC_ACQUIRE);
+			if (Snapshots.Acquire())
+			{
+				const SceneSnapshot &Snapshot = Snapshots.GetReadSlot();
+				++SnapshotsRead;
+				if (Snapshot.Tick <= LastTickRead)
+					++SnapshotsOutOfOrder;
+				if (Snapshot.Tick > TickCount || HashSnapshot(Snapshot) != TickHashes[Snapshot.Tick])
+					++SnapshotsTorn;
+				LastTickRead = Snapshot.Tick;
+
+				Interpolator.Push(Snapshot);
+				for (int k=0; k<=4; ++k)
+					Interpolator.Interpolate(Snapshot.Time - FrameTime * (1.0 - k / 4.0));
+				Snapshot.Portals.GetVirtualizePower(Snapshot.OrangePortal, 2);
+			}
+			else if (Done)
+				return;
+			else
+				std::this_thread::yield();
+		}
+	};
+
+	Clock::time_point Start = Clock::now();
+	if (Threaded)
+	{
+		std::thread Simulation([&]()
+		{
+			RunFrames();
+			__atomic_store_n(&SimulationDone, true, __ATOMIC_RELEASE);
+		});
+		ReadSnapshots();
+		Simulation.join();
+	}
+	else
+		RunFrames();
+	double TotalSeconds = std::chrono::duration<double>(Clock::now() - Start).count();
+
+
+	// report
+	std::vector<double> Sorted = StepMicroseconds;
+	std::sort(Sorted.begin(), Sorted.end());
+
+	double StepSeconds = 0.0;
+	for (unsigned int i=0; i<Sorted.size(); ++i)
+		StepSeconds += Sorted[i] * 1e-6;
+
+	printf("room       %s\n", RoomPath);
+	printf("frames     %u x %u\n", (unsigned int)Frames.size(), Repeat);
+	printf("steps      %u\n", (unsigned int)Sorted.size());
+	printf("total      %.3f s\n", TotalSeconds);
+	printf("steps/sec  %.0f\n", StepSeconds > 0.0 ? Sorted.size() / StepSeconds : 0.0);
+	printf("latency us p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+		Percentile(Sorted, 0.5), Percentile(Sorted, 0.9), Percentile(Sorted, 0.99),
+		Percentile(Sorted, 0.999), Sorted.empty() ? 0.0 : Sorted.back());
+
+	// end positions, so runs can be compared for identical behaviour
+	XMFLOAT3 L = LeftCamera.GetPosition();
+	XMFLOAT3 R = RightCamera.GetPosition();
+	printf("left cam   %f %f %f  scale %f\n", L.x, L.y, L.z, LeftCamera.GetViewScale());
+	printf("player cam %f %f %f  scale %f\n", R.x, R.y, R.z, RightCamera.GetViewScale());
+	printf("state hash %016llx\n", HashCameras(LeftCamera, RightCamera));
+
+	if (UseCache)
+	{
+		unsigned int Hits[2], Misses[2];
+		Caches[0].GetCounters(&Hits[0], &Misses[0]);
+		Caches[1].GetCounters(&Hits[1], &Misses[1]);
+		unsigned int Lookups = Hits[0] + Hits[1] + Misses[0] + Misses[1];
+		printf("cache      %u hits, %u misses (%.1f%% hit)\n", Hits[0] + Hits[1], Misses[0] + Misses[1],
+			Lookups > 0 ? 100.0 * (Hits[0] + Hits[1]) / Lookups : 0.0);
+	}
+
+	if (Fixed)
+	{
+		const FixedTimestep::TickStats &Stats = Ticker.GetStats();
+		printf("ticks      %u of %.6f s, %u dropped, %u moving, %u sweeps (%u per tick)\n", Ticker.GetTicks(),
+			TickStep, Stats.DroppedTicks, Stats.Ticks, Stats.Substeps, Substeps);
+		printf("tick us    avg %.3f  p50 <%.0f  p99 <%.0f  max %.3f\n",
+			Stats.Ticks > 0 ? Stats.TotalMicroseconds / Stats.Ticks : 0.0, Ticker.GetPercentileMicroseconds(0.5),
+			Ticker.GetPercentileMicroseconds(0.99), Stats.MaxMicroseconds);
+	}
+
+	if (Threaded)
+	{
+		printf("snapshots  read %u of %u, last tick %u, torn %u, out of order %u\n", SnapshotsRead, TickCount,
+			LastTickRead, SnapshotsTorn, SnapshotsOutOfOrder);
+		if (SnapshotsTorn > 0 || SnapshotsOutOfOrder > 0 || LastTickRead != TickCount)
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,145 @@
+//***************************************************************************************
+// Headless/SimdMathTestMain.cpp
+//
+// Checks that SimdMath.h's Vec2/Vec3/Mat4 functions give the same results, bit for bit,
+// as the XMFloat helpers of MathFunctions.h and XMMatrixMultiply, on random vectors and
+// matrices.  The collision code moved onto SimdMath.h relies on this to behave exactly
+// as before.  Prints the version of SimdMath.h that was built and how many results
+// differed; returns 1 if any did.
+//
+// usage: portals_simd_test [-count n] [-seed n]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "MathFunctions.h"
+#include "SimdMath.h"
+#include <stdio.h>
+
+static float RandomRange(float Lo, float Hi)
+{
+	return Lo + (Hi - Lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static UINT Differences = 0;
+
+static void Check(const char *Name, float A, float B)
+{
+	if (memcmp(&A, &B, sizeof(float)) != 0)
+	{
+		if (Differences < 10)
+			printf("%-20s %.9g != %.9g\n", Name, A, B);
+		++Differences;
+	}
+}
+
+static void Check(const char *Name, const XMFLOAT2 &A, const XMFLOAT2 &B)
+{
+	Check(Name, A.x, B.x);
+	Check(Name, A.y, B.y);
+}
+
+static void Check(const char *Name, const XMFLOAT3 &A, const XMFLOAT3 &B)
+{
+	Check(Name, A.x, B.x);
+	Check(Name, A.y, B.y);
+	Check(Name, A.z, B.z);
+}
+
+int main(int argc, char **argv)
+{
+	UINT Count = 100000;
+	UINT Seed = 1;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-count" && i+1<argc)
+			Count = (UINT)atoi(argv[++i]);
+		else if (Arg=="-seed" && i+1<argc)
+			Seed = (UINT)atoi(argv[++i]);
+		else
+			Usage = true;
+	}
+	if (Usage)
+	{
+		fprintf(stderr, "usage: %s [-count n] [-seed n]\n", argv[0]);
+		return 1;
+	}
+
+	srand(Seed);
+	for (UINT i=0; i<Count; ++i)
+	{
+		float s = RandomRange(-10.0f, 10.0f);
+		XMFLOAT2 a2(RandomRange(-10.0f, 10.0f), RandomRange(-10.0f, 10.0f));
+		XMFLOAT2 b2(RandomRange(-10.0f, 10.0f), RandomRange(-10.0f, 10.0f));
+		XMFLOAT3 a3(RandomRange(-10.0f, 10.0f), RandomRange(-10.0f, 10.0f), RandomRange(-10.0f, 10.0f));
+		XMFLOAT3 b3(RandomRange(-10.0f, 10.0f), RandomRange(-10.0f, 10.0f), RandomRange(-10.0f, 10.0f));
+		XMMATRIX M, N;
+		for (int r=0; r<4; ++r)
+		{
+			for (int c=0; c<4; ++c)
+			{
+				M(r,c) = RandomRange(-2.0f, 2.0f);
+				N(r,c) = RandomRange(-2.0f, 2.0f);
+			}
+		}
+		M(3,3) += 8.0f;		// keeps w of TransformCoord away from 0
+
+		Vec2 A2 = Vec2Load(a2);
+		Vec2 B2 = Vec2Load(b2);
+		Vec3 A3 = Vec3Load(a3);
+		Vec3 B3 = Vec3Load(b3);
+		Mat4 M4 = Mat4Load(M);
+
+		Check("Vec2 load/store", Vec2Store(A2), a2);
+		Check("Vec2 +", Vec2Store(A2 + B2), a2 + b2);
+		Check("Vec2 -", Vec2Store(A2 - B2), a2 - b2);
+		Check("Vec2 negate", Vec2Store(-A2), -a2);
+		Check("Vec2 * float", Vec2Store(s * A2), s * a2);
+		Check("Vec2 / float", Vec2Store(A2 / s), a2 / s);
+		Check("Vec2Dot", Vec2Dot(A2, B2), XMFloat2Dot(a2, b2));
+		Check("Vec2Cross", Vec2Cross(A2, B2), XMFloat2Cross(a2, b2));
+		Check("Vec2Length", Vec2Length(A2), XMFloat2Length(a2));
+		Check("Vec2Normalize", Vec2Store(Vec2Normalize(A2)), XMFloat2Normalize(a2));
+		Check("Vec2Left90", Vec2Store(Vec2Left90(A2)), XMFloat2Left90(a2));
+		Check("Vec2Right90", Vec2Store(Vec2Right90(A2)), XMFloat2Right90(a2));
+
+		Check("Vec3 load/store", Vec3Store(A3), a3);
+		Check("Vec3 +", Vec3Store(A3 + B3), a3 + b3);
+		Check("Vec3 -", Vec3Store(A3 - B3), a3 - b3);
+		Check("Vec3 negate", Vec3Store(-A3), -a3);
+		Check("Vec3 * float", Vec3Store(A3 * s), a3 * s);
+		Check("Vec3 / float", Vec3Store(A3 / s), a3 / s);
+		Check("Vec3Dot", Vec3Dot(A3, B3), XMFloat3Dot(a3, b3));
+		Check("Vec3Cross", Vec3Store(Vec3Cross(A3, B3)), XMFloat3Cross(a3, b3));
+		Check("Vec3Length", Vec3Length(A3), XMFloat3Length(a3));
+		Check("Vec3Normalize", Vec3Store(Vec3Normalize(A3)), XMFloat3Normalize(a3));
+		Check("Vec3GetXZ", Vec2Store(Vec3GetXZ(A3)), XMFLOAT2(a3.x, a3.z));
+		Check("Vec3FromXZ", Vec3Store(Vec3FromXZ(A2, s)), XMFLOAT3(a2.x, s, a2.y));
+		Check("Vec3TransformCoord", Vec3Store(Vec3TransformCoord(A3, M4)), XMFloat3TransformCoord(a3, M));
+		Check("Vec3TransformNormal", Vec3Store(Vec3TransformNormal(A3, M4)), XMFloat3TransformNormal(a3, M));
+
+		XMMATRIX P = Mat4Store(Mat4Multiply(M4, Mat4Load(N)));
+		XMMATRIX Q = XMMatrixMultiply(M, N);
+		for (int r=0; r<4; ++r)
+			for (int c=0; c<4; ++c)
+				Check("Mat4Multiply", P(r,c), Q(r,c));
+
+		if ((A2 == B2) != (a2 == b2) || !(A2 == A2) || (A3 == B3) != (a3 == b3) || !(A3 == A3))
+			Check("==", 0.0f, 1.0f);
+	}
+
+#if SIMD_MATH_AVX2
+	const char *Version = "SSE2 + AVX2";
+#elif SIMD_MATH_SSE2
+	const char *Version = "SSE2";
+#else
+	const char *Version = "scalar";
+#endif
+	printf("simd math    %s, %u random cases\n", Version, Count);
+	printf("differences  %u\n", Differences);
+
+	return Differences == 0 ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+//***************************************************************************************
+// Headless/TripleBufferTestMain.cpp
+//
+// Stress test for TripleBuffer.  A writer thread publishes payloads stamped with a
+// sequence number as fast as it can, while this thread acquires and checks them in a
+// tight loop.  Every word of a payload is derived from its sequence number, so a slot
+// written while the reader holds it shows up as a torn payload, and an acquire that goes
+// back in time shows up as a sequence number that didn't increase.  Prints counts;
+// returns 1 on any torn payload, out of order sequence number, or if the last payload
+// never arrives.
+//
+// usage: portals_triplebuffer_test [-publishes n]
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include "TripleBuffer.h"
+#include <stdio.h>
+#include <thread>
+
+struct Payload
+{
+	unsigned long long Sequence;
+	UINT Words[30];		// spans a few cache lines, so a torn copy is likely to be caught
+};
+
+static void FillPayload(Payload *P, unsigned long long Sequence)
+{
+	P->Sequence = Sequence;
+	for (UINT i=0; i<30; ++i)
+		P->Words[i] = (UINT)(Sequence * 2654435761u) + i;
+}
+
+static bool PayloadIntact(const Payload &P)
+{
+	for (UINT i=0; i<30; ++i)
+	{
+		if (P.Words[i] != (UINT)(P.Sequence * 2654435761u) + i)
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long Publishes = 5000000;
+	bool Usage = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		std::string Arg = argv[i];
+		if (Arg=="-publishes" && i+1<argc)
+			Publishes = (unsigned long long)atoll(argv[++i]);
+		else
+			Usage = true;
+	}
+	if (Usage || Publishes == 0)
+	{
+		fprintf(stderr, "usage: %s [-publishes n]\n", argv[0]);
+		return 1;
+	}
+
+	// all three slots start as sequence 0, which the reader holds until its first acquire
+	TripleBuffer<Payload> Buffer;
+	for (int i=0; i<3; ++i)
+		FillPayload(&Buffer.GetSlot(i), 0);
+
+	std::thread Writer([&Buffer, Publishes]()
+	{
+		for (unsigned long long s=1; s<=Publishes; ++s)
+		{
+			FillPayload(&Buffer.GetWriteSlot(), s);
+			Buffer.Publish();
+		}
+	});
+
+	unsigned long long Last = 0;
+	unsigned long long Acquires = 0;
+	unsigned long long Checks = 0;
+	unsigned long long Torn = 0;
+	unsigned long long OutOfOrder = 0;
+	while (Last < Publishes)
+	{
+		bool Fresh = Buffer.Acquire();
+		const Payload &P = Buffer.GetReadSlot();
+
+		// the read slot is checked on every pass, not only after an acquire, since the writer must
+		// never touch it while it's held
+		unsigned long long Sequence = P.Sequence;
+		if (!PayloadIntact(P))
+		{
+			if (Torn < 10)
+				printf("torn payload, sequence %llu\n", Sequence);
+			++Torn;
+		}
+		if (Fresh ? Sequence <= Last : Sequence != Last)
+		{
+			if (OutOfOrder < 10)
+				printf("sequence %llu after %llu%s\n", Sequence, Last, Fresh ? "" : " without an acquire");
+			++OutOfOrder;
+		}
+		if (Fresh)
+			++Acquires;
+		Last = Sequence > Last ? Sequence : Last;
+		++Checks;
+	}
+	Writer.join();
+
+	printf("publishes    %llu\n", Publishes);
+	printf("acquires     %llu\n", Acquires);
+	printf("checks       %llu\n", Checks);
+	printf("torn         %llu\n", Torn);
+	printf("out of order %llu\n", OutOfOrder);
+
+	return (Torn == 0 && OutOfOrder == 0 && Last == Publishes) ? 0 : 1;
+}
@@ -0,0 +1,17 @@
+//***************************************************************************************
+// Headless/d3dUtil.cpp
+//
+// Definitions for the headless stand-in of d3dUtil.h.
+//***************************************************************************************
+
+#include "d3dUtil.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+void dprintf(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+}
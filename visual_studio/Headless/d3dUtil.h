@@ -0,0 +1,319 @@
+//***************************************************************************************
+// Headless/d3dUtil.h
+//
+// Stand-in for Framework/d3dUtil.h used by the headless (non-Windows) build.  Provides
+// the subset of XNA Math that the Helpers' simulation code (Room, Portal, Camera,
+// SpherePath, FirstPersonObject) relies on, with the same row-vector conventions,
+// so those files compile unmodified with GCC/Clang.
+//***************************************************************************************
+
+#ifndef D3DUTIL_H
+#define D3DUTIL_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+
+using std::min;
+using std::max;
+
+typedef unsigned int UINT;
+typedef float FLOAT;
+
+
+struct XMFLOAT2
+{
+	float x, y;
+	XMFLOAT2() {}
+	XMFLOAT2(float x, float y) : x(x), y(y) {}
+};
+
+struct XMFLOAT3
+{
+	float x, y, z;
+	XMFLOAT3() {}
+	XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+
+struct XMFLOAT4
+{
+	float x, y, z, w;
+	XMFLOAT4() {}
+	XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+};
+
+
+struct XMVECTOR
+{
+	float v[4];
+};
+typedef const XMVECTOR& FXMVECTOR;
+typedef const XMVECTOR& CXMVECTOR;
+
+inline XMVECTOR XMVectorSet(float x, float y, float z, float w)
+{
+	XMVECTOR V = {{x, y, z, w}};
+	return V;
+}
+inline XMVECTOR XMVectorReplicate(float s) { return XMVectorSet(s, s, s, s); }
+inline XMVECTOR XMVectorZero() { return XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f); }
+
+inline float XMVectorGetX(FXMVECTOR V) { return V.v[0]; }
+inline float XMVectorGetY(FXMVECTOR V) { return V.v[1]; }
+inline float XMVectorGetZ(FXMVECTOR V) { return V.v[2]; }
+inline float XMVectorGetW(FXMVECTOR V) { return V.v[3]; }
+
+inline XMVECTOR operator+(FXMVECTOR A, FXMVECTOR B) { return XMVectorSet(A.v[0]+B.v[0], A.v[1]+B.v[1], A.v[2]+B.v[2], A.v[3]+B.v[3]); }
+inline XMVECTOR operator-(FXMVECTOR A, FXMVECTOR B) { return XMVectorSet(A.v[0]-B.v[0], A.v[1]-B.v[1], A.v[2]-B.v[2], A.v[3]-B.v[3]); }
+inline XMVECTOR operator*(FXMVECTOR A, FXMVECTOR B) { return XMVectorSet(A.v[0]*B.v[0], A.v[1]*B.v[1], A.v[2]*B.v[2], A.v[3]*B.v[3]); }
+inline XMVECTOR operator-(FXMVECTOR A) { return XMVectorSet(-A.v[0], -A.v[1], -A.v[2], -A.v[3]); }
+inline XMVECTOR operator*(float s, FXMVECTOR A) { return XMVectorSet(s*A.v[0], s*A.v[1], s*A.v[2], s*A.v[3]); }
+inline XMVECTOR operator*(FXMVECTOR A, float s) { return s*A; }
+inline XMVECTOR operator/(FXMVECTOR A, float s) { return XMVectorSet(A.v[0]/s, A.v[1]/s, A.v[2]/s, A.v[3]/s); }
+inline XMVECTOR& operator+=(XMVECTOR &A, FXMVECTOR B) { A = A+B; return A; }
+inline XMVECTOR& operator-=(XMVECTOR &A, FXMVECTOR B) { A = A-B; return A; }
+inline XMVECTOR& operator*=(XMVECTOR &A, float s) { A = s*A; return A; }
+
+inline XMVECTOR XMLoadFloat2(const XMFLOAT2 *p) { return XMVectorSet(p->x, p->y, 0.0f, 0.0f); }
+inline XMVECTOR XMLoadFloat3(const XMFLOAT3 *p) { return XMVectorSet(p->x, p->y, p->z, 0.0f); }
+inline XMVECTOR XMLoadFloat4(const XMFLOAT4 *p) { return XMVectorSet(p->x, p->y, p->z, p->w); }
+inline void XMStoreFloat2(XMFLOAT2 *p, FXMVECTOR V) { p->x = V.v[0]; p->y = V.v[1]; }
+inline void XMStoreFloat3(XMFLOAT3 *p, FXMVECTOR V) { p->x = V.v[0]; p->y = V.v[1]; p->z = V.v[2]; }
+inline void XMStoreFloat4(XMFLOAT4 *p, FXMVECTOR V) { p->x = V.v[0]; p->y = V.v[1]; p->z = V.v[2]; p->w = V.v[3]; }
+
+inline XMVECTOR XMVector3Dot(FXMVECTOR A, FXMVECTOR B)
+{
+	return XMVectorReplicate(A.v[0]*B.v[0] + A.v[1]*B.v[1] + A.v[2]*B.v[2]);
+}
+inline XMVECTOR XMVector3Cross(FXMVECTOR A, FXMVECTOR B)
+{
+	return XMVectorSet(A.v[1]*B.v[2] - A.v[2]*B.v[1],
+						A.v[2]*B.v[0] - A.v[0]*B.v[2],
+						A.v[0]*B.v[1] - A.v[1]*B.v[0],
+						0.0f);
+}
+inline XMVECTOR XMVector3LengthSq(FXMVECTOR V) { return XMVector3Dot(V, V); }
+inline XMVECTOR XMVector3Length(FXMVECTOR V) { return XMVectorReplicate(sqrtf(XMVectorGetX(XMVector3Dot(V, V)))); }
+inline XMVECTOR XMVector3Normalize(FXMVECTOR V)
+{
+	float L = XMVectorGetX(XMVector3Length(V));
+	if (L > 0.0f)
+		return V / L;
+	return V;
+}
+
+
+struct XMMATRIX
+{
+	XMVECTOR r[4];
+
+	XMMATRIX() {}
+	XMMATRIX(FXMVECTOR R0, FXMVECTOR R1, FXMVECTOR R2, CXMVECTOR R3)
+	{
+		r[0] = R0; r[1] = R1; r[2] = R2; r[3] = R3;
+	}
+	XMMATRIX(float m00, float m01, float m02, float m03,
+			float m10, float m11, float m12, float m13,
+			float m20, float m21, float m22, float m23,
+			float m30, float m31, float m32, float m33)
+	{
+		r[0] = XMVectorSet(m00, m01, m02, m03);
+		r[1] = XMVectorSet(m10, m11, m12, m13);
+		r[2] = XMVectorSet(m20, m21, m22, m23);
+		r[3] = XMVectorSet(m30, m31, m32, m33);
+	}
+
+	float operator()(UINT Row, UINT Column)const { return r[Row].v[Column]; }
+	float& operator()(UINT Row, UINT Column) { return r[Row].v[Column]; }
+
+	XMMATRIX& operator*=(const XMMATRIX &M);
+	XMMATRIX operator*(const XMMATRIX &M)const;
+};
+typedef const XMMATRIX& CXMMATRIX;
+
+inline XMMATRIX XMMatrixMultiply(CXMMATRIX A, CXMMATRIX B)
+{
+	XMMATRIX R;
+	for (int i=0; i<4; ++i)
+	{
+		for (int j=0; j<4; ++j)
+		{
+			R.r[i].v[j] = A.r[i].v[0]*B.r[0].v[j] + A.r[i].v[1]*B.r[1].v[j]
+						+ A.r[i].v[2]*B.r[2].v[j] + A.r[i].v[3]*B.r[3].v[j];
+		}
+	}
+	return R;
+}
+inline XMMATRIX& XMMATRIX::operator*=(const XMMATRIX &M) { *this = XMMatrixMultiply(*this, M); return *this; }
+inline XMMATRIX XMMATRIX::operator*(const XMMATRIX &M)const { return XMMatrixMultiply(*this, M); }
+
+inline XMMATRIX XMMatrixIdentity()
+{
+	return XMMATRIX(1.0f, 0.0f, 0.0f, 0.0f,
+					0.0f, 1.0f, 0.0f, 0.0f,
+					0.0f, 0.0f, 1.0f, 0.0f,
+					0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+inline XMMATRIX XMMatrixScaling(float sx, float sy, float sz)
+{
+	return XMMATRIX(sx,   0.0f, 0.0f, 0.0f,
+					0.0f, sy,   0.0f, 0.0f,
+					0.0f, 0.0f, sz,   0.0f,
+					0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+inline XMMATRIX XMMatrixTranslation(float x, float y, float z)
+{
+	return XMMATRIX(1.0f, 0.0f, 0.0f, 0.0f,
+					0.0f, 1.0f, 0.0f, 0.0f,
+					0.0f, 0.0f, 1.0f, 0.0f,
+					x,    y,    z,    1.0f);
+}
+
+inline XMMATRIX XMMatrixRotationX(float Angle)
+{
+	float s = sinf(Angle);
+	float c = cosf(Angle);
+	return XMMATRIX(1.0f, 0.0f, 0.0f, 0.0f,
+					0.0f, c,    s,    0.0f,
+					0.0f, -s,   c,    0.0f,
+					0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+inline XMMATRIX XMMatrixRotationY(float Angle)
+{
+	float s = sinf(Angle);
+	float c = cosf(Angle);
+	return XMMATRIX(c,    0.0f, -s,   0.0f,
+					0.0f, 1.0f, 0.0f, 0.0f,
+					s,    0.0f, c,    0.0f,
+					0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+inline XMMATRIX XMMatrixRotationAxis(FXMVECTOR Axis, float Angle)
+{
+	XMVECTOR N = XMVector3Normalize(Axis);
+	float x = N.v[0], y = N.v[1], z = N.v[2];
+	float s = sinf(Angle);
+	float c = cosf(Angle);
+	float t = 1.0f - c;
+	return XMMATRIX(c + t*x*x,		t*x*y + s*z,	t*x*z - s*y,	0.0f,
+					t*x*y - s*z,	c + t*y*y,		t*y*z + s*x,	0.0f,
+					t*x*z + s*y,	t*y*z - s*x,	c + t*z*z,		0.0f,
+					0.0f,			0.0f,			0.0f,			1.0f);
+}
+
+inline XMMATRIX XMMatrixTranspose(CXMMATRIX M)
+{
+	XMMATRIX T;
+	for (int i=0; i<4; ++i)
+		for (int j=0; j<4; ++j)
+			T.r[i].v[j] = M.r[j].v[i];
+	return T;
+}
+
+inline XMMATRIX XMMatrixInverse(XMVECTOR *pDeterminant, CXMMATRIX M)
+{
+	const float *m = &M.r[0].v[0];
+	float inv[16];
+
+	inv[0] = m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15] + m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10];
+	inv[4] = -m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15] - m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10];
+	inv[8] = m[4]*m[9]*m[15] - m[4]*m[11]*m[13] - m[8]*m[5]*m[15] + m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9];
+	inv[12] = -m[4]*m[9]*m[14] + m[4]*m[10]*m[13] + m[8]*m[5]*m[14] - m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9];
+	inv[1] = -m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15] - m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10];
+	inv[5] = m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15] + m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10];
+	inv[9] = -m[0]*m[9]*m[15] + m[0]*m[11]*m[13] + m[8]*m[1]*m[15] - m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9];
+	inv[13] = m[0]*m[9]*m[14] - m[0]*m[10]*m[13] - m[8]*m[1]*m[14] + m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9];
+	inv[2] = m[1]*m[6]*m[15] - m[1]*m[7]*m[14] - m[5]*m[2]*m[15] + m[5]*m[3]*m[14] + m[13]*m[2]*m[7] - m[13]*m[3]*m[6];
+	inv[6] = -m[0]*m[6]*m[15] + m[0]*m[7]*m[14] + m[4]*m[2]*m[15] - m[4]*m[3]*m[14] - m[12]*m[2]*m[7] + m[12]*m[3]*m[6];
+	inv[10] = m[0]*m[5]*m[15] - m[0]*m[7]*m[13] - m[4]*m[1]*m[15] + m[4]*m[3]*m[13] + m[12]*m[1]*m[7] - m[12]*m[3]*m[5];
+	inv[14] = -m[0]*m[5]*m[14] + m[0]*m[6]*m[13] + m[4]*m[1]*m[14] - m[4]*m[2]*m[13] - m[12]*m[1]*m[6] + m[12]*m[2]*m[5];
+	inv[3] = -m[1]*m[6]*m[11] + m[1]*m[7]*m[10] + m[5]*m[2]*m[11] - m[5]*m[3]*m[10] - m[9]*m[2]*m[7] + m[9]*m[3]*m[6];
+	inv[7] = m[0]*m[6]*m[11] - m[0]*m[7]*m[10] - m[4]*m[2]*m[11] + m[4]*m[3]*m[10] + m[8]*m[2]*m[7] - m[8]*m[3]*m[6];
+	inv[11] = -m[0]*m[5]*m[11] + m[0]*m[7]*m[9] + m[4]*m[1]*m[11] - m[4]*m[3]*m[9] - m[8]*m[1]*m[7] + m[8]*m[3]*m[5];
+	inv[15] = m[0]*m[5]*m[10] - m[0]*m[6]*m[9] - m[4]*m[1]*m[10] + m[4]*m[2]*m[9] + m[8]*m[1]*m[6] - m[8]*m[2]*m[5];
+
+	float det = m[0]*inv[0] + m[1]*inv[4] + m[2]*inv[8] + m[3]*inv[12];
+	if (pDeterminant)
+		*pDeterminant = XMVectorReplicate(det);
+
+	XMMATRIX R;
+	float *r = &R.r[0].v[0];
+	for (int i=0; i<16; ++i)
+		r[i] = inv[i] / det;
+	return R;
+}
+
+struct XMFLOAT4X4
+{
+	float m[4][4];
+	XMFLOAT4X4() {}
+	float operator()(UINT Row, UINT Column)const { return m[Row][Column]; }
+	float& operator()(UINT Row, UINT Column) { return m[Row][Column]; }
+};
+
+inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4 *p)
+{
+	XMMATRIX M;
+	for (int i=0; i<4; ++i)
+		M.r[i] = XMVectorSet(p->m[i][0], p->m[i][1], p->m[i][2], p->m[i][3]);
+	return M;
+}
+inline void XMStoreFloat4x4(XMFLOAT4X4 *p, CXMMATRIX M)
+{
+	for (int i=0; i<4; ++i)
+		for (int j=0; j<4; ++j)
+			p->m[i][j] = M.r[i].v[j];
+}
+
+inline XMVECTOR XMVector4Transform(FXMVECTOR V, CXMMATRIX M)
+{
+	XMVECTOR R;
+	for (int j=0; j<4; ++j)
+		R.v[j] = V.v[0]*M.r[0].v[j] + V.v[1]*M.r[1].v[j] + V.v[2]*M.r[2].v[j] + V.v[3]*M.r[3].v[j];
+	return R;
+}
+
+// same order of operations as xnamath's SSE versions: ((z*r2 + r3) + y*r1) + x*r0
+inline XMVECTOR XMVector3TransformCoord(FXMVECTOR V, CXMMATRIX M)
+{
+	XMVECTOR R;
+	for (int j=0; j<4; ++j)
+		R.v[j] = ((V.v[2]*M.r[2].v[j] + M.r[3].v[j]) + V.v[1]*M.r[1].v[j]) + V.v[0]*M.r[0].v[j];
+	float w = R.v[3];
+	for (int j=0; j<4; ++j)
+		R.v[j] = R.v[j] / w;
+	return R;
+}
+
+inline XMVECTOR XMVector3TransformNormal(FXMVECTOR V, CXMMATRIX M)
+{
+	XMVECTOR R;
+	for (int j=0; j<4; ++j)
+		R.v[j] = (V.v[2]*M.r[2].v[j] + V.v[1]*M.r[1].v[j]) + V.v[0]*M.r[0].v[j];
+	return R;
+}
+
+inline float XMConvertToRadians(float Degrees) { return Degrees * (3.14159265359f / 180.0f); }
+
+// winnt.h's.  elements are assigned T() instead of having their bytes cleared, so class types
+// are value-initialized
+template <typename T>
+inline void ZeroMemory(T *Destination, size_t Length)
+{
+	for (size_t i=0; i<Length/sizeof(T); ++i)
+		Destination[i] = T();
+}
+
+
+void dprintf(const char *format, ...);
+
+#endif // D3DUTIL_H
@@ -1,9 +1,13 @@
 #include "Camera.h"
 
+#if CAMERA_SSE_CULLING
+#include <xmmintrin.h>
+#endif
+
 
 Camera::Camera()
 	: FovY(PI/4.0f), Aspect(1.0f), Near(0.01f), Far(1000.0f), ViewScale(1.0f),
-	AttachedTo(0)
+	AttachedTo(0), TransformCount(0)
 {
 	Position = XMFLOAT3(0.0f, 0.0f, 0.0f);
 	Right = XMFLOAT3(1.0f, 0.0f, 0.0f);
@@ -51,6 +55,11 @@ float Camera::GetBoundingSphereRadius()const
 	return AttachedTo->GetBoundingSphereRadius();
 }
 
+unsigned int Camera::GetTransformCount()const
+{
+	return this->TransformCount;
+}
+
 XMMATRIX Camera::GetViewMatrix()const
 {
 	// calculate R, U, L axes scaled by ViewScale factor
@@ -75,6 +84,44 @@ XMMATRIX Camera::GetProjMatrix()const
 	return this->ProjMatrix;
 }
 
+bool Camera::GetObliqueProjMatrix(XMFLOAT3 PlanePosition, XMFLOAT3 PlaneNormal, XMMATRIX *ObliqueProj_ptr)const
+{
+	// the near plane can't be moved closer than Near, or behind the eye
+	float EyeDist = XMFloat3Dot(Position - PlanePosition, PlaneNormal);
+	if (EyeDist > -Near * ViewScale)
+		return false;
+
+	// view space plane.  the view matrix takes P to (dot(P-Position, Right), .., .., ViewScale), so a
+	// point with view coordinates V has dot(P-PlanePosition, PlaneNormal) proportional to dot(V, ViewPlane)
+	XMFLOAT4 ViewPlane(XMFloat3Dot(PlaneNormal, Right), XMFloat3Dot(PlaneNormal, Up), XMFloat3Dot(PlaneNormal, Look),
+						EyeDist / ViewScale);
+
+	*ObliqueProj_ptr = CalculateObliqueProjMatrix(ProjMatrix, ViewPlane);
+	return true;
+}
+
+XMMATRIX Camera::CalculateObliqueProjMatrix(const XMMATRIX &Proj, const XMFLOAT4 &ViewPlane)
+{
+	float XScale = XMVectorGetX(Proj.r[0]);
+	float YScale = XMVectorGetY(Proj.r[1]);
+	float A = XMVectorGetZ(Proj.r[2]);
+	float B = XMVectorGetZ(Proj.r[3]);
+
+	// the corner of the far face opposite the plane, (sgn(x), sgn(y), 1, 1) in clip space, taken back to view space
+	float QX = (ViewPlane.x > 0.0f ? 1.0f : (ViewPlane.x < 0.0f ? -1.0f : 0.0f)) / XScale;
+	float QY = (ViewPlane.y > 0.0f ? 1.0f : (ViewPlane.y < 0.0f ? -1.0f : 0.0f)) / YScale;
+	float QZ = 1.0f;
+	float QW = (1.0f - A) / B;
+
+	// clip z becomes a scaled distance to the plane.  the scale puts the far plane through Q,
+	// which keeps as much of the original frustum as possible
+	float Scale = 1.0f / (ViewPlane.x*QX + ViewPlane.y*QY + ViewPlane.z*QZ + ViewPlane.w*QW);
+	return XMMATRIX(	XScale,		0.0f,		Scale*ViewPlane.x,		0.0f,
+						0.0f,		YScale,		Scale*ViewPlane.y,		0.0f,
+						0.0f,		0.0f,		Scale*ViewPlane.z,		1.0f,
+						0.0f,		0.0f,		Scale*ViewPlane.w,		0.0f	);
+}
+
 void Camera::Orthonormalize()
 {
 	XMVECTOR R = XMLoadFloat3(&Right);
@@ -101,6 +148,33 @@ void Camera::UpdateProjMatrix()
 							0.0f,				0.0f,			Far/(Far-Near),			1.0f,
 							0.0f,				0.0f,			Near*Far/(Near-Far),	0.0f	
 						);
+
+	// frustum planes and edge rays used by the culling functions
+	float HalfFovY = FovY / 2.0f;
+	HalfFovX = atanf(tanf(HalfFovY)*Aspect);
+
+	LeftPlaneNormal = XMFLOAT3(cosf(HalfFovX), 0.0f, sinf(HalfFovX));
+	RightPlaneNormal = XMFLOAT3(-cosf(HalfFovX), 0.0f, sinf(HalfFovX));
+	BottomPlaneNormal = XMFLOAT3(0.0f, cosf(HalfFovY), sinf(HalfFovY));
+	TopPlaneNormal = XMFLOAT3(0.0f, -cosf(HalfFovY), sinf(HalfFovY));
+
+	LeftPlaneToZY = XMMatrixRotationY(HalfFovX);		// rotate CW around Y axis to YZ plane
+	RightPlaneToZY = XMMatrixRotationY(-HalfFovX);		// CCW
+	TopPlaneToXZ = XMMatrixRotationX(HalfFovY);			// rotate CW around X axis to XZ plane
+	BottomPlaneToXZ = XMMatrixRotationX(-HalfFovY);		// CCW
+
+	float Tan_HalfFovY = tanf(HalfFovY);
+	XMVECTOR TopLeftRay = XMVectorSet(-Aspect*Tan_HalfFovY, Tan_HalfFovY, 1.0f, 0.0f);
+
+	// 2D top and bottom rays in the ZY plane
+	XMVECTOR TopRayYZ = XMVector3TransformNormal(TopLeftRay, LeftPlaneToZY);
+	TopRay = XMFLOAT2(XMVectorGetZ(TopRayYZ), XMVectorGetY(TopRayYZ));
+	BottomRay = XMFLOAT2(TopRay.x, -TopRay.y);
+
+	// 2D left and right rays in the XZ plane
+	XMVECTOR LeftRayXZ = XMVector3TransformNormal(TopLeftRay, TopPlaneToXZ);
+	LeftRay = XMFLOAT2(XMVectorGetX(LeftRayXZ), XMVectorGetZ(LeftRayXZ));
+	RightRay = XMFLOAT2(-LeftRay.x, LeftRay.y);
 }
 
 
@@ -134,14 +208,14 @@ void Camera::LookAtAndLevel(XMFLOAT3 Target)
 
 void Camera::Level()
 {
-	XMVECTOR BU = XMLoadFloat3(&XMFLOAT3(0.0f, 1.0f, 0.0f));
+	XMVECTOR BU = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
 	XMVECTOR L = XMLoadFloat3(&Look);
 
 	XMVECTOR R;
 	XMVECTOR BUCrossL = XMVector3Cross(BU, L);
 	if (XMVectorGetX(XMVector3Length(BUCrossL)) == 0.0f)
 	{
-		R = XMLoadFloat3(&XMFLOAT3(1.0f, 0.0f, 0.0f));
+		R = XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
 	}
 	else
 	{
@@ -258,6 +332,8 @@ XMFLOAT3 Camera::MoveUp(float Dist)
 
 void Camera::Transform(const XMMATRIX &M)
 {
+	++TransformCount;
+
 	XMVECTOR R = XMLoadFloat3(&Right);
 	XMVECTOR U = XMLoadFloat3(&Up);
 	XMVECTOR L = XMLoadFloat3(&Look);
@@ -314,6 +390,22 @@ FirstPersonObject* Camera::DetachFromObject()
 	return Object;
 }
 
+void Camera::Interpolate(const Camera &From, const Camera &To, float t)
+{
+	*this = To;
+	this->AttachedTo = 0;
+	if (From.TransformCount != To.TransformCount)
+		return;
+
+	Position = From.Position + t*(To.Position - From.Position);
+	Right = From.Right + t*(To.Right - From.Right);
+	Up = From.Up + t*(To.Up - From.Up);
+	Look = From.Look + t*(To.Look - From.Look);
+	BodyUp = XMFloat3Normalize(From.BodyUp + t*(To.BodyUp - From.BodyUp));
+	ViewScale = From.ViewScale + t*(To.ViewScale - From.ViewScale);
+	Orthonormalize();
+}
+
 float Camera::SurfaceVisibilityFactor(XMFLOAT3 SurfacePoint, XMFLOAT3 SurfaceNormal)const
 {
 	XMVECTOR P = XMLoadFloat3(&SurfacePoint);
@@ -333,38 +425,39 @@ XMFLOAT3 Camera::SelfVirtualCollision(const XMMATRIX &Virtualize, float SphereRa
 	*RedirectDir_ptr = Dir;
 
 	// if this camera has no attached object, it cannot collide with itself
+	Vec3 Sw = Vec3Load(S);
+	Vec3 Dirw = Vec3Load(Dir);
 	if (!AttachedTo)
-		return S + MoveDist*Dir;
-
-	// calculate virtual S, virtual Dir, virtual MoveDist 
-	XMFLOAT3 Sv;
-	XMFLOAT3 Dirv;
-	XMVECTOR SVirtual = XMVector3TransformCoord(XMLoadFloat3(&S), Virtualize);
-	XMVECTOR DirVirtual = XMVector3TransformNormal(XMLoadFloat3(&Dir), Virtualize);
-	XMStoreFloat3(&Sv, SVirtual);
-	XMStoreFloat3(&Dirv, DirVirtual);
+		return Vec3Store(Sw + MoveDist*Dirw);
+
+	// calculate virtual S, virtual Dir, virtual MoveDist
+	Mat4 V = Mat4Load(Virtualize);
+	Vec3 Sv;
+	Vec3 Dirv;
+	Sv = Vec3TransformCoord(Sw, V);
+	Dirv = Vec3TransformNormal(Dirw, V);
 	// NOTE: do not normalize Dirv and do not scale MoveDistv
 
 	// the virtual sphereradius is scaled by DirvLength as well
-	float SphereRadiusv = SphereRadius * XMFloat3Length(Dirv);
+	float SphereRadiusv = SphereRadius * Vec3Length(Dirv);
 
 	// find collision
-	XMFLOAT3 g = S-Sv;
-	XMFLOAT3 h = Dir-Dirv;
+	Vec3 g = Sw-Sv;
+	Vec3 h = Dirw-Dirv;
 	float rsum = SphereRadius+SphereRadiusv;
-	// quadratic coefficients	
-	float a = XMFloat3LengthSq(h);
-	float b_half = XMFloat3Dot(g, h);
-	float c = XMFloat3LengthSq(g) - rsum*rsum;
+	// quadratic coefficients
+	float a = Vec3LengthSq(h);
+	float b_half = Vec3Dot(g, h);
+	float c = Vec3LengthSq(g) - rsum*rsum;
 
 	float discr_over_4 = b_half*b_half - a*c;		// discriminant/2
 	if (discr_over_4 <= 0.0f)
-		return S + MoveDist*Dir;
+		return Vec3Store(Sw + MoveDist*Dirw);
 
 	// find smaller root for t
 	float t = (-b_half - sqrtf(discr_over_4)) / a;
 	if (t < -T_THRESHOLD || t > MoveDist)
-		return S + MoveDist*Dir;
+		return Vec3Store(Sw + MoveDist*Dirw);
 
 	// collision occurs
 	*RedirectRatio_ptr = 0.0f;	// no redirects for self-collision
@@ -372,7 +465,7 @@ XMFLOAT3 Camera::SelfVirtualCollision(const XMMATRIX &Virtualize, float SphereRa
 
 	// bump t, calculate X
 	t -= T_BUMP;
-	return S + t*Dir;
+	return Vec3Store(Sw + t*Dirw);
 }
 
 
@@ -418,214 +511,235 @@ bool Camera::FrustumContainsDisc(XMFLOAT3 DiscCenter, XMFLOAT3 DiscNormal, float
 	XMMATRIX View = GetViewMatrix();
 	C = ViewScale * XMVector3TransformCoord(C, View);	// convert disccenter and discnormal to view space
 	N = XMVector3TransformNormal(N, View);
-	float HalfFovY = FovY / 2.0f;
-	float HalfFovX = atanf(tanf(HalfFovY)*Aspect);
-
-
-	// left plane
-	XMVECTOR LeftNP = XMLoadFloat3(&XMFLOAT3(cosf(HalfFovX), 0.0f, sinf(HalfFovX)));
-	float DiscCenterDistToLeftPlane = XMVectorGetX(XMVector3Dot(C, LeftNP));
-	float DiscRadiusTowardsLeftPlane = DiscRadius * XMVectorGetX(XMVector3Length(XMVector3Cross(N, LeftNP)));
-	if (DiscCenterDistToLeftPlane <= -DiscRadiusTowardsLeftPlane)
+	XMStoreFloat3(&DiscCenter, C);
+	XMStoreFloat3(&DiscNormal, N);
+
+	// order: left, right, bottom, top
+	const XMFLOAT3 *PlaneNormals[4] = { &LeftPlaneNormal, &RightPlaneNormal, &BottomPlaneNormal, &TopPlaneNormal };
+	float DistToPlanes[4];
+	float RadiusTowardsPlanes[4];
+	for (int i=0; i<4; ++i)
 	{
-		//dprintf("disc wrong side of left plane\n");
-		return false;
-	}
-
-	// right plane
-	XMVECTOR RightNP = XMLoadFloat3(&XMFLOAT3(-cosf(HalfFovX), 0.0f, sinf(HalfFovX)));
-	float DiscCenterDistToRightPlane = XMVectorGetX(XMVector3Dot(C, RightNP));
-	float DiscRadiusTowardsRightPlane = DiscRadius * XMVectorGetX(XMVector3Length(XMVector3Cross(N, RightNP)));
-	if (DiscCenterDistToRightPlane <= -DiscRadiusTowardsRightPlane)
-	{
-		//dprintf("disc wrong side of right plane\n");
-		return false;
-	}
-
-	// bottom plane
-	XMVECTOR BottomNP = XMLoadFloat3(&XMFLOAT3(0.0f, cosf(HalfFovY), sinf(HalfFovY)));
-	float DiscCenterDistToBottomPlane = XMVectorGetX(XMVector3Dot(C, BottomNP));
-	float DiscRadiusTowardsBottomPlane = DiscRadius * XMVectorGetX(XMVector3Length(XMVector3Cross(N, BottomNP)));
-	if (DiscCenterDistToBottomPlane <= -DiscRadiusTowardsBottomPlane)
-	{
-		//dprintf("disc wrong side of bottom plane\n");
-		return false;
-	}
-
-	// top plane
-	XMVECTOR TopNP = XMLoadFloat3(&XMFLOAT3(0.0f, -cosf(HalfFovY), sinf(HalfFovY)));
-	float DiscCenterDistToTopPlane = XMVectorGetX(XMVector3Dot(C, TopNP));
-	float DiscRadiusTowardsTopPlane = DiscRadius * XMVectorGetX(XMVector3Length(XMVector3Cross(N, TopNP)));
-	if (DiscCenterDistToTopPlane <= -DiscRadiusTowardsTopPlane)
-	{
-		//dprintf("disc wrong side of top plane\n");
-		return false;
+		XMVECTOR NP = XMLoadFloat3(PlaneNormals[i]);
+		DistToPlanes[i] = XMVectorGetX(XMVector3Dot(C, NP));
+		RadiusTowardsPlanes[i] = DiscRadius * XMVectorGetX(XMVector3Length(XMVector3Cross(N, NP)));
+		if (DistToPlanes[i] <= -RadiusTowardsPlanes[i])
+			return false;		// disc is on the wrong side of this plane
 	}
 
 
 	// now check if the disc is completely inside all planes, ie completely inside frustum
-	if ( (DiscCenterDistToLeftPlane >= DiscRadiusTowardsLeftPlane &&
-			DiscCenterDistToRightPlane >= DiscRadiusTowardsRightPlane) &&
-			(DiscCenterDistToBottomPlane >= DiscRadiusTowardsBottomPlane &&
-			DiscCenterDistToTopPlane >= DiscRadiusTowardsTopPlane ) )
+	if ( (DistToPlanes[0] >= RadiusTowardsPlanes[0] &&
+			DistToPlanes[1] >= RadiusTowardsPlanes[1]) &&
+			(DistToPlanes[2] >= RadiusTowardsPlanes[2] &&
+			DistToPlanes[3] >= RadiusTowardsPlanes[3] ) )
 	{
 		//dprintf("disc is completely inside all 4 planes\n");
 		return true;
 	}
 
+	return DiscCrossesFrustum(DiscCenter, DiscNormal, DiscRadius, DistToPlanes, RadiusTowardsPlanes);
+}
+
 
+// C and N are in view space.  the disc is known to be on the inside of all 4 planes or crossing them
+bool Camera::DiscCrossesFrustum(XMFLOAT3 DiscCenter, XMFLOAT3 DiscNormal, float DiscRadius, const float DistToPlanes[4],
+								const float RadiusTowardsPlanes[4])const
+{
 	// at this point, the disc must intersect the frustum somewhere.
 
 	// for each plane that the disc intersects, find the line segment of intersection with that plane
 	// for this disc to be partially in the frustum, at least one of these line segments of intersection
 	// has to be inside or partially inside the frustum rays of that plane
 	
-
+	XMVECTOR C = XMLoadFloat3(&DiscCenter);
+	XMVECTOR N = XMLoadFloat3(&DiscNormal);
 
 	XMVECTOR G,H,Q1,Q2;
 	XMFLOAT2 A, B;
 	float a;
 
-	// frustum ray directions
-	float Tan_HalfFovY = tanf(HalfFovY);
-	XMVECTOR TopLeftRay = XMLoadFloat3(&XMFLOAT3(-Aspect*Tan_HalfFovY, Tan_HalfFovY, 1.0f));
-
 
-	// check intersection in left and right frustum planes
+	// check intersection in left and right frustum planes (top and bottom rays in the ZY plane),
+	// then in the top and bottom planes (left and right rays in the XZ plane)
+	const XMFLOAT3 *PlaneNormals[4] = { &LeftPlaneNormal, &RightPlaneNormal, &TopPlaneNormal, &BottomPlaneNormal };
+	const XMMATRIX *PlaneTo2D[4] = { &LeftPlaneToZY, &RightPlaneToZY, &TopPlaneToXZ, &BottomPlaneToXZ };
+	const int PlaneIndex[4] = { 0, 1, 3, 2 };
 
-	
-	// calculate 2D top and bottom rays in the ZY plane. 
-	XMMATRIX M = XMMatrixRotationY(HalfFovX);	// rotate CW around Y axis to YZ plane
-	XMVECTOR TopRayYZ = XMVector3TransformNormal(TopLeftRay, M);
-	XMFLOAT2 TopRay = XMFLOAT2(XMVectorGetZ(TopRayYZ), XMVectorGetY(TopRayYZ));
-	XMFLOAT2 BottomRay = XMFLOAT2(TopRay.x, -TopRay.y);
-
-	// Left Plane
-	if (abs(DiscCenterDistToLeftPlane) < DiscRadiusTowardsLeftPlane)
+	for (int i=0; i<4; ++i)
 	{
-		//dprintf("Left plane intersected\n");
-
-		// find disc intersection segment endpoints with the left plane
-		XMVECTOR LeftM = XMVector3Cross(LeftNP, N);
-		a = DiscCenterDistToLeftPlane / XMVectorGetX(XMVector3Length(LeftM));
-		LeftM = XMVector3Normalize(LeftM);
-		G = C + a*(XMVector3Cross(LeftM, N));
-		H = sqrtf(DiscRadius*DiscRadius - a*a) * LeftM;
+		float DistToPlane = DistToPlanes[PlaneIndex[i]];
+		float RadiusTowardsPlane = RadiusTowardsPlanes[PlaneIndex[i]];
+		if (!(abs(DistToPlane) < RadiusTowardsPlane))
+			continue;
+
+		// find disc intersection segment endpoints with this plane
+		XMVECTOR PlaneM = XMVector3Cross(XMLoadFloat3(PlaneNormals[i]), N);
+		a = DistToPlane / XMVectorGetX(XMVector3Length(PlaneM));
+		PlaneM = XMVector3Normalize(PlaneM);
+		G = C + a*(XMVector3Cross(PlaneM, N));
+		H = sqrtf(DiscRadius*DiscRadius - a*a) * PlaneM;
 		Q1 = G - H;
 		Q2 = G + H;
 
-		// transform Q1 and Q2 to ZY plane
-		Q1 = XMVector3TransformCoord(Q1, M);
-		Q2 = XMVector3TransformCoord(Q2, M);
-
-		A = XMFLOAT2(XMVectorGetZ(Q1), XMVectorGetY(Q1));
-		B = XMFLOAT2(XMVectorGetZ(Q2), XMVectorGetY(Q2));
+		// transform Q1 and Q2 to the 2D plane of the frustum rays
+		Q1 = XMVector3TransformCoord(Q1, *PlaneTo2D[i]);
+		Q2 = XMVector3TransformCoord(Q2, *PlaneTo2D[i]);
 
-		if (FrustumContainsSegment2D(TopRay, BottomRay, A, B))
+		bool Contains;
+		if (i < 2)
 		{
-			//dprintf("			Left plane 2D frustum intersects disc.\n");
-			return true;
+			A = XMFLOAT2(XMVectorGetZ(Q1), XMVectorGetY(Q1));
+			B = XMFLOAT2(XMVectorGetZ(Q2), XMVectorGetY(Q2));
+			Contains = FrustumContainsSegment2D(TopRay, BottomRay, A, B);
 		}
-	}
-
-	// Right Plane
-	if (abs(DiscCenterDistToRightPlane) < DiscRadiusTowardsRightPlane)
-	{
-		//dprintf("Right plane intersected\n");
-
-
-		// find disc intersection segment endpoints with the Right plane
-		XMVECTOR RightM = XMVector3Cross(RightNP, N);
-		a = DiscCenterDistToRightPlane / XMVectorGetX(XMVector3Length(RightM));
-		RightM = XMVector3Normalize(RightM);
-		G = C + a*(XMVector3Cross(RightM, N));
-		H = sqrtf(DiscRadius*DiscRadius - a*a) * RightM;
-		Q1 = G - H;
-		Q2 = G + H;
-
-		// transform Q1 and Q2 to ZY plane, now rotating CCW around Y.
-		M = XMMatrixRotationY(-HalfFovX);
-		Q1 = XMVector3TransformCoord(Q1, M);
-		Q2 = XMVector3TransformCoord(Q2, M);
-
-		A = XMFLOAT2(XMVectorGetZ(Q1), XMVectorGetY(Q1));
-		B = XMFLOAT2(XMVectorGetZ(Q2), XMVectorGetY(Q2));
-
-		if (FrustumContainsSegment2D(TopRay, BottomRay, A, B))
+		else
 		{
-			//dprintf("			Right plane 2D frustum intersects disc.\n");
-			return true;
+			A = XMFLOAT2(XMVectorGetX(Q1), XMVectorGetZ(Q1));
+			B = XMFLOAT2(XMVectorGetX(Q2), XMVectorGetZ(Q2));
+			Contains = FrustumContainsSegment2D(LeftRay, RightRay, A, B);
 		}
+		if (Contains)
+			return true;
 	}
 
-
-	// Check intersection in the 
-
-	// calculate 2D top and bottom rays in the ZY plane. 
-	M = XMMatrixRotationX(HalfFovY);	// rotate CW around X axis to XZ plane
-	XMVECTOR LeftRayXZ = XMVector3TransformNormal(TopLeftRay, M);
-	XMFLOAT2 LeftRay = XMFLOAT2(XMVectorGetX(LeftRayXZ), XMVectorGetZ(LeftRayXZ));
-	XMFLOAT2 RightRay = XMFLOAT2(-LeftRay.x, LeftRay.y);
+	//dprintf("Disc intersects one of the 4 planes, but not any of the 2D frustums\n");
+	return false;
+}
 
 
-	// top plane
-	if (abs(DiscCenterDistToTopPlane) < DiscRadiusTowardsTopPlane)
+// the 4 side plane normals rotated into world space, in the order left, right, bottom, top
+void Camera::GetWorldPlaneNormals(XMFLOAT3 PlaneNormals[4])const
+{
+	const XMFLOAT3 *ViewPlaneNormals[4] = { &LeftPlaneNormal, &RightPlaneNormal, &BottomPlaneNormal, &TopPlaneNormal };
+	for (int i=0; i<4; ++i)
 	{
-		//dprintf("Top plane intersected\n");
-
-		// find disc intersection segment endpoints with the Top plane
-		XMVECTOR TopM = XMVector3Cross(TopNP, N);
-		a = DiscCenterDistToTopPlane / XMVectorGetX(XMVector3Length(TopM));
-		TopM = XMVector3Normalize(TopM);
-		G = C + a*(XMVector3Cross(TopM, N));
-		H = sqrtf(DiscRadius*DiscRadius - a*a) * TopM;
-		Q1 = G - H;
-		Q2 = G + H;
+		const XMFLOAT3 &NP = *ViewPlaneNormals[i];
+		PlaneNormals[i] = NP.x*Right + NP.y*Up + NP.z*Look;
+	}
+}
 
-		// transform Q1 and Q2 to XZ plane
-		Q1 = XMVector3TransformCoord(Q1, M);
-		Q2 = XMVector3TransformCoord(Q2, M);
 
-		A = XMFLOAT2(XMVectorGetX(Q1), XMVectorGetZ(Q1));
-		B = XMFLOAT2(XMVectorGetX(Q2), XMVectorGetZ(Q2));
+void Camera::ClassifySpheres(const XMFLOAT3 *Centers, const float *Radii, UINT Count, CullResult *Results)const
+{
+	XMFLOAT3 PlaneNormals[4];
+	GetWorldPlaneNormals(PlaneNormals);
 
-		if (FrustumContainsSegment2D(LeftRay, RightRay, A, B))
+	UINT i = 0;
+#if CAMERA_SSE_CULLING
+	__m128 Zero = _mm_setzero_ps();
+	for (; i+4<=Count; i+=4)
+	{
+		// sphere centers relative to the eye, 4 at a time
+		__m128 X = _mm_sub_ps(_mm_setr_ps(Centers[i].x, Centers[i+1].x, Centers[i+2].x, Centers[i+3].x), _mm_set1_ps(Position.x));
+		__m128 Y = _mm_sub_ps(_mm_setr_ps(Centers[i].y, Centers[i+1].y, Centers[i+2].y, Centers[i+3].y), _mm_set1_ps(Position.y));
+		__m128 Z = _mm_sub_ps(_mm_setr_ps(Centers[i].z, Centers[i+1].z, Centers[i+2].z, Centers[i+3].z), _mm_set1_ps(Position.z));
+		__m128 R = _mm_loadu_ps(Radii + i);
+		__m128 NegR = _mm_sub_ps(Zero, R);
+
+		__m128 Outside = Zero;
+		__m128 Inside = _mm_cmpeq_ps(Zero, Zero);
+		for (int p=0; p<4; ++p)
 		{
-			//dprintf("			Top plane 2D frustum intersects disc.\n");
-			return true;
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(X, _mm_set1_ps(PlaneNormals[p].x)),
+											_mm_mul_ps(Y, _mm_set1_ps(PlaneNormals[p].y))),
+											_mm_mul_ps(Z, _mm_set1_ps(PlaneNormals[p].z)));
+			Outside = _mm_or_ps(Outside, _mm_cmple_ps(d, NegR));
+			Inside = _mm_and_ps(Inside, _mm_cmpge_ps(d, R));
+		}
+
+		int OutsideMask = _mm_movemask_ps(Outside);
+		int InsideMask = _mm_movemask_ps(Inside);
+		for (int k=0; k<4; ++k)
+		{
+			if (OutsideMask & (1<<k))
+				Results[i+k] = CULL_OUTSIDE;
+			else if (InsideMask & (1<<k))
+				Results[i+k] = CULL_INSIDE;
+			else
+				Results[i+k] = CULL_INTERSECTING;
 		}
 	}
+#endif
 
-	// bottom plane
-	if (abs(DiscCenterDistToBottomPlane) < DiscRadiusTowardsBottomPlane)
+	// leftovers, or everything if the SSE version is off
+	for (; i<Count; ++i)
 	{
-		//dprintf("Bottom plane intersected\n");
+		XMFLOAT3 EC = Centers[i] - Position;
+		float R = Radii[i];
+		bool Outside = false;
+		bool Inside = true;
+		for (int p=0; p<4; ++p)
+		{
+			float d = (EC.x*PlaneNormals[p].x + EC.y*PlaneNormals[p].y) + EC.z*PlaneNormals[p].z;
+			Outside = Outside || (d <= -R);
+			Inside = Inside && (d >= R);
+		}
+		Results[i] = Outside ? CULL_OUTSIDE : (Inside ? CULL_INSIDE : CULL_INTERSECTING);
+	}
+}
 
 
-		// find disc intersection segment endpoints with the Bottom plane
-		XMVECTOR BottomM = XMVector3Cross(BottomNP, N);
-		a = DiscCenterDistToBottomPlane / XMVectorGetX(XMVector3Length(BottomM));
-		BottomM = XMVector3Normalize(BottomM);
-		G = C + a*(XMVector3Cross(BottomM, N));
-		H = sqrtf(DiscRadius*DiscRadius - a*a) * BottomM;
-		Q1 = G - H;
-		Q2 = G + H;
-
-		// transform Q1 and Q2 to ZY plane, now rotating CCW around X.
-		M = XMMatrixRotationX(-HalfFovY);
-		Q1 = XMVector3TransformCoord(Q1, M);
-		Q2 = XMVector3TransformCoord(Q2, M);
+void Camera::ClassifyDiscs(const XMFLOAT3 *Centers, const XMFLOAT3 *Normals, const float *Radii, UINT Count,
+						CullResult *Results)const
+{
+	// the plane tests are done in view space, same as FrustumContainsDisc.  a disc's radius towards
+	// a plane is DiscRadius * |N x NP|
+	XMMATRIX View = GetViewMatrix();
 
-		A = XMFLOAT2(XMVectorGetX(Q1), XMVectorGetZ(Q1));
-		B = XMFLOAT2(XMVectorGetX(Q2), XMVectorGetZ(Q2));
+	for (UINT i=0; i<Count; ++i)
+	{
+		XMFLOAT3 C;
+		XMFLOAT3 N;
+		XMStoreFloat3(&C, ViewScale * XMVector3TransformCoord(XMLoadFloat3(&Centers[i]), View));
+		XMStoreFloat3(&N, XMVector3TransformNormal(XMLoadFloat3(&Normals[i]), View));
+		float R = Radii[i];
+
+		float DistToPlanes[4];
+		float RadiusTowardsPlanes[4];
+#if CAMERA_SSE_CULLING
+		// all 4 planes at once
+		__m128 PX = _mm_setr_ps(LeftPlaneNormal.x, RightPlaneNormal.x, BottomPlaneNormal.x, TopPlaneNormal.x);
+		__m128 PY = _mm_setr_ps(LeftPlaneNormal.y, RightPlaneNormal.y, BottomPlaneNormal.y, TopPlaneNormal.y);
+		__m128 PZ = _mm_setr_ps(LeftPlaneNormal.z, RightPlaneNormal.z, BottomPlaneNormal.z, TopPlaneNormal.z);
+		__m128 NX = _mm_set1_ps(N.x);
+		__m128 NY = _mm_set1_ps(N.y);
+		__m128 NZ = _mm_set1_ps(N.z);
+
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(C.x), PX), _mm_mul_ps(_mm_set1_ps(C.y), PY)),
+								_mm_mul_ps(_mm_set1_ps(C.z), PZ));
+		__m128 CrossX = _mm_sub_ps(_mm_mul_ps(NY, PZ), _mm_mul_ps(NZ, PY));
+		__m128 CrossY = _mm_sub_ps(_mm_mul_ps(NZ, PX), _mm_mul_ps(NX, PZ));
+		__m128 CrossZ = _mm_sub_ps(_mm_mul_ps(NX, PY), _mm_mul_ps(NY, PX));
+		__m128 CrossLengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(CrossX, CrossX), _mm_mul_ps(CrossY, CrossY)),
+											_mm_mul_ps(CrossZ, CrossZ));
+		__m128 r = _mm_mul_ps(_mm_set1_ps(R), _mm_sqrt_ps(CrossLengthSq));
+		_mm_storeu_ps(DistToPlanes, d);
+		_mm_storeu_ps(RadiusTowardsPlanes, r);
+#else
+		const XMFLOAT3 *PlaneNormals[4] = { &LeftPlaneNormal, &RightPlaneNormal, &BottomPlaneNormal, &TopPlaneNormal };
+		for (int p=0; p<4; ++p)
+		{
+			DistToPlanes[p] = XMFloat3Dot(C, *PlaneNormals[p]);
+			RadiusTowardsPlanes[p] = R * XMFloat3Length(XMFloat3Cross(N, *PlaneNormals[p]));
+		}
+#endif
 
-		if (FrustumContainsSegment2D(LeftRay, RightRay, A, B))
+		bool Outside = false;
+		bool Inside = true;
+		for (int p=0; p<4; ++p)
 		{
-			//dprintf("			Bottom plane 2D frustum intersects disc.\n");
-			return true;
+			Outside = Outside || (DistToPlanes[p] <= -RadiusTowardsPlanes[p]);
+			Inside = Inside && (DistToPlanes[p] >= RadiusTowardsPlanes[p]);
 		}
-	}
 
-	//dprintf("Disc intersects one of the 4 planes, but not any of the 2D frustums\n");
-	return false;
+		if (Outside)
+			Results[i] = CULL_OUTSIDE;
+		else if (Inside)
+			Results[i] = CULL_INSIDE;
+		else if (DiscCrossesFrustum(C, N, R, DistToPlanes, RadiusTowardsPlanes))
+			Results[i] = CULL_INTERSECTING;
+		else
+			Results[i] = CULL_OUTSIDE;
+	}
 }
@@ -24,9 +24,32 @@ private:
 
 	FirstPersonObject *AttachedTo;	// an object that will move/rotate with this camera
 
+	unsigned int TransformCount;	// times Transform has been called, i.e. times the camera went through a portal
+
 	XMMATRIX ProjMatrix;	// cached projection matrix
 
+	// view space frustum, recalculated along with ProjMatrix.  the side planes go through the eye
+	// and their normals point into the frustum
+	float HalfFovX;
+	XMFLOAT3 LeftPlaneNormal;
+	XMFLOAT3 RightPlaneNormal;
+	XMFLOAT3 BottomPlaneNormal;
+	XMFLOAT3 TopPlaneNormal;
+
+	// rotations taking the left/right planes to the ZY plane and the top/bottom planes to the XZ plane,
+	// and the 2D frustum edge rays within those planes
+	XMMATRIX LeftPlaneToZY;
+	XMMATRIX RightPlaneToZY;
+	XMMATRIX TopPlaneToXZ;
+	XMMATRIX BottomPlaneToXZ;
+	XMFLOAT2 TopRay;
+	XMFLOAT2 BottomRay;
+	XMFLOAT2 LeftRay;
+	XMFLOAT2 RightRay;
+
 public:
+	enum CullResult { CULL_OUTSIDE = 0, CULL_INTERSECTING, CULL_INSIDE };
+
 	Camera();
 	~Camera();
 
@@ -38,9 +61,19 @@ public:
 
 	float GetViewScale()const;
 	float GetBoundingSphereRadius()const;
+	unsigned int GetTransformCount()const;
 
 	XMMATRIX GetViewMatrix()const;
 	XMMATRIX GetProjMatrix()const;
+
+	// projection matrix whose near plane is the plane through PlanePosition facing PlaneNormal, so anything
+	// behind that plane is clipped by the rasterizer instead of by clip() in the pixel shader.
+	// returns false if the eye isn't at least Near behind the plane; ObliqueProj_ptr is left alone then
+	bool GetObliqueProjMatrix(XMFLOAT3 PlanePosition, XMFLOAT3 PlaneNormal, XMMATRIX *ObliqueProj_ptr)const;
+
+	// Lengyel's oblique near plane.  Proj must be a perspective matrix like ProjMatrix, and ViewPlane a
+	// view space plane with the eye on its negative side.  points with dot(V, ViewPlane) < 0 get clip z < 0
+	static XMMATRIX CalculateObliqueProjMatrix(const XMMATRIX &Proj, const XMFLOAT4 &ViewPlane);
 	void Orthonormalize();
 
 	void SetPosition(XMFLOAT3 Position);
@@ -63,14 +96,28 @@ public:
 	void AttachToObject(FirstPersonObject *Object);
 	FirstPersonObject* DetachFromObject();
 
+	// becomes a detached copy of To, moved back towards From by 1-t.  if To has gone through a portal since From,
+	// there's nothing to interpolate along and it's just To
+	void Interpolate(const Camera &From, const Camera &To, float t);
+
 	float SurfaceVisibilityFactor(XMFLOAT3 SurfacePoint, XMFLOAT3 SurfaceNormal)const;
 	bool FrustumContainsDisc(XMFLOAT3 DiscCenter, XMFLOAT3 DiscNormal, float DiscRadius)const;
 
+	// classify Count spheres/discs against the 4 side planes of the frustum, using SSE.
+	// discs that cross a plane get the same segment test as FrustumContainsDisc, so a disc is
+	// CULL_OUTSIDE when FrustumContainsDisc would return false
+	void ClassifySpheres(const XMFLOAT3 *Centers, const float *Radii, UINT Count, CullResult *Results)const;
+	void ClassifyDiscs(const XMFLOAT3 *Centers, const XMFLOAT3 *Normals, const float *Radii, UINT Count,
+						CullResult *Results)const;
+
 	XMFLOAT3 SelfVirtualCollision(const XMMATRIX &Virtualize, float SphereRadius, XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist,
 									float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr)const;
 
 private:
 	void UpdateProjMatrix();
+	void GetWorldPlaneNormals(XMFLOAT3 PlaneNormals[4])const;
+	bool DiscCrossesFrustum(XMFLOAT3 C, XMFLOAT3 N, float DiscRadius, const float DistToPlanes[4],
+							const float RadiusTowardsPlanes[4])const;
 	static bool FrustumContainsSegment2D(const XMFLOAT2 &LDir, const XMFLOAT2 &RDir, 
 											const XMFLOAT2 &A, const XMFLOAT2 &B);
 
@@ -0,0 +1,338 @@
+#include "D3D11RenderBackend.h"
+
+D3D11RenderBackend::D3D11RenderBackend()
+	: Context(0), SlotBuffer(0), SlotSRV(0), SlotIndexVB(0), CurrentTech(0), BoundMesh(-1), BoundLevel(false),
+	ScissorEnabled(false)
+{
+	ZeroMemory(Meshes, sizeof(Meshes));
+	XMStoreFloat4x4(&World, XMMatrixIdentity());
+	XMStoreFloat4x4(&ViewProj, XMMatrixIdentity());
+	XMStoreFloat4x4(&PlayerWorld, XMMatrixIdentity());
+}
+
+D3D11RenderBackend::~D3D11RenderBackend()
+{
+	ReleaseCOM(SlotBuffer);
+	ReleaseCOM(SlotSRV);
+	ReleaseCOM(SlotIndexVB);
+}
+
+
+void D3D11RenderBackend::Init(ID3D11Device *Device, ID3D11DeviceContext *Context)
+{
+	this->Context = Context;
+
+	const UINT MaxSlots = PORTAL_ITERATIONS + 1;
+
+	// slot array, rewritten with WRITE_DISCARD for each portal
+	D3D11_BUFFER_DESC sbd;
+	sbd.Usage = D3D11_USAGE_DYNAMIC;
+	sbd.ByteWidth = sizeof(LevelSlot) * MaxSlots;
+	sbd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	sbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	sbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	sbd.StructureByteStride = sizeof(LevelSlot);
+	HR(Device->CreateBuffer(&sbd, 0, &SlotBuffer));
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvd;
+	srvd.Format = DXGI_FORMAT_UNKNOWN;
+	srvd.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvd.Buffer.FirstElement = 0;
+	srvd.Buffer.NumElements = MaxSlots;
+	HR(Device->CreateShaderResourceView(SlotBuffer, &srvd, &SlotSRV));
+
+	// per-instance slot indices.  StartInstanceLocation = s reads SlotIndices[s]
+	UINT SlotIndices[PORTAL_ITERATIONS + 1];
+	for (UINT i=0; i<MaxSlots; ++i)
+		SlotIndices[i] = i;
+
+	D3D11_BUFFER_DESC vbd;
+	vbd.Usage = D3D11_USAGE_IMMUTABLE;
+	vbd.ByteWidth = sizeof(UINT) * MaxSlots;
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbd.CPUAccessFlags = 0;
+	vbd.MiscFlags = 0;
+	vbd.StructureByteStride = 0;
+	D3D11_SUBRESOURCE_DATA vinitData;
+	vinitData.pSysMem = SlotIndices;
+	HR(Device->CreateBuffer(&vbd, &vinitData, &SlotIndexVB));
+
+	Effects::BasicFX->SetLevelSlots(SlotSRV);
+	Effects::RoomPortalFX->SetLevelSlots(SlotSRV);
+	Effects::PortalFX->SetLevelSlots(SlotSRV);
+}
+
+void D3D11RenderBackend::SetMesh(MeshType Mesh, const MeshDesc &Desc)
+{
+	Meshes[Mesh] = Desc;
+}
+
+void D3D11RenderBackend::SetDirLights(const DirectionalLight Lights[3])
+{
+	memcpy(DirLights, Lights, 3*sizeof(DirectionalLight));
+	Effects::RoomPortalFX->SetDirLights(DirLights);
+	Effects::BasicFX->SetDirLights(DirLights);
+	Invalidate();
+}
+
+void D3D11RenderBackend::SetPortalTextures(ID3D11ShaderResourceView *PortalADiffuseMap,
+											ID3D11ShaderResourceView *PortalBDiffuseMap)
+{
+	Effects::RoomPortalFX->SetPortalADiffuseMap(PortalADiffuseMap);
+	Effects::RoomPortalFX->SetPortalBDiffuseMap(PortalBDiffuseMap);
+	Invalidate();
+}
+
+
+UINT D3D11RenderBackend::GetIndexCount(MeshType Mesh)const
+{
+	return Meshes[Mesh].IndexCount;
+}
+
+// the app may have drawn or changed effect variables since the last frame
+void D3D11RenderBackend::BeginFrame()
+{
+	Invalidate();
+	BoundMesh = -1;
+	ScissorEnabled = false;
+}
+
+void D3D11RenderBackend::SetStencil(StencilMode Mode, UINT StencilRef)
+{
+	ID3D11DepthStencilState *DSS = 0;
+	switch (Mode)
+	{
+	case STENCIL_SET:
+		DSS = RenderStates::StencilSetToDSS;
+		break;
+	case STENCIL_EQUAL:
+		DSS = RenderStates::StencilEqualDSS;
+		break;
+	case STENCIL_EQUAL_DEPTH_ALWAYS:
+		DSS = RenderStates::StencilEqualDepthAlwaysDSS;
+		break;
+	case STENCIL_EQUAL_INCREMENT:
+		DSS = RenderStates::StencilEqualIncrementDSS;
+		break;
+	}
+	Context->OMSetDepthStencilState(DSS, StencilRef);
+}
+
+void D3D11RenderBackend::SetScissor(bool Enable, int Left, int Top, int Right, int Bottom)
+{
+	if (Enable)
+	{
+		D3D11_RECT Rect = { Left, Top, Right, Bottom };
+		Context->RSSetScissorRects(1, &Rect);
+	}
+	ScissorEnabled = Enable;
+	Invalidate();
+}
+
+void D3D11RenderBackend::SetPortals(const Portal &PortalA, const Portal &PortalB)
+{
+	Effects::RoomPortalFX->SetPortalA(PortalA.GetScaledPortalMatrix());
+	Effects::RoomPortalFX->SetPortalATexRadRatio(PortalA.GetTextureRadiusRatio());
+	Effects::RoomPortalFX->SetPortalB(PortalB.GetScaledPortalMatrix());
+	Effects::RoomPortalFX->SetPortalBTexRadRatio(PortalB.GetTextureRadiusRatio());
+	Invalidate();
+}
+
+void D3D11RenderBackend::SetEye(XMFLOAT3 EyePosition, float ViewScale)
+{
+	Effects::RoomPortalFX->SetEyePosW(EyePosition);
+	Effects::BasicFX->SetEyePosW(EyePosition);
+	Effects::RoomPortalFX->SetViewScale(ViewScale);
+	Effects::BasicFX->SetViewScale(ViewScale);
+	Invalidate();
+}
+
+void D3D11RenderBackend::SetLights(const XMFLOAT3 LightDirections[3])
+{
+	DirectionalLight Lights[3];
+	memcpy(Lights, DirLights, 3*sizeof(DirectionalLight));
+	for (unsigned int i=0; i<3; ++i)
+		Lights[i].Direction = LightDirections[i];
+
+	Effects::RoomPortalFX->SetDirLights(Lights);
+	Effects::BasicFX->SetDirLights(Lights);
+	Invalidate();
+}
+
+void D3D11RenderBackend::SetClipPlane(XMFLOAT3 Position, XMFLOAT3 Normal, float Offset)
+{
+	Effects::RoomPortalFX->SetClipPlanePosition(Position);
+	Effects::RoomPortalFX->SetClipPlaneNormal(Normal);
+	Effects::RoomPortalFX->SetClipPlaneOffset(Offset);
+	Effects::BasicFX->SetClipPlanePosition(Position);
+	Effects::BasicFX->SetClipPlaneNormal(Normal);
+	Effects::BasicFX->SetClipPlaneOffset(Offset);
+	Effects::PortalFX->SetClipPlanePosition(Position);
+	Effects::PortalFX->SetClipPlaneNormal(Normal);
+	Effects::PortalFX->SetClipPlaneOffset(Offset);
+	Invalidate();
+}
+
+void D3D11RenderBackend::SetObjectConstants(const XMFLOAT4X4 &World, const XMFLOAT4X4 &ViewProj)
+{
+	this->World = World;
+	this->ViewProj = ViewProj;
+	Invalidate();
+}
+
+void D3D11RenderBackend::DrawIndexed(MeshType Mesh, ShadeMode Mode, UINT Start, UINT Count)
+{
+	const MeshDesc &M = Meshes[Mesh];
+	bool PlaneClip = (Mode == SHADE_PLANE_CLIP);
+
+	ID3DX11EffectTechnique *Tech;
+	switch (Mesh)
+	{
+	case MESH_WALLS:
+	case MESH_FLOOR:
+	case MESH_CEILING:
+		if (Mode == SHADE_NO_PORTAL_HOLES)
+			Tech = Effects::RoomPortalFX->Light3TexPortalAPortalBNoHolesTech;
+		else
+			Tech = PlaneClip ? Effects::RoomPortalFX->Light3TexPortalAPortalBClipTech :
+								Effects::RoomPortalFX->Light3TexPortalAPortalBTech;
+		break;
+	case MESH_PLAYER:
+		Tech = PlaneClip ? Effects::BasicFX->Light3TexClipTech : Effects::BasicFX->Light3TexTech;
+		break;
+	case MESH_PORTAL_BOX:
+		Tech = PlaneClip ? Effects::PortalFX->PortalBoxClipTech : Effects::PortalFX->PortalBoxTech;
+		break;
+	default:
+		Tech = Effects::PortalFX->PortalBoxClearDepthTech;
+		break;
+	}
+
+	bool Rebind = ((int)Mesh != BoundMesh || BoundLevel);
+	if (Rebind)
+		BindMesh(Mesh, false);
+
+	if (Rebind || Tech != CurrentTech)
+	{
+		XMMATRIX W = XMLoadFloat4x4(&World);
+		XMMATRIX WorldViewProj = W * XMLoadFloat4x4(&ViewProj);
+		if (Mesh == MESH_PLAYER)
+		{
+			Effects::BasicFX->SetWorld(W);
+			Effects::BasicFX->SetWorldInvTranspose(MathFunctions::InverseTranspose(W));
+			Effects::BasicFX->SetWorldViewProj(WorldViewProj);
+		}
+		else if (Mesh == MESH_WALLS || Mesh == MESH_FLOOR || Mesh == MESH_CEILING)
+		{
+			Effects::RoomPortalFX->SetWorld(W);
+			Effects::RoomPortalFX->SetWorldInvTranspose(MathFunctions::InverseTranspose(W));
+			Effects::RoomPortalFX->SetWorldViewProj(WorldViewProj);
+		}
+		else
+		{
+			Effects::PortalFX->SetWorld(W);
+			Effects::PortalFX->SetWorldViewProj(WorldViewProj);
+		}
+
+		ApplyPass(Tech, Mesh);
+	}
+
+	Context->DrawIndexed(Count, M.IBOffset + Start, M.VBOffset);
+}
+
+void D3D11RenderBackend::SetLevelSlots(const LevelSlot *Slots, UINT SlotCount, const XMFLOAT4X4 &PlayerWorld)
+{
+	D3D11_MAPPED_SUBRESOURCE Mapped;
+	HR(Context->Map(SlotBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &Mapped));
+	memcpy(Mapped.pData, Slots, sizeof(LevelSlot) * min(SlotCount, (UINT)(PORTAL_ITERATIONS + 1)));
+	Context->Unmap(SlotBuffer, 0);
+
+	this->PlayerWorld = PlayerWorld;
+	Invalidate();
+}
+
+void D3D11RenderBackend::DrawLevel(MeshType Mesh, UINT Slot, bool PlaneClip, UINT Start, UINT Count)
+{
+	const MeshDesc &M = Meshes[Mesh];
+
+	ID3DX11EffectTechnique *Tech;
+	switch (Mesh)
+	{
+	case MESH_WALLS:
+	case MESH_FLOOR:
+	case MESH_CEILING:
+		Tech = PlaneClip ? Effects::RoomPortalFX->Light3TexPortalAPortalBClipLevelTech :
+							Effects::RoomPortalFX->Light3TexPortalAPortalBLevelTech;
+		break;
+	case MESH_PLAYER:
+		Tech = PlaneClip ? Effects::BasicFX->Light3TexClipLevelTech : Effects::BasicFX->Light3TexLevelTech;
+		break;
+	case MESH_PORTAL_BOX:
+		Tech = PlaneClip ? Effects::PortalFX->PortalBoxClipLevelTech : Effects::PortalFX->PortalBoxLevelTech;
+		break;
+	default:
+		Tech = Effects::PortalFX->PortalBoxClearDepthLevelTech;
+		break;
+	}
+
+	bool Rebind = ((int)Mesh != BoundMesh || !BoundLevel);
+	if (Rebind)
+		BindMesh(Mesh, true);
+
+	if (Rebind || Tech != CurrentTech)
+	{
+		if (Mesh == MESH_PLAYER)
+			Effects::BasicFX->SetLevelObjectWorld(XMLoadFloat4x4(&PlayerWorld));
+		else if (Mesh == MESH_WALLS || Mesh == MESH_FLOOR || Mesh == MESH_CEILING)
+			Effects::RoomPortalFX->SetLevelObjectWorld(XMMatrixIdentity());
+
+		ApplyPass(Tech, Mesh);
+	}
+
+	Context->DrawIndexedInstanced(Count, 1, M.IBOffset + Start, M.VBOffset, Slot);
+}
+
+
+void D3D11RenderBackend::Invalidate()
+{
+	CurrentTech = 0;
+}
+
+// the techniques all have a single pass.  only the portal box's passes use DepthBiasRS; the rest use the
+// default rasterizer state
+void D3D11RenderBackend::ApplyPass(ID3DX11EffectTechnique *Tech, MeshType Mesh)
+{
+	Tech->GetPassByIndex(0)->Apply(0, Context);
+	if (ScissorEnabled)
+		Context->RSSetState(Mesh == MESH_PORTAL_BOX ? RenderStates::ScissorDepthBiasRS : RenderStates::ScissorRS);
+	CurrentTech = Tech;
+}
+
+// binds Mesh's buffers and sets its material.  level draws also bind the slot indices as a second vertex buffer
+void D3D11RenderBackend::BindMesh(MeshType Mesh, bool Level)
+{
+	const MeshDesc &M = Meshes[Mesh];
+
+	ID3D11Buffer *VBs[2] = { M.VB, SlotIndexVB };
+	UINT Strides[2] = { sizeof(Vertex::Basic32), sizeof(UINT) };
+	UINT Offsets[2] = { 0, 0 };
+	Context->IASetInputLayout(Level ? InputLayouts::Basic32Level : InputLayouts::Basic32);
+	Context->IASetVertexBuffers(0, Level ? 2 : 1, VBs, Strides, Offsets);
+	Context->IASetIndexBuffer(M.IB, DXGI_FORMAT_R32_UINT, 0);
+	BoundMesh = Mesh;
+	BoundLevel = Level;
+
+	XMMATRIX TexTransform = XMLoadFloat4x4(&M.TexTransform);
+	if (Mesh == MESH_PLAYER)
+	{
+		Effects::BasicFX->SetTexTransform(TexTransform);
+		Effects::BasicFX->SetMaterial(M.Mat);
+		Effects::BasicFX->SetDiffuseMap(M.DiffuseMap);
+	}
+	else if (Mesh == MESH_WALLS || Mesh == MESH_FLOOR || Mesh == MESH_CEILING)
+	{
+		Effects::RoomPortalFX->SetTexTransform(TexTransform);
+		Effects::RoomPortalFX->SetMaterial(M.Mat);
+		Effects::RoomPortalFX->SetDiffuseMap(M.DiffuseMap);
+	}
+}
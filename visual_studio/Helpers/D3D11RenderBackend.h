@@ -0,0 +1,82 @@
+#ifndef D3D11RENDERBACKEND_H
+#define D3D11RENDERBACKEND_H
+
+#include "d3dUtil.h"
+#include "Light.h"
+#include "Effects.h"
+#include "Vertex.h"
+#include "MathFunctions.h"
+#include "RenderStates.h"
+#include "RenderBackend.h"
+
+// RenderBackend on a D3D11 context and the effects in Effects.  the level slots live in a dynamic structured
+// buffer that's rewritten once per portal, and each level draw is a one-instance DrawIndexedInstanced whose
+// StartInstanceLocation picks the slot out of a buffer of slot indices.
+// a mesh's buffers and material are only rebound when a different mesh is drawn, and consecutive draws of
+// the same mesh and technique with no Set* call between them (the wall ranges) share one pass Apply
+class D3D11RenderBackend : public RenderBackend
+{
+public:
+	// where a mesh is in its buffers, and what it's drawn with
+	struct MeshDesc
+	{
+		ID3D11Buffer *VB;
+		ID3D11Buffer *IB;
+		UINT IndexCount;
+		UINT IBOffset;
+		UINT VBOffset;
+		Material Mat;
+		XMFLOAT4X4 TexTransform;
+		ID3D11ShaderResourceView *DiffuseMap;
+	};
+
+	D3D11RenderBackend();
+	~D3D11RenderBackend();
+
+	// Effects and InputLayouts must be initialized first
+	void Init(ID3D11Device *Device, ID3D11DeviceContext *Context);
+	void SetMesh(MeshType Mesh, const MeshDesc &Desc);
+
+	// light colors; SetLights only changes the directions
+	void SetDirLights(const DirectionalLight Lights[3]);
+	void SetPortalTextures(ID3D11ShaderResourceView *PortalADiffuseMap, ID3D11ShaderResourceView *PortalBDiffuseMap);
+
+	UINT GetIndexCount(MeshType Mesh)const;
+	void BeginFrame();
+	void SetStencil(StencilMode Mode, UINT StencilRef);
+	void SetScissor(bool Enable, int Left, int Top, int Right, int Bottom);
+	void SetPortals(const Portal &PortalA, const Portal &PortalB);
+	void SetEye(XMFLOAT3 EyePosition, float ViewScale);
+	void SetLights(const XMFLOAT3 LightDirections[3]);
+	void SetClipPlane(XMFLOAT3 Position, XMFLOAT3 Normal, float Offset);
+	void SetObjectConstants(const XMFLOAT4X4 &World, const XMFLOAT4X4 &ViewProj);
+	void DrawIndexed(MeshType Mesh, ShadeMode Mode, UINT Start, UINT Count);
+	void SetLevelSlots(const LevelSlot *Slots, UINT SlotCount, const XMFLOAT4X4 &PlayerWorld);
+	void DrawLevel(MeshType Mesh, UINT Slot, bool PlaneClip, UINT Start, UINT Count);
+
+private:
+	ID3D11DeviceContext *Context;
+	ID3D11Buffer *SlotBuffer;
+	ID3D11ShaderResourceView *SlotSRV;
+	ID3D11Buffer *SlotIndexVB;		// 0, 1, 2, ... one per instance
+
+	MeshDesc Meshes[MESH_COUNT];
+	DirectionalLight DirLights[3];
+	XMFLOAT4X4 World;
+	XMFLOAT4X4 ViewProj;
+	XMFLOAT4X4 PlayerWorld;
+
+	// last technique applied, cleared by every Set* call.  and the mesh that's bound, cleared by BeginFrame
+	ID3DX11EffectTechnique *CurrentTech;
+	int BoundMesh;
+	bool BoundLevel;
+
+	// every pass Apply resets the rasterizer state, so a scissor-enabled one is set again after each
+	bool ScissorEnabled;
+
+	void Invalidate();
+	void BindMesh(MeshType Mesh, bool Level);
+	void ApplyPass(ID3DX11EffectTechnique *Tech, MeshType Mesh);
+};
+
+#endif
@@ -32,6 +32,8 @@ BasicEffect::BasicEffect(ID3D11Device* device, const std::wstring& filename)
 	Light3Tech    = mFX->GetTechniqueByName("Light3");
 	Light3TexTech = mFX->GetTechniqueByName("Light3Tex");
 	Light3TexClipTech= mFX->GetTechniqueByName("Light3TexClip");
+	Light3TexLevelTech = mFX->GetTechniqueByName("Light3TexLevel");
+	Light3TexClipLevelTech = mFX->GetTechniqueByName("Light3TexClipLevel");
 
 	WireframeTech = mFX->GetTechniqueByName("Wireframe");
 
@@ -47,6 +49,9 @@ BasicEffect::BasicEffect(ID3D11Device* device, const std::wstring& filename)
 	DirLights         = mFX->GetVariableByName("gDirLights");
 	Mat		          = mFX->GetVariableByName("gMaterial");
 	DiffuseMap        = mFX->GetVariableByName("gDiffuseMap")->AsShaderResource();
+	// per-instance slot levels
+	LevelObjectWorld	= mFX->GetVariableByName("gLevelObjectWorld")->AsMatrix();
+	LevelSlots			= mFX->GetVariableByName("gLevelSlots")->AsShaderResource();
 }
 
 BasicEffect::~BasicEffect()
@@ -64,6 +69,8 @@ RoomPortalEffect::RoomPortalEffect(ID3D11Device* device, const std::wstring& fil
 	Light3TexPortalAPortalBTech    = mFX->GetTechniqueByName("Light3TexPortalAPortalB");
 	Light3TexPortalAPortalBClipTech    = mFX->GetTechniqueByName("Light3TexPortalAPortalBClip");
 	Light3TexPortalAPortalBNoHolesTech    = mFX->GetTechniqueByName("Light3TexPortalAPortalBNoHoles");
+	Light3TexPortalAPortalBLevelTech    = mFX->GetTechniqueByName("Light3TexPortalAPortalBLevel");
+	Light3TexPortalAPortalBClipLevelTech    = mFX->GetTechniqueByName("Light3TexPortalAPortalBClipLevel");
 
 	WorldViewProj     = mFX->GetVariableByName("gWorldViewProj")->AsMatrix();
 	World             = mFX->GetVariableByName("gWorld")->AsMatrix();
@@ -84,6 +91,9 @@ RoomPortalEffect::RoomPortalEffect(ID3D11Device* device, const std::wstring& fil
 	PortalB					= mFX->GetVariableByName("gPortalB")->AsMatrix();
 	PortalBTexRadRatio		= mFX->GetVariableByName("gPortalBTexRadRatio")->AsScalar();
 	PortalBDiffuseMap		= mFX->GetVariableByName("gPortalBDiffuseMap")->AsShaderResource();
+	// per-instance slot levels
+	LevelObjectWorld	= mFX->GetVariableByName("gLevelObjectWorld")->AsMatrix();
+	LevelSlots			= mFX->GetVariableByName("gLevelSlots")->AsShaderResource();
 }
 
 RoomPortalEffect::~RoomPortalEffect()
@@ -101,12 +111,17 @@ PortalEffect::PortalEffect(ID3D11Device* device, const std::wstring& filename)
 	PortalBoxTech    = mFX->GetTechniqueByName("PortalBox");
 	PortalBoxClipTech    = mFX->GetTechniqueByName("PortalBoxClip");
 	PortalBoxClearDepthTech = mFX->GetTechniqueByName("PortalBoxClearDepth");
+	PortalBoxLevelTech    = mFX->GetTechniqueByName("PortalBoxLevel");
+	PortalBoxClipLevelTech    = mFX->GetTechniqueByName("PortalBoxClipLevel");
+	PortalBoxClearDepthLevelTech = mFX->GetTechniqueByName("PortalBoxClearDepthLevel");
 
 	WorldViewProj     = mFX->GetVariableByName("gWorldViewProj")->AsMatrix();
 	World             = mFX->GetVariableByName("gWorld")->AsMatrix();
 		ClipPlanePosition           = mFX->GetVariableByName("gClipPlanePosition")->AsVector();
 		ClipPlaneNormal				= mFX->GetVariableByName("gClipPlaneNormal")->AsVector();
 		ClipPlaneOffset			= mFX->GetVariableByName("gClipPlaneOffset")->AsScalar();
+	// per-instance slot levels
+	LevelSlots			= mFX->GetVariableByName("gLevelSlots")->AsShaderResource();
 }
 
 PortalEffect::~PortalEffect()
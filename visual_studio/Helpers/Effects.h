@@ -39,10 +39,15 @@ public:
 	void SetDirLights(const DirectionalLight* lights)   { DirLights->SetRawValue(lights, 0, 3*sizeof(DirectionalLight)); }
 	void SetMaterial(const Material& mat)               { Mat->SetRawValue(&mat, 0, sizeof(Material)); }
 	void SetDiffuseMap(ID3D11ShaderResourceView* tex)   { DiffuseMap->SetResource(tex); }
+	// per-instance slot levels
+	void SetLevelObjectWorld(CXMMATRIX M)					{ LevelObjectWorld->SetMatrix(reinterpret_cast<const float*>(&M)); }
+	void SetLevelSlots(ID3D11ShaderResourceView* slots)		{ LevelSlots->SetResource(slots); }
 
 	ID3DX11EffectTechnique* Light3Tech;
 	ID3DX11EffectTechnique* Light3TexTech;
 	ID3DX11EffectTechnique* Light3TexClipTech;
+	ID3DX11EffectTechnique* Light3TexLevelTech;
+	ID3DX11EffectTechnique* Light3TexClipLevelTech;
 	ID3DX11EffectTechnique* WireframeTech;
 
 
@@ -58,6 +63,9 @@ public:
 	ID3DX11EffectVariable* DirLights;
 	ID3DX11EffectVariable* Mat;			// don't call this "Material": that's a class name
 	ID3DX11EffectShaderResourceVariable* DiffuseMap;
+	// per-instance slot levels
+	ID3DX11EffectMatrixVariable* LevelObjectWorld;
+	ID3DX11EffectShaderResourceVariable* LevelSlots;
 };
 
 
@@ -92,6 +100,9 @@ public:
 	void SetPortalB(CXMMATRIX M)								{ PortalB->SetMatrix(reinterpret_cast<const float*>(&M)); }
 	void SetPortalBTexRadRatio(float f)							{ PortalBTexRadRatio->SetFloat(f); }
 	void SetPortalBDiffuseMap(ID3D11ShaderResourceView* tex)	{ PortalBDiffuseMap->SetResource(tex); }
+	// per-instance slot levels
+	void SetLevelObjectWorld(CXMMATRIX M)					{ LevelObjectWorld->SetMatrix(reinterpret_cast<const float*>(&M)); }
+	void SetLevelSlots(ID3D11ShaderResourceView* slots)		{ LevelSlots->SetResource(slots); }
 
 
 	ID3DX11EffectTechnique* Light3TexPortalAClipTech;
@@ -99,6 +110,8 @@ public:
 	ID3DX11EffectTechnique* Light3TexPortalAPortalBTech;
 	ID3DX11EffectTechnique* Light3TexPortalAPortalBClipTech;
 	ID3DX11EffectTechnique* Light3TexPortalAPortalBNoHolesTech;
+	ID3DX11EffectTechnique* Light3TexPortalAPortalBLevelTech;
+	ID3DX11EffectTechnique* Light3TexPortalAPortalBClipLevelTech;
 
 
 	ID3DX11EffectMatrixVariable* WorldViewProj;
@@ -121,6 +134,9 @@ public:
 	ID3DX11EffectMatrixVariable* PortalB;
 	ID3DX11EffectScalarVariable* PortalBTexRadRatio;
 	ID3DX11EffectShaderResourceVariable* PortalBDiffuseMap;
+	// per-instance slot levels
+	ID3DX11EffectMatrixVariable* LevelObjectWorld;
+	ID3DX11EffectShaderResourceVariable* LevelSlots;
 };
 
 
@@ -138,16 +154,23 @@ public:
 		void SetClipPlanePosition(const XMFLOAT3& v)		{ ClipPlanePosition->SetRawValue(&v, 0, sizeof(XMFLOAT3)); }
 		void SetClipPlaneNormal(const XMFLOAT3& v)			{ ClipPlaneNormal->SetRawValue(&v, 0, sizeof(XMFLOAT3)); }
 		void SetClipPlaneOffset(float f)					{ ClipPlaneOffset->SetFloat(f); }
+	// per-instance slot levels
+	void SetLevelSlots(ID3D11ShaderResourceView* slots)		{ LevelSlots->SetResource(slots); }
 
 	ID3DX11EffectTechnique* PortalBoxTech;
 	ID3DX11EffectTechnique* PortalBoxClipTech;
 	ID3DX11EffectTechnique* PortalBoxClearDepthTech;
+	ID3DX11EffectTechnique* PortalBoxLevelTech;
+	ID3DX11EffectTechnique* PortalBoxClipLevelTech;
+	ID3DX11EffectTechnique* PortalBoxClearDepthLevelTech;
 
 	ID3DX11EffectMatrixVariable* WorldViewProj;
 	ID3DX11EffectMatrixVariable* World;
 		ID3DX11EffectVectorVariable* ClipPlanePosition;
 		ID3DX11EffectVectorVariable* ClipPlaneNormal;
 		ID3DX11EffectScalarVariable* ClipPlaneOffset;
+	// per-instance slot levels
+	ID3DX11EffectShaderResourceVariable* LevelSlots;
 };
 
 
@@ -0,0 +1,91 @@
+#include "FixedTimestep.h"
+
+FixedTimestep::FixedTimestep(double Step, UINT MaxTicksPerAdvance)
+	: Step(Step), MaxTicksPerAdvance(MaxTicksPerAdvance), Accumulator(0.0), Ticks(0)
+{
+	ResetStats();
+}
+
+FixedTimestep::~FixedTimestep()
+{
+}
+
+UINT FixedTimestep::Advance(double Elapsed)
+{
+	if (Elapsed > 0.0)
+		Accumulator += Elapsed;
+
+	UINT Due = (UINT)(Accumulator / Step);
+	Accumulator -= Due * Step;
+	if (Due > MaxTicksPerAdvance)
+	{
+		Stats.DroppedTicks += Due - MaxTicksPerAdvance;
+		Due = MaxTicksPerAdvance;
+	}
+
+	Ticks += Due;
+	return Due;
+}
+
+double FixedTimestep::GetStep()const
+{
+	return Step;
+}
+
+UINT FixedTimestep::GetTicks()const
+{
+	return Ticks;
+}
+
+double FixedTimestep::GetTime()const
+{
+	return Ticks * Step;
+}
+
+double FixedTimestep::GetAlpha()const
+{
+	return Accumulator / Step;
+}
+
+double FixedTimestep::GetTimeToNextTick()const
+{
+	return Step - Accumulator;
+}
+
+
+void FixedTimestep::RecordTick(double Microseconds, UINT Substeps)
+{
+	++Stats.Ticks;
+	Stats.Substeps += Substeps;
+	Stats.TotalMicroseconds += Microseconds;
+	if (Microseconds > Stats.MaxMicroseconds)
+		Stats.MaxMicroseconds = Microseconds;
+
+	UINT Bucket = 0;
+	while (Bucket < FIXED_TIMESTEP_HISTOGRAM_BUCKETS-1 && Microseconds >= (double)(1u << Bucket))
+		++Bucket;
+	++Stats.Histogram[Bucket];
+}
+
+const FixedTimestep::TickStats& FixedTimestep::GetStats()const
+{
+	return Stats;
+}
+
+void FixedTimestep::ResetStats()
+{
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+double FixedTimestep::GetPercentileMicroseconds(double p)const
+{
+	UINT Target = (UINT)(p * Stats.Ticks + 0.5);
+	UINT Count = 0;
+	for (UINT i=0; i<FIXED_TIMESTEP_HISTOGRAM_BUCKETS; ++i)
+	{
+		Count += Stats.Histogram[i];
+		if (Count >= Target && Count > 0)
+			return std::min((double)(1u << i), Stats.MaxMicroseconds);
+	}
+	return Stats.MaxMicroseconds;
+}
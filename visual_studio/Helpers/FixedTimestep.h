@@ -0,0 +1,53 @@
+#ifndef FIXEDTIMESTEP_H
+#define FIXEDTIMESTEP_H
+
+#include "d3dUtil.h"
+#include "Macros.h"
+
+// turns variable frame times into whole ticks of a fixed length, carrying what's left over to the next frame.
+// every tick simulates exactly Step seconds, so the same input per tick gives bit-identical results no matter
+// what the frame rate was.  at most MaxTicksPerAdvance ticks are run per Advance; the time owed beyond that is
+// dropped, so a stall doesn't snowball into ever longer frames.  also keeps cost statistics of the ticks run,
+// which the caller times and reports with RecordTick
+class FixedTimestep
+{
+public:
+	// tick costs are bucketed by powers of two of microseconds: bucket i holds costs in [2^(i-1), 2^i)
+	struct TickStats
+	{
+		UINT Ticks;
+		UINT DroppedTicks;
+		UINT Substeps;
+		double TotalMicroseconds;
+		double MaxMicroseconds;
+		UINT Histogram[FIXED_TIMESTEP_HISTOGRAM_BUCKETS];
+	};
+
+	FixedTimestep(double Step, UINT MaxTicksPerAdvance);
+	~FixedTimestep();
+
+	// adds Elapsed seconds, and returns how many ticks are due now
+	UINT Advance(double Elapsed);
+
+	double GetStep()const;
+	UINT GetTicks()const;				// ticks run since construction, counting the ones due from Advance
+	double GetTime()const;				// GetTicks() * Step
+	double GetAlpha()const;				// how far into the next tick the leftover time is, from 0 to 1
+	double GetTimeToNextTick()const;
+
+	void RecordTick(double Microseconds, UINT Substeps);
+	const TickStats& GetStats()const;
+	void ResetStats();
+
+	// upper bound of the histogram bucket the p'th fraction of recorded ticks fall into
+	double GetPercentileMicroseconds(double p)const;
+
+private:
+	double Step;
+	UINT MaxTicksPerAdvance;
+	double Accumulator;
+	UINT Ticks;
+	TickStats Stats;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "InputScript.h"
+#include "RoomFile.h"
+
+#ifndef _MSC_VER
+#define sscanf_s sscanf
+#endif
+
+InputFrame::InputFrame()
+	: dt(0.0f), ForwardSteps(0.0f), RightSteps(0.0f), UpSteps(0.0f), Sprint(false),
+	RotateRight(0.0f), RotateUp(0.0f), Camera(0)
+{
+}
+
+
+bool InputScript::Load(const char *Path, std::vector<InputFrame> &Frames)
+{
+	std::ifstream ifs(Path);
+	if (!ifs.is_open())
+		return false;
+
+	Frames.clear();
+
+	std::string Line;
+	while (RoomFile::GetNextDataLine(ifs, Line))
+	{
+		// fields missing from the end of the line keep their defaults
+		InputFrame Frame;
+		int Sprint = 0;
+		if (sscanf_s(Line.c_str(), "%f %f %f %f %d %f %f %d", &Frame.dt,
+				&Frame.ForwardSteps, &Frame.RightSteps, &Frame.UpSteps, &Sprint,
+				&Frame.RotateRight, &Frame.RotateUp, &Frame.Camera) < 4)
+			continue;
+		Frame.Sprint = (Sprint != 0);
+		Frames.push_back(Frame);
+	}
+
+	ifs.close();
+	return true;
+}
+
+
+void InputScript::WriteFrame(std::ostream &os, const InputFrame &Frame)
+{
+	// 9 significant digits read back as the same float, so a replay matches the recording bit for bit
+	std::streamsize Precision = os.precision(9);
+	os << Frame.dt << ' ' << Frame.ForwardSteps << ' ' << Frame.RightSteps << ' ' << Frame.UpSteps << ' '
+		<< (Frame.Sprint ? 1 : 0) << ' ' << Frame.RotateRight << ' ' << Frame.RotateUp << ' '
+		<< Frame.Camera << '\n';
+	os.precision(Precision);
+}
@@ -0,0 +1,34 @@
+#ifndef INPUTSCRIPT_H
+#define INPUTSCRIPT_H
+
+#include "d3dUtil.h"
+#include <vector>
+
+// one frame of player input, as seen by PortalsApp::UpdateScene.  a script is a text file with
+// one frame per line:  dt ForwardSteps RightSteps UpSteps Sprint RotateRight RotateUp Camera
+// rotations are in radians, Sprint is 0 or 1, Camera is 0 for the left camera and 1 for the player.
+// lines starting with # are ignored
+struct InputFrame
+{
+	float dt;
+	float ForwardSteps;
+	float RightSteps;
+	float UpSteps;
+	bool Sprint;
+	float RotateRight;
+	float RotateUp;
+	int Camera;
+
+	InputFrame();
+};
+
+class InputScript
+{
+public:
+	// returns false if the file can't be opened
+	static bool Load(const char *Path, std::vector<InputFrame> &Frames);
+
+	static void WriteFrame(std::ostream &os, const InputFrame &Frame);
+};
+
+#endif
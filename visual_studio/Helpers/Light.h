@@ -4,7 +4,8 @@
 struct DirectionalLight
 {
 	// struct constructor: zeros everything
-	DirectionalLight() { ZeroMemory(this, sizeof(this)); }
+	DirectionalLight() : Ambient(0.0f, 0.0f, 0.0f, 0.0f), Diffuse(0.0f, 0.0f, 0.0f, 0.0f),
+		Specular(0.0f, 0.0f, 0.0f, 0.0f), Direction(0.0f, 0.0f, 0.0f), pad(0.0f) {}
 
 	XMFLOAT4 Ambient;
 	XMFLOAT4 Diffuse;
@@ -15,7 +16,8 @@ struct DirectionalLight
 
 struct Material
 {
-	Material() { ZeroMemory(this, sizeof(this)); }
+	Material() : Ambient(0.0f, 0.0f, 0.0f, 0.0f), Diffuse(0.0f, 0.0f, 0.0f, 0.0f),
+		Specular(0.0f, 0.0f, 0.0f, 0.0f), Reflect(0.0f, 0.0f, 0.0f, 0.0f) {}
 
 	XMFLOAT4 Ambient;
 	XMFLOAT4 Diffuse;
@@ -4,7 +4,11 @@
 
 // used in main
 #define ROOM_FILE_PATH "./RoomFiles/room.txt"
+#define RECORD_INPUT 0									// writes each frame's input to INPUT_RECORDING_FILE_PATH
+#define INPUT_RECORDING_FILE_PATH "./input.txt"			// for replaying with the headless simulation
 #define PORTAL_ITERATIONS 30
+#define PORTAL_PLAN_MIN_PIXEL_AREA 1.0f	// portal recursion stops once the next portal covers less screen area than this
+#define PORTAL_CULL_MAX_PLANES (5 + PORTAL_BOX_N_SIDES)	// screen rect, portal plane, and one per portal box side
 
 #define ORANGE_STENCIL_REF 10
 #define BLUE_STENCIL_REF 100
@@ -15,28 +19,53 @@
 #define PORTAL_ROTATE_SPEED 60.0f		// speed at which portal rolls, in deg/s
 #define PORTAL_SIZE_CHANGE_SPEED 1.5f	// speed at which portal radius changes, in m/s
 
+#define SIMULATION_TICK_RATE 120.0		// ticks per second of the simulation thread, each simulating 1/SIMULATION_TICK_RATE s
+#define SIMULATION_SUBSTEPS 1			// sweeps each tick's camera movement is split into
+#define SIMULATION_MAX_TICKS_PER_ADVANCE 8	// ticks run back to back after a stall; the rest are dropped
+#define FIXED_TIMESTEP_HISTOGRAM_BUCKETS 24	// tick cost histogram, in powers of two of microseconds
+
 
 
 // keepout radius for the camera when it's not attached to any FirstPersonObject
 // should not be 0: that allows camera to clip through room at corners
 #define CAMERA_SPHERE_RADIUS 0.02f
+#define CAMERA_SSE_CULLING 1		// set to 0 to use the scalar versions of ClassifySpheres/ClassifyDiscs
+#define SIMD_MATH_SSE 1			// set to 0 to build the plain C++ versions of SimdMath.h's Vec2/Vec3/Mat4
 
 // room, portal
 #define T_THRESHOLD 0.01f	// X=S+t*Dir, no collision if t<-T_THRESHOLD. T_THRESHOLD should be nonnegative
 #define T_BUMP 0.001f		// t -= T_BUMP before calculating X.  Slightly bumps the point of collision away from the boundary.
 
+// room
+#define ROOM_GRID_EDGES_PER_CELL 2.0f		// average number of wall edges the room's edge grid aims to put in each cell
+#define ROOM_GRID_MAX_CELLS_PER_AXIS 1024	// upper limit on the edge grid resolution
+#define ROOM_SSE_EXIT_KERNEL 0				// set to 1 to start with Room::EXIT_KERNEL_SSE instead of FindFirstExit
+#define ROOM_CANDIDATE_CACHE_MARGIN 1.0f		// how far past a query a CandidateCache gathers edges, so the mover can drift before it gathers again
+
 // portal
 #define DISC_CONTAINS_THRESHOLD 0.01f	// used in DiscContainsPoint. returns true if point is within this value of disc plane
 #define PORTAL_BOX_DEPTH 0.02f			// the depth of the portalbox used in place of the disc when camera is too close for disc to render
 #define PORTAL_BOX_N_SIDES 16			// the portalbox will be an N-gon prism
 
 #define ITERATIVE_THRESHOLD 0.00005f		// stop solving for t when accuracy of t reaches this threshold
+#define ITERATIVE_ILLINOIS 0				// set to 1 to start with Portal::ROOT_SOLVER_ILLINOIS instead of regula falsi
+#define ITERATIVE_MAX_STEPS 24				// max steps per monotonic interval with ROOT_SOLVER_ILLINOIS
 #define SPHERE_INTERSECT_RING_THRESHOLD 0.001f	// used in SpherePathCollision when checking if a larger sphere already intersects the ring
+#define PORTAL_RING_BOUNDS_MARGIN 0.01f			// padding on the torus bounds used to skip the ring quartic in SpherePathCollision
 
 #define PORTALS_SAME_PLANE_THRESHOLD 0.01f	// used in PortalRelocate to determine if 2 portals are in the same plane
 
 #define PORTAL_MIN_PHYS_RADIUS 0.1f				// used in PortalRelocate to limit how small portals can be
 
+// portal set
+#define PORTALSET_GRID_MAX_CELLS_PER_AXIS 256	// upper limit on the resolution of the grid used to look up portals
+
+// software render backend
+#define SOFTWARE_RASTER_TILE_SIZE 32		// tiles are this many pixels square; each is rasterized by one thread
+#define SOFTWARE_RASTER_SUBPIXEL_BITS 4		// fraction bits of the fixed point vertex positions
+#define SOFTWARE_RASTER_GUARD_BAND 2.0f		// triangles are only clipped at this many viewport half-sizes from its center
+#define SOFTWARE_RASTER_SSE 1				// set to 0 to step the edge functions without SSE2
+
 
 
 #endif
\ No newline at end of file
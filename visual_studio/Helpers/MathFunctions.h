@@ -4,35 +4,164 @@
 #include "d3dUtil.h"
 #define PI 3.14159265359f
 
-XMFLOAT2 operator+(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs);
-XMFLOAT2 operator-(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs);
-XMFLOAT2 operator-(const XMFLOAT2 &rhs);
-XMFLOAT2 operator*(float lhs, const XMFLOAT2 &rhs);
-XMFLOAT2 operator*(const XMFLOAT2 &lhs, float rhs);
-XMFLOAT2 operator/(const XMFLOAT2 &lhs, float rhs);
-bool operator==(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs);
-bool operator!=(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs);
-float XMFloat2Dot(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs);
-float XMFloat2Cross(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs);
-float XMFloat2Length(const XMFLOAT2 &v);
-float XMFloat2LengthSq(const XMFLOAT2 &v);
-XMFLOAT2 XMFloat2Normalize(const XMFLOAT2 &v);
-XMFLOAT2 XMFloat2Left90(const XMFLOAT2 &v);
-XMFLOAT2 XMFloat2Right90(const XMFLOAT2 &v);
-
-XMFLOAT3 operator+(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs);
-XMFLOAT3 operator-(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs);
-XMFLOAT3 operator-(const XMFLOAT3 &rhs);
-XMFLOAT3 operator*(float lhs, const XMFLOAT3 &rhs);
-XMFLOAT3 operator*(const XMFLOAT3 &lhs, float rhs);
-XMFLOAT3 operator/(const XMFLOAT3 &lhs, float rhs);
-bool operator==(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs);
-bool operator!=(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs);
-float XMFloat3Dot(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs);
-XMFLOAT3 XMFloat3Cross(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs);
-float XMFloat3Length(const XMFLOAT3 &v);
-float XMFloat3LengthSq(const XMFLOAT3 &v);
-XMFLOAT3 XMFloat3Normalize(const XMFLOAT3 &v);
+// defined inline so collision code can keep values in registers instead of calling out for every operation
+inline XMFLOAT2 operator+(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs)
+{
+	return XMFLOAT2(lhs.x+rhs.x, lhs.y+rhs.y);
+}
+
+inline XMFLOAT2 operator-(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs)
+{
+	return XMFLOAT2(lhs.x-rhs.x, lhs.y-rhs.y);
+}
+
+inline XMFLOAT2 operator-(const XMFLOAT2 &rhs)
+{
+	return XMFLOAT2(-rhs.x, -rhs.y);
+}
+
+inline XMFLOAT2 operator*(float lhs, const XMFLOAT2 &rhs)
+{
+	return XMFLOAT2(lhs*rhs.x, lhs*rhs.y);
+}
+inline XMFLOAT2 operator*(const XMFLOAT2 &lhs, float rhs)
+{
+	return XMFLOAT2(lhs.x*rhs, lhs.y*rhs);
+}
+
+inline XMFLOAT2 operator/(const XMFLOAT2 &lhs, float rhs)
+{
+	return XMFLOAT2(lhs.x/rhs, lhs.y/rhs);
+}
+
+inline bool operator==(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs)
+{
+	return (lhs.x==rhs.x && lhs.y==rhs.y);
+}
+
+inline bool operator!=(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs)
+{
+	return (lhs.x!=rhs.x || lhs.y!=rhs.y);
+}
+
+inline float XMFloat2Dot(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs)
+{
+	return lhs.x*rhs.x + lhs.y*rhs.y;
+}
+
+inline float XMFloat2Cross(const XMFLOAT2 &lhs, const XMFLOAT2 &rhs)
+{
+	return lhs.x*rhs.y - lhs.y*rhs.x;
+}
+
+inline float XMFloat2Length(const XMFLOAT2 &v)
+{
+	return sqrtf(v.x*v.x + v.y*v.y);
+}
+
+inline float XMFloat2LengthSq(const XMFLOAT2 &v)
+{
+	return v.x*v.x + v.y*v.y;
+}
+
+inline XMFLOAT2 XMFloat2Normalize(const XMFLOAT2 &v)
+{
+	return v / XMFloat2Length(v);
+}
+
+inline XMFLOAT2 XMFloat2Left90(const XMFLOAT2 &v)
+{
+	return XMFLOAT2(-v.y, v.x);
+}
+
+inline XMFLOAT2 XMFloat2Right90(const XMFLOAT2 &v)
+{
+	return XMFLOAT2(v.y, -v.x);
+}
+
+
+inline XMFLOAT3 operator+(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs)
+{
+	return XMFLOAT3(lhs.x+rhs.x, lhs.y+rhs.y, lhs.z+rhs.z);
+}
+
+inline XMFLOAT3 operator-(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs)
+{
+	return XMFLOAT3(lhs.x-rhs.x, lhs.y-rhs.y, lhs.z-rhs.z);
+}
+inline XMFLOAT3 operator-(const XMFLOAT3 &rhs)
+{
+	return XMFLOAT3(-rhs.x, -rhs.y, -rhs.z);
+}
+inline XMFLOAT3 operator*(float lhs, const XMFLOAT3 &rhs)
+{
+	return XMFLOAT3(lhs*rhs.x, lhs*rhs.y, lhs*rhs.z);
+}
+
+inline XMFLOAT3 operator*(const XMFLOAT3 &lhs, float rhs)
+{
+	return XMFLOAT3(lhs.x*rhs, lhs.y*rhs, lhs.z*rhs);
+}
+
+inline XMFLOAT3 operator/(const XMFLOAT3 &lhs, float rhs)
+{
+	return XMFLOAT3(lhs.x/rhs, lhs.y/rhs, lhs.z/rhs);
+}
+
+inline bool operator==(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs)
+{
+	return (lhs.x==rhs.x && (lhs.y==rhs.y && lhs.z==rhs.z));
+}
+
+inline bool operator!=(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs)
+{
+	return (lhs.x!=rhs.x || (lhs.y!=rhs.y || lhs.z!=rhs.z));
+}
+
+inline float XMFloat3Dot(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs)
+{
+	return lhs.x*rhs.x + lhs.y*rhs.y + lhs.z*rhs.z;
+}
+
+inline XMFLOAT3 XMFloat3Cross(const XMFLOAT3 &lhs, const XMFLOAT3 &rhs)
+{
+	return XMFLOAT3(lhs.y*rhs.z - lhs.z*rhs.y,
+					lhs.z*rhs.x - lhs.x*rhs.z,
+					lhs.x*rhs.y - lhs.y*rhs.x);
+}
+
+inline float XMFloat3Length(const XMFLOAT3 &v)
+{
+	return sqrtf(v.x*v.x + v.y*v.y + v.z*v.z);
+}
+
+inline float XMFloat3LengthSq(const XMFLOAT3 &v)
+{
+	return v.x*v.x + v.y*v.y + v.z*v.z;
+}
+
+inline XMFLOAT3 XMFloat3Normalize(const XMFLOAT3 &v)
+{
+	return v / XMFloat3Length(v);
+}
+
+// transform a point/direction by M without going through XMVECTOR.
+// same order of operations as XMVector3TransformCoord/XMVector3TransformNormal
+inline XMFLOAT3 XMFloat3TransformCoord(const XMFLOAT3 &v, CXMMATRIX M)
+{
+	float x = ((v.z*M(2,0) + M(3,0)) + v.y*M(1,0)) + v.x*M(0,0);
+	float y = ((v.z*M(2,1) + M(3,1)) + v.y*M(1,1)) + v.x*M(0,1);
+	float z = ((v.z*M(2,2) + M(3,2)) + v.y*M(1,2)) + v.x*M(0,2);
+	float w = ((v.z*M(2,3) + M(3,3)) + v.y*M(1,3)) + v.x*M(0,3);
+	return XMFLOAT3(x/w, y/w, z/w);
+}
+
+inline XMFLOAT3 XMFloat3TransformNormal(const XMFLOAT3 &v, CXMMATRIX M)
+{
+	return XMFLOAT3((v.z*M(2,0) + v.y*M(1,0)) + v.x*M(0,0),
+					(v.z*M(2,1) + v.y*M(1,1)) + v.x*M(0,1),
+					(v.z*M(2,2) + v.y*M(1,2)) + v.x*M(0,2));
+}
 
 class MathFunctions
 {
@@ -0,0 +1,291 @@
+#include "NullRenderBackend.h"
+
+// what D3D11RenderBackend writes when it rebinds a mesh: the material and the texture transform
+#define NULL_BACKEND_MESH_CONSTANT_BYTES (4*sizeof(XMFLOAT4) + sizeof(XMFLOAT4X4))
+
+NullRenderBackend::NullRenderBackend()
+{
+	for (UINT i=0; i<MESH_COUNT; ++i)
+		IndexCounts[i] = 0;
+	BeginFrame();
+}
+
+NullRenderBackend::~NullRenderBackend()
+{
+}
+
+
+void NullRenderBackend::SetIndexCount(MeshType Mesh, UINT IndexCount)
+{
+	IndexCounts[Mesh] = IndexCount;
+}
+
+
+UINT NullRenderBackend::GetIndexCount(MeshType Mesh)const
+{
+	return IndexCounts[Mesh];
+}
+
+// forgets the commands, slots, state and stats of the last frame, but not the meshes
+void NullRenderBackend::BeginFrame()
+{
+	Commands.clear();
+	Slots.clear();
+	memset(&Stats, 0, sizeof(Stats));
+	ErrorCount = 0;
+
+	StencilSet = false;
+	CurrentStencil = STENCIL_DEFAULT;
+	CurrentStencilRef = 0;
+	ScissorEnabled = false;
+	for (int i=0; i<4; ++i)
+		CurrentScissor[i] = 0;
+	PortalsSet = false;
+	EyeSet = false;
+	LightsSet = false;
+	ClipPlaneSet = false;
+	ObjectConstantsSet = false;
+	CurrentShader = -1;
+	CurrentMesh = -1;
+}
+
+void NullRenderBackend::SetStencil(StencilMode Mode, UINT StencilRef)
+{
+	Command C = Command();
+	C.Type = COMMAND_SET_STENCIL;
+	C.Stencil = Mode;
+	C.StencilRef = StencilRef;
+	AddCommand(C);
+
+	if (!StencilSet || Mode != CurrentStencil || StencilRef != CurrentStencilRef)
+		++Stats.StencilChanges;
+	StencilSet = true;
+	CurrentStencil = Mode;
+	CurrentStencilRef = StencilRef;
+}
+
+void NullRenderBackend::SetScissor(bool Enable, int Left, int Top, int Right, int Bottom)
+{
+	Command C = Command();
+	C.Type = COMMAND_SET_SCISSOR;
+	C.ScissorEnable = Enable;
+	C.ScissorLeft = Left;
+	C.ScissorTop = Top;
+	C.ScissorRight = Right;
+	C.ScissorBottom = Bottom;
+	AddCommand(C);
+
+	if (Enable && (Left < 0 || Top < 0 || Right < Left || Bottom < Top))
+		Error("scissor rect is inverted or off the render target");
+
+	// the rect only matters while the scissor test is on
+	bool SameRect = (Left == CurrentScissor[0] && Top == CurrentScissor[1] && Right == CurrentScissor[2]
+					&& Bottom == CurrentScissor[3]);
+	if (Enable != ScissorEnabled || (Enable && !SameRect))
+		++Stats.ScissorChanges;
+	ScissorEnabled = Enable;
+	if (Enable)
+	{
+		CurrentScissor[0] = Left;
+		CurrentScissor[1] = Top;
+		CurrentScissor[2] = Right;
+		CurrentScissor[3] = Bottom;
+	}
+}
+
+void NullRenderBackend::SetPortals(const Portal &/*PortalA*/, const Portal &/*PortalB*/)
+{
+	Command C = Command();
+	C.Type = COMMAND_SET_PORTALS;
+	AddCommand(C);
+
+	AddConstants(2 * (sizeof(XMFLOAT4X4) + sizeof(float)));
+	PortalsSet = true;
+}
+
+void NullRenderBackend::SetEye(XMFLOAT3 /*EyePosition*/, float ViewScale)
+{
+	Command C = Command();
+	C.Type = COMMAND_SET_EYE;
+	AddCommand(C);
+
+	if (!(ViewScale > 0.0f))
+		Error("view scale isn't positive");
+	AddConstants(sizeof(XMFLOAT3) + sizeof(float));
+	EyeSet = true;
+}
+
+void NullRenderBackend::SetLights(const XMFLOAT3 /*LightDirections*/[3])
+{
+	Command C = Command();
+	C.Type = COMMAND_SET_LIGHTS;
+	AddCommand(C);
+
+	AddConstants(3 * sizeof(XMFLOAT3));
+	LightsSet = true;
+}
+
+void NullRenderBackend::SetClipPlane(XMFLOAT3 /*Position*/, XMFLOAT3 /*Normal*/, float /*Offset*/)
+{
+	Command C = Command();
+	C.Type = COMMAND_SET_CLIP_PLANE;
+	AddCommand(C);
+
+	AddConstants(2 * sizeof(XMFLOAT3) + sizeof(float));
+	ClipPlaneSet = true;
+}
+
+void NullRenderBackend::SetObjectConstants(const XMFLOAT4X4 &/*World*/, const XMFLOAT4X4 &/*ViewProj*/)
+{
+	Command C = Command();
+	C.Type = COMMAND_SET_OBJECT_CONSTANTS;
+	AddCommand(C);
+
+	AddConstants(2 * sizeof(XMFLOAT4X4));
+	ObjectConstantsSet = true;
+}
+
+void NullRenderBackend::DrawIndexed(MeshType Mesh, ShadeMode Mode, UINT Start, UINT Count)
+{
+	Command C = Command();
+	C.Type = COMMAND_DRAW_INDEXED;
+	C.Mesh = Mesh;
+	C.Shade = Mode;
+	C.PlaneClip = (Mode == SHADE_PLANE_CLIP);
+	C.Start = Start;
+	C.Count = Count;
+	AddCommand(C);
+
+	if (!ObjectConstantsSet)
+		Error("draw before any object constants were set");
+	if (!EyeSet || !LightsSet)
+		Error("draw before the eye and the lights were set");
+	if (Mode == SHADE_PLANE_CLIP && !ClipPlaneSet)
+		Error("plane clipped draw before any clip plane was set");
+	if (Mode == SHADE_NO_PORTAL_HOLES && Mesh > MESH_CEILING)
+		Error("SHADE_NO_PORTAL_HOLES on a mesh that isn't part of the room");
+	if (Mesh <= MESH_CEILING && !PortalsSet)
+		Error("room drawn before the portals were set");
+	if (Mesh == MESH_PORTAL_BOX_CLEAR_DEPTH && Mode != SHADE_DEFAULT)
+		Error("depth-clearing box drawn with a shade mode");
+	CheckRange(Mesh, Start, Count);
+
+	CountDraw(Mesh, false, 2*(Mesh*3 + Mode), Count);
+}
+
+void NullRenderBackend::SetLevelSlots(const LevelSlot *Slots, UINT SlotCount, const XMFLOAT4X4 &/*PlayerWorld*/)
+{
+	Command C = Command();
+	C.Type = COMMAND_SET_LEVEL_SLOTS;
+	C.SlotCount = SlotCount;
+	AddCommand(C);
+
+	if (SlotCount == 0)
+		Error("no level slots");
+	if (SlotCount > PORTAL_ITERATIONS + 1)
+		Error("more level slots than PORTAL_ITERATIONS+1");
+	this->Slots.assign(Slots, Slots + SlotCount);
+
+	AddConstants(SlotCount * sizeof(LevelSlot) + sizeof(XMFLOAT4X4));
+	++Stats.SlotUploads;
+}
+
+void NullRenderBackend::DrawLevel(MeshType Mesh, UINT Slot, bool PlaneClip, UINT Start, UINT Count)
+{
+	Command C = Command();
+	C.Type = COMMAND_DRAW_LEVEL;
+	C.Mesh = Mesh;
+	C.Slot = Slot;
+	C.PlaneClip = PlaneClip;
+	C.Start = Start;
+	C.Count = Count;
+	AddCommand(C);
+
+	if (Slots.empty())
+		Error("draw before any level slots were set");
+	else if (Slot >= Slots.size())
+		Error("draw in a slot that wasn't set");
+	if (!EyeSet)
+		Error("draw before the eye was set");
+	if (Mesh <= MESH_CEILING && !PortalsSet)
+		Error("room drawn before the portals were set");
+	if (Mesh == MESH_PORTAL_BOX_CLEAR_DEPTH && PlaneClip)
+		Error("depth-clearing box drawn with PlaneClip");
+	CheckRange(Mesh, Start, Count);
+
+	CountDraw(Mesh, true, 2*(Mesh*3 + (PlaneClip ? SHADE_PLANE_CLIP : SHADE_DEFAULT)) + 1, Count);
+}
+
+
+const std::vector<NullRenderBackend::Command>& NullRenderBackend::GetCommands()const
+{
+	return Commands;
+}
+
+const std::vector<RenderBackend::LevelSlot>& NullRenderBackend::GetSlots()const
+{
+	return Slots;
+}
+
+const NullRenderBackend::FrameStats& NullRenderBackend::GetFrameStats()const
+{
+	return Stats;
+}
+
+UINT NullRenderBackend::GetErrorCount()const
+{
+	return ErrorCount;
+}
+
+
+void NullRenderBackend::AddCommand(const Command &C)
+{
+	Commands.push_back(C);
+}
+
+void NullRenderBackend::AddConstants(UINT Bytes)
+{
+	++Stats.ConstantUpdates;
+	Stats.ConstantBytes += Bytes;
+}
+
+// the room meshes share a technique, so only Shader says when the pipeline changes
+void NullRenderBackend::CountDraw(MeshType Mesh, bool Level, int Shader, UINT Count)
+{
+	if (!StencilSet)
+		Error("draw before any stencil state was set");
+
+	if (Mesh <= MESH_CEILING)
+		Shader -= 6 * Mesh;
+	if (Shader != CurrentShader)
+		++Stats.ShaderChanges;
+	CurrentShader = Shader;
+
+	int MeshKey = 2*Mesh + (Level ? 1 : 0);
+	if (MeshKey != CurrentMesh)
+	{
+		++Stats.MeshChanges;
+		if (Mesh <= MESH_PLAYER)
+			AddConstants(NULL_BACKEND_MESH_CONSTANT_BYTES);
+	}
+	CurrentMesh = MeshKey;
+
+	++Stats.Draws;
+	Stats.Triangles += Count / 3;
+}
+
+void NullRenderBackend::CheckRange(MeshType Mesh, UINT Start, UINT Count)
+{
+	if (Count == 0 || Count % 3 != 0)
+		Error("index count isn't a positive multiple of 3");
+	if (Start % 3 != 0)
+		Error("start index isn't at a triangle");
+	if (Start > IndexCounts[Mesh] || Count > IndexCounts[Mesh] - Start)
+		Error("draw runs past the end of the mesh");
+}
+
+void NullRenderBackend::Error(const char *Message)
+{
+	++ErrorCount;
+	dprintf("NullRenderBackend: command %u: %s\n", (UINT)Commands.size() - 1, Message);
+}
@@ -0,0 +1,99 @@
+#ifndef NULLRENDERBACKEND_H
+#define NULLRENDERBACKEND_H
+
+#include "d3dUtil.h"
+#include <vector>
+#include "RenderBackend.h"
+
+// RenderBackend that draws nothing.  it records every command, checks it against the state before it, and
+// counts the work D3D11RenderBackend would do for it, so a frame's rendering cost can be measured headless
+class NullRenderBackend : public RenderBackend
+{
+public:
+	enum CommandType { COMMAND_SET_STENCIL = 0, COMMAND_SET_PORTALS, COMMAND_SET_EYE, COMMAND_SET_LIGHTS,
+						COMMAND_SET_CLIP_PLANE, COMMAND_SET_OBJECT_CONSTANTS, COMMAND_DRAW_INDEXED,
+						COMMAND_SET_LEVEL_SLOTS, COMMAND_DRAW_LEVEL, COMMAND_SET_SCISSOR };
+
+	struct Command
+	{
+		CommandType Type;
+		StencilMode Stencil;	// COMMAND_SET_STENCIL
+		UINT StencilRef;
+		UINT SlotCount;			// COMMAND_SET_LEVEL_SLOTS
+		MeshType Mesh;			// COMMAND_DRAW_INDEXED, COMMAND_DRAW_LEVEL
+		ShadeMode Shade;		// COMMAND_DRAW_INDEXED
+		UINT Slot;				// COMMAND_DRAW_LEVEL
+		bool PlaneClip;
+		UINT Start;
+		UINT Count;
+		bool ScissorEnable;		// COMMAND_SET_SCISSOR
+		int ScissorLeft, ScissorTop, ScissorRight, ScissorBottom;
+	};
+
+	// counted since BeginFrame
+	struct FrameStats
+	{
+		UINT Draws;
+		UINT Triangles;
+		UINT StencilChanges;		// SetStencil calls that changed the mode or the ref
+		UINT ShaderChanges;			// draws with a different technique than the draw before
+		UINT MeshChanges;			// draws of a different mesh, or a level draw after a regular one or the other way
+									// around: buffers and material rebound
+		UINT ConstantUpdates;		// Set* calls that write constants, plus material updates
+		UINT ConstantBytes;			// bytes of constants written by those
+		UINT SlotUploads;
+		UINT ScissorChanges;		// SetScissor calls that changed the rect or turned it on or off
+	};
+
+	NullRenderBackend();
+	~NullRenderBackend();
+
+	void SetIndexCount(MeshType Mesh, UINT IndexCount);
+
+	UINT GetIndexCount(MeshType Mesh)const;
+	void BeginFrame();
+	void SetStencil(StencilMode Mode, UINT StencilRef);
+	void SetScissor(bool Enable, int Left, int Top, int Right, int Bottom);
+	void SetPortals(const Portal &PortalA, const Portal &PortalB);
+	void SetEye(XMFLOAT3 EyePosition, float ViewScale);
+	void SetLights(const XMFLOAT3 LightDirections[3]);
+	void SetClipPlane(XMFLOAT3 Position, XMFLOAT3 Normal, float Offset);
+	void SetObjectConstants(const XMFLOAT4X4 &World, const XMFLOAT4X4 &ViewProj);
+	void DrawIndexed(MeshType Mesh, ShadeMode Mode, UINT Start, UINT Count);
+	void SetLevelSlots(const LevelSlot *Slots, UINT SlotCount, const XMFLOAT4X4 &PlayerWorld);
+	void DrawLevel(MeshType Mesh, UINT Slot, bool PlaneClip, UINT Start, UINT Count);
+
+	const std::vector<Command>& GetCommands()const;
+	const std::vector<LevelSlot>& GetSlots()const;
+	const FrameStats& GetFrameStats()const;
+	UINT GetErrorCount()const;				// commands that broke a rule since BeginFrame; each one is also dprintf'd
+
+private:
+	UINT IndexCounts[MESH_COUNT];
+	std::vector<Command> Commands;
+	std::vector<LevelSlot> Slots;
+	FrameStats Stats;
+	UINT ErrorCount;
+
+	// state set so far this frame
+	bool StencilSet;
+	StencilMode CurrentStencil;
+	UINT CurrentStencilRef;
+	bool ScissorEnabled;
+	int CurrentScissor[4];
+	bool PortalsSet;
+	bool EyeSet;
+	bool LightsSet;
+	bool ClipPlaneSet;
+	bool ObjectConstantsSet;
+	int CurrentShader;
+	int CurrentMesh;
+
+	void AddCommand(const Command &C);
+	void AddConstants(UINT Bytes);
+	void CountDraw(MeshType Mesh, bool Level, int Shader, UINT Count);
+	void CheckRange(MeshType Mesh, UINT Start, UINT Count);
+	void Error(const char *Message);
+};
+
+#endif
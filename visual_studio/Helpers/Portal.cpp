@@ -1,5 +1,9 @@
 #include "Portal.h"
 
+volatile long Portal::LastVersion = 0;
+unsigned int Portal::RingQuarticsSolved = 0;
+unsigned int Portal::RingQuarticsSkipped = 0;
+Portal::RootSolver Portal::Solver = (ITERATIVE_ILLINOIS ? Portal::ROOT_SOLVER_ILLINOIS : Portal::ROOT_SOLVER_REGULA_FALSI);
 
 Portal::Portal()
 	: PhysicalRadius(1.0f), IntendedPhysicalRadius(1.0f), MaxPhysicalRadius(std::numeric_limits<float>::infinity()),
@@ -10,6 +14,17 @@ Portal::Portal()
 	Left = XMFLOAT3(1.0f, 0.0f, 0.0f);
 	Up = XMFLOAT3(0.0f, 1.0f, 0.0f);
 	Normal = XMFLOAT3(0.0f, 0.0f, 1.0f);
+
+	Changed();
+}
+
+// a copy is a new portal state, so it gets its own version like an assigned portal does
+Portal::Portal(const Portal &rhs)
+	: Position(rhs.Position), Left(rhs.Left), Up(rhs.Up), Normal(rhs.Normal),
+	PhysicalRadius(rhs.PhysicalRadius), IntendedPhysicalRadius(rhs.IntendedPhysicalRadius),
+	MaxPhysicalRadius(rhs.MaxPhysicalRadius), TextureRadiusRatio(rhs.TextureRadiusRatio)
+{
+	Changed();
 }
 
 Portal::~Portal()
@@ -19,18 +34,43 @@ Portal::~Portal()
 
 Portal& Portal::operator=(const Portal &rhs)
 {
-	memcpy(this, &rhs, sizeof(Portal));
+	Position = rhs.Position;
+	Left = rhs.Left;
+	Up = rhs.Up;
+	Normal = rhs.Normal;
+	PhysicalRadius = rhs.PhysicalRadius;
+	IntendedPhysicalRadius = rhs.IntendedPhysicalRadius;
+	MaxPhysicalRadius = rhs.MaxPhysicalRadius;
+	TextureRadiusRatio = rhs.TextureRadiusRatio;
+	Changed();
 	return *this;
 }
 
+// gives the portal a version number no other portal state has had
+void Portal::Changed()
+{
+#ifdef _MSC_VER
+	Version = (unsigned int)InterlockedIncrement(&LastVersion);
+#else
+	Version = (unsigned int)__atomic_add_fetch(&LastVersion, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+unsigned int Portal::GetVersion()const
+{
+	return this->Version;
+}
+
 void Portal::SetTextureRadiusRatio(float TextureRadiusRatio)
 {
 	this->TextureRadiusRatio = TextureRadiusRatio;
+	Changed();
 }
 
 void Portal::SetPosition(XMFLOAT3 Position)
 {
 	this->Position = Position;
+	Changed();
 }
 
 void Portal::SetNormalAndUp(XMFLOAT3 Normal, XMFLOAT3 Up)
@@ -40,6 +80,7 @@ void Portal::SetNormalAndUp(XMFLOAT3 Normal, XMFLOAT3 Up)
 	XMVECTOR N = XMLoadFloat3(&Normal);
 	XMVECTOR U = XMLoadFloat3(&Up);
 	XMStoreFloat3(&(this->Left), XMVector3Cross(U, N));
+	Changed();
 }
 
 /*
@@ -51,11 +92,13 @@ void Portal::SetIntendedPhysicalRadius(float IntendedPhysicalRad)
 {
 	this->IntendedPhysicalRadius = max(IntendedPhysicalRad, PORTAL_MIN_PHYS_RADIUS);
 	this->PhysicalRadius = min(this->IntendedPhysicalRadius, this->MaxPhysicalRadius);
+	Changed();
 }
 void Portal::SetMaxPhysicalRadius(float MaxPhysicalRad)
 {
 	this->MaxPhysicalRadius = max(MaxPhysicalRad, PORTAL_MIN_PHYS_RADIUS);
 	this->PhysicalRadius = min(this->IntendedPhysicalRadius, this->MaxPhysicalRadius);
+	Changed();
 }
 /*
 void Portal::SetTextureRadius(float TextureRadius)
@@ -66,11 +109,13 @@ void Portal::SetIntendedTextureRadius(float IntendedTextureRad)
 {
 	this->IntendedPhysicalRadius = max(IntendedTextureRad/this->TextureRadiusRatio, PORTAL_MIN_PHYS_RADIUS);
 	this->PhysicalRadius = min(this->IntendedPhysicalRadius, this->MaxPhysicalRadius);
+	Changed();
 }
 void Portal::SetMaxTextureRadius(float MaxTextureRad)
 {
 	this->MaxPhysicalRadius = max(MaxTextureRad/this->TextureRadiusRatio, PORTAL_MIN_PHYS_RADIUS);
 	this->PhysicalRadius = min(this->IntendedPhysicalRadius, this->MaxPhysicalRadius);
+	Changed();
 }
 
 void Portal::RotateLeftAroundNormal(float Angle)
@@ -83,6 +128,7 @@ void Portal::RotateLeftAroundNormal(float Angle)
 
 	XMStoreFloat3(&Left, cos*L - sin*U);
 	XMStoreFloat3(&Up, sin*L + cos*U);
+	Changed();
 }
 
 
@@ -107,12 +153,14 @@ void Portal::Transform(const XMMATRIX &M)
 	XMStoreFloat3(&Up, U);
 	XMStoreFloat3(&Normal, N);
 	XMStoreFloat3(&Position, P);
+	Changed();
 }
 
 void Portal::Flip()
 {
 	Left = -Left;
 	Normal = -Normal;
+	Changed();
 }
 
 XMFLOAT3 Portal::GetLeft()const
@@ -166,34 +214,26 @@ float Portal::GetMaxTextureRadius()const
 bool Portal::DiscContainsPoint(XMFLOAT3 Point)const
 {
 	// if Point is in plane of portal and within PhysicalRadius of portal center, return true
-	XMVECTOR P = XMLoadFloat3(&Point);
-	XMVECTOR C = XMLoadFloat3(&Position);
-	if (XMVectorGetX(XMVector3Length(P-C)) <= PhysicalRadius)
-	{
-		XMVECTOR N = XMLoadFloat3(&Normal);
-		return (abs(XMVectorGetX(XMVector3Dot(P-C, N))) <= DISC_CONTAINS_THRESHOLD);
-	}
+	XMFLOAT3 CP = Point - Position;
+	if (XMFloat3Length(CP) <= PhysicalRadius)
+		return (abs(XMFloat3Dot(CP, Normal)) <= DISC_CONTAINS_THRESHOLD);
 	return false;
 }
 
 // being tangent to portal plane does not count as intersection
 bool Portal::DiscIntersectSphere(XMFLOAT3 Center, float Radius)const
 {
-	XMVECTOR D = XMLoadFloat3(&Center);
-	XMVECTOR C = XMLoadFloat3(&Position);
-	XMVECTOR N = XMLoadFloat3(&Normal);
-
-	float DistToPortalPlane = XMVectorGetX(XMVector3Dot(D-C, N));
+	float DistToPortalPlane = XMFloat3Dot(Center-Position, Normal);
 	if (DistToPortalPlane >= Radius)
 		return false;
 
 	// project sphere center onto portal plane
-	XMVECTOR E = D - DistToPortalPlane * N;
+	XMFLOAT3 E = Center - DistToPortalPlane * Normal;
 	float SpherePlaneIntersectionRadius = sqrtf(Radius*Radius - DistToPortalPlane*DistToPortalPlane);
 
 	// portal disc and SpherePlaneIntersectionDisc overlap if sum of their radii is bigger
 	// than distance between their centers
-	return ( PhysicalRadius + SpherePlaneIntersectionRadius > XMVectorGetX(XMVector3Length(E-C)) );
+	return ( PhysicalRadius + SpherePlaneIntersectionRadius > XMFloat3Length(E-Position) );
 }
 
 
@@ -208,12 +248,14 @@ XMFLOAT3 Portal::SpherePathCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Di
 	*RedirectDir_ptr = Dir;
 
 	// transform path to portal space
-	XMFLOAT3 Sp;
-	XMFLOAT3 Dirp;
-	
-	XMMATRIX M = GetPortalMatrix();
-	XMStoreFloat3(&Sp, XMVector3TransformCoord(XMLoadFloat3(&S), M));
-	XMStoreFloat3(&Dirp, XMVector3TransformNormal(XMLoadFloat3(&Dir), M));
+	Vec3 Sp;
+	Vec3 Dirp;
+
+	Mat4 M = Mat4Load(GetPortalMatrix());
+	Sp = Vec3TransformCoord(Vec3Load(S), M);
+	Dirp = Vec3TransformNormal(Vec3Load(Dir), M);
+	float Spz = Vec3GetZ(Sp);
+	float Dirpz = Vec3GetZ(Dirp);
 
 
 	// NOTE: IN PORTAL SPACE, THE PORTAL IS IN THE XY-PLANE.
@@ -225,26 +267,34 @@ XMFLOAT3 Portal::SpherePathCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Di
 	float r_sq = SphereRadius*SphereRadius;
 
 	//float alpha = 1.0f;
-	float beta = 2.0f * XMFloat3Dot(Sp, Dirp);
-	float gamma = XMFloat3LengthSq(Sp) - r_sq - R_sq;
+	float beta = 2.0f * Vec3Dot(Sp, Dirp);
+	float gamma = Vec3LengthSq(Sp) - r_sq - R_sq;
 
 	// quartic equation coefficients
 	// at^4+bt^3+ct^2+dt+e=0
 	float coeffs[5];
 	coeffs[0] = 1.0f;												// a
 	coeffs[1] = 2.0f*beta;											// b
-	coeffs[2] = beta*beta + 2.0f*gamma + 4.0f*R_sq*Dirp.z*Dirp.z;	// c
-	coeffs[3] = 2.0f*beta*gamma + 8.0f*R_sq*Sp.z*Dirp.z;			// d
-	coeffs[4] = gamma*gamma + 4.0f*R_sq*(Sp.z*Sp.z - r_sq);			// e
+	coeffs[2] = beta*beta + 2.0f*gamma + 4.0f*R_sq*Dirpz*Dirpz;		// c
+	coeffs[3] = 2.0f*beta*gamma + 8.0f*R_sq*Spz*Dirpz;				// d
+	coeffs[4] = gamma*gamma + 4.0f*R_sq*(Spz*Spz - r_sq);			// e
 
-	// solve for point of collision of path with torus
+	// solve for point of collision of path with torus, unless the path can't reach it
 	float t = MoveDist;
-	FindLowestQuarticRootInInterval(coeffs, -T_THRESHOLD, MoveDist, &t);
+	if (PathMayTouchRing(SphereRadius, Sp, Dirp, -T_THRESHOLD, MoveDist))
+	{
+		++RingQuarticsSolved;
+		FindLowestQuarticRootInInterval(coeffs, -T_THRESHOLD, MoveDist, &t);
+	}
+	else
+	{
+		++RingQuarticsSkipped;
+	}
 
 
 	// spheres larger than the ring oftentimes slip thru the ring in the middle due to the large t errors
 	// resulting from the sharp "pit" in the torus.  we will check for this
-	if (SphereRadius > PhysicalRadius && Dirp.z != 0.0f)
+	if (SphereRadius > PhysicalRadius && Dirpz != 0.0f)
 	{
 		// see if path ray intersects the disc of radius 2R, at height h = sqrt(r^2-R^2)
 		// this height is the tip of the torus pit
@@ -252,19 +302,20 @@ XMFLOAT3 Portal::SpherePathCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Di
 
 		// find where this path intersects with the plane at height +-h, depending on Dirp
 		float t2;	// Sp.z + t2*Dirp.z = +- h
-		if (Dirp.z  < 0.0f)	// path heading downwards
-			t2 = (h - Sp.z) / Dirp.z;
+		if (Dirpz  < 0.0f)	// path heading downwards
+			t2 = (h - Spz) / Dirpz;
 		else		// path heading upwards
-			t2 = (-h - Sp.z) / Dirp.z;
+			t2 = (-h - Spz) / Dirpz;
 
 		// does a closer intersection occur?
 		if (-T_THRESHOLD < t2 && t2 < t)
 		{
 			// find intersection point
-			XMFLOAT3 Xp2 = Sp + t2*Dirp;
+			Vec3 Xp2 = Sp + t2*Dirp;
+			Vec2 Xp2xy = Vec2Set(Vec3GetX(Xp2), Vec3GetY(Xp2));
 
 			// is the intersection point inside circle of radius 2R with origin as center?
-			if (sqrtf(Xp2.x*Xp2.x + Xp2.y*Xp2.y) < 2.0f*PhysicalRadius)
+			if (Vec2Length(Xp2xy) < 2.0f*PhysicalRadius)
 			{
 				// if intersection occurred, that means the sphere is erroneously passed thru the portal
 				// teleport it to the portal-ring lock position
@@ -272,10 +323,10 @@ XMFLOAT3 Portal::SpherePathCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Di
 				*RedirectRatio_ptr = 0.0f;
 			
 				// relocate sphere to sphere-ring lock position, bumped back by T_BUMP
-				if (Dirp.z < 0.0f)
-					return Position + (h+T_BUMP)*Normal;//(h+T_BUMP)*Normal;
+				if (Dirpz < 0.0f)
+					return Vec3Store(Vec3Load(Position) + (h+T_BUMP)*Vec3Load(Normal));//(h+T_BUMP)*Normal;
 				else
-					return Position - (h+T_BUMP)*Normal;//(h+T_BUMP)*Normal;
+					return Vec3Store(Vec3Load(Position) - (h+T_BUMP)*Vec3Load(Normal));//(h+T_BUMP)*Normal;
 			}
 		}
 	}
@@ -283,36 +334,93 @@ XMFLOAT3 Portal::SpherePathCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Di
 
 	// if no intersection occurred, return
 	if (t==MoveDist)
-		return S + MoveDist*Dir;
+		return Vec3Store(Vec3Load(S) + MoveDist*Vec3Load(Dir));
 
 	*XDist_ptr = t;
 
 	// calculate collision point (X) in portal space
-	XMFLOAT3 Xp = Sp + t*Dirp;	
-	if (Xp.x==0.0f && Xp.y==0.0f)
+	Vec3 Xp = Sp + t*Dirp;
+	Vec2 Xpxy = Vec2Set(Vec3GetX(Xp), Vec3GetY(Xp));
+	if (Xpxy == Vec2Set(0.0f, 0.0f))
 	{
 		*RedirectRatio_ptr = 0.0f;
 	}
 	else
 	{
 		// calculate redirect and redirect-ratio in portal space
-		XMFLOAT3 XpDirLeft90 = XMFloat3Normalize(XMFLOAT3(Xp.y, -Xp.x, 0.0f));
-		XMFLOAT3 Tp = PhysicalRadius * XMFloat3Normalize(XMFLOAT3(Xp.x, Xp.y, 0.0f));
-		XMFLOAT3 XpTpDir = XMFloat3Normalize(Tp-Xp);
-		XMFLOAT3 RedirectDirp = XMFloat3Cross(XpTpDir, XpDirLeft90);
-		float RedirectRatiop = XMFloat3Dot(RedirectDirp, Dirp);
+		Vec3 XpDirLeft90 = Vec3Normalize(Vec3Set(Vec3GetY(Xp), -Vec3GetX(Xp), 0.0f));
+		Vec3 Tp = PhysicalRadius * Vec3Normalize(Vec3Set(Vec3GetX(Xp), Vec3GetY(Xp), 0.0f));
+		Vec3 XpTpDir = Vec3Normalize(Tp-Xp);
+		Vec3 RedirectDirp = Vec3Cross(XpTpDir, XpDirLeft90);
+		float RedirectRatiop = Vec3Dot(RedirectDirp, Dirp);
 		if (RedirectRatiop < 0.0f)
 		{
 			RedirectDirp = -RedirectDirp;
 			RedirectRatiop = -RedirectRatiop;
 		}
 		*RedirectRatio_ptr = RedirectRatiop;
-		*RedirectDir_ptr = RedirectDirp.x*Left + RedirectDirp.y*Up + RedirectDirp.z*Normal;		// convert redirect to world space
+		*RedirectDir_ptr = Vec3Store(Vec3GetX(RedirectDirp)*Vec3Load(Left) + Vec3GetY(RedirectDirp)*Vec3Load(Up)
+									+ Vec3GetZ(RedirectDirp)*Vec3Load(Normal));		// convert redirect to world space
 	}
 
 	// bump t, calculate X
 	t -= T_BUMP;
-	return S + t*Dir;
+	return Vec3Store(Vec3Load(S) + t*Vec3Load(Dir));
+}
+
+
+// conservative test of the path segment Sp+t*Dirp, t in [tmin,tmax], against the bounds of the
+// torus swept by the sphere around the ring (portal space).  returns false only if the segment
+// stays out of the slab |z|<=r, or outside the sphere of radius R+r, or inside the hole of radius R-r
+bool Portal::PathMayTouchRing(float SphereRadius, const Vec3 &Sp, const Vec3 &Dirp, float tmin, float tmax)const
+{
+	float Reach = SphereRadius + PORTAL_RING_BOUNDS_MARGIN;
+	Vec3 A = Sp + tmin*Dirp;
+	Vec3 B = Sp + tmax*Dirp;
+
+	// both ends on the same side of the slab
+	float Az = Vec3GetZ(A);
+	float Bz = Vec3GetZ(B);
+	if ((Az > Reach && Bz > Reach) || (Az < -Reach && Bz < -Reach))
+		return false;
+
+	// closest point of the segment to the portal center is outside the bounding sphere
+	float Outer = PhysicalRadius + Reach;
+	float DirLengthSq = Vec3LengthSq(Dirp);
+	float tc = (DirLengthSq > 0.0f) ? -Vec3Dot(Sp, Dirp) / DirLengthSq : tmin;
+	tc = min(max(tc, tmin), tmax);
+	if (Vec3LengthSq(Sp + tc*Dirp) > Outer*Outer)
+		return false;
+
+	// x^2+y^2 is convex along the segment, so if both ends are in the hole, all of it is
+	float Inner = PhysicalRadius - Reach;
+	if (Inner > 0.0f && Vec2LengthSq(Vec2Set(Vec3GetX(A), Vec3GetY(A))) < Inner*Inner
+		&& Vec2LengthSq(Vec2Set(Vec3GetX(B), Vec3GetY(B))) < Inner*Inner)
+		return false;
+
+	return true;
+}
+
+void Portal::GetRingQuarticCounters(unsigned int *Solved_ptr, unsigned int *Skipped_ptr)
+{
+	*Solved_ptr = RingQuarticsSolved;
+	*Skipped_ptr = RingQuarticsSkipped;
+}
+
+void Portal::ResetRingQuarticCounters()
+{
+	RingQuarticsSolved = 0;
+	RingQuarticsSkipped = 0;
+}
+
+void Portal::SetRootSolver(RootSolver Solver)
+{
+	Portal::Solver = Solver;
+}
+
+Portal::RootSolver Portal::GetRootSolver()
+{
+	return Solver;
 }
 
 
@@ -440,27 +548,65 @@ bool Portal::FindPolynomialRootInMonotonicInterval(int degree, const float *coef
 	float fx;
 	float x = m-ITERATIVE_THRESHOLD-1.0f;	// value to make sure the loop doesn't exit immediately
 	float xprev;
-	
-	do
-	{
-		xprev = x;
 
-		// calculate next guess
-		x = xmin + fxmin/(fxmin-fxmax)*(xmax-xmin);
-		fx = Negate * CalculatePolynomial(x, degree, coeffs);
-		
-		// invariant: f(xmin)<=0, f(xmax)>0
-		if (fx <= 0.0f)
+	if (Solver == ROOT_SOLVER_ILLINOIS)
+	{
+		// Illinois method: same guesses as below, but when one endpoint is kept twice in a row its f
+		// is halved.  this stops the bracket from stalling on one side, so the step count can be capped
+		int KeptSide = 0;	// -1 if xmin was kept on the last step, 1 if xmax was
+		for (int Step=0; Step<ITERATIVE_MAX_STEPS; ++Step)
 		{
-			xmin = x;
-			fxmin = fx;	
+			xprev = x;
+
+			// calculate next guess
+			x = xmin + fxmin/(fxmin-fxmax)*(xmax-xmin);
+			fx = Negate * CalculatePolynomial(x, degree, coeffs);
+
+			// invariant: f(xmin)<=0, f(xmax)>0
+			if (fx <= 0.0f)
+			{
+				xmin = x;
+				fxmin = fx;
+				if (KeptSide==1)
+					fxmax *= 0.5f;
+				KeptSide = 1;
+			}
+			else
+			{
+				xmax = x;
+				fxmax = fx;
+				if (KeptSide==-1)
+					fxmin *= 0.5f;
+				KeptSide = -1;
+			}
+
+			if (abs(x-xprev) <= ITERATIVE_THRESHOLD || xmax-xmin <= ITERATIVE_THRESHOLD)
+				break;
 		}
-		else
+	}
+	else
+	{
+		do
 		{
-			xmax = x;
-			fxmax = fx;
-		}
-	}while(abs(x-xprev) > ITERATIVE_THRESHOLD);
+			xprev = x;
+
+			// calculate next guess
+			x = xmin + fxmin/(fxmin-fxmax)*(xmax-xmin);
+			fx = Negate * CalculatePolynomial(x, degree, coeffs);
+		
+			// invariant: f(xmin)<=0, f(xmax)>0
+			if (fx <= 0.0f)
+			{
+				xmin = x;
+				fxmin = fx;	
+			}
+			else
+			{
+				xmax = x;
+				fxmax = fx;
+			}
+		}while(abs(x-xprev) > ITERATIVE_THRESHOLD);
+	}
 
 	*x_ptr = x;
 	return true;
@@ -483,16 +629,20 @@ float Portal::CalculatePolynomial(float t, int degree, const float *coeffs)
 bool Portal::PathCrossesPortal(XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist)const
 {
 	// does not count as crossing if path heads into portal from wrong side (eg from behind)
-	float DirDotN = XMFloat3Dot(Dir, Normal);
+	Vec3 N = Vec3Load(Normal);
+	Vec3 P = Vec3Load(Position);
+	Vec3 Sv = Vec3Load(S);
+	Vec3 Dirv = Vec3Load(Dir);
+	float DirDotN = Vec3Dot(Dirv, N);
 	if (DirDotN >= 0.0f)
 		return false;
 
-	float t = XMFloat3Dot(Position-S, Normal) / DirDotN;
+	float t = Vec3Dot(P-Sv, N) / DirDotN;
 	if (!(0.0f <= t && t < MoveDist))
 		return false;
 
-	XMFLOAT3 E = S + t*Dir;
-	return (XMFloat3Length(E-Position) < PhysicalRadius);
+	Vec3 E = Sv + t*Dirv;
+	return (Vec3Length(E-P) < PhysicalRadius);
 }
 
 
@@ -509,6 +659,7 @@ void Portal::Orthonormalize()
 	XMStoreFloat3(&Left, L);
 	XMStoreFloat3(&Up, U);
 	XMStoreFloat3(&Normal, N);
+	Changed();
 }
 
 XMMATRIX Portal::GetBoxWorldMatrix()const
@@ -525,14 +676,9 @@ XMMATRIX Portal::GetBoxWorldMatrix()const
 
 XMMATRIX Portal::GetPortalMatrix()const
 {
-	XMVECTOR L = XMLoadFloat3(&Left);
-	XMVECTOR U = XMLoadFloat3(&Up);
-	XMVECTOR N = XMLoadFloat3(&Normal);
-
-	XMVECTOR P = XMLoadFloat3(&Position);
-	float tL = -XMVectorGetX(XMVector3Dot(P, L));
-	float tU = -XMVectorGetX(XMVector3Dot(P, U));
-	float tN = -XMVectorGetX(XMVector3Dot(P, N));
+	float tL = -XMFloat3Dot(Position, Left);
+	float tU = -XMFloat3Dot(Position, Up);
+	float tN = -XMFloat3Dot(Position, Normal);
 
 	// no scaling used.  portal size does not matter for this matrix
 	return XMMATRIX(	Left.x,		Up.x,			Normal.x,		0.0f,
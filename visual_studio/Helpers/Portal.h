@@ -4,10 +4,21 @@
 #include "d3dUtil.h"
 #include "Macros.h"
 #include "GeometryGenerator.h"
+#include "SimdMath.h"
 #include <limits>
 
 class Portal
 {
+public:
+	// how the ring quartic's roots are refined inside each monotonic interval.  regula falsi runs until
+	// its guesses settle; Illinois halves the f of an endpoint kept twice in a row, so it can't stall on
+	// one side and stops after ITERATIVE_MAX_STEPS steps
+	enum RootSolver
+	{
+		ROOT_SOLVER_REGULA_FALSI,
+		ROOT_SOLVER_ILLINOIS
+	};
+
 private:
 	// physical attributes
 	XMFLOAT3 Position;
@@ -23,8 +34,13 @@ private:
 	// texture attributes
 	float TextureRadiusRatio;
 
+	// changes whenever any of the above does, so cached values derived from them can tell when to update
+	unsigned int Version;
+	static volatile long LastVersion;	// incremented atomically, since the render thread transforms copies of portals
+
 public:
 	Portal();
+	Portal(const Portal &rhs);
 	~Portal();
 
 	void SetTextureRadiusRatio(float TextureRadiusRatio);
@@ -75,12 +91,31 @@ public:
 	
 	bool PathCrossesPortal(XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist)const;
 
+	unsigned int GetVersion()const;
+
+	// how many SpherePathCollision calls solved the ring quartic, and how many skipped it
+	// because the path was nowhere near the ring.  shared by all portals
+	static void GetRingQuarticCounters(unsigned int *Solved_ptr, unsigned int *Skipped_ptr);
+	static void ResetRingQuarticCounters();
+
+	// shared by all portals.  starts as ITERATIVE_ILLINOIS picks; only change it while no collisions are running
+	static void SetRootSolver(RootSolver Solver);
+	static RootSolver GetRootSolver();
+
 private:
+	void Changed();
+	bool PathMayTouchRing(float SphereRadius, const Vec3 &Sp, const Vec3 &Dirp, float tmin, float tmax)const;
+
 	static bool FindLowestQuarticRootInInterval(const float coeffs[5], float m, float n, float *x_ptr);;
 	static int FindQuadraticRootsInInterval(const float coeffs[3], float m, float n, float xs[2]);
 	static int FindCubicRootsInInterval(const float coeffs[4], float m, float n, float xs[3]);
 	static bool FindPolynomialRootInMonotonicInterval(int degree, const float *coeffs, float m, float n, float *x_ptr, bool *IsIncreasing_ptr);
 	static float CalculatePolynomial(float t, int degree, const float *coeffs);
+
+	static unsigned int RingQuarticsSolved;
+	static unsigned int RingQuarticsSkipped;
+
+	static RootSolver Solver;
 };
 
 #endif
\ No newline at end of file
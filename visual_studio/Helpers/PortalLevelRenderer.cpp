@@ -0,0 +1,118 @@
+#include "PortalLevelRenderer.h"
+
+PortalLevelRenderer::PortalLevelRenderer()
+{
+}
+
+PortalLevelRenderer::~PortalLevelRenderer()
+{
+}
+
+
+void PortalLevelRenderer::Render(const PortalPair &Portals, const Portal &LookThruPortal,
+				const std::vector<PortalRecursionPlanner::Level> &Levels,
+				const std::vector<Room::IndexRange> &WallRanges,
+				const Camera &Cam, const XMFLOAT3 LightDirections[3], const XMMATRIX &PlayerWorld,
+				RenderBackend &Backend)
+{
+	if (Levels.empty())
+		return;
+
+	const XMMATRIX &Virtualize = Portals.GetVirtualize(LookThruPortal);
+	XMMATRIX View = Cam.GetViewMatrix();
+	XMMATRIX ViewProj = View * Cam.GetProjMatrix();
+
+	Slots.resize(Levels.size() + 1);
+	SlotPlaneClip.resize(Levels.size() + 1);
+
+	// slot 0 is the real world.  only the depth-clearing box of the first level is drawn in it
+	RenderBackend::LevelSlot &RealSlot = Slots[0];
+	XMStoreFloat4x4(&RealSlot.WorldToVirtual, XMMatrixIdentity());
+	XMStoreFloat4x4(&RealSlot.ViewProj, ViewProj);
+	XMStoreFloat4x4(&RealSlot.PortalBoxWorld, LookThruPortal.GetBoxWorldMatrix());
+	for (unsigned int i=0; i<3; ++i)
+		RealSlot.LightDirections[i] = LightDirections[i];
+	SetSlotClipPlane(LookThruPortal, &RealSlot);
+	SlotPlaneClip[0] = false;
+
+	for (unsigned int l=0; l<Levels.size(); ++l)
+	{
+		const Portal &CurrentPortal = Levels[l].CurrentPortal;
+		RenderBackend::LevelSlot &Slot = Slots[l+1];
+		const RenderBackend::LevelSlot &PrevSlot = Slots[l];
+
+		Slot.WorldToVirtual = Levels[l].WorldToVirtual;
+		XMStoreFloat4x4(&Slot.PortalBoxWorld, Levels[l].NextPortal.GetBoxWorldMatrix());
+
+		// each realm's lights are the previous realm's, virtualized once more
+		for (unsigned int i=0; i<3; ++i)
+		{
+			XMVECTOR D = XMLoadFloat3(&PrevSlot.LightDirections[i]);
+			D = XMVector3Normalize(XMVector3TransformNormal(D, Virtualize));
+			XMStoreFloat3(&Slot.LightDirections[i], D);
+		}
+
+		// everything in this realm must be clipped using the plane of the CurrentPortal, preferably by the near
+		// plane of an oblique projection.  only the depth row changes, so x, y and the stencil match ViewProj
+		SetSlotClipPlane(CurrentPortal, &Slot);
+		XMMATRIX ObliqueProj;
+		bool PlaneClip = !Cam.GetObliqueProjMatrix(CurrentPortal.GetPosition(), -CurrentPortal.GetNormal(), &ObliqueProj);
+		XMStoreFloat4x4(&Slot.ViewProj, PlaneClip ? ViewProj : View * ObliqueProj);
+		SlotPlaneClip[l+1] = PlaneClip;
+	}
+
+	XMFLOAT4X4 PlayerWorldF;
+	XMStoreFloat4x4(&PlayerWorldF, PlayerWorld);
+	Backend.SetLevelSlots(&Slots[0], (UINT)Slots.size(), PlayerWorldF);
+
+	UINT FloorCount = Backend.GetIndexCount(RenderBackend::MESH_FLOOR);
+	UINT CeilingCount = Backend.GetIndexCount(RenderBackend::MESH_CEILING);
+	UINT PlayerCount = Backend.GetIndexCount(RenderBackend::MESH_PLAYER);
+	UINT BoxCount = Backend.GetIndexCount(RenderBackend::MESH_PORTAL_BOX);
+
+	for (unsigned int l=0; l<Levels.size(); ++l)
+	{
+		UINT StencilRef = Levels[l].StencilRef;
+		UINT Slot = l + 1;
+		bool PlaneClip = SlotPlaneClip[Slot];
+
+		// only this level's stencil ref passes inside the draws below, and it was only written inside the scissor
+		// rect, so the rect just skips pixels the stencil test would have failed
+		int Left, Top, Right, Bottom;
+		Levels[l].Scissor.GetPixelBounds(&Left, &Top, &Right, &Bottom);
+		Backend.SetScissor(true, Left, Top, Right, Bottom);
+
+		// render current portal box to clear depth of this portal's insides.  the current portal's box is the
+		// previous realm's next portal box
+		Backend.SetStencil(RenderBackend::STENCIL_EQUAL_DEPTH_ALWAYS, StencilRef);
+		Backend.DrawLevel(RenderBackend::MESH_PORTAL_BOX_CLEAR_DEPTH, Slot - 1, false, 0, BoxCount);
+
+		// render virtual room with both portals, even though we only need CurrentPortal
+		Backend.SetStencil(RenderBackend::STENCIL_EQUAL, StencilRef);
+		for (UINT r=0; r<Levels[l].WallRangeCount; ++r)
+		{
+			const Room::IndexRange &Range = WallRanges[Levels[l].WallRangeStart + r];
+			Backend.DrawLevel(RenderBackend::MESH_WALLS, Slot, PlaneClip, Range.Start, Range.Count);
+		}
+		Backend.DrawLevel(RenderBackend::MESH_FLOOR, Slot, PlaneClip, 0, FloorCount);
+		Backend.DrawLevel(RenderBackend::MESH_CEILING, Slot, PlaneClip, 0, CeilingCount);
+
+		// render virtual player
+		if (Levels[l].PlayerVisible)
+			Backend.DrawLevel(RenderBackend::MESH_PLAYER, Slot, PlaneClip, 0, PlayerCount);
+
+		// render next portal box to increment stencil, and to cover up hole
+		Backend.SetStencil(RenderBackend::STENCIL_EQUAL_INCREMENT, StencilRef);
+		Backend.DrawLevel(RenderBackend::MESH_PORTAL_BOX, Slot, PlaneClip, 0, BoxCount);
+	}
+	Backend.SetScissor(false, 0, 0, 0, 0);
+}
+
+
+void PortalLevelRenderer::SetSlotClipPlane(const Portal &ClipPortal, RenderBackend::LevelSlot *Slot_ptr)
+{
+	Slot_ptr->ClipPlanePosition = ClipPortal.GetPosition();
+	Slot_ptr->ClipPlaneNormal = -ClipPortal.GetNormal();
+	Slot_ptr->ClipPlaneOffset = 0.0f;
+	Slot_ptr->Pad = 0.0f;
+}
@@ -0,0 +1,38 @@
+#ifndef PORTALLEVELRENDERER_H
+#define PORTALLEVELRENDERER_H
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include <vector>
+#include "Camera.h"
+#include "Portal.h"
+#include "PortalPair.h"
+#include "PortalRecursionPlanner.h"
+#include "Room.h"
+#include "RenderBackend.h"
+
+// draws the planned levels of a portal's insides through a RenderBackend, for when the player isn't clipping
+// a portal.  every realm's constants go into one slot array uploaded once per portal: slot 0 is the real world,
+// slot l+1 is the realm of level l.  the levels themselves can't be merged into fewer draws, since each one's
+// stencil ref and depth clear depend on the level before it
+class PortalLevelRenderer
+{
+public:
+	PortalLevelRenderer();
+	~PortalLevelRenderer();
+
+	void Render(const PortalPair &Portals, const Portal &LookThruPortal,
+				const std::vector<PortalRecursionPlanner::Level> &Levels,
+				const std::vector<Room::IndexRange> &WallRanges,
+				const Camera &Cam, const XMFLOAT3 LightDirections[3], const XMMATRIX &PlayerWorld,
+				RenderBackend &Backend);
+
+private:
+	// kept around so rendering doesn't allocate
+	std::vector<RenderBackend::LevelSlot> Slots;
+	std::vector<bool> SlotPlaneClip;
+
+	static void SetSlotClipPlane(const Portal &ClipPortal, RenderBackend::LevelSlot *Slot_ptr);
+};
+
+#endif
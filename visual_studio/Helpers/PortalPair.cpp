@@ -0,0 +1,85 @@
+#include "PortalPair.h"
+
+PortalPair::PortalPair(const Portal &First, const Portal &Second)
+	: CacheValid(false)
+{
+	Portals[0] = &First;
+	Portals[1] = &Second;
+	VirtualizePowers[0][0] = XMMatrixIdentity();
+	VirtualizePowers[1][0] = XMMatrixIdentity();
+	VirtualizePowersBuilt[0] = 0;
+	VirtualizePowersBuilt[1] = 0;
+}
+
+PortalPair::~PortalPair()
+{
+}
+
+
+const Portal& PortalPair::GetFirst()const
+{
+	return *Portals[0];
+}
+const Portal& PortalPair::GetSecond()const
+{
+	return *Portals[1];
+}
+const Portal& PortalPair::GetOther(const Portal &ThisPortal)const
+{
+	return *Portals[1-IndexOf(ThisPortal)];
+}
+
+
+const XMMATRIX& PortalPair::GetVirtualize(const Portal &LookThru)const
+{
+	Update();
+	return Virtualize[IndexOf(LookThru)];
+}
+
+// looking through one portal undoes looking through the other
+const XMMATRIX& PortalPair::GetUnvirtualize(const Portal &LookThru)const
+{
+	Update();
+	return Virtualize[1-IndexOf(LookThru)];
+}
+
+float PortalPair::GetVirtualizeScale(const Portal &LookThru)const
+{
+	Update();
+	return VirtualizeScale[IndexOf(LookThru)];
+}
+
+const XMMATRIX& PortalPair::GetVirtualizePower(const Portal &LookThru, int Level)const
+{
+	Update();
+	int i = IndexOf(LookThru);
+	while (VirtualizePowersBuilt[i] < Level)
+	{
+		int Built = ++VirtualizePowersBuilt[i];
+		VirtualizePowers[i][Built] = (Built==1) ? Virtualize[i] : VirtualizePowers[i][Built-1] * Virtualize[i];
+	}
+	return VirtualizePowers[i][Level];
+}
+
+
+int PortalPair::IndexOf(const Portal &ThisPortal)const
+{
+	return (&ThisPortal == Portals[0]) ? 0 : 1;
+}
+
+void PortalPair::Update()const
+{
+	if (CacheValid && CachedVersions[0]==Portals[0]->GetVersion() && CachedVersions[1]==Portals[1]->GetVersion())
+		return;
+
+	for (int i=0; i<2; ++i)
+	{
+		const Portal &LookThru = *Portals[i];
+		const Portal &Other = *Portals[1-i];
+		Virtualize[i] = Portal::CalculateVirtualizationMatrix(LookThru, Other);
+		VirtualizeScale[i] = LookThru.GetPhysicalRadius() / Other.GetPhysicalRadius();
+		VirtualizePowersBuilt[i] = 0;
+		CachedVersions[i] = LookThru.GetVersion();
+	}
+	CacheValid = true;
+}
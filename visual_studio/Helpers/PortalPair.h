@@ -0,0 +1,49 @@
+#ifndef PORTALPAIR_H
+#define PORTALPAIR_H
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Portal.h"
+
+// two linked portals, and the virtualization matrices between them.  the matrices are only
+// recalculated when one of the portals has changed since they were last used
+class PortalPair
+{
+public:
+	PortalPair(const Portal &First, const Portal &Second);
+	~PortalPair();
+
+	const Portal& GetFirst()const;
+	const Portal& GetSecond()const;
+	const Portal& GetOther(const Portal &ThisPortal)const;
+
+	// LookThru must be one of the two portals of this pair.
+	// Virtualize is Portal::CalculateVirtualizationMatrix(LookThru, other portal), Unvirtualize is its inverse
+	const XMMATRIX& GetVirtualize(const Portal &LookThru)const;
+	const XMMATRIX& GetUnvirtualize(const Portal &LookThru)const;
+	float GetVirtualizeScale(const Portal &LookThru)const;
+
+	// Virtualize^Level, for 0 <= Level <= PORTAL_ITERATIONS
+	const XMMATRIX& GetVirtualizePower(const Portal &LookThru, int Level)const;
+
+private:
+	int IndexOf(const Portal &ThisPortal)const;
+	void Update()const;
+
+private:
+	const Portal *Portals[2];
+
+	// portal versions the cached values were calculated from
+	mutable unsigned int CachedVersions[2];
+	mutable bool CacheValid;
+
+	// index i is for looking through Portals[i]
+	mutable XMMATRIX Virtualize[2];
+	mutable float VirtualizeScale[2];
+
+	// powers are only built as deep as they've been asked for.  VirtualizePowers[i][0] is the identity
+	mutable XMMATRIX VirtualizePowers[2][PORTAL_ITERATIONS+1];
+	mutable int VirtualizePowersBuilt[2];
+};
+
+#endif
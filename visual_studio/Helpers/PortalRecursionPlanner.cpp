@@ -0,0 +1,244 @@
+#include "PortalRecursionPlanner.h"
+
+PortalRecursionPlanner::ScreenRect::ScreenRect()
+	: Left(0.0f), Top(0.0f), Right(0.0f), Bottom(0.0f)
+{
+}
+
+PortalRecursionPlanner::ScreenRect::ScreenRect(float Left, float Top, float Right, float Bottom)
+	: Left(Left), Top(Top), Right(Right), Bottom(Bottom)
+{
+}
+
+bool PortalRecursionPlanner::ScreenRect::IsEmpty()const
+{
+	return (Right <= Left || Bottom <= Top);
+}
+
+float PortalRecursionPlanner::ScreenRect::GetArea()const
+{
+	if (IsEmpty())
+		return 0.0f;
+	return (Right - Left) * (Bottom - Top);
+}
+
+PortalRecursionPlanner::ScreenRect PortalRecursionPlanner::ScreenRect::Intersect(const ScreenRect &rhs)const
+{
+	return ScreenRect(max(Left, rhs.Left), max(Top, rhs.Top), min(Right, rhs.Right), min(Bottom, rhs.Bottom));
+}
+
+void PortalRecursionPlanner::ScreenRect::GetPixelBounds(int *Left_ptr, int *Top_ptr, int *Right_ptr, int *Bottom_ptr)const
+{
+	*Left_ptr = (int)floorf(Left);
+	*Top_ptr = (int)floorf(Top);
+	*Right_ptr = (int)ceilf(Right);
+	*Bottom_ptr = (int)ceilf(Bottom);
+}
+
+
+
+void PortalRecursionPlanner::Plan(const PortalPair &Portals, const Portal &LookThruPortal, int PlayerInitialLevel,
+					UINT InitialStencilRef, int MaxLevels, XMFLOAT3 EyePos, const XMMATRIX &ViewProj,
+					const ScreenRect &Viewport, std::vector<Level> &Levels)
+{
+	Levels.clear();
+
+	const XMMATRIX &Virtualize = Portals.GetVirtualize(LookThruPortal);
+	Portal CurrentPortal = LookThruPortal;
+	ScreenRect ParentRect = Viewport;
+
+	for (int i=0; i<MaxLevels; ++i)
+	{
+		// the insides of CurrentPortal can only show up where CurrentPortal does, and inside the portal before it
+		ScreenRect Rect = ProjectPortalBox(CurrentPortal, ViewProj, Viewport).Intersect(ParentRect);
+		if (Rect.GetArea() < PORTAL_PLAN_MIN_PIXEL_AREA)
+			break;
+
+		Levels.push_back(Level());
+		Level &L = Levels.back();
+		L.CurrentPortal = CurrentPortal;
+		XMStoreFloat4x4(&L.WorldToVirtual, Portals.GetVirtualizePower(LookThruPortal, i+1));
+		XMStoreFloat4x4(&L.OldPlayerWorldToVirtual, Portals.GetVirtualizePower(LookThruPortal, PlayerInitialLevel+i));
+		XMStoreFloat4x4(&L.PlayerWorldToVirtual, Portals.GetVirtualizePower(LookThruPortal, PlayerInitialLevel+i+1));
+		L.StencilRef = InitialStencilRef + i;
+		L.Scissor = Rect;
+		L.CullPlaneCount = BuildCullPlanes(CurrentPortal, EyePos, ViewProj, Viewport, Rect, L.CullPlanes);
+		L.WallRangeStart = 0;
+		L.WallRangeCount = 0;
+		L.OldPlayerVisible = true;
+		L.PlayerVisible = true;
+
+		// calculate next portal
+		CurrentPortal.Transform(Virtualize);
+		L.NextPortal = CurrentPortal;
+
+		ParentRect = Rect;
+	}
+}
+
+
+PortalRecursionPlanner::ScreenRect PortalRecursionPlanner::ProjectPortalBox(const Portal &ThisPortal,
+					const XMMATRIX &ViewProj, const ScreenRect &Viewport)
+{
+	// corners of a box around the portal box mesh: the N-gon's circumradius in portal space,
+	// from the portal plane to PORTAL_BOX_DEPTH behind it
+	float R = 1.0f / cosf(PI / PORTAL_BOX_N_SIDES);
+	XMMATRIX BoxToClip = ThisPortal.GetBoxWorldMatrix() * ViewProj;
+
+	XMVECTOR Clip[8];
+	UINT OutsideAll = 0x1f;		// clip planes that every corner is outside of
+	bool BehindEye = false;
+	for (int i=0; i<8; ++i)
+	{
+		XMVECTOR Corner = XMVectorSet((i&1) ? R : -R, (i&2) ? R : -R, (i&4) ? -PORTAL_BOX_DEPTH : 0.0f, 1.0f);
+		Clip[i] = XMVector4Transform(Corner, BoxToClip);
+
+		float x = XMVectorGetX(Clip[i]);
+		float y = XMVectorGetY(Clip[i]);
+		float w = XMVectorGetW(Clip[i]);
+		UINT Outside = 0;
+		if (x < -w)	Outside |= 0x01;
+		if (x > w)	Outside |= 0x02;
+		if (y < -w)	Outside |= 0x04;
+		if (y > w)	Outside |= 0x08;
+		if (w <= 0.0f)	Outside |= 0x10;
+		OutsideAll &= Outside;
+		BehindEye = BehindEye || (w <= 0.0f);
+	}
+
+	// box is entirely off one side of the frustum
+	if (OutsideAll != 0)
+		return ScreenRect();
+
+	// a corner behind the eye doesn't project to anything sensible.  the box might cover the whole screen
+	if (BehindEye)
+		return Viewport;
+
+	float MinX = std::numeric_limits<float>::infinity();
+	float MaxX = -MinX;
+	float MinY = MinX;
+	float MaxY = -MinX;
+	for (int i=0; i<8; ++i)
+	{
+		float w = XMVectorGetW(Clip[i]);
+		float x = XMVectorGetX(Clip[i]) / w;
+		float y = XMVectorGetY(Clip[i]) / w;
+		MinX = min(MinX, x);
+		MaxX = max(MaxX, x);
+		MinY = min(MinY, y);
+		MaxY = max(MaxY, y);
+	}
+
+	// NDC to pixels.  NDC y points up, screen y points down
+	float Width = Viewport.Right - Viewport.Left;
+	float Height = Viewport.Bottom - Viewport.Top;
+	ScreenRect Rect(Viewport.Left + 0.5f*(MinX + 1.0f)*Width,
+					Viewport.Top + 0.5f*(1.0f - MaxY)*Height,
+					Viewport.Left + 0.5f*(MaxX + 1.0f)*Width,
+					Viewport.Top + 0.5f*(1.0f - MinY)*Height);
+	return Rect.Intersect(Viewport);
+}
+
+
+
+void PortalRecursionPlanner::Cull(const Room &ThisRoom, XMFLOAT3 PlayerCenter, float PlayerRadius,
+					std::vector<Level> &Levels, std::vector<Room::IndexRange> &WallRanges)
+{
+	WallRanges.clear();
+
+	XMFLOAT4 RoomPlanes[PORTAL_CULL_MAX_PLANES];
+	for (unsigned int l=0; l<Levels.size(); ++l)
+	{
+		Level &L = Levels[l];
+
+		// a room point P is drawn at P*WorldToVirtual, so the room space plane is WorldToVirtual*Plane
+		XMMATRIX PlaneToRoom = XMMatrixTranspose(XMLoadFloat4x4(&L.WorldToVirtual));
+		for (UINT p=0; p<L.CullPlaneCount; ++p)
+			XMStoreFloat4(&RoomPlanes[p], XMVector4Transform(XMLoadFloat4(&L.CullPlanes[p]), PlaneToRoom));
+
+		L.WallRangeStart = WallRanges.size();
+		ThisRoom.CullWalls(RoomPlanes, L.CullPlaneCount, WallRanges);
+		L.WallRangeCount = WallRanges.size() - L.WallRangeStart;
+
+		// the virtualization matrices scale uniformly
+		XMMATRIX OldPlayerWorldToVirtual = XMLoadFloat4x4(&L.OldPlayerWorldToVirtual);
+		XMMATRIX PlayerWorldToVirtual = XMLoadFloat4x4(&L.PlayerWorldToVirtual);
+		L.OldPlayerVisible = SphereInsidePlanes(XMFloat3TransformCoord(PlayerCenter, OldPlayerWorldToVirtual),
+					PlayerRadius * XMVectorGetX(XMVector3Length(OldPlayerWorldToVirtual.r[0])), L.CullPlanes, L.CullPlaneCount);
+		L.PlayerVisible = SphereInsidePlanes(XMFloat3TransformCoord(PlayerCenter, PlayerWorldToVirtual),
+					PlayerRadius * XMVectorGetX(XMVector3Length(PlayerWorldToVirtual.r[0])), L.CullPlanes, L.CullPlaneCount);
+	}
+}
+
+
+UINT PortalRecursionPlanner::BuildCullPlanes(const Portal &ThisPortal, XMFLOAT3 EyePos, const XMMATRIX &ViewProj,
+					const ScreenRect &Viewport, const ScreenRect &Rect, XMFLOAT4 *Planes)
+{
+	UINT PlaneCount = 0;
+
+	// the frustum through Rect: Left <= x/w <= Right and Bottom <= y/w <= Top in NDC.
+	// with Clip = P*ViewProj, x is dot(P, column 0 of ViewProj) and so on
+	float Width = Viewport.Right - Viewport.Left;
+	float Height = Viewport.Bottom - Viewport.Top;
+	float NdcLeft = 2.0f*(Rect.Left - Viewport.Left)/Width - 1.0f;
+	float NdcRight = 2.0f*(Rect.Right - Viewport.Left)/Width - 1.0f;
+	float NdcTop = 1.0f - 2.0f*(Rect.Top - Viewport.Top)/Height;
+	float NdcBottom = 1.0f - 2.0f*(Rect.Bottom - Viewport.Top)/Height;
+
+	XMMATRIX Columns = XMMatrixTranspose(ViewProj);
+	XMStoreFloat4(&Planes[PlaneCount++], Columns.r[0] - NdcLeft*Columns.r[3]);
+	XMStoreFloat4(&Planes[PlaneCount++], NdcRight*Columns.r[3] - Columns.r[0]);
+	XMStoreFloat4(&Planes[PlaneCount++], Columns.r[1] - NdcBottom*Columns.r[3]);
+	XMStoreFloat4(&Planes[PlaneCount++], NdcTop*Columns.r[3] - Columns.r[1]);
+
+	// only what's behind the portal is drawn, same as the clip plane
+	XMFLOAT3 C = ThisPortal.GetPosition();
+	XMFLOAT3 N = ThisPortal.GetNormal();
+	Planes[PlaneCount++] = XMFLOAT4(-N.x, -N.y, -N.z, XMFloat3Dot(C, N));
+
+	// planes through the eye and each side of the portal box.  each plane has to keep both the front and back
+	// edge of its side, so it goes through whichever one is further out.  skipped if the eye is too close to
+	// the portal plane for the planes to mean anything
+	if (XMFloat3Dot(EyePos - C, N) <= PORTAL_BOX_DEPTH)
+		return PlaneCount;
+
+	XMMATRIX BoxWorld = ThisPortal.GetBoxWorldMatrix();
+	float R = 1.0f / cosf(PI / PORTAL_BOX_N_SIDES);
+	float RadiansPerSlice = 2.0f * PI / PORTAL_BOX_N_SIDES;
+	for (int i=0; i<PORTAL_BOX_N_SIDES; ++i)
+	{
+		float Theta0 = (float)i * RadiansPerSlice;
+		float Theta1 = (float)(i+1) * RadiansPerSlice;
+		XMFLOAT3 Front0 = XMFloat3TransformCoord(XMFLOAT3(R*cosf(Theta0), R*sinf(Theta0), 0.0f), BoxWorld);
+		XMFLOAT3 Front1 = XMFloat3TransformCoord(XMFLOAT3(R*cosf(Theta1), R*sinf(Theta1), 0.0f), BoxWorld);
+		XMFLOAT3 Back0 = XMFloat3TransformCoord(XMFLOAT3(R*cosf(Theta0), R*sinf(Theta0), -PORTAL_BOX_DEPTH), BoxWorld);
+		XMFLOAT3 Back1 = XMFloat3TransformCoord(XMFLOAT3(R*cosf(Theta1), R*sinf(Theta1), -PORTAL_BOX_DEPTH), BoxWorld);
+
+		// orient towards the portal center
+		XMFLOAT3 Normal = XMFloat3Cross(Front0 - EyePos, Front1 - EyePos);
+		if (XMFloat3Dot(Normal, C - EyePos) < 0.0f)
+			Normal = -Normal;
+		if (XMFloat3Dot(Normal, Back0 - EyePos) < 0.0f)
+		{
+			Normal = XMFloat3Cross(Back0 - EyePos, Back1 - EyePos);
+			if (XMFloat3Dot(Normal, C - EyePos) < 0.0f)
+				Normal = -Normal;
+		}
+		Planes[PlaneCount++] = XMFLOAT4(Normal.x, Normal.y, Normal.z, -XMFloat3Dot(Normal, EyePos));
+	}
+
+	return PlaneCount;
+}
+
+
+bool PortalRecursionPlanner::SphereInsidePlanes(XMFLOAT3 Center, float Radius, const XMFLOAT4 *Planes, UINT PlaneCount)
+{
+	// the planes aren't normalized, so the radius is scaled by the length of each plane normal instead
+	for (UINT p=0; p<PlaneCount; ++p)
+	{
+		XMFLOAT3 Normal(Planes[p].x, Planes[p].y, Planes[p].z);
+		if (XMFloat3Dot(Normal, Center) + Planes[p].w < -Radius * XMFloat3Length(Normal))
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,82 @@
+#ifndef PORTALRECURSIONPLANNER_H
+#define PORTALRECURSIONPLANNER_H
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include <vector>
+#include "MathFunctions.h"
+#include "Portal.h"
+#include "PortalPair.h"
+#include "Room.h"
+
+// decides how many levels of a portal's insides are worth rendering.  each successive portal is projected
+// to a screen rect and clipped to the rect of the level before it; recursion stops once the rect is empty
+// or smaller than PORTAL_PLAN_MIN_PIXEL_AREA.  each level also gets the volume visible through its portal,
+// used to cull the walls and the player before drawing them.  doesn't touch the GPU
+class PortalRecursionPlanner
+{
+public:
+	// in pixels, Left/Top inclusive, Right/Bottom exclusive
+	struct ScreenRect
+	{
+		float Left;
+		float Top;
+		float Right;
+		float Bottom;
+
+		ScreenRect();
+		ScreenRect(float Left, float Top, float Right, float Bottom);
+		bool IsEmpty()const;
+		float GetArea()const;
+		ScreenRect Intersect(const ScreenRect &rhs)const;
+
+		// rounded out to whole pixels, for RenderBackend::SetScissor
+		void GetPixelBounds(int *Left_ptr, int *Top_ptr, int *Right_ptr, int *Bottom_ptr)const;
+	};
+
+	// everything RenderPortalInsides needs to draw one level
+	struct Level
+	{
+		Portal CurrentPortal;		// this level is seen through CurrentPortal.  also its clip plane
+		Portal NextPortal;			// CurrentPortal one level deeper, drawn to increment the stencil
+		XMFLOAT4X4 WorldToVirtual;
+		XMFLOAT4X4 OldPlayerWorldToVirtual;		// player copies for when the player clips a portal
+		XMFLOAT4X4 PlayerWorldToVirtual;
+		UINT StencilRef;
+		ScreenRect Scissor;			// screen bounds of CurrentPortal at this level.  every draw of the level is inside it
+
+		// world space volume that can be seen through CurrentPortal at this level: the frustum through
+		// Scissor, the portal plane, and the planes through the eye and the sides of the portal box.
+		// a point P is inside if dot(Plane.xyz, P) + Plane.w >= 0 for every plane
+		XMFLOAT4 CullPlanes[PORTAL_CULL_MAX_PLANES];
+		UINT CullPlaneCount;
+
+		// filled in by Cull.  the visible walls are WallRanges[WallRangeStart] to WallRanges[WallRangeStart+WallRangeCount-1]
+		UINT WallRangeStart;
+		UINT WallRangeCount;
+		bool OldPlayerVisible;
+		bool PlayerVisible;
+	};
+
+	// fills Levels with at most MaxLevels levels of LookThruPortal's insides.
+	// PlayerInitialLevel is only used for the player matrices; pass 0 if the player isn't clipping a portal
+	static void Plan(const PortalPair &Portals, const Portal &LookThruPortal, int PlayerInitialLevel,
+					UINT InitialStencilRef, int MaxLevels, XMFLOAT3 EyePos, const XMMATRIX &ViewProj,
+					const ScreenRect &Viewport, std::vector<Level> &Levels);
+
+	// culls the room's walls and the player's bounding sphere against the cull planes of every level.
+	// each level draws the room with WorldToVirtual, so the planes are taken into room space first
+	static void Cull(const Room &ThisRoom, XMFLOAT3 PlayerCenter, float PlayerRadius,
+					std::vector<Level> &Levels, std::vector<Room::IndexRange> &WallRanges);
+
+	// screen bounds of the portal box, empty if it's outside the frustum.  if the box crosses the eye plane,
+	// returns the whole viewport
+	static ScreenRect ProjectPortalBox(const Portal &ThisPortal, const XMMATRIX &ViewProj, const ScreenRect &Viewport);
+
+private:
+	static UINT BuildCullPlanes(const Portal &ThisPortal, XMFLOAT3 EyePos, const XMMATRIX &ViewProj,
+					const ScreenRect &Viewport, const ScreenRect &Rect, XMFLOAT4 *Planes);
+	static bool SphereInsidePlanes(XMFLOAT3 Center, float Radius, const XMFLOAT4 *Planes, UINT PlaneCount);
+};
+
+#endif
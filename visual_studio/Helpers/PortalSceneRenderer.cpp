@@ -0,0 +1,320 @@
+#include "PortalSceneRenderer.h"
+
+PortalSceneRenderer::PortalSceneRenderer()
+{
+}
+
+PortalSceneRenderer::~PortalSceneRenderer()
+{
+}
+
+
+void PortalSceneRenderer::RenderPortalView(const Room &ThisRoom, const PortalPair &Portals, FirstPersonObject &Player,
+				bool PlayerIntersectOrangePortal, bool PlayerIntersectBluePortal,
+				const Camera &Cam, const PortalRecursionPlanner::ScreenRect &Viewport,
+				const XMFLOAT3 LightDirections[3], RenderBackend &Backend)
+{
+	const Portal &OrangePortal = Portals.GetFirst();
+	const Portal &BluePortal = Portals.GetSecond();
+	XMMATRIX ViewProj = Cam.GetViewMatrix() * Cam.GetProjMatrix();
+	XMMATRIX PlayerWorld = Player.GetWorldMatrix();
+
+	// calculate how many iterations the world should be virtualized inside each portal
+	int OrangePortalIterations = 1;
+	int BluePortalIterations = 1;
+
+	XMFLOAT3 PortalCenters[2] = { OrangePortal.GetPosition(), BluePortal.GetPosition() };
+	XMFLOAT3 PortalNormals[2] = { OrangePortal.GetNormal(), BluePortal.GetNormal() };
+	float PortalRadii[2] = { OrangePortal.GetPhysicalRadius(), BluePortal.GetPhysicalRadius() };
+	Camera::CullResult PortalCulls[2];
+	Cam.ClassifyDiscs(PortalCenters, PortalNormals, PortalRadii, 2, PortalCulls);
+
+	bool OrangePortalInFrustum = (PortalCulls[0] != Camera::CULL_OUTSIDE);
+	bool BluePortalInFrustum = (PortalCulls[1] != Camera::CULL_OUTSIDE);
+	float OrangePortalVisibility = Cam.SurfaceVisibilityFactor(OrangePortal.GetPosition(), OrangePortal.GetNormal());
+	float BluePortalVisibility  = Cam.SurfaceVisibilityFactor(BluePortal.GetPosition(), BluePortal.GetNormal());
+	
+	bool CanSeeOrange = OrangePortalInFrustum && (OrangePortalVisibility >= 0.0f);
+	bool CanSeeBlue = BluePortalInFrustum && (BluePortalVisibility >= 0.0f);
+
+	if (CanSeeOrange && CanSeeBlue)
+	{
+		OrangePortalIterations = PORTAL_ITERATIONS / 2;
+		BluePortalIterations = PORTAL_ITERATIONS - OrangePortalIterations;
+	}
+	else if (CanSeeOrange)
+		OrangePortalIterations = PORTAL_ITERATIONS-1;
+	else if (CanSeeBlue)
+		BluePortalIterations = PORTAL_ITERATIONS-1;
+
+
+	// set per-view constants
+	Backend.SetPortals(OrangePortal, BluePortal);
+	Backend.SetEye(Cam.GetPosition(), Cam.GetViewScale());
+	Backend.SetLights(LightDirections);
+
+
+	// render room and both portals
+
+	Backend.SetStencil(RenderBackend::STENCIL_DEFAULT, 0);
+	Room::IndexRange AllWalls = { 0, Backend.GetIndexCount(RenderBackend::MESH_WALLS) };
+	DrawRoom(RenderBackend::SHADE_DEFAULT, &AllWalls, 1, XMMatrixIdentity(), ViewProj, Backend);
+
+
+	// rest of rendering steps depends on whether or not the player intersects the portal
+
+	if (PlayerIntersectOrangePortal || PlayerIntersectBluePortal)
+	{
+		const Portal *ThisPortal_ptr;
+		int ThisPortalIterations;
+		UINT ThisPortalStencilRef;
+		std::vector<PortalRecursionPlanner::Level> *ThisPortalPlan_ptr;
+		std::vector<Room::IndexRange> *ThisPortalWallRanges_ptr;
+
+		const Portal *OtherPortal_ptr;
+		int OtherPortalIterations;
+		UINT OtherPortalStencilRef;
+		std::vector<PortalRecursionPlanner::Level> *OtherPortalPlan_ptr;
+		std::vector<Room::IndexRange> *OtherPortalWallRanges_ptr;
+		
+		if (PlayerIntersectOrangePortal)
+		{
+			ThisPortal_ptr = &OrangePortal;
+			ThisPortalIterations = OrangePortalIterations;
+			ThisPortalStencilRef = ORANGE_STENCIL_REF;
+			ThisPortalPlan_ptr = &OrangePortalPlan;
+			ThisPortalWallRanges_ptr = &OrangePortalWallRanges;
+			OtherPortal_ptr = &BluePortal;
+			OtherPortalIterations = BluePortalIterations;
+			OtherPortalStencilRef = BLUE_STENCIL_REF;
+			OtherPortalPlan_ptr = &BluePortalPlan;
+			OtherPortalWallRanges_ptr = &BluePortalWallRanges;
+		}
+		else
+		{
+			ThisPortal_ptr = &BluePortal;
+			ThisPortalIterations = BluePortalIterations;
+			ThisPortalStencilRef = BLUE_STENCIL_REF;
+			ThisPortalPlan_ptr = &BluePortalPlan;
+			ThisPortalWallRanges_ptr = &BluePortalWallRanges;
+			OtherPortal_ptr = &OrangePortal;
+			OtherPortalIterations = OrangePortalIterations;
+			OtherPortalStencilRef =  ORANGE_STENCIL_REF;
+			OtherPortalPlan_ptr = &OrangePortalPlan;
+			OtherPortalWallRanges_ptr = &OrangePortalWallRanges;
+		}
+
+
+		// virtualization matrices
+		const XMMATRIX &OtherVirtualize = Portals.GetVirtualize(*OtherPortal_ptr);
+
+
+		// render portion of player outside of ThisPortal
+
+		Backend.SetClipPlane(ThisPortal_ptr->GetPosition(), ThisPortal_ptr->GetNormal(), -0.01f);
+		DrawMesh(RenderBackend::MESH_PLAYER, RenderBackend::SHADE_PLANE_CLIP, PlayerWorld, ViewProj, Backend);
+
+
+		// render portion of player outside of OtherPortal
+
+		Backend.SetClipPlane(OtherPortal_ptr->GetPosition(), OtherPortal_ptr->GetNormal(), -0.01f);
+		DrawMesh(RenderBackend::MESH_PLAYER, RenderBackend::SHADE_PLANE_CLIP, PlayerWorld * OtherVirtualize, ViewProj, Backend);
+
+		
+		// render portal boxes to stencil, and to cover up the hole
+
+		Backend.SetStencil(RenderBackend::STENCIL_SET, ORANGE_STENCIL_REF);
+		DrawMesh(RenderBackend::MESH_PORTAL_BOX, RenderBackend::SHADE_DEFAULT, OrangePortal.GetBoxWorldMatrix(), ViewProj, Backend);
+
+		Backend.SetStencil(RenderBackend::STENCIL_SET, BLUE_STENCIL_REF);
+		DrawMesh(RenderBackend::MESH_PORTAL_BOX, RenderBackend::SHADE_DEFAULT, BluePortal.GetBoxWorldMatrix(), ViewProj, Backend);
+
+
+		// render portal insides, skipping levels too small to see and walls that can't be seen through the portal
+
+		PortalRecursionPlanner::Plan(Portals, *ThisPortal_ptr, 0, ThisPortalStencilRef, ThisPortalIterations,
+									Cam.GetPosition(), ViewProj, Viewport, *ThisPortalPlan_ptr);
+		PortalRecursionPlanner::Cull(ThisRoom, Player.GetPosition(), Player.GetBoundingSphereRadius(),
+									*ThisPortalPlan_ptr, *ThisPortalWallRanges_ptr);
+		RenderPortalInsidesPlayerClip(Portals, *ThisPortal_ptr, *ThisPortalPlan_ptr, *ThisPortalWallRanges_ptr,
+									PlayerWorld, ViewProj, LightDirections, Backend);
+
+
+		PortalRecursionPlanner::Plan(Portals, *OtherPortal_ptr, 1, OtherPortalStencilRef, OtherPortalIterations,
+									Cam.GetPosition(), ViewProj, Viewport, *OtherPortalPlan_ptr);
+		PortalRecursionPlanner::Cull(ThisRoom, Player.GetPosition(), Player.GetBoundingSphereRadius(),
+									*OtherPortalPlan_ptr, *OtherPortalWallRanges_ptr);
+		RenderPortalInsidesPlayerClip(Portals, *OtherPortal_ptr, *OtherPortalPlan_ptr, *OtherPortalWallRanges_ptr,
+									PlayerWorld, ViewProj, LightDirections, Backend);
+	}
+	else
+	{
+		// render player
+
+		DrawMesh(RenderBackend::MESH_PLAYER, RenderBackend::SHADE_DEFAULT, PlayerWorld, ViewProj, Backend);
+
+		
+		// render portal boxes to stencil, and to cover up the hole
+
+		Backend.SetStencil(RenderBackend::STENCIL_SET, ORANGE_STENCIL_REF);
+		DrawMesh(RenderBackend::MESH_PORTAL_BOX, RenderBackend::SHADE_DEFAULT, OrangePortal.GetBoxWorldMatrix(), ViewProj, Backend);
+
+		Backend.SetStencil(RenderBackend::STENCIL_SET, BLUE_STENCIL_REF);
+		DrawMesh(RenderBackend::MESH_PORTAL_BOX, RenderBackend::SHADE_DEFAULT, BluePortal.GetBoxWorldMatrix(), ViewProj, Backend);
+		
+		
+		// render orange portal insides, skipping levels too small to see and walls that can't be seen through the portal
+
+		PortalRecursionPlanner::Plan(Portals, OrangePortal, 0, ORANGE_STENCIL_REF, OrangePortalIterations,
+									Cam.GetPosition(), ViewProj, Viewport, OrangePortalPlan);
+		PortalRecursionPlanner::Cull(ThisRoom, Player.GetPosition(), Player.GetBoundingSphereRadius(),
+									OrangePortalPlan, OrangePortalWallRanges);
+		LevelRenderer.Render(Portals, OrangePortal, OrangePortalPlan, OrangePortalWallRanges,
+									Cam, LightDirections, PlayerWorld, Backend);
+
+
+		// render blue portal insides, skipping levels too small to see and walls that can't be seen through the portal
+
+		PortalRecursionPlanner::Plan(Portals, BluePortal, 0, BLUE_STENCIL_REF, BluePortalIterations,
+									Cam.GetPosition(), ViewProj, Viewport, BluePortalPlan);
+		PortalRecursionPlanner::Cull(ThisRoom, Player.GetPosition(), Player.GetBoundingSphereRadius(),
+									BluePortalPlan, BluePortalWallRanges);
+		LevelRenderer.Render(Portals, BluePortal, BluePortalPlan, BluePortalWallRanges,
+									Cam, LightDirections, PlayerWorld, Backend);
+	}
+}
+
+void PortalSceneRenderer::RenderOverview(const PortalPair &Portals, const Camera &Cam, const XMFLOAT3 LightDirections[3],
+				RenderBackend &Backend)
+{
+	Backend.SetPortals(Portals.GetFirst(), Portals.GetSecond());
+	Backend.SetEye(Cam.GetPosition(), Cam.GetViewScale());
+	Backend.SetLights(LightDirections);
+
+	Backend.SetStencil(RenderBackend::STENCIL_DEFAULT, 0);
+	Room::IndexRange AllWalls = { 0, Backend.GetIndexCount(RenderBackend::MESH_WALLS) };
+	DrawRoom(RenderBackend::SHADE_NO_PORTAL_HOLES, &AllWalls, 1, XMMatrixIdentity(),
+			Cam.GetViewMatrix() * Cam.GetProjMatrix(), Backend);
+}
+
+
+const std::vector<PortalRecursionPlanner::Level>& PortalSceneRenderer::GetOrangePortalPlan()const
+{
+	return OrangePortalPlan;
+}
+
+const std::vector<PortalRecursionPlanner::Level>& PortalSceneRenderer::GetBluePortalPlan()const
+{
+	return BluePortalPlan;
+}
+
+
+
+void PortalSceneRenderer::DrawRoom(RenderBackend::ShadeMode Mode, const Room::IndexRange *WallRanges, UINT WallRangeCount,
+				const XMMATRIX &World, const XMMATRIX &ViewProj, RenderBackend &Backend)
+{
+	XMFLOAT4X4 WorldF, ViewProjF;
+	XMStoreFloat4x4(&WorldF, World);
+	XMStoreFloat4x4(&ViewProjF, ViewProj);
+	Backend.SetObjectConstants(WorldF, ViewProjF);
+
+	for (UINT r=0; r<WallRangeCount; ++r)
+		Backend.DrawIndexed(RenderBackend::MESH_WALLS, Mode, WallRanges[r].Start, WallRanges[r].Count);
+	Backend.DrawIndexed(RenderBackend::MESH_FLOOR, Mode, 0, Backend.GetIndexCount(RenderBackend::MESH_FLOOR));
+	Backend.DrawIndexed(RenderBackend::MESH_CEILING, Mode, 0, Backend.GetIndexCount(RenderBackend::MESH_CEILING));
+}
+
+void PortalSceneRenderer::DrawMesh(RenderBackend::MeshType Mesh, RenderBackend::ShadeMode Mode,
+				const XMMATRIX &World, const XMMATRIX &ViewProj, RenderBackend &Backend)
+{
+	XMFLOAT4X4 WorldF, ViewProjF;
+	XMStoreFloat4x4(&WorldF, World);
+	XMStoreFloat4x4(&ViewProjF, ViewProj);
+	Backend.SetObjectConstants(WorldF, ViewProjF);
+
+	Backend.DrawIndexed(Mesh, Mode, 0, Backend.GetIndexCount(Mesh));
+}
+
+
+void PortalSceneRenderer::RenderPortalInsidesPlayerClip(const PortalPair &Portals, const Portal &LookThruPortal,
+				const std::vector<PortalRecursionPlanner::Level> &Levels,
+				const std::vector<Room::IndexRange> &WallRanges, const XMMATRIX &PlayerWorld,
+				const XMMATRIX &ViewProj, const XMFLOAT3 LightDirections[3], RenderBackend &Backend)
+{
+	XMFLOAT3 VirtualLightDirections[3] = { LightDirections[0], LightDirections[1], LightDirections[2] };
+	const XMMATRIX &Virtualize = Portals.GetVirtualize(LookThruPortal);
+
+	for (unsigned int l=0; l<Levels.size(); ++l)
+	{
+		const Portal &CurrentPortal = Levels[l].CurrentPortal;
+		const Portal &NextPortal = Levels[l].NextPortal;
+		UINT StencilRef = Levels[l].StencilRef;
+
+		// everything below only passes the stencil test inside this level's scissor rect
+		int Left, Top, Right, Bottom;
+		Levels[l].Scissor.GetPixelBounds(&Left, &Top, &Right, &Bottom);
+		Backend.SetScissor(true, Left, Top, Right, Bottom);
+
+		// worldtovirtual transforms for this realm
+		XMMATRIX WorldToVirtual = XMLoadFloat4x4(&Levels[l].WorldToVirtual);
+		XMMATRIX OldPlayerWorldToVirtual = XMLoadFloat4x4(&Levels[l].OldPlayerWorldToVirtual);
+		XMMATRIX PlayerWorldToVirtual = XMLoadFloat4x4(&Levels[l].PlayerWorldToVirtual);
+
+		// everything in this realm uses the same set of virtual lights
+		for (unsigned int i=0; i<3; ++i)
+		{
+			XMVECTOR D;
+			D = XMLoadFloat3(&VirtualLightDirections[i]);
+			D = XMVector3Normalize(XMVector3TransformNormal(D, Virtualize));
+			XMStoreFloat3(&VirtualLightDirections[i], D);
+		}
+		Backend.SetLights(VirtualLightDirections);
+
+		// everything in this realm must be clipped using the plane of the CurrentPortal
+		Backend.SetClipPlane(CurrentPortal.GetPosition(), -CurrentPortal.GetNormal(), 0.0f);
+
+
+		// render current portal box to clear depth of this portal's insides
+	
+		Backend.SetStencil(RenderBackend::STENCIL_EQUAL_DEPTH_ALWAYS, StencilRef);
+		DrawMesh(RenderBackend::MESH_PORTAL_BOX_CLEAR_DEPTH, RenderBackend::SHADE_DEFAULT,
+				CurrentPortal.GetBoxWorldMatrix(), ViewProj, Backend);
+	
+
+		// render virtual room with both portals, even though we only need CurrentPortal
+
+		Backend.SetStencil(RenderBackend::STENCIL_EQUAL, StencilRef);
+		const Room::IndexRange *LevelWallRanges = Levels[l].WallRangeCount > 0 ? &WallRanges[Levels[l].WallRangeStart] : 0;
+		DrawRoom(RenderBackend::SHADE_PLANE_CLIP, LevelWallRanges, Levels[l].WallRangeCount, WorldToVirtual, ViewProj, Backend);
+
+	
+		// render portion of previous virtual player that's in this realm
+
+		if (Levels[l].OldPlayerVisible)
+		{
+			Backend.SetClipPlane(CurrentPortal.GetPosition(), -CurrentPortal.GetNormal(), -0.01f);
+			DrawMesh(RenderBackend::MESH_PLAYER, RenderBackend::SHADE_PLANE_CLIP,
+					PlayerWorld * OldPlayerWorldToVirtual, ViewProj, Backend);
+		}
+
+
+		// render portion of current virtual player that's in this realm
+
+		if (Levels[l].PlayerVisible)
+		{
+			Backend.SetClipPlane(NextPortal.GetPosition(), NextPortal.GetNormal(), -0.01f);
+			DrawMesh(RenderBackend::MESH_PLAYER, RenderBackend::SHADE_PLANE_CLIP,
+					PlayerWorld * PlayerWorldToVirtual, ViewProj, Backend);
+		}
+
+	
+		// render next portal box to increment stencil, and to cover up hole.  it's clipped like the room
+
+		if (Levels[l].OldPlayerVisible || Levels[l].PlayerVisible)
+			Backend.SetClipPlane(CurrentPortal.GetPosition(), -CurrentPortal.GetNormal(), 0.0f);
+		Backend.SetStencil(RenderBackend::STENCIL_EQUAL_INCREMENT, StencilRef);
+		DrawMesh(RenderBackend::MESH_PORTAL_BOX, RenderBackend::SHADE_PLANE_CLIP,
+				NextPortal.GetBoxWorldMatrix(), ViewProj, Backend);
+	}
+	Backend.SetScissor(false, 0, 0, 0, 0);
+}
@@ -0,0 +1,61 @@
+#ifndef PORTALSCENERENDERER_H
+#define PORTALSCENERENDERER_H
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include <vector>
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "Portal.h"
+#include "PortalPair.h"
+#include "PortalRecursionPlanner.h"
+#include "PortalLevelRenderer.h"
+#include "Room.h"
+#include "RenderBackend.h"
+
+// everything PortalsApp::DrawScene draws, as commands to a RenderBackend.  doesn't touch the GPU itself,
+// so the same frame can be drawn by D3D11RenderBackend or counted by NullRenderBackend
+class PortalSceneRenderer
+{
+public:
+	PortalSceneRenderer();
+	~PortalSceneRenderer();
+
+	// the room, the player and both portals' insides seen from Cam.  Portals' first portal is orange, its
+	// second is blue.  the PlayerIntersect flags say which portal the player is clipping, if any
+	void RenderPortalView(const Room &ThisRoom, const PortalPair &Portals, FirstPersonObject &Player,
+				bool PlayerIntersectOrangePortal, bool PlayerIntersectBluePortal,
+				const Camera &Cam, const PortalRecursionPlanner::ScreenRect &Viewport,
+				const XMFLOAT3 LightDirections[3], RenderBackend &Backend);
+
+	// the room seen from Cam, with both portals drawn on it but without their holes
+	void RenderOverview(const PortalPair &Portals, const Camera &Cam, const XMFLOAT3 LightDirections[3],
+				RenderBackend &Backend);
+
+	// the last RenderPortalView's plans, for stats
+	const std::vector<PortalRecursionPlanner::Level>& GetOrangePortalPlan()const;
+	const std::vector<PortalRecursionPlanner::Level>& GetBluePortalPlan()const;
+
+private:
+	// levels of each portal's insides to render this frame.  kept around so planning doesn't allocate
+	std::vector<PortalRecursionPlanner::Level> OrangePortalPlan;
+	std::vector<PortalRecursionPlanner::Level> BluePortalPlan;
+	std::vector<Room::IndexRange> OrangePortalWallRanges;
+	std::vector<Room::IndexRange> BluePortalWallRanges;
+
+	PortalLevelRenderer LevelRenderer;
+
+	// only the walls in WallRanges are drawn
+	static void DrawRoom(RenderBackend::ShadeMode Mode, const Room::IndexRange *WallRanges, UINT WallRangeCount,
+				const XMMATRIX &World, const XMMATRIX &ViewProj, RenderBackend &Backend);
+	static void DrawMesh(RenderBackend::MeshType Mesh, RenderBackend::ShadeMode Mode,
+				const XMMATRIX &World, const XMMATRIX &ViewProj, RenderBackend &Backend);
+
+	// the player is drawn virtualized through LookThruPortal PlayerInitialLevel more times than the room
+	static void RenderPortalInsidesPlayerClip(const PortalPair &Portals, const Portal &LookThruPortal,
+				const std::vector<PortalRecursionPlanner::Level> &Levels,
+				const std::vector<Room::IndexRange> &WallRanges, const XMMATRIX &PlayerWorld,
+				const XMMATRIX &ViewProj, const XMFLOAT3 LightDirections[3], RenderBackend &Backend);
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "PortalSet.h"
+
+PortalSet::PortalSet()
+	: OriginX(0.0f), OriginZ(0.0f), CellSize(1.0f), CellsX(0), CellsZ(0), CurrentStamp(0)
+{
+}
+
+PortalSet::~PortalSet()
+{
+}
+
+
+void PortalSet::AddPair(const PortalPair &Pair)
+{
+	Pairs.push_back(&Pair);
+}
+
+void PortalSet::Clear()
+{
+	Pairs.clear();
+	GridVersions.clear();
+	CellsX = 0;
+	CellsZ = 0;
+}
+
+
+unsigned int PortalSet::GetPairCount()const
+{
+	return Pairs.size();
+}
+const PortalPair& PortalSet::GetPair(unsigned int PairIndex)const
+{
+	return *Pairs[PairIndex];
+}
+
+unsigned int PortalSet::GetPortalCount()const
+{
+	return 2 * Pairs.size();
+}
+const Portal& PortalSet::GetPortal(unsigned int PortalIndex)const
+{
+	const PortalPair &Pair = *Pairs[PortalIndex/2];
+	return (PortalIndex%2==0) ? Pair.GetFirst() : Pair.GetSecond();
+}
+const PortalPair& PortalSet::GetPairOfPortal(unsigned int PortalIndex)const
+{
+	return *Pairs[PortalIndex/2];
+}
+
+
+
+void PortalSet::Refresh()
+{
+	unsigned int PortalCount = GetPortalCount();
+
+	// see if anything changed since the grid was built
+	bool Changed = (GridVersions.size() != PortalCount);
+	for (unsigned int i=0; i<PortalCount && !Changed; ++i)
+		Changed = (GridVersions[i] != GetPortal(i).GetVersion());
+	if (!Changed)
+		return;
+
+	GridVersions.resize(PortalCount);
+	CellStart.clear();
+	CellPortals.clear();
+	PortalStamps.assign(PortalCount, 0);
+	CurrentStamp = 0;
+	CellsX = 0;
+	CellsZ = 0;
+	if (PortalCount==0)
+		return;
+
+	// XZ bounds of the squares around each portal's disc.  the texture radius is used when it's
+	// bigger, since PortalRelocate keeps other portals away from the texture ring
+	float MinX = std::numeric_limits<float>::infinity();
+	float MaxX = -std::numeric_limits<float>::infinity();
+	float MinZ = MinX;
+	float MaxZ = MaxX;
+	float RadiusSum = 0.0f;
+	for (unsigned int i=0; i<PortalCount; ++i)
+	{
+		const Portal &P = GetPortal(i);
+		GridVersions[i] = P.GetVersion();
+
+		float R = max(P.GetPhysicalRadius(), P.GetTextureRadius());
+		MinX = min(MinX, P.GetPosition().x - R);
+		MaxX = max(MaxX, P.GetPosition().x + R);
+		MinZ = min(MinZ, P.GetPosition().z - R);
+		MaxZ = max(MaxZ, P.GetPosition().z + R);
+		RadiusSum += R;
+	}
+
+	// cells about as wide as the average disc
+	float Width = max(MaxX - MinX, 0.001f);
+	float Height = max(MaxZ - MinZ, 0.001f);
+	CellSize = max(2.0f * RadiusSum / PortalCount, max(Width, Height) / PORTALSET_GRID_MAX_CELLS_PER_AXIS);
+
+	OriginX = MinX;
+	OriginZ = MinZ;
+	CellsX = min((int)(Width / CellSize) + 1, PORTALSET_GRID_MAX_CELLS_PER_AXIS);
+	CellsZ = min((int)(Height / CellSize) + 1, PORTALSET_GRID_MAX_CELLS_PER_AXIS);
+
+	std::vector<std::pair<UINT, UINT>> CellPortalPairs;
+	for (unsigned int i=0; i<PortalCount; ++i)
+	{
+		const Portal &P = GetPortal(i);
+		float R = max(P.GetPhysicalRadius(), P.GetTextureRadius());
+		int x0 = CellX(P.GetPosition().x - R);
+		int x1 = CellX(P.GetPosition().x + R);
+		int z0 = CellZ(P.GetPosition().z - R);
+		int z1 = CellZ(P.GetPosition().z + R);
+		for (int z=z0; z<=z1; ++z)
+			for (int x=x0; x<=x1; ++x)
+				CellPortalPairs.push_back(std::make_pair((UINT)(z*CellsX + x), i));
+	}
+
+	// pack the cell lists into one array; sorting keeps each cell's portals in increasing order
+	std::sort(CellPortalPairs.begin(), CellPortalPairs.end());
+
+	CellStart.assign(CellsX*CellsZ + 1, 0);
+	CellPortals.resize(CellPortalPairs.size());
+	for (unsigned int i=0; i<CellPortalPairs.size(); ++i)
+	{
+		++CellStart[CellPortalPairs[i].first + 1];
+		CellPortals[i] = CellPortalPairs[i].second;
+	}
+	for (int c=0; c<CellsX*CellsZ; ++c)
+		CellStart[c+1] += CellStart[c];
+}
+
+int PortalSet::CellX(float x)const
+{
+	// clamp before converting so far away or infinite coordinates stay in range
+	float c = floorf((x - OriginX) / CellSize);
+	return (int)min(max(c, 0.0f), (float)(CellsX-1));
+}
+
+int PortalSet::CellZ(float z)const
+{
+	// clamp before converting so far away or infinite coordinates stay in range
+	float c = floorf((z - OriginZ) / CellSize);
+	return (int)min(max(c, 0.0f), (float)(CellsZ-1));
+}
+
+
+
+int PortalSet::FindPortalIntersectingSphere(XMFLOAT3 Center, float Radius)const
+{
+	FindPortalsNear(Center, Radius, Candidates);
+	for (unsigned int k=0; k<Candidates.size(); ++k)
+	{
+		if (GetPortal(Candidates[k]).DiscIntersectSphere(Center, Radius))
+			return Candidates[k];
+	}
+	return -1;
+}
+
+int PortalSet::FindPortalContainingTangentPoint(XMFLOAT3 T)const
+{
+	FindPortalsNear(T, PORTALS_SAME_PLANE_THRESHOLD, Candidates);
+	for (unsigned int k=0; k<Candidates.size(); ++k)
+	{
+		const Portal &P = GetPortal(Candidates[k]);
+		XMFLOAT3 TtoPortalCenter = P.GetPosition() - T;
+		if ( abs(XMFloat3Dot(TtoPortalCenter, P.GetNormal())) < PORTALS_SAME_PLANE_THRESHOLD &&
+				XMFloat3Length(TtoPortalCenter) < P.GetPhysicalRadius() )
+			return Candidates[k];
+	}
+	return -1;
+}
+
+void PortalSet::FindPortalsNear(XMFLOAT3 Center, float Radius, std::vector<UINT> &PortalIndices)const
+{
+	PortalIndices.clear();
+	if (CellsX==0 || CellsZ==0)
+		return;
+
+	// reset stamps when the counter wraps around
+	if (++CurrentStamp == 0)
+	{
+		std::fill(PortalStamps.begin(), PortalStamps.end(), 0);
+		CurrentStamp = 1;
+	}
+
+	// the query square is clamped to the grid, which covers every disc
+	if (Center.x + Radius < OriginX || Center.x - Radius > OriginX + CellsX*CellSize ||
+		Center.z + Radius < OriginZ || Center.z - Radius > OriginZ + CellsZ*CellSize)
+		return;
+
+	int x0 = CellX(Center.x - Radius);
+	int x1 = CellX(Center.x + Radius);
+	int z0 = CellZ(Center.z - Radius);
+	int z1 = CellZ(Center.z + Radius);
+	for (int z=z0; z<=z1; ++z)
+	{
+		for (int x=x0; x<=x1; ++x)
+		{
+			int c = z*CellsX + x;
+			for (UINT k=CellStart[c]; k<CellStart[c+1]; ++k)
+			{
+				UINT PortalIndex = CellPortals[k];
+				if (PortalStamps[PortalIndex] != CurrentStamp)
+				{
+					PortalStamps[PortalIndex] = CurrentStamp;
+					PortalIndices.push_back(PortalIndex);
+				}
+			}
+		}
+	}
+
+	// callers take the first portal that passes their test, so keep the set's order
+	std::sort(PortalIndices.begin(), PortalIndices.end());
+}
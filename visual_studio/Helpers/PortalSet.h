@@ -0,0 +1,70 @@
+#ifndef PORTALSET_H
+#define PORTALSET_H
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include <vector>
+#include "MathFunctions.h"
+#include "Portal.h"
+#include "PortalPair.h"
+
+// all the linked portal pairs of a level.  portal i is portal i%2 of pair i/2.
+// a uniform grid over the XZ bounds of the portals' discs lets queries only test nearby portals
+class PortalSet
+{
+public:
+	PortalSet();
+	~PortalSet();
+
+	void AddPair(const PortalPair &Pair);
+	void Clear();
+
+	unsigned int GetPairCount()const;
+	const PortalPair& GetPair(unsigned int PairIndex)const;
+
+	unsigned int GetPortalCount()const;
+	const Portal& GetPortal(unsigned int PortalIndex)const;
+	const PortalPair& GetPairOfPortal(unsigned int PortalIndex)const;
+
+	// rebuilds the lookup grid if any portal has changed since the last call.
+	// must be called after moving, resizing or adding portals, before querying the set again
+	void Refresh();
+
+	// index of the first portal whose disc intersects the sphere, or -1
+	int FindPortalIntersectingSphere(XMFLOAT3 Center, float Radius)const;
+
+	// index of the first portal whose disc contains the tangent point T of a room collision, or -1
+	int FindPortalContainingTangentPoint(XMFLOAT3 T)const;
+
+	// indices of the portals whose discs may be within Radius of Center, in increasing order
+	void FindPortalsNear(XMFLOAT3 Center, float Radius, std::vector<UINT> &PortalIndices)const;
+
+private:
+	int CellX(float x)const;
+	int CellZ(float z)const;
+
+private:
+	std::vector<const PortalPair*> Pairs;
+
+	// portal versions the grid was built from
+	std::vector<unsigned int> GridVersions;
+
+	float OriginX;
+	float OriginZ;
+	float CellSize;
+	int CellsX;
+	int CellsZ;
+
+	// portals of cell c are CellPortals[CellStart[c]] to CellPortals[CellStart[c+1]-1]
+	std::vector<UINT> CellStart;
+	std::vector<UINT> CellPortals;
+
+	// used to avoid returning a portal twice when its disc spans several cells
+	mutable std::vector<UINT> PortalStamps;
+	mutable UINT CurrentStamp;
+
+	// scratch list for the Find functions
+	mutable std::vector<UINT> Candidates;
+};
+
+#endif
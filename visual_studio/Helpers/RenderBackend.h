@@ -0,0 +1,71 @@
+#ifndef RENDERBACKEND_H
+#define RENDERBACKEND_H
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Portal.h"
+
+// everything PortalSceneRenderer draws a frame with.  D3D11RenderBackend is the real one; NullRenderBackend
+// records, validates and counts the commands, so the rendering work of a frame can be measured without a GPU.
+// the backend owns the meshes and their materials, so a draw only names a mesh and a range of its indices
+class RenderBackend
+{
+public:
+	enum StencilMode { STENCIL_DEFAULT = 0, STENCIL_SET, STENCIL_EQUAL, STENCIL_EQUAL_DEPTH_ALWAYS,
+						STENCIL_EQUAL_INCREMENT };
+
+	enum MeshType { MESH_WALLS = 0, MESH_FLOOR, MESH_CEILING, MESH_PLAYER,
+						MESH_PORTAL_BOX, MESH_PORTAL_BOX_CLEAR_DEPTH, MESH_COUNT };
+
+	// SHADE_NO_PORTAL_HOLES is only for the room meshes
+	enum ShadeMode { SHADE_DEFAULT = 0, SHADE_PLANE_CLIP, SHADE_NO_PORTAL_HOLES };
+
+	// one realm of a portal's insides, for DrawLevel.  laid out like LevelSlot in FX/PortalLevels.fx
+	struct LevelSlot
+	{
+		XMFLOAT4X4 WorldToVirtual;
+		XMFLOAT4X4 ViewProj;			// may have an oblique near plane, except in slot 0
+		XMFLOAT4X4 PortalBoxWorld;		// box of the portal leading out of this realm
+		XMFLOAT3 LightDirections[3];
+		XMFLOAT3 ClipPlanePosition;
+		float ClipPlaneOffset;
+		XMFLOAT3 ClipPlaneNormal;
+		float Pad;
+	};
+
+	virtual ~RenderBackend() {}
+
+	virtual UINT GetIndexCount(MeshType Mesh)const = 0;
+
+	// forgets any state cached from the last frame
+	virtual void BeginFrame() = 0;
+
+	virtual void SetStencil(StencilMode Mode, UINT StencilRef) = 0;
+
+	// limits the draws after it to the render target pixels in [Left, Right) x [Top, Bottom), like RSSetScissorRects
+	// with a scissor-enabled rasterizer state.  Enable false lets them cover the whole viewport again
+	virtual void SetScissor(bool Enable, int Left, int Top, int Right, int Bottom) = 0;
+
+	// per-view constants.  the portals are the ones drawn on the room's walls
+	virtual void SetPortals(const Portal &PortalA, const Portal &PortalB) = 0;
+	virtual void SetEye(XMFLOAT3 EyePosition, float ViewScale) = 0;
+	virtual void SetLights(const XMFLOAT3 LightDirections[3]) = 0;
+	virtual void SetClipPlane(XMFLOAT3 Position, XMFLOAT3 Normal, float Offset) = 0;
+
+	// per-object constants, used by DrawIndexed until they're set again
+	virtual void SetObjectConstants(const XMFLOAT4X4 &World, const XMFLOAT4X4 &ViewProj) = 0;
+
+	// draws indices [Start, Start+Count) of Mesh.  SHADE_PLANE_CLIP clips against the plane from SetClipPlane
+	virtual void DrawIndexed(MeshType Mesh, ShadeMode Mode, UINT Start, UINT Count) = 0;
+
+	// replaces the slots of the previous portal.  PlayerWorld is the player's real world matrix; each slot's
+	// WorldToVirtual is applied after it
+	virtual void SetLevelSlots(const LevelSlot *Slots, UINT SlotCount, const XMFLOAT4X4 &PlayerWorld) = 0;
+
+	// draws indices [Start, Start+Count) of Mesh in realm Slot, with the slot's matrices, lights and clip plane
+	// instead of the per-view and per-object constants.  PlaneClip clips against the slot's clip plane per pixel,
+	// for when its ViewProj couldn't be made oblique
+	virtual void DrawLevel(MeshType Mesh, UINT Slot, bool PlaneClip, UINT Start, UINT Count) = 0;
+};
+
+#endif
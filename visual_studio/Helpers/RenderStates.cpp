@@ -8,6 +8,9 @@ ID3D11DepthStencilState* RenderStates::StencilEqualDecrementDSS = 0;
 ID3D11DepthStencilState* RenderStates::StencilEqualDepthAlwaysDSS = 0;
 ID3D11DepthStencilState* RenderStates::StencilLessEqualSetToDSS = 0;
 
+ID3D11RasterizerState* RenderStates::ScissorRS = 0;
+ID3D11RasterizerState* RenderStates::ScissorDepthBiasRS = 0;
+
 
 void RenderStates::InitAll(ID3D11Device* device)
 {
@@ -175,6 +178,33 @@ void RenderStates::InitAll(ID3D11Device* device)
 
 	HR(device->CreateDepthStencilState(&StencilLessEqualSetToDesc, &StencilLessEqualSetToDSS));
 
+
+
+	// the effects' passes set their own rasterizer state, so these are set after a pass is applied
+	D3D11_RASTERIZER_DESC ScissorDesc;
+
+	ScissorDesc.FillMode = D3D11_FILL_SOLID;
+	ScissorDesc.CullMode = D3D11_CULL_BACK;
+	ScissorDesc.FrontCounterClockwise = false;
+	ScissorDesc.DepthBias = 0;
+	ScissorDesc.DepthBiasClamp = 0.0f;
+	ScissorDesc.SlopeScaledDepthBias = 0.0f;
+	ScissorDesc.DepthClipEnable = true;
+	ScissorDesc.ScissorEnable = true;
+	ScissorDesc.MultisampleEnable = false;
+	ScissorDesc.AntialiasedLineEnable = false;
+
+	HR(device->CreateRasterizerState(&ScissorDesc, &ScissorRS));
+
+
+	D3D11_RASTERIZER_DESC ScissorDepthBiasDesc = ScissorDesc;
+
+	ScissorDepthBiasDesc.DepthBias = 10;
+	ScissorDepthBiasDesc.DepthBiasClamp = 0.0f;
+	ScissorDepthBiasDesc.SlopeScaledDepthBias = 0.01f;
+
+	HR(device->CreateRasterizerState(&ScissorDepthBiasDesc, &ScissorDepthBiasRS));
+
 }
 
 void RenderStates::DestroyAll()
@@ -186,4 +216,6 @@ void RenderStates::DestroyAll()
 	ReleaseCOM(StencilEqualDecrementDSS);
 	ReleaseCOM(StencilEqualDepthAlwaysDSS);
 	ReleaseCOM(StencilLessEqualSetToDSS);
+	ReleaseCOM(ScissorRS);
+	ReleaseCOM(ScissorDepthBiasRS);
 }
\ No newline at end of file
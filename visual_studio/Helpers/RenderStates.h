@@ -17,6 +17,10 @@ public:
 	static ID3D11DepthStencilState* StencilEqualDecrementDSS;
 	static ID3D11DepthStencilState* StencilEqualDepthAlwaysDSS;
 	static ID3D11DepthStencilState* StencilLessEqualSetToDSS;	// used for rendering player after next portal disc has been rendered
+
+	// Rasterizer states
+	static ID3D11RasterizerState* ScissorRS;				// the default rasterizer state with the scissor test on
+	static ID3D11RasterizerState* ScissorDepthBiasRS;		// DepthBiasRS from LightHelper.fx with the scissor test on
 };
 
 #endif
\ No newline at end of file
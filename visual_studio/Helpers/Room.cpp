@@ -1,4 +1,5 @@
 #include "Room.h"
+#include <xmmintrin.h>
 
 
 
@@ -8,64 +9,143 @@ Room::BoundaryElementsList::BoundaryElementsList()
 }
 Room::BoundaryElementsList::~BoundaryElementsList()
 {
-	for (unsigned int i=0; i<ElementPointers.size(); ++i)
-		delete ElementPointers[i];
 }
-void Room::BoundaryElementsList::AddEdge(const XMFLOAT2 &U, const XMFLOAT2 &V)
+void Room::BoundaryElementsList::Clear()
 {
-	ElementPointers.push_back(new BoundaryEdge(U, V));
+	Elements.clear();
 }
-void Room::BoundaryElementsList::AddVertex(const XMFLOAT2 &V)
+void Room::BoundaryElementsList::AddEdge(const XMFLOAT2 &U, const XMFLOAT2 &V, const XMFLOAT2 &Normal)
 {
-	ElementPointers.push_back(new BoundaryVertex(V));
+	Elements.push_back(BoundaryElement::Edge(U, V, Normal));
 }
-void Room::BoundaryElementsList::Delete(int Index)
+void Room::BoundaryElementsList::AddVertex(const XMFLOAT2 &V)
 {
-	delete ElementPointers[Index];
-	ElementPointers.erase(ElementPointers.begin() + Index);
+	Elements.push_back(BoundaryElement::Vertex(V));
 }
-Room::BoundaryElement* Room::BoundaryElementsList::operator[](const int Index)const
+const Room::BoundaryElement& Room::BoundaryElementsList::operator[](const int Index)const
 {
-	return ElementPointers[Index];
+	return Elements[Index];
 }
 unsigned int Room::BoundaryElementsList::size()const
 {
-	return ElementPointers.size();
+	return Elements.size();
 }
 
 
-// BOUNDARY EDGE stuff *************************************************************************
+// BOUNDARY ELEMENTS SOA
+Room::BoundaryElementsSoA::BoundaryElementsSoA()
+	: EdgeCount(0), VertexCount(0)
+{
+}
+void Room::BoundaryElementsSoA::Clear()
+{
+	EdgeCount = 0;
+	VertexCount = 0;
+}
+void Room::BoundaryElementsSoA::AddEdge(const XMFLOAT2 &U, const XMFLOAT2 &V, const XMFLOAT2 &Normal)
+{
+	// storage is grown geometrically, and always to a multiple of 4 elements so the kernel can
+	// always load whole registers
+	if (EdgeCount == EdgeUx.size())
+	{
+		unsigned int Size = max(2*EdgeCount, 4u);
+		EdgeUx.resize(Size);
+		EdgeUz.resize(Size);
+		EdgeVx.resize(Size);
+		EdgeVz.resize(Size);
+		EdgeNx.resize(Size);
+		EdgeNz.resize(Size);
+		EdgeOrder.resize(Size);
+	}
+	EdgeUx[EdgeCount] = U.x;
+	EdgeUz[EdgeCount] = U.y;
+	EdgeVx[EdgeCount] = V.x;
+	EdgeVz[EdgeCount] = V.y;
+	EdgeNx[EdgeCount] = Normal.x;
+	EdgeNz[EdgeCount] = Normal.y;
+	EdgeOrder[EdgeCount] = (float)(EdgeCount + VertexCount);
+	++EdgeCount;
+}
+void Room::BoundaryElementsSoA::AddVertex(const XMFLOAT2 &V)
+{
+	if (VertexCount == VertexX.size())
+	{
+		unsigned int Size = max(2*VertexCount, 4u);
+		VertexX.resize(Size);
+		VertexZ.resize(Size);
+		VertexOrder.resize(Size);
+	}
+	VertexX[VertexCount] = V.x;
+	VertexZ[VertexCount] = V.y;
+	VertexOrder[VertexCount] = (float)(EdgeCount + VertexCount);
+	++VertexCount;
+}
+
+
+// BOUNDARY ELEMENT stuff *************************************************************************
 
-Room::BoundaryEdge::BoundaryEdge(XMFLOAT2 U, XMFLOAT2 V) :
-U(U), V(V)
+Room::BoundaryElement Room::BoundaryElement::Edge(const XMFLOAT2 &U, const XMFLOAT2 &V, const XMFLOAT2 &Normal)
 {
+	BoundaryElement E;
+	E.IsEdge = true;
+	E.U = U;
+	E.V = V;
+	E.Normal = Normal;
+	return E;
 }
 
-Room::BoundaryEdge::~BoundaryEdge()
+Room::BoundaryElement Room::BoundaryElement::Vertex(const XMFLOAT2 &V)
 {
+	BoundaryElement E;
+	E.IsEdge = false;
+	E.U = V;
+	E.V = V;
+	E.Normal = XMFLOAT2(0.0f, 0.0f);
+	return E;
 }
 
+bool Room::BoundaryElement::RayPathExit(float DiscRadius, const Vec2 &S, const Vec2 &Dir, Vec2 *X_ptr, float *XDist_ptr,
+											float *LeftRedCos_ptr, Vec2 *LeftRedDir_ptr,
+											Vec2 *T_ptr, Vec2 *TNormal_ptr)const
+{
+	if (IsEdge)
+		return EdgeRayPathExit(DiscRadius, S, Dir, X_ptr, XDist_ptr, LeftRedCos_ptr, LeftRedDir_ptr, T_ptr, TNormal_ptr);
+	return VertexRayPathExit(DiscRadius, S, Dir, X_ptr, XDist_ptr, LeftRedCos_ptr, LeftRedDir_ptr, T_ptr, TNormal_ptr);
+}
+
+void Room::BoundaryElement::PrintInfo()const
+{
+	if (IsEdge)
+		dprintf("Edge: (%f, %f)--(%f, %f)\n", U.x, U.y, V.x, V.y);
+	else
+		dprintf("Vertex: (%f, %f)\n", V.x, V.y);
+}
+
+
+// BOUNDARY EDGE stuff *************************************************************************
 
 // given a ray path for the disc, see if it will exit the polygon through this edge
-bool Room::BoundaryEdge::RayPathExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Dir, XMFLOAT2 *X_ptr, float *XDist_ptr,
-											float *LeftRedCos_ptr, XMFLOAT2 *LeftRedDir_ptr,
-											XMFLOAT2 *T_ptr, XMFLOAT2 *TNormal_ptr)const
+bool Room::BoundaryElement::EdgeRayPathExit(float DiscRadius, const Vec2 &S, const Vec2 &Dir, Vec2 *X_ptr, float *XDist_ptr,
+											float *LeftRedCos_ptr, Vec2 *LeftRedDir_ptr,
+											Vec2 *T_ptr, Vec2 *TNormal_ptr)const
 {
 	// calculate shifted segment AB which is the DiscCenter boundary
-	XMFLOAT2 UV = V-U;
-	XMFLOAT2 UVNormal = XMFloat2Normalize(XMFloat2Left90(UV));
-	XMFLOAT2 A = U + DiscRadius * UVNormal;
-	XMFLOAT2 B = V + DiscRadius * UVNormal;
-
-	float DirCrossSA = XMFloat2Cross(Dir, A-S);
-	float DirCrossSB = XMFloat2Cross(Dir, B-S);
+	Vec2 EdgeU = Vec2Load(U);
+	Vec2 EdgeV = Vec2Load(V);
+	Vec2 UV = EdgeV-EdgeU;
+	Vec2 UVNormal = Vec2Load(Normal);
+	Vec2 A = EdgeU + DiscRadius * UVNormal;
+	Vec2 B = EdgeV + DiscRadius * UVNormal;
+
+	float DirCrossSA = Vec2Cross(Dir, A-S);
+	float DirCrossSB = Vec2Cross(Dir, B-S);
 	if ( (DirCrossSA>0.0f || DirCrossSB<0.0f) || (DirCrossSA==0.0f && DirCrossSB==0.0f) )
 		return false;
 
-	XMFLOAT2 AB = B-A;
+	Vec2 AB = B-A;
 
 	// X = S+t*Dir = A+u*AB.
-	float t = XMFloat2Cross(A-S, AB) / XMFloat2Cross(Dir, AB);
+	float t = Vec2Cross(A-S, AB) / Vec2Cross(Dir, AB);
 	if (t < -T_THRESHOLD)
 		return false;
 
@@ -73,14 +153,14 @@ bool Room::BoundaryEdge::RayPathExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Dir,
 
 	// calculate T info
 	// X = A+u*AB, T = U+u*UV
-	float u = XMFloat2Cross(A-S, Dir) / XMFloat2Cross(Dir, AB);
-	*T_ptr = U + u*UV;
+	float u = Vec2Cross(A-S, Dir) / Vec2Cross(Dir, AB);
+	*T_ptr = EdgeU + u*UV;
 	*TNormal_ptr = UVNormal;
 
 	// calculate X info
 	*XDist_ptr = t;
-	*LeftRedDir_ptr = XMFloat2Right90(UVNormal);
-	*LeftRedCos_ptr = XMFloat2Dot(Dir, *LeftRedDir_ptr);
+	*LeftRedDir_ptr = Vec2Right90(UVNormal);
+	*LeftRedCos_ptr = Vec2Dot(Dir, *LeftRedDir_ptr);
 
 	// bump t, calculate X
 	t -= T_BUMP;
@@ -90,30 +170,16 @@ bool Room::BoundaryEdge::RayPathExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Dir,
 }
 
 
-void Room::BoundaryEdge::PrintInfo()const
-{
-	dprintf("Edge: (%f, %f)--(%f, %f)\n", U.x, U.y, V.x, V.y);
-}
-
-
 
 
 // BOUNDARY VERTEX STUFF *********************************************************************
 
-Room::BoundaryVertex::BoundaryVertex(XMFLOAT2 V) :
-V(V)
+bool Room::BoundaryElement::VertexRayPathExit(float DiscRadius, const Vec2 &S, const Vec2 &Dir, Vec2 *X_ptr, float *XDist_ptr,
+									float *LeftRedCos_ptr, Vec2 *LeftRedDir_ptr,
+									Vec2 *T_ptr, Vec2 *TNormal_ptr)const
 {
-}
-
-Room::BoundaryVertex::~BoundaryVertex()
-{
-}
-
-bool Room::BoundaryVertex::RayPathExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Dir, XMFLOAT2 *X_ptr, float *XDist_ptr,
-									float *LeftRedCos_ptr, XMFLOAT2 *LeftRedDir_ptr,
-									XMFLOAT2 *T_ptr, XMFLOAT2 *TNormal_ptr)const
-{
-	XMFLOAT2 VS = S-V;
+	Vec2 VertexV = Vec2Load(V);
+	Vec2 VS = S-VertexV;
 	/*
 	// check if the circle around V is intersected by the ray line
 	if (abs(XMFloat2Cross(VS, Dir)) >= DiscRadius)
@@ -123,8 +189,8 @@ bool Room::BoundaryVertex::RayPathExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Di
 	// X = S + t*Dir
 	// (X-V)dot(X-V)=rad^2
 	// a = XMFloat2LengthSq(Dir) = 1
-	float b_half = XMFloat2Dot(VS, Dir);
-	float c = XMFloat2LengthSq(VS) - DiscRadius*DiscRadius;
+	float b_half = Vec2Dot(VS, Dir);
+	float c = Vec2LengthSq(VS) - DiscRadius*DiscRadius;
 
 	// check discriminant
 	float discr_over_4 = b_half*b_half - c;
@@ -136,16 +202,16 @@ bool Room::BoundaryVertex::RayPathExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Di
 	if (t < -T_THRESHOLD)
 		return false;
 
-	XMFLOAT2 XUnbumped = S + t*Dir;
+	Vec2 XUnbumped = S + t*Dir;
 
 	// calculate T info
-	*T_ptr = V;
-	*TNormal_ptr = XMFloat2Normalize(XUnbumped - V);
+	*T_ptr = VertexV;
+	*TNormal_ptr = Vec2Normalize(XUnbumped - VertexV);
 
 	// calculate X info
 	*XDist_ptr = t;
-	*LeftRedDir_ptr = XMFloat2Right90(*TNormal_ptr);
-	*LeftRedCos_ptr = XMFloat2Dot(Dir, *LeftRedDir_ptr);
+	*LeftRedDir_ptr = Vec2Right90(*TNormal_ptr);
+	*LeftRedCos_ptr = Vec2Dot(Dir, *LeftRedDir_ptr);
 
 	// bump t, calculate x
 	t -= T_BUMP;
@@ -154,19 +220,322 @@ bool Room::BoundaryVertex::RayPathExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Di
 	return true;
 }
 
-void Room::BoundaryVertex::PrintInfo()const
+
+// EDGE GRID STUFF *************************************************************************************
+
+Room::EdgeGrid::EdgeGrid()
+	: OriginX(0.0f), OriginZ(0.0f), CellSize(1.0f), CellsX(0), CellsZ(0), CurrentStamp(0)
 {
-	dprintf("Vertex: (%f, %f)\n", V.x, V.y);
 }
 
+void Room::EdgeGrid::Build(const std::vector<WallEdge> &Edges, float MinX, float MaxX, float MinZ, float MaxZ)
+{
+	CellStart.clear();
+	CellEdges.clear();
+	CellNearestEdge.clear();
+	EdgeStamps.assign(Edges.size(), 0);
+	CurrentStamp = 0;
+
+	CellsX = 0;
+	CellsZ = 0;
+	if (Edges.empty())
+		return;
+
+	// pick a cell size so that each cell holds about ROOM_GRID_EDGES_PER_CELL edges on average
+	float Width = max(MaxX - MinX, 0.001f);
+	float Height = max(MaxZ - MinZ, 0.001f);
+	CellSize = sqrtf(Width * Height * ROOM_GRID_EDGES_PER_CELL / (float)Edges.size());
+	CellSize = max(CellSize, max(Width, Height) / ROOM_GRID_MAX_CELLS_PER_AXIS);
+	
+	OriginX = MinX;
+	OriginZ = MinZ;
+	CellsX = min((int)(Width / CellSize) + 1, ROOM_GRID_MAX_CELLS_PER_AXIS);
+	CellsZ = min((int)(Height / CellSize) + 1, ROOM_GRID_MAX_CELLS_PER_AXIS);
+
+	// find which cells each edge passes through.  the cells in the bounding box of the edge are
+	// candidates; the ones whose corners all lie strictly on one side of the edge line are skipped
+	std::vector<std::pair<UINT, UINT>> CellEdgePairs;
+	for (unsigned int i=0; i<Edges.size(); ++i)
+	{
+		XMFLOAT2 U = Edges[i].U;
+		XMFLOAT2 V = Edges[i].V;
+		XMFLOAT2 UV = V-U;
+
+		int x0 = CellX(min(U.x, V.x));
+		int x1 = CellX(max(U.x, V.x));
+		int z0 = CellZ(min(U.y, V.y));
+		int z1 = CellZ(max(U.y, V.y));
+		for (int z=z0; z<=z1; ++z)
+		{
+			for (int x=x0; x<=x1; ++x)
+			{
+				// cell corners, slightly enlarged so edges lying along a cell border are kept
+				float Lo_x = OriginX + x*CellSize - 0.001f;
+				float Lo_z = OriginZ + z*CellSize - 0.001f;
+				float Hi_x = Lo_x + CellSize + 0.002f;
+				float Hi_z = Lo_z + CellSize + 0.002f;
+
+				float c0 = XMFloat2Cross(UV, XMFLOAT2(Lo_x, Lo_z)-U);
+				float c1 = XMFloat2Cross(UV, XMFLOAT2(Hi_x, Lo_z)-U);
+				float c2 = XMFloat2Cross(UV, XMFLOAT2(Hi_x, Hi_z)-U);
+				float c3 = XMFloat2Cross(UV, XMFLOAT2(Lo_x, Hi_z)-U);
+				if ( (c0>0.0f && c1>0.0f && c2>0.0f && c3>0.0f) || (c0<0.0f && c1<0.0f && c2<0.0f && c3<0.0f) )
+					continue;
+
+				CellEdgePairs.push_back(std::make_pair((UINT)(z*CellsX + x), i));
+			}
+		}
+	}
+
+	// pack the cell lists into one array; sorting keeps each cell's edges in increasing order
+	std::sort(CellEdgePairs.begin(), CellEdgePairs.end());
+
+	CellStart.assign(CellsX*CellsZ + 1, 0);
+	CellEdges.resize(CellEdgePairs.size());
+	for (unsigned int i=0; i<CellEdgePairs.size(); ++i)
+	{
+		++CellStart[CellEdgePairs[i].first + 1];
+		CellEdges[i] = CellEdgePairs[i].second;
+	}
+	for (int c=0; c<CellsX*CellsZ; ++c)
+		CellStart[c+1] += CellStart[c];
+
+	// seed the cells that have edges with the one nearest their center
+	const UINT NoEdge = (UINT)-1;
+	CellNearestEdge.assign(CellsX*CellsZ, NoEdge);
+	std::vector<float> CellDist(CellsX*CellsZ, std::numeric_limits<float>::infinity());
+	for (int z=0; z<CellsZ; ++z)
+	{
+		for (int x=0; x<CellsX; ++x)
+		{
+			int c = z*CellsX + x;
+			XMFLOAT2 Center(OriginX + (x+0.5f)*CellSize, OriginZ + (z+0.5f)*CellSize);
+			for (UINT k=CellStart[c]; k<CellStart[c+1]; ++k)
+			{
+				float d = DistanceToEdge(Edges[CellEdges[k]], Center);
+				if (d < CellDist[c])
+				{
+					CellDist[c] = d;
+					CellNearestEdge[c] = CellEdges[k];
+				}
+			}
+		}
+	}
+
+	// spread them: forward over the neighbors already visited, then back over the others
+	static const int Forward[4][2] = { {-1, 0}, {-1, -1}, {0, -1}, {1, -1} };
+	for (int Pass=0; Pass<2; ++Pass)
+	{
+		int Step = (Pass==0 ? 1 : -1);
+		for (int i=0; i<CellsX*CellsZ; ++i)
+		{
+			int c = (Pass==0 ? i : CellsX*CellsZ-1 - i);
+			int x = c % CellsX;
+			int z = c / CellsX;
+			XMFLOAT2 Center(OriginX + (x+0.5f)*CellSize, OriginZ + (z+0.5f)*CellSize);
+			for (int n=0; n<4; ++n)
+			{
+				int nx = x + Step*Forward[n][0];
+				int nz = z + Step*Forward[n][1];
+				if (nx<0 || nx>=CellsX || nz<0 || nz>=CellsZ)
+					continue;
+
+				UINT Edge = CellNearestEdge[nz*CellsX + nx];
+				if (Edge == NoEdge || Edge == CellNearestEdge[c])
+					continue;
+
+				float d = DistanceToEdge(Edges[Edge], Center);
+				if (d < CellDist[c])
+				{
+					CellDist[c] = d;
+					CellNearestEdge[c] = Edge;
+				}
+			}
+		}
+	}
+}
+
+int Room::EdgeGrid::CellX(float x)const
+{
+	int c = (int)floorf((x - OriginX) / CellSize);
+	return min(max(c, 0), CellsX-1);
+}
+
+int Room::EdgeGrid::CellZ(float z)const
+{
+	int c = (int)floorf((z - OriginZ) / CellSize);
+	return min(max(c, 0), CellsZ-1);
+}
+
+UINT Room::EdgeGrid::CellIndex(XMFLOAT2 P)const
+{
+	if (CellsX==0 || CellsZ==0)
+		return 0;
+	return CellZ(P.y)*CellsX + CellX(P.x);
+}
+
+UINT Room::EdgeGrid::NearbyEdge(XMFLOAT2 P)const
+{
+	return CellNearestEdge[CellIndex(P)];
+}
+
+void Room::EdgeGrid::GatherEdges(XMFLOAT2 Center, float HalfWidth, std::vector<UINT> &EdgeIndices)const
+{
+	EdgeIndices.clear();
+	if (CellsX==0 || CellsZ==0)
+		return;
+
+	// reset stamps when the counter wraps around
+	if (++CurrentStamp == 0)
+	{
+		std::fill(EdgeStamps.begin(), EdgeStamps.end(), 0);
+		CurrentStamp = 1;
+	}
+
+	int x0 = CellX(Center.x - HalfWidth);
+	int x1 = CellX(Center.x + HalfWidth);
+	int z0 = CellZ(Center.y - HalfWidth);
+	int z1 = CellZ(Center.y + HalfWidth);
+	for (int z=z0; z<=z1; ++z)
+	{
+		for (int x=x0; x<=x1; ++x)
+		{
+			int c = z*CellsX + x;
+			for (UINT k=CellStart[c]; k<CellStart[c+1]; ++k)
+			{
+				UINT Edge = CellEdges[k];
+				if (EdgeStamps[Edge] != CurrentStamp)
+				{
+					EdgeStamps[Edge] = CurrentStamp;
+					EdgeIndices.push_back(Edge);
+				}
+			}
+		}
+	}
+
+	// callers rely on the edges being visited in the same order as the polygons list them
+	std::sort(EdgeIndices.begin(), EdgeIndices.end());
+}
+
+Room::EdgeGrid::RayWalk::RayWalk(const EdgeGrid &Grid, XMFLOAT2 S, XMFLOAT2 Dir)
+	: Grid(Grid), S(S), Dir(Dir), X(0), Z(0), StepX(0), StepZ(0), EnterT(0.0f), ExitT(0.0f), Done(true)
+{
+	if (Grid.CellsX==0 || Grid.CellsZ==0)
+		return;
+
+	// clip the ray to the grid's bounds, one slab per axis
+	float Lo[2] = { Grid.OriginX, Grid.OriginZ };
+	float Hi[2] = { Grid.OriginX + Grid.CellsX*Grid.CellSize, Grid.OriginZ + Grid.CellsZ*Grid.CellSize };
+	float Start[2] = { S.x, S.y };
+	float Step[2] = { Dir.x, Dir.y };
+	ExitT = std::numeric_limits<float>::infinity();
+	for (int a=0; a<2; ++a)
+	{
+		if (Step[a] == 0.0f)
+		{
+			if (Start[a] < Lo[a] || Start[a] > Hi[a])
+				return;
+			continue;
+		}
+		float t0 = (Lo[a] - Start[a]) / Step[a];
+		float t1 = (Hi[a] - Start[a]) / Step[a];
+		EnterT = max(EnterT, min(t0, t1));
+		ExitT = min(ExitT, max(t0, t1));
+	}
+	if (EnterT > ExitT)
+		return;
+
+	X = Grid.CellX(S.x + EnterT*Dir.x);
+	Z = Grid.CellZ(S.y + EnterT*Dir.y);
+	StepX = (Dir.x > 0.0f) ? 1 : ((Dir.x < 0.0f) ? -1 : 0);
+	StepZ = (Dir.y > 0.0f) ? 1 : ((Dir.y < 0.0f) ? -1 : 0);
+	Done = (StepX == 0 && StepZ == 0);
+}
+
+bool Room::EdgeGrid::RayWalk::Next(float *EnterT_ptr, const UINT **Edges_ptr, UINT *EdgeCount_ptr)
+{
+	if (Done)
+		return false;
+
+	int c = Z*Grid.CellsX + X;
+	*EnterT_ptr = EnterT;
+	*Edges_ptr = Grid.CellEdges.empty() ? NULL : &Grid.CellEdges[Grid.CellStart[c]];
+	*EdgeCount_ptr = Grid.CellStart[c+1] - Grid.CellStart[c];
+
+	// the t where the ray crosses the far side of this cell in x and in z, worked out from S every time so
+	// the steps don't add up rounding errors
+	float XCrossT = std::numeric_limits<float>::infinity();
+	float ZCrossT = std::numeric_limits<float>::infinity();
+	if (StepX != 0)
+		XCrossT = (Grid.OriginX + (X + (StepX > 0 ? 1 : 0))*Grid.CellSize - S.x) / Dir.x;
+	if (StepZ != 0)
+		ZCrossT = (Grid.OriginZ + (Z + (StepZ > 0 ? 1 : 0))*Grid.CellSize - S.y) / Dir.y;
+
+	if (XCrossT < ZCrossT)
+	{
+		X += StepX;
+		EnterT = max(EnterT, XCrossT);
+	}
+	else
+	{
+		Z += StepZ;
+		EnterT = max(EnterT, ZCrossT);
+	}
+	if (X<0 || X>=Grid.CellsX || Z<0 || Z>=Grid.CellsZ || EnterT > ExitT)
+		Done = true;
+	return true;
+}
+
+
+
+
+// CANDIDATE CACHE STUFF *******************************************************************************
+
+Room::CandidateCache::CandidateCache()
+	: Owner(NULL), OwnerVersion(0), Center(0.0f, 0.0f), HalfWidth(0.0f), Hits(0), Misses(0)
+{
+}
+
+void Room::CandidateCache::Invalidate()
+{
+	Owner = NULL;
+}
+
+void Room::CandidateCache::GetCounters(unsigned int *Hits_ptr, unsigned int *Misses_ptr)const
+{
+	*Hits_ptr = Hits;
+	*Misses_ptr = Misses;
+}
+
+void Room::CandidateCache::ResetCounters()
+{
+	Hits = 0;
+	Misses = 0;
+}
+
+
+
 
 // ROOM STUFF ***************************************************************************************************
+Room::ExitKernel Room::Kernel = (ROOM_SSE_EXIT_KERNEL ? Room::EXIT_KERNEL_SSE : Room::EXIT_KERNEL_SCALAR);
+
 Room::Room()
-	: FloorY(0.0f), CeilingY(0.0f), MinX(0.0f), MaxX(0.0f), MinZ(0.0f), MaxZ(0.0f), WallCount(0)
+	: MinX(0.0f), MaxX(0.0f), MinZ(0.0f), MaxZ(0.0f), WallCount(0), TopographyVersion(0), FloorY(0.0f), CeilingY(0.0f),
+	WallQueries(0), WallQueryGridEdges(0), WallQueryElements(0)
 {
 }
 
 // setters
+void Room::SetExitKernel(ExitKernel Kernel)
+{
+	Room::Kernel = Kernel;
+}
+
+Room::ExitKernel Room::GetExitKernel()
+{
+	return Kernel;
+}
+
 void Room::SetFloorAndCeiling(float FloorHeight, float CeilingHeight)
 {
 	FloorY = FloorHeight;
@@ -176,6 +545,8 @@ void Room::SetFloorAndCeiling(float FloorHeight, float CeilingHeight)
 void Room::SetTopography(const std::vector<std::vector<XMFLOAT2>> &Polygons)
 {
 	BoundaryPolygons.resize(Polygons.size());
+	WallEdges.clear();
+	WallEdgeArrays = WallEdgesSoA();
 	WallCount = 0;
 	for (unsigned int i=0; i<Polygons.size(); ++i)
 	{
@@ -188,12 +559,65 @@ void Room::SetTopography(const std::vector<std::vector<XMFLOAT2>> &Polygons)
 			MaxX = max(MaxX, Polygons[i][j].x);
 			MinZ = min(MinZ, Polygons[i][j].y);
 			MaxZ = max(MaxZ, Polygons[i][j].y);
+
+			WallEdge Edge;
+			Edge.U = Polygons[i][j];
+			Edge.V = (j==Polygons[i].size()-1) ? Polygons[i][0] : Polygons[i][j+1];
+			Edge.Length = XMFloat2Length(Edge.V-Edge.U);
+			// a repeated vertex gives a zero-length edge, which has no direction to normalize.  it's kept
+			// so edges still match the polygon's vertices, but it's skipped as an exit; its U is
+			// also the next edge's U, so that vertex is still tested
+			if (Edge.Length > 0.0f)
+				Edge.Dir = XMFloat2Normalize(Edge.V-Edge.U);
+			else
+				Edge.Dir = XMFLOAT2(0.0f, 0.0f);
+			Edge.Normal = XMFloat2Left90(Edge.Dir);
+			WallEdges.push_back(Edge);
+
+			WallEdgeArrays.Ux.push_back(Edge.U.x);
+			WallEdgeArrays.Uz.push_back(Edge.U.y);
+			WallEdgeArrays.Vx.push_back(Edge.V.x);
+			WallEdgeArrays.Vz.push_back(Edge.V.y);
+			WallEdgeArrays.Nx.push_back(Edge.Normal.x);
+			WallEdgeArrays.Nz.push_back(Edge.Normal.y);
 		}
 	}
+
+	WallEdgeGrid.Build(WallEdges, MinX, MaxX, MinZ, MaxZ);
+	++TopographyVersion;
 }
 
 
 // getters, prints
+float Room::GetFloorY()const
+{
+	return FloorY;
+}
+
+float Room::GetCeilingY()const
+{
+	return CeilingY;
+}
+
+const std::vector<std::vector<XMFLOAT2>>& Room::GetBoundaryPolygons()const
+{
+	return BoundaryPolygons;
+}
+
+void Room::GetWallQueryCounters(unsigned int *Queries_ptr, unsigned int *GridEdges_ptr, unsigned int *Elements_ptr)const
+{
+	*Queries_ptr = WallQueries;
+	*GridEdges_ptr = WallQueryGridEdges;
+	*Elements_ptr = WallQueryElements;
+}
+
+void Room::ResetWallQueryCounters()
+{
+	WallQueries = 0;
+	WallQueryGridEdges = 0;
+	WallQueryElements = 0;
+}
+
 void Room::PrintBoundaries()
 {
 	dprintf("\n");
@@ -213,65 +637,142 @@ XMFLOAT3 Room::SpherePathVirtualCollision(const XMMATRIX &Virtualize, const XMMA
 									float SphereRadius, XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist,
 									float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr)const
 {
-	// calculate virtual S, virtual Dir, virtual MoveDist 
-	XMFLOAT3 Sv;
-	XMFLOAT3 Dirv;
-	XMVECTOR SVirtual = XMVector3TransformCoord(XMLoadFloat3(&S), Virtualize);
-	XMVECTOR DirVirtual = XMVector3TransformNormal(XMLoadFloat3(&Dir), Virtualize);
-	XMStoreFloat3(&Sv, SVirtual);
-	XMStoreFloat3(&Dirv, DirVirtual);
-	
+	// calculate virtual S, virtual Dir, virtual MoveDist
+	Mat4 V = Mat4Load(Virtualize);
+	Vec3 Sv;
+	Vec3 Dirv;
+	Sv = Vec3TransformCoord(Vec3Load(S), V);
+	Dirv = Vec3TransformNormal(Vec3Load(Dir), V);
+
 	// scaling factor of the virtualization
-	float DirvLength = XMFloat3Length(Dirv);
+	float DirvLength = Vec3Length(Dirv);
 
 	// the only output that can be passed thru is RedirectRatio.  everything else needs to be unvirtualized
-	XMFLOAT3 Xv;
+	Vec3 Xv;
 	float XDistv;
-	XMFLOAT3 RedirectDirv;
-	XMFLOAT3 Tv;			// unused
-	XMFLOAT3 TNormalv;		// unused
-	Xv = SpherePathCollision(SphereRadius*DirvLength, Sv, Dirv/DirvLength, MoveDist*DirvLength, &XDistv, RedirectRatio_ptr, &RedirectDirv, &Tv, &TNormalv);
+	Vec3 RedirectDirv;
+	Vec3 Tv;			// unused
+	Vec3 TNormalv;		// unused
+	Xv = SpherePathCollision(SphereRadius*DirvLength, Sv, Dirv/DirvLength, MoveDist*DirvLength, &XDistv, RedirectRatio_ptr, &RedirectDirv, &Tv, &TNormalv, NULL);
 
 	// un-virtualize Xv
-	XMFLOAT3 X;
-	XMVECTOR XUnvirtual = XMVector3TransformCoord(XMLoadFloat3(&Xv), Unvirtualize);
-	XMStoreFloat3(&X, XUnvirtual);
+	Mat4 U = Mat4Load(Unvirtualize);
+	XMFLOAT3 X = Vec3Store(Vec3TransformCoord(Xv, U));
 	// un-virtualize RedirectDirv
-	XMVECTOR RedirectDirUnvirtual = XMVector3TransformNormal(XMLoadFloat3(&RedirectDirv), Unvirtualize);
-	XMStoreFloat3(RedirectDir_ptr, RedirectDirUnvirtual);
+	*RedirectDir_ptr = Vec3Store(Vec3TransformNormal(RedirectDirv, U));
 	// unscale XDist
-	*XDist_ptr = XDistv / DirvLength;	// XDist needs to be unscaled 
-	
+	*XDist_ptr = XDistv / DirvLength;	// XDist needs to be unscaled
+
 	return X;
 }
 
 
+void Room::SpherePathCollisionBatch(const std::vector<SpherePathQuery> &Queries, std::vector<SpherePathResult> &Results)const
+{
+	Results.resize(Queries.size());
+
+	// sort the queries by the cell their path starts in; ties keep their original order
+	BatchOrder.resize(Queries.size());
+	for (unsigned int i=0; i<Queries.size(); ++i)
+	{
+		BatchOrder[i].first = WallEdgeGrid.CellIndex(XMFLOAT2(Queries[i].S.x, Queries[i].S.z));
+		BatchOrder[i].second = i;
+	}
+	std::sort(BatchOrder.begin(), BatchOrder.end());
+
+	for (unsigned int First=0; First<BatchOrder.size(); )
+	{
+		// find this cell's run of queries, and the square that covers all of them
+		unsigned int End = First;
+		float LoX = std::numeric_limits<float>::infinity(), HiX = -LoX, LoZ = LoX, HiZ = -LoX;
+		while (End < BatchOrder.size() && BatchOrder[End].first == BatchOrder[First].first)
+		{
+			const SpherePathQuery &Q = Queries[BatchOrder[End].second];
+			float HalfWidth = WallQueryHalfWidth(Q.SphereRadius, Vec3Load(Q.Dir), Q.MoveDist);
+			LoX = min(LoX, Q.S.x - HalfWidth);
+			HiX = max(HiX, Q.S.x + HalfWidth);
+			LoZ = min(LoZ, Q.S.z - HalfWidth);
+			HiZ = max(HiZ, Q.S.z + HalfWidth);
+			++End;
+		}
+
+		// a query alone in its cell has nothing to share edges with
+		if (End - First == 1)
+		{
+			const SpherePathQuery &Q = Queries[BatchOrder[First].second];
+			SpherePathResult &R = Results[BatchOrder[First].second];
+			R.X = SpherePathCollision(Q.SphereRadius, Q.S, Q.Dir, Q.MoveDist,
+							&R.XDist, &R.RedirectRatio, &R.RedirectDir, &R.T, &R.TNormal);
+			First = End;
+			continue;
+		}
+
+		// size the square around its center with the same sums the cache checks queries with, so
+		// rounding can't make any query in the run miss
+		XMFLOAT2 Center(0.5f*(LoX + HiX), 0.5f*(LoZ + HiZ));
+		float CoverHalfWidth = 0.0f;
+		for (unsigned int k=First; k<End; ++k)
+		{
+			const SpherePathQuery &Q = Queries[BatchOrder[k].second];
+			float HalfWidth = WallQueryHalfWidth(Q.SphereRadius, Vec3Load(Q.Dir), Q.MoveDist);
+			CoverHalfWidth = max(CoverHalfWidth, fabsf(Q.S.x - Center.x) + HalfWidth);
+			CoverHalfWidth = max(CoverHalfWidth, fabsf(Q.S.z - Center.y) + HalfWidth);
+		}
+		FillCandidateCache(BatchCache, Center, CoverHalfWidth);
+
+		for (unsigned int k=First; k<End; ++k)
+		{
+			const SpherePathQuery &Q = Queries[BatchOrder[k].second];
+			SpherePathResult &R = Results[BatchOrder[k].second];
+			R.X = SpherePathCollision(Q.SphereRadius, Q.S, Q.Dir, Q.MoveDist,
+							&R.XDist, &R.RedirectRatio, &R.RedirectDir, &R.T, &R.TNormal, &BatchCache);
+		}
+		First = End;
+	}
+}
+
+
 XMFLOAT3 Room::SpherePathCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist,
 									float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr,
-									XMFLOAT3 *T_ptr, XMFLOAT3 *TNormal_ptr)const
+									XMFLOAT3 *T_ptr, XMFLOAT3 *TNormal_ptr, CandidateCache *Cache)const
+{
+	Vec3 RedirectDir;
+	Vec3 T;
+	Vec3 TNormal;
+	Vec3 X = SpherePathCollision(SphereRadius, Vec3Load(S), Vec3Load(Dir), MoveDist,
+									XDist_ptr, RedirectRatio_ptr, &RedirectDir, &T, &TNormal, Cache);
+	*RedirectDir_ptr = Vec3Store(RedirectDir);
+	*T_ptr = Vec3Store(T);
+	*TNormal_ptr = Vec3Store(TNormal);
+	return Vec3Store(X);
+}
+
+Vec3 Room::SpherePathCollision(float SphereRadius, const Vec3 &S, const Vec3 &Dir, float MoveDist,
+									float *XDist_ptr, float *RedirectRatio_ptr, Vec3 *RedirectDir_ptr,
+									Vec3 *T_ptr, Vec3 *TNormal_ptr, CandidateCache *Cache)const
 {
 	// find path collision with floor or ceiling
-	XMFLOAT3 FloorCeilingX;
+	Vec3 FloorCeilingX;
 	float FloorCeilingXDist;
 	float FloorCeilingRedirectRatio;
-	XMFLOAT3 FloorCeilingRedirectDir;
-	XMFLOAT3 FloorCeilingT;
-	XMFLOAT3 FloorCeilingTNormal;
+	Vec3 FloorCeilingRedirectDir;
+	Vec3 FloorCeilingT = Vec3Set(0.0f, 0.0f, 0.0f);
+	Vec3 FloorCeilingTNormal = Vec3Set(0.0f, 0.0f, 0.0f);
 	FloorCeilingX = SpherePathFloorCeilingCollision(SphereRadius, S, Dir, MoveDist, 
 		&FloorCeilingXDist, &FloorCeilingRedirectRatio, &FloorCeilingRedirectDir, &FloorCeilingT, &FloorCeilingTNormal);
 
 	// find path collision with walls
 	float WallXDist;
 	float WallRedirectRatio;
-	XMFLOAT3 WallRedirectDir;
-	XMFLOAT3 WallX;
-	XMFLOAT3 WallT;
-	XMFLOAT3 WallTNormal;
+	Vec3 WallRedirectDir;
+	Vec3 WallX;
+	Vec3 WallT;
+	Vec3 WallTNormal;
 	WallX = SpherePathWallCollision(SphereRadius, S, Dir, MoveDist, 
-			&WallXDist, &WallRedirectRatio, &WallRedirectDir, &WallT, &WallTNormal);
+			&WallXDist, &WallRedirectRatio, &WallRedirectDir, &WallT, &WallTNormal, Cache);
 
 	// return the collision that's closer. if both equally close, then return the one that's more restrictive
-	XMFLOAT3 X;
+	Vec3 X;
 	if (FloorCeilingXDist < WallXDist || 
 		(FloorCeilingXDist==WallXDist && FloorCeilingRedirectRatio < WallRedirectRatio))
 	{
@@ -296,9 +797,9 @@ XMFLOAT3 Room::SpherePathCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Dir,
 
 
 
-XMFLOAT3 Room::SpherePathFloorCeilingCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist,
-									float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr,
-									XMFLOAT3 *T_ptr, XMFLOAT3 *TNormal_ptr)const
+Vec3 Room::SpherePathFloorCeilingCollision(float SphereRadius, const Vec3 &S, const Vec3 &Dir, float MoveDist,
+									float *XDist_ptr, float *RedirectRatio_ptr, Vec3 *RedirectDir_ptr,
+									Vec3 *T_ptr, Vec3 *TNormal_ptr)const
 {
 	// defaults
 	*XDist_ptr = MoveDist;
@@ -306,43 +807,45 @@ XMFLOAT3 Room::SpherePathFloorCeilingCollision(float SphereRadius, XMFLOAT3 S, X
 	*RedirectDir_ptr = Dir;
 
 	// check if this path has movement in the Y direction
-	if (Dir.y==0.0f)
+	float DirY = Vec3GetY(Dir);
+	if (DirY==0.0f)
 		return S + MoveDist*Dir;
 
 
 	// convert inputs to Y axis projections
-	float StartY = S.y;
+	float StartY = Vec3GetY(S);
 
 	// solve for t: X=S+t*Dir
 	// X.y = StartY + t * Dir.y
-	bool HeadingUp = (Dir.y > 0.0f);
+	bool HeadingUp = (DirY > 0.0f);
 	float t;
 	if (HeadingUp)
-		t = ((CeilingY-SphereRadius) - StartY) / Dir.y;
+		t = ((CeilingY-SphereRadius) - StartY) / DirY;
 	else
-		t = ((FloorY+SphereRadius) - StartY) / Dir.y;
+		t = ((FloorY+SphereRadius) - StartY) / DirY;
 
 	// check path exits floor/ceiling
 	if (t < -T_THRESHOLD || t >= MoveDist)
 		return S + MoveDist*Dir;
 
 	// find XZ coordinate of X
-	XMFLOAT2 XXZ = XMFLOAT2(S.x+t*Dir.x, S.z+t*Dir.z);
+	Vec2 DirXZ = Vec3GetXZ(Dir);
+	Vec2 XXZ = Vec3GetXZ(S) + t*DirXZ;
 
 	// calculate T info
-	*T_ptr = XMFLOAT3(XXZ.x, (HeadingUp ? CeilingY : FloorY), XXZ.y);
-	*TNormal_ptr = XMFLOAT3(0.0f, (HeadingUp ? -1.0f : 1.0f), 0.0f);
+	*T_ptr = Vec3FromXZ(XXZ, (HeadingUp ? CeilingY : FloorY));
+	*TNormal_ptr = Vec3Set(0.0f, (HeadingUp ? -1.0f : 1.0f), 0.0f);
 
 	// calculate X info
 	*XDist_ptr = t;
-	if (Dir.x==0.0f && Dir.z==0.0f)
+	if (DirXZ == Vec2Set(0.0f, 0.0f))
 	{
 		*RedirectRatio_ptr = 0.0f;
 	}
 	else
 	{
-		*RedirectDir_ptr = XMFloat3Normalize(XMFLOAT3(Dir.x, 0.0f, Dir.z));
-		*RedirectRatio_ptr = XMFloat3Dot(*RedirectDir_ptr, Dir);
+		*RedirectDir_ptr = Vec3Normalize(Vec3FromXZ(DirXZ, 0.0f));
+		*RedirectRatio_ptr = Vec3Dot(*RedirectDir_ptr, Dir);
 	}
 
 	// bump t, calculate X
@@ -351,72 +854,132 @@ XMFLOAT3 Room::SpherePathFloorCeilingCollision(float SphereRadius, XMFLOAT3 S, X
 }
 
 
-XMFLOAT3 Room::SpherePathWallCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist,
-									float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr,
-									XMFLOAT3 *T_ptr, XMFLOAT3 *TNormal_ptr)const
+float Room::WallQueryHalfWidth(float SphereRadius, const Vec3 &Dir, float MoveDist)
+{
+	float MoveDistXZ = MoveDist * Vec2Length(Vec3GetXZ(Dir));
+	return 1.5f*(MoveDistXZ + SphereRadius);
+}
+
+void Room::FillCandidateCache(CandidateCache &Cache, XMFLOAT2 Center, float HalfWidth)const
+{
+	Cache.Owner = this;
+	Cache.OwnerVersion = TopographyVersion;
+	Cache.Center = Center;
+	Cache.HalfWidth = HalfWidth;
+	WallEdgeGrid.GatherEdges(Center, HalfWidth, Cache.Edges);
+}
+
+
+Vec3 Room::SpherePathWallCollision(float SphereRadius, const Vec3 &S, const Vec3 &Dir, float MoveDist,
+									float *XDist_ptr, float *RedirectRatio_ptr, Vec3 *RedirectDir_ptr,
+									Vec3 *T_ptr, Vec3 *TNormal_ptr, CandidateCache *Cache)const
 {
 	// defaults
 	*XDist_ptr = MoveDist;
 	*RedirectRatio_ptr = 1.0f;
 	*RedirectDir_ptr = Dir;
-	
+
 	// see if this path has any movement in the XZ plane.  If not, no wall collision will happen
-	if (Dir.x==0.0f && Dir.z==0.0f)
+	Vec2 DirXZ = Vec3GetXZ(Dir);
+	if (DirXZ == Vec2Set(0.0f, 0.0f))
 		return S + MoveDist*Dir;
 
 
 	// convert inputs to XZ plane projections
-	XMFLOAT2 StartXZ = XMFLOAT2(S.x, S.z);
-	XMFLOAT2 DirXZ = XMFLOAT2(Dir.x, Dir.z);
-	float DirXZRatio = XMFloat2Length(DirXZ);
-	DirXZ = XMFloat2Normalize(DirXZ);
+	Vec2 StartXZ = Vec3GetXZ(S);
+	float DirXZRatio = Vec2Length(DirXZ);
+	DirXZ = Vec2Normalize(DirXZ);
 	float MoveDistXZ = MoveDist * DirXZRatio;
 
 	// in the XZ plane, find the boundary elements that are close enough for the disc to exit at
-	BoundaryElementsList DiscCenterBoundaryElements;
+	bool UseSSE = (Kernel == EXIT_KERNEL_SSE);
+	if (UseSSE)
+		DiscCenterBoundaryElementsSoA.Clear();
+	else
+		DiscCenterBoundaryElements.Clear();
 	
 	float SumDist = MoveDistXZ + SphereRadius;
-	for (unsigned int PolygonIndex=0; PolygonIndex<BoundaryPolygons.size(); ++PolygonIndex)
+
+	// any vertex or edge that passes the tests below has a point within sqrt(2)*SumDist of S,
+	// so only the edges the grid finds in that neighborhood need to be checked.  the tests pick the
+	// same elements in the same order from any superset of them, such as a cache's edges
+	float HalfWidth = WallQueryHalfWidth(SphereRadius, Dir, MoveDist);
+	const std::vector<UINT> *Edges = &CandidateEdges;
+	XMFLOAT2 Start = Vec2Store(StartXZ);
+	if (Cache)
 	{
-		const std::vector<XMFLOAT2> &Vertices = BoundaryPolygons[PolygonIndex];
-		for (unsigned int i=0; i<Vertices.size(); ++i)
+		if (Cache->Owner == this && Cache->OwnerVersion == TopographyVersion
+			&& fabsf(Start.x - Cache->Center.x) + HalfWidth <= Cache->HalfWidth
+			&& fabsf(Start.y - Cache->Center.y) + HalfWidth <= Cache->HalfWidth)
 		{
-			// get edge at this index: UV
-			XMFLOAT2 U = Vertices[i];
-			XMFLOAT2 V = (i==Vertices.size()-1) ? Vertices[0] : Vertices[i+1];
+			++Cache->Hits;
+		}
+		else
+		{
+			++Cache->Misses;
+			FillCandidateCache(*Cache, Start, HalfWidth + ROOM_CANDIDATE_CACHE_MARGIN);
+		}
+		Edges = &Cache->Edges;
+	}
+	else
+		WallEdgeGrid.GatherEdges(Start, HalfWidth, CandidateEdges);
 
-			// can U be reached from S?
-			if (SumDist >= XMFloat2Length(U-StartXZ))
-			{
-				//dprintf("	Vertex (%f, %f)\n",U.x,U.y);
-				DiscCenterBoundaryElements.AddVertex(U);
-			}
+	for (unsigned int k=0; k<Edges->size(); ++k)
+	{
+		// get edge at this index: UV
+		const WallEdge &Edge = WallEdges[(*Edges)[k]];
+		Vec2 U = Vec2Load(Edge.U);
+		Vec2 V = Vec2Load(Edge.V);
+
+		// can U be reached from S?
+		if (SumDist >= Vec2Length(U-StartXZ))
+		{
+			//dprintf("	Vertex (%f, %f)\n",Edge.U.x,Edge.U.y);
+			if (UseSSE)
+				DiscCenterBoundaryElementsSoA.AddVertex(Edge.U);
+			else
+				DiscCenterBoundaryElements.AddVertex(Edge.U);
+		}
 
-			// can UV be reached from S?
-			XMFLOAT2 UVDir = XMFloat2Normalize(V-U);
-			if (SumDist >= abs(XMFloat2Cross(StartXZ-U, UVDir)))	// S close enough to line UV
+		// can UV be reached from S?
+		Vec2 UVDir = Vec2Load(Edge.Dir);
+		if (Edge.Length > 0.0f
+			&& SumDist >= abs(Vec2Cross(StartXZ-U, UVDir)))	// S close enough to line UV
+		{
+			Vec2 US = StartXZ-U;
+			Vec2 VS = StartXZ-V;
+			if (Vec2Dot(VS, UVDir)<=SumDist			// S not too far to the side of U or V
+				&& Vec2Dot(US, UVDir)>=-SumDist)
 			{
-				XMFLOAT2 US = StartXZ-U;
-				XMFLOAT2 VS = StartXZ-V;
-				if (XMFloat2Dot(VS, UVDir)<=SumDist			// S not too far to the side of U or V
-					&& XMFloat2Dot(US, UVDir)>=-SumDist)
-				{
-					//dprintf("	Edge (%f, %f)--(%f, %f)\n", U.x,U.y,V.x,V.y);
-					DiscCenterBoundaryElements.AddEdge(U, V);
-				}
+				//dprintf("	Edge (%f, %f)--(%f, %f)\n", Edge.U.x,Edge.U.y,Edge.V.x,Edge.V.y);
+				if (UseSSE)
+					DiscCenterBoundaryElementsSoA.AddEdge(Edge.U, Edge.V, Edge.Normal);
+				else
+					DiscCenterBoundaryElements.AddEdge(Edge.U, Edge.V, Edge.Normal);
 			}
 		}
 	}
 
+	++WallQueries;
+	WallQueryGridEdges += Edges->size();
+	if (UseSSE)
+		WallQueryElements += DiscCenterBoundaryElementsSoA.EdgeCount + DiscCenterBoundaryElementsSoA.VertexCount;
+	else
+		WallQueryElements += DiscCenterBoundaryElements.size();
+
 	// find where the XZ disc of the sphere will exit the room in the XZ plane
-	XMFLOAT2 XXZ;
+	Vec2 XXZ;
 	float XDistXZ;
 	float RedirectRatioXZ;
-	XMFLOAT2 RedirectDirXZ;
-	XMFLOAT2 TXZ;
-	XMFLOAT2 TNormalXZ;
-	XXZ = FindFirstExit(SphereRadius, StartXZ, DirXZ, MoveDistXZ, DiscCenterBoundaryElements,
-						&XDistXZ, &RedirectRatioXZ, &RedirectDirXZ, &TXZ, &TNormalXZ);
+	Vec2 RedirectDirXZ;
+	Vec2 TXZ;
+	Vec2 TNormalXZ;
+	if (UseSSE)
+		XXZ = FindFirstExitSSE(SphereRadius, StartXZ, DirXZ, MoveDistXZ, DiscCenterBoundaryElementsSoA,
+							&XDistXZ, &RedirectRatioXZ, &RedirectDirXZ, &TXZ, &TNormalXZ);
+	else
+		XXZ = FindFirstExit(SphereRadius, StartXZ, DirXZ, MoveDistXZ, DiscCenterBoundaryElements,
+							&XDistXZ, &RedirectRatioXZ, &RedirectDirXZ, &TXZ, &TNormalXZ);
 
 	// check if a wall collision even occurred.  if not, return
 	if (XDistXZ==MoveDistXZ)
@@ -426,69 +989,70 @@ XMFLOAT3 Room::SpherePathWallCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3
 	*XDist_ptr = XDistXZ / DirXZRatio;
 
 	// find the y coordinate of X
-	float XY = S.y + *XDist_ptr*Dir.y;
+	float DirY = Vec3GetY(Dir);
+	float XY = Vec3GetY(S) + *XDist_ptr*DirY;
 
 	// convert T info back to 3D
-	*T_ptr = XMFLOAT3(TXZ.x, XY, TXZ.y);
-	*TNormal_ptr = XMFLOAT3(TNormalXZ.x, 0.0f, TNormalXZ.y);
+	*T_ptr = Vec3FromXZ(TXZ, XY);
+	*TNormal_ptr = Vec3FromXZ(TNormalXZ, 0.0f);
 
 	// convert X info back to 3D
 	// if no redirect is possible in the XZ plane, then we must redirect in the Y direction
 	if (RedirectRatioXZ==0.0f)
 	{
-		if (Dir.y==0.0f)	// if we can't redirect along Y neither, then we have no redirect
+		if (DirY==0.0f)	// if we can't redirect along Y neither, then we have no redirect
 		{
 			*RedirectRatio_ptr = 0.0f;
 		}
 		else
 		{
-			*RedirectDir_ptr = XMFLOAT3(0.0f, (Dir.y>0.0f) ? 1.0f : -1.0f, 0.0f);
-			*RedirectRatio_ptr = XMFloat3Dot(*RedirectDir_ptr, Dir);
+			*RedirectDir_ptr = Vec3Set(0.0f, (DirY>0.0f) ? 1.0f : -1.0f, 0.0f);
+			*RedirectRatio_ptr = Vec3Dot(*RedirectDir_ptr, Dir);
 		}
 	}
 	else
 	{
 		// normalize reconstructed 3D RedirectDir for good measure
-		*RedirectDir_ptr = XMFloat3Normalize(XMFLOAT3(RedirectDirXZ.x * DirXZRatio, Dir.y, RedirectDirXZ.y * DirXZRatio));
-		*RedirectRatio_ptr = XMFloat3Dot(*RedirectDir_ptr, Dir);
+		*RedirectDir_ptr = Vec3Normalize(Vec3FromXZ(RedirectDirXZ * DirXZRatio, DirY));
+		*RedirectRatio_ptr = Vec3Dot(*RedirectDir_ptr, Dir);
 	}
-	
-	return XMFLOAT3(XXZ.x, XY, XXZ.y);	// note: XZ is the y coordinate of the unbumped X, while XXZ is the xa coordinates of the bumped X
+
+	return Vec3FromXZ(XXZ, XY);	// note: XZ is the y coordinate of the unbumped X, while XXZ is the xa coordinates of the bumped X
 }
 
 
 
 
-XMFLOAT2 Room::FindFirstExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Dir, float MoveDist, 
+Vec2 Room::FindFirstExit(float DiscRadius, const Vec2 &S, const Vec2 &Dir, float MoveDist,
 							const BoundaryElementsList &DiscCenterBoundaryElements,
-							float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT2 *RedirectDir_ptr,
-							XMFLOAT2 *T_ptr, XMFLOAT2 *TNormal_ptr)const
+							float *XDist_ptr, float *RedirectRatio_ptr, Vec2 *RedirectDir_ptr,
+							Vec2 *T_ptr, Vec2 *TNormal_ptr)const
 {
 
-	XMFLOAT2 ClosestX = S + MoveDist*Dir;
+	Vec2 ClosestX = S + MoveDist*Dir;
 	float ClosestXDist = MoveDist;
 	float ClosestLeftRedCos = 1.0f;
-	XMFLOAT2 ClosestLeftRedDir = Dir;
-	XMFLOAT2 ClosestT;
-	XMFLOAT2 ClosestTNormal;
+	Vec2 ClosestLeftRedDir = Dir;
+	Vec2 ClosestT = Vec2Set(0.0f, 0.0f);
+	Vec2 ClosestTNormal = Vec2Set(0.0f, 0.0f);
 
 	//dprintf("\nFinding exit and redirect info for this intended path:\n");
 	//dprintf("S=(%f, %f), Dir=(%f, %f), MoveDist=%f\n",S.x,S.y,Dir.x,Dir.y,MoveDist);
 
 	// find the X and redirection from the closest and most restrictive boundary element
 	float XDist;
-	XMFLOAT2 X;
+	Vec2 X;
 	float LeftRedCos;
-	XMFLOAT2 LeftRedDir;
-	XMFLOAT2 T;
-	XMFLOAT2 TNormal;
+	Vec2 LeftRedDir;
+	Vec2 T;
+	Vec2 TNormal;
 	for (unsigned int i=0; i<DiscCenterBoundaryElements.size(); ++i)
 	{
-		if (!DiscCenterBoundaryElements[i]->RayPathExit(DiscRadius, S, Dir, &X, &XDist, &LeftRedCos, &LeftRedDir, &T, &TNormal))
+		if (!DiscCenterBoundaryElements[i].RayPathExit(DiscRadius, S, Dir, &X, &XDist, &LeftRedCos, &LeftRedDir, &T, &TNormal))
 			continue;
 		
 		//dprintf("	%d: ",i);
-		//DiscCenterBoundaryElements[i]->PrintInfo();
+		//DiscCenterBoundaryElements[i].PrintInfo();
 		//dprintf("		Disc on path ray exits this element at X=(%f, %f), XDist=%f...\n",X.x,X.y,XDist);
 		/*
 		if (XDist == ClosestXDist)
@@ -540,10 +1104,223 @@ XMFLOAT2 Room::FindFirstExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Dir, float M
 
 
 
-void Room::PortalRelocate(XMFLOAT3 S, XMFLOAT3 Dir, Portal &ThisPortal, const Portal &OtherPortal)const
+// keeps, per lane, the exit that FindFirstExit would prefer: lowest t, then lowest |cos| of the
+// redirect, then whichever element comes first in the list
+static inline void UpdateBestExit(__m128 Valid, __m128 t, __m128 AbsCos, __m128 Order, __m128 Slot,
+									__m128 &BestT, __m128 &BestAbsCos, __m128 &BestOrder, __m128 &BestSlot)
+{
+	__m128 SameT = _mm_cmpeq_ps(t, BestT);
+	__m128 SameCos = _mm_cmpeq_ps(AbsCos, BestAbsCos);
+	__m128 Better = _mm_or_ps(_mm_cmplt_ps(t, BestT),
+					_mm_and_ps(SameT, _mm_or_ps(_mm_cmplt_ps(AbsCos, BestAbsCos),
+											_mm_and_ps(SameCos, _mm_cmplt_ps(Order, BestOrder)))));
+	Better = _mm_and_ps(Better, Valid);
+
+	BestT = _mm_or_ps(_mm_and_ps(Better, t), _mm_andnot_ps(Better, BestT));
+	BestAbsCos = _mm_or_ps(_mm_and_ps(Better, AbsCos), _mm_andnot_ps(Better, BestAbsCos));
+	BestOrder = _mm_or_ps(_mm_and_ps(Better, Order), _mm_andnot_ps(Better, BestOrder));
+	BestSlot = _mm_or_ps(_mm_and_ps(Better, Slot), _mm_andnot_ps(Better, BestSlot));
+}
+
+// horizontal version of UpdateBestExit: returns the lane holding the preferred exit
+static inline int FindBestExitLane(__m128 BestT, __m128 BestAbsCos, __m128 BestOrder)
+{
+	float t[4], AbsCos[4], Order[4];
+	_mm_storeu_ps(t, BestT);
+	_mm_storeu_ps(AbsCos, BestAbsCos);
+	_mm_storeu_ps(Order, BestOrder);
+
+	int Best = 0;
+	for (int i=1; i<4; ++i)
+	{
+		if (t[i] < t[Best] ||
+			(t[i] == t[Best] && (AbsCos[i] < AbsCos[Best] || (AbsCos[i] == AbsCos[Best] && Order[i] < Order[Best]))))
+		{
+			Best = i;
+		}
+	}
+	return Best;
+}
+
+
+// evaluates the same per-element math as BoundaryElement::RayPathExit, 4 elements per instruction.
+// only t and the redirect cosine are needed to pick the winning element; its full exit info is
+// then calculated with the scalar RayPathExit so the outputs match FindFirstExit exactly
+Vec2 Room::FindFirstExitSSE(float DiscRadius, const Vec2 &S, const Vec2 &Dir, float MoveDist,
+							const BoundaryElementsSoA &Elements,
+							float *XDist_ptr, float *RedirectRatio_ptr, Vec2 *RedirectDir_ptr,
+							Vec2 *T_ptr, Vec2 *TNormal_ptr)const
+{
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 SignMask = _mm_set1_ps(-0.0f);
+	const __m128 LaneIndex = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	const __m128 MinT = _mm_set1_ps(-T_THRESHOLD);
+	const __m128 Radius = _mm_set1_ps(DiscRadius);
+	const __m128 Sx = _mm_set1_ps(Vec2GetX(S));
+	const __m128 Sz = _mm_set1_ps(Vec2GetY(S));
+	const __m128 Dx = _mm_set1_ps(Vec2GetX(Dir));
+	const __m128 Dz = _mm_set1_ps(Vec2GetY(Dir));
+
+	// the default exit (the end of the path) comes before every element
+	const __m128 DefaultT = _mm_set1_ps(MoveDist);
+	const __m128 DefaultAbsCos = _mm_set1_ps(1.0f);
+	const __m128 DefaultOrder = _mm_set1_ps(-1.0f);
+
+
+	// EDGES
+	__m128 EdgeBestT = DefaultT;
+	__m128 EdgeBestAbsCos = DefaultAbsCos;
+	__m128 EdgeBestOrder = DefaultOrder;
+	__m128 EdgeBestSlot = Zero;
+	for (unsigned int i=0; i<Elements.EdgeCount; i+=4)
+	{
+		__m128 Slot = _mm_add_ps(_mm_set1_ps((float)i), LaneIndex);
+		__m128 InRange = _mm_cmplt_ps(Slot, _mm_set1_ps((float)Elements.EdgeCount));
+
+		__m128 Ux = _mm_loadu_ps(&Elements.EdgeUx[i]);
+		__m128 Uz = _mm_loadu_ps(&Elements.EdgeUz[i]);
+		__m128 Vx = _mm_loadu_ps(&Elements.EdgeVx[i]);
+		__m128 Vz = _mm_loadu_ps(&Elements.EdgeVz[i]);
+		__m128 Nx = _mm_loadu_ps(&Elements.EdgeNx[i]);
+		__m128 Nz = _mm_loadu_ps(&Elements.EdgeNz[i]);
+
+		// shifted segment AB
+		__m128 Ax = _mm_add_ps(Ux, _mm_mul_ps(Radius, Nx));
+		__m128 Az = _mm_add_ps(Uz, _mm_mul_ps(Radius, Nz));
+		__m128 Bx = _mm_add_ps(Vx, _mm_mul_ps(Radius, Nx));
+		__m128 Bz = _mm_add_ps(Vz, _mm_mul_ps(Radius, Nz));
+
+		__m128 SAx = _mm_sub_ps(Ax, Sx);
+		__m128 SAz = _mm_sub_ps(Az, Sz);
+		__m128 SBx = _mm_sub_ps(Bx, Sx);
+		__m128 SBz = _mm_sub_ps(Bz, Sz);
+		__m128 DirCrossSA = _mm_sub_ps(_mm_mul_ps(Dx, SAz), _mm_mul_ps(Dz, SAx));
+		__m128 DirCrossSB = _mm_sub_ps(_mm_mul_ps(Dx, SBz), _mm_mul_ps(Dz, SBx));
+
+		__m128 ABx = _mm_sub_ps(Bx, Ax);
+		__m128 ABz = _mm_sub_ps(Bz, Az);
+		__m128 t = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(SAx, ABz), _mm_mul_ps(SAz, ABx)),
+							_mm_sub_ps(_mm_mul_ps(Dx, ABz), _mm_mul_ps(Dz, ABx)));
+
+		// LeftRedDir = Right90(Normal)
+		__m128 Cos = _mm_add_ps(_mm_mul_ps(Dx, Nz), _mm_mul_ps(Dz, _mm_xor_ps(Nx, SignMask)));
+
+		__m128 Invalid = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(DirCrossSA, Zero), _mm_cmplt_ps(DirCrossSB, Zero)),
+						_mm_and_ps(_mm_cmpeq_ps(DirCrossSA, Zero), _mm_cmpeq_ps(DirCrossSB, Zero)));
+		Invalid = _mm_or_ps(Invalid, _mm_cmplt_ps(t, MinT));
+		__m128 Valid = _mm_andnot_ps(Invalid, InRange);
+
+		UpdateBestExit(Valid, t, _mm_andnot_ps(SignMask, Cos), _mm_loadu_ps(&Elements.EdgeOrder[i]), Slot,
+						EdgeBestT, EdgeBestAbsCos, EdgeBestOrder, EdgeBestSlot);
+	}
+
+
+	// VERTICES
+	__m128 VertexBestT = DefaultT;
+	__m128 VertexBestAbsCos = DefaultAbsCos;
+	__m128 VertexBestOrder = DefaultOrder;
+	__m128 VertexBestSlot = Zero;
+	const __m128 RadiusSq = _mm_set1_ps(DiscRadius*DiscRadius);
+	for (unsigned int i=0; i<Elements.VertexCount; i+=4)
+	{
+		__m128 Slot = _mm_add_ps(_mm_set1_ps((float)i), LaneIndex);
+		__m128 InRange = _mm_cmplt_ps(Slot, _mm_set1_ps((float)Elements.VertexCount));
+
+		__m128 Vx = _mm_loadu_ps(&Elements.VertexX[i]);
+		__m128 Vz = _mm_loadu_ps(&Elements.VertexZ[i]);
+
+		__m128 VSx = _mm_sub_ps(Sx, Vx);
+		__m128 VSz = _mm_sub_ps(Sz, Vz);
+		__m128 b_half = _mm_add_ps(_mm_mul_ps(VSx, Dx), _mm_mul_ps(VSz, Dz));
+		__m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(VSx, VSx), _mm_mul_ps(VSz, VSz)), RadiusSq);
+		__m128 discr_over_4 = _mm_sub_ps(_mm_mul_ps(b_half, b_half), c);
+		__m128 t = _mm_sub_ps(_mm_xor_ps(b_half, SignMask), _mm_sqrt_ps(discr_over_4));
+
+		// TNormal = normalize(XUnbumped - V), LeftRedDir = Right90(TNormal)
+		__m128 TNx = _mm_sub_ps(_mm_add_ps(Sx, _mm_mul_ps(t, Dx)), Vx);
+		__m128 TNz = _mm_sub_ps(_mm_add_ps(Sz, _mm_mul_ps(t, Dz)), Vz);
+		__m128 Length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(TNx, TNx), _mm_mul_ps(TNz, TNz)));
+		TNx = _mm_div_ps(TNx, Length);
+		TNz = _mm_div_ps(TNz, Length);
+		__m128 Cos = _mm_add_ps(_mm_mul_ps(Dx, TNz), _mm_mul_ps(Dz, _mm_xor_ps(TNx, SignMask)));
+
+		__m128 Invalid = _mm_or_ps(_mm_cmple_ps(discr_over_4, Zero), _mm_cmplt_ps(t, MinT));
+		__m128 Valid = _mm_andnot_ps(Invalid, InRange);
+
+		UpdateBestExit(Valid, t, _mm_andnot_ps(SignMask, Cos), _mm_loadu_ps(&Elements.VertexOrder[i]), Slot,
+						VertexBestT, VertexBestAbsCos, VertexBestOrder, VertexBestSlot);
+	}
+
+
+	// reduce each list to its best lane, then pick between the best edge and the best vertex
+	float Lanes[4];
+	int EdgeLane = FindBestExitLane(EdgeBestT, EdgeBestAbsCos, EdgeBestOrder);
+	_mm_storeu_ps(Lanes, EdgeBestT);
+	float EdgeT = Lanes[EdgeLane];
+	_mm_storeu_ps(Lanes, EdgeBestAbsCos);
+	float EdgeAbsCos = Lanes[EdgeLane];
+	_mm_storeu_ps(Lanes, EdgeBestOrder);
+	float EdgeOrder = Lanes[EdgeLane];
+	_mm_storeu_ps(Lanes, EdgeBestSlot);
+	int EdgeSlot = (int)Lanes[EdgeLane];
+
+	int VertexLane = FindBestExitLane(VertexBestT, VertexBestAbsCos, VertexBestOrder);
+	_mm_storeu_ps(Lanes, VertexBestT);
+	float VertexT = Lanes[VertexLane];
+	_mm_storeu_ps(Lanes, VertexBestAbsCos);
+	float VertexAbsCos = Lanes[VertexLane];
+	_mm_storeu_ps(Lanes, VertexBestOrder);
+	float VertexOrder = Lanes[VertexLane];
+	_mm_storeu_ps(Lanes, VertexBestSlot);
+	int VertexSlot = (int)Lanes[VertexLane];
+
+	bool UseVertex = (VertexT < EdgeT ||
+					(VertexT == EdgeT && (VertexAbsCos < EdgeAbsCos || (VertexAbsCos == EdgeAbsCos && VertexOrder < EdgeOrder))));
+
+	// the default exit, if no element beat it
+	Vec2 ClosestX = S + MoveDist*Dir;
+	float ClosestXDist = MoveDist;
+	float ClosestLeftRedCos = 1.0f;
+	Vec2 ClosestLeftRedDir = Dir;
+	Vec2 ClosestT = Vec2Set(0.0f, 0.0f);
+	Vec2 ClosestTNormal = Vec2Set(0.0f, 0.0f);
+
+	// an order of -1 means the default exit won
+	if ((UseVertex ? VertexOrder : EdgeOrder) >= 0.0f)
+	{
+		BoundaryElement Element = UseVertex
+			? BoundaryElement::Vertex(XMFLOAT2(Elements.VertexX[VertexSlot], Elements.VertexZ[VertexSlot]))
+			: BoundaryElement::Edge(XMFLOAT2(Elements.EdgeUx[EdgeSlot], Elements.EdgeUz[EdgeSlot]),
+									XMFLOAT2(Elements.EdgeVx[EdgeSlot], Elements.EdgeVz[EdgeSlot]),
+									XMFLOAT2(Elements.EdgeNx[EdgeSlot], Elements.EdgeNz[EdgeSlot]));
+
+		Vec2 X;
+		float XDist;
+		Element.RayPathExit(DiscRadius, S, Dir, &X, &XDist, &ClosestLeftRedCos, &ClosestLeftRedDir, &ClosestT, &ClosestTNormal);
+
+		// an exit exactly at the end of the path only changes the redirect, like in FindFirstExit
+		if (XDist < ClosestXDist)
+		{
+			ClosestX = X;
+			ClosestXDist = XDist;
+		}
+	}
+
+	*XDist_ptr = ClosestXDist;
+	*RedirectRatio_ptr = abs(ClosestLeftRedCos);
+	*RedirectDir_ptr = ((ClosestLeftRedCos>0.0f) ? 1.0f : -1.0f) * ClosestLeftRedDir;
+	*T_ptr = ClosestT;
+	*TNormal_ptr = ClosestTNormal;
+	return ClosestX;
+}
+
+
+
+
+void Room::PortalRelocate(XMFLOAT3 S, XMFLOAT3 Dir, Portal &ThisPortal, const PortalSet &Portals)const
 {
 	// find out where this ray first intersects the room
-	bool WallIntersect;
+	bool WallIntersect = false;
 
 	float XDist = std::numeric_limits<float>::infinity();	// X = S+t*Dir
 	XMFLOAT3 X;
@@ -578,18 +1355,27 @@ void Room::PortalRelocate(XMFLOAT3 S, XMFLOAT3 Dir, Portal &ThisPortal, const Po
 		XMFLOAT2 StartXZ = XMFLOAT2(S.x, S.z);
 		XMFLOAT2 DirXZ = XMFLOAT2(Dir.x, Dir.z);
 
-		// find intersection between ray and walls, possibly ceiling/floor
+		// find intersection between ray and walls, possibly ceiling/floor.  the edges are visited cell by cell
+		// along the ray, until the next cell starts past the closest X so far.  a tie goes to the floor/ceiling,
+		// or to the edge that comes first in WallEdges, the same as when every edge was tested in order
+		const UINT NoEdge = (UINT)-1;
+		UINT XEdge = NoEdge;
 		float t;
-		for (unsigned int PolygonIndex=0; PolygonIndex<BoundaryPolygons.size(); ++PolygonIndex)
+		float CellEnterT;
+		const UINT *CellEdges;
+		UINT CellEdgeCount;
+		EdgeGrid::RayWalk Walk(WallEdgeGrid, StartXZ, DirXZ);
+		while (Walk.Next(&CellEnterT, &CellEdges, &CellEdgeCount) && CellEnterT <= XDist)
 		{
-			const std::vector<XMFLOAT2> &Vertices = BoundaryPolygons[PolygonIndex];
-			for (unsigned int i=0; i<Vertices.size(); ++i)
+			for (UINT k=0; k<CellEdgeCount; ++k)
 			{
 				// NOTE: DirXZ is not normalized
 
 				// get vertices of this edge: UV
-				XMFLOAT2 U = Vertices[i];
-				XMFLOAT2 V = (i==Vertices.size()-1) ? Vertices[0] : Vertices[i+1];
+				UINT i = CellEdges[k];
+				const WallEdge &Edge = WallEdges[i];
+				XMFLOAT2 U = Edge.U;
+				XMFLOAT2 V = Edge.V;
 
 				// intersect the ray with this edge
 				float DirCrossSU = XMFloat2Cross(DirXZ, U-StartXZ);
@@ -602,27 +1388,32 @@ void Room::PortalRelocate(XMFLOAT3 S, XMFLOAT3 Dir, Portal &ThisPortal, const Po
 				// see if this edge results in a closer X
 				// X = S+t*Dir = U+u*UV.
 				t = XMFloat2Cross(U-StartXZ, UV) / XMFloat2Cross(DirXZ, UV);
-				if (t < 0.0f || t >= XDist)
+				if (t < 0.0f || t > XDist || (t == XDist && (XEdge == NoEdge || i >= XEdge)))
 					continue;
 
 				// replace current candidate for X
-				
+			
 				// use A+u*AB to calculate X so it's guaranteed to be on AB even if u is slightly off
 				float u = XMFloat2Cross(U-StartXZ, DirXZ) / XMFloat2Cross(DirXZ, UV);
 				XXZ = U + u*UV;
-				XMFLOAT2 XNormalXZ = XMFloat2Left90(XMFloat2Normalize(UV));
+				XMFLOAT2 XNormalXZ = Edge.Normal;
 
 				XDist = t;
 				X = XMFLOAT3(XXZ.x, S.y + t*Dir.y, XXZ.y);
 				XNormal = XMFLOAT3(XNormalXZ.x, 0.0f, XNormalXZ.y);
 				XWallU = U;
 				XWallV = V;
+				XEdge = i;
 
 				WallIntersect = true;
-			}
-		}//end for each polygon
+			}//end for each edge of this cell
+		}//end for each cell
 	}//end if ray has horizontal component
 
+	// a level ray from outside the room can miss everything
+	if (XDist == std::numeric_limits<float>::infinity())
+		return;
+
 
 	// we now have the location of X. now we need to calculate the radius the portal will have
 	float MaxR = std::numeric_limits<float>::infinity();
@@ -642,48 +1433,34 @@ void Room::PortalRelocate(XMFLOAT3 S, XMFLOAT3 Dir, Portal &ThisPortal, const Po
 	}
 	else
 	{
-		// check distance of X from all polygon edges
-		float d;
-		for (unsigned int PolygonIndex=0; PolygonIndex<BoundaryPolygons.size(); ++PolygonIndex)
-		{
-			const std::vector<XMFLOAT2> &Vertices = BoundaryPolygons[PolygonIndex];
-			for (unsigned int i=0; i<Vertices.size(); ++i)
-			{
-				// get vertices of this edge: UV
-				XMFLOAT2 U = Vertices[i];
-				XMFLOAT2 V = (i==Vertices.size()-1) ? Vertices[0] : Vertices[i+1];
-
-				XMFLOAT2 UV = V-U;
-
-				// check if X is within bounds of UV
-				if (XMFloat2Dot(XXZ-U, UV) < 0.0f)	// X is beyond U
-					d = XMFloat2Length(XXZ-U);
-				else if (XMFloat2Dot(XXZ-V, UV) > 0.0f)	// X is beyond V
-					d = XMFloat2Length(XXZ-V);
-				else
-					d = abs(XMFloat2Cross(XMFloat2Normalize(UV), XXZ-U));
-
-				if (d < MaxR)
-					MaxR = d;
-			}
-		}// end for each polygon
+		// check distance of X from the nearest polygon edge
+		MaxR = DistanceToWalls(XXZ);
 	}
 
-	// check distance of X away from the other portal, if they will be on the same plane
-	if (XNormal==OtherPortal.GetNormal())
+	// check distance of X away from the other portals, if they will be on the same plane.
+	// only portals whose rings could be closer than MaxR need to be looked at
+	Portals.FindPortalsNear(X, MaxR, NearbyPortals);
+	for (unsigned int i=0; i<NearbyPortals.size(); ++i)
 	{
-		XMFLOAT3 XToOther = OtherPortal.GetPosition() - X;
-		if (abs(XMFloat3Dot(XToOther, XNormal)) < PORTALS_SAME_PLANE_THRESHOLD)
-		{
-			float PortalsDist = XMFloat3Length(XToOther);
-			// if X is inside the other portal, don't do anything
-			if (PortalsDist < OtherPortal.GetTextureRadius())
-				return;
+		const Portal &OtherPortal = Portals.GetPortal(NearbyPortals[i]);
+		if (&OtherPortal == &ThisPortal)
+			continue;
 
-			// check distance between X and the ring of the otherportal
-			float d;
-			if ((d=PortalsDist-OtherPortal.GetTextureRadius()) < MaxR)
-				MaxR = d;
+		if (XNormal==OtherPortal.GetNormal())
+		{
+			XMFLOAT3 XToOther = OtherPortal.GetPosition() - X;
+			if (abs(XMFloat3Dot(XToOther, XNormal)) < PORTALS_SAME_PLANE_THRESHOLD)
+			{
+				float PortalsDist = XMFloat3Length(XToOther);
+				// if X is inside the other portal, don't do anything
+				if (PortalsDist < OtherPortal.GetTextureRadius())
+					return;
+
+				// check distance between X and the ring of the otherportal
+				float d;
+				if ((d=PortalsDist-OtherPortal.GetTextureRadius()) < MaxR)
+					MaxR = d;
+			}
 		}
 	}
 
@@ -707,6 +1484,38 @@ void Room::PortalRelocate(XMFLOAT3 S, XMFLOAT3 Dir, Portal &ThisPortal, const Po
 	ThisPortal.SetMaxTextureRadius(MaxR);
 }
 
+float Room::DistanceToWalls(XMFLOAT2 P)const
+{
+	if (WallEdges.empty())
+		return std::numeric_limits<float>::infinity();
+
+	// the nearest edge has a point within MaxR of P, so it's among the edges the grid finds there
+	float MaxR = DistanceToEdge(WallEdges[WallEdgeGrid.NearbyEdge(P)], P);
+	WallEdgeGrid.GatherEdges(P, MaxR, CandidateEdges);
+
+	float Dist = MaxR;
+	float d;
+	for (unsigned int k=0; k<CandidateEdges.size(); ++k)
+	{
+		if ((d=DistanceToEdge(WallEdges[CandidateEdges[k]], P)) < Dist)
+			Dist = d;
+	}
+	return Dist;
+}
+
+float Room::DistanceToEdge(const WallEdge &Edge, XMFLOAT2 P)
+{
+	XMFLOAT2 UV = Edge.V-Edge.U;
+
+	// check if P is within bounds of UV
+	if (Edge.Length == 0.0f || XMFloat2Dot(P-Edge.U, UV) < 0.0f)	// P is beyond U
+		return XMFloat2Length(P-Edge.U);
+	else if (XMFloat2Dot(P-Edge.V, UV) > 0.0f)	// P is beyond V
+		return XMFloat2Length(P-Edge.V);
+	else
+		return abs(XMFloat2Cross(Edge.Dir, P-Edge.U));
+}
+
 
 
 void Room::BuildMeshData(GeometryGenerator::MeshData &RoomMesh, 
@@ -721,60 +1530,57 @@ void Room::BuildMeshData(GeometryGenerator::MeshData &RoomMesh,
 	UINT WallsVertexCount = 0;
 	UINT WallsIndexCount = 0;
 	GeometryGenerator::Vertex Vert;
-	for (unsigned int P=0; P<BoundaryPolygons.size(); ++P)
+	for (unsigned int i=0; i<WallEdges.size(); ++i)
 	{
-		const std::vector<XMFLOAT2> &PolygonVertices = BoundaryPolygons[P];
-		for (unsigned int i=0; i<PolygonVertices.size(); ++i)
-		{
-			// get this vertex and the next one
-			XMFLOAT2 U = PolygonVertices[i];
-			XMFLOAT2 V = PolygonVertices[i==PolygonVertices.size()-1 ? 0 : i+1];
-			XMFLOAT2 UVDir = XMFloat2Normalize(V-U);
-			XMFLOAT2 UVNormal = XMFloat2Left90(UVDir);
-			float WallWidth = XMFloat2Length(V-U);
-			float WallHeight = CeilingY - FloorY;
-
-			Vert.Normal = XMFLOAT3(UVNormal.x, 0.0f, UVNormal.y);
-			Vert.Tangent = XMFLOAT3(UVDir.x, 0.0f, UVDir.y);
-			
-			// vertices are added in CW order, starting from bottom left
-			// textures are tiled to 1x1 squares on the wall
-
-			// bottom left
-			Vert.Position = XMFLOAT3(V.x, FloorY, V.y);
-			Vert.TexCoord = XMFLOAT2(0.0f, WallHeight);
-			RoomMesh.Vertices.push_back(Vert);
-
-			// top left
-			Vert.Position = XMFLOAT3(V.x, CeilingY, V.y);
-			Vert.TexCoord = XMFLOAT2(0.0f, 0.0f);
-			RoomMesh.Vertices.push_back(Vert);
-			
-			// top right
-			Vert.Position = XMFLOAT3(U.x, CeilingY, U.y);
-			Vert.TexCoord = XMFLOAT2(WallWidth, 0.0f);
-			RoomMesh.Vertices.push_back(Vert);
-
-			// bottom right
-			Vert.Position = XMFLOAT3(U.x, FloorY, U.y);
-			Vert.TexCoord = XMFLOAT2(WallWidth, WallHeight);
-			RoomMesh.Vertices.push_back(Vert);
-
-
-			// add to indices
-
-			// upper left triangle
-			RoomMesh.Indices.push_back(WallsVertexCount);
-			RoomMesh.Indices.push_back(WallsVertexCount + 1);
-			RoomMesh.Indices.push_back(WallsVertexCount + 2);
-			// bottom right triangle
-			RoomMesh.Indices.push_back(WallsVertexCount);
-			RoomMesh.Indices.push_back(WallsVertexCount + 2);
-			RoomMesh.Indices.push_back(WallsVertexCount + 3);
-
-			WallsVertexCount += 4;
-			WallsIndexCount += 6; 
-		}
+		// get this vertex and the next one
+		const WallEdge &Edge = WallEdges[i];
+		XMFLOAT2 U = Edge.U;
+		XMFLOAT2 V = Edge.V;
+		XMFLOAT2 UVDir = Edge.Dir;
+		XMFLOAT2 UVNormal = Edge.Normal;
+		float WallWidth = Edge.Length;
+		float WallHeight = CeilingY - FloorY;
+
+		Vert.Normal = XMFLOAT3(UVNormal.x, 0.0f, UVNormal.y);
+		Vert.Tangent = XMFLOAT3(UVDir.x, 0.0f, UVDir.y);
+		
+		// vertices are added in CW order, starting from bottom left
+		// textures are tiled to 1x1 squares on the wall
+
+		// bottom left
+		Vert.Position = XMFLOAT3(V.x, FloorY, V.y);
+		Vert.TexCoord = XMFLOAT2(0.0f, WallHeight);
+		RoomMesh.Vertices.push_back(Vert);
+
+		// top left
+		Vert.Position = XMFLOAT3(V.x, CeilingY, V.y);
+		Vert.TexCoord = XMFLOAT2(0.0f, 0.0f);
+		RoomMesh.Vertices.push_back(Vert);
+		
+		// top right
+		Vert.Position = XMFLOAT3(U.x, CeilingY, U.y);
+		Vert.TexCoord = XMFLOAT2(WallWidth, 0.0f);
+		RoomMesh.Vertices.push_back(Vert);
+
+		// bottom right
+		Vert.Position = XMFLOAT3(U.x, FloorY, U.y);
+		Vert.TexCoord = XMFLOAT2(WallWidth, WallHeight);
+		RoomMesh.Vertices.push_back(Vert);
+
+
+		// add to indices
+
+		// upper left triangle
+		RoomMesh.Indices.push_back(WallsVertexCount);
+		RoomMesh.Indices.push_back(WallsVertexCount + 1);
+		RoomMesh.Indices.push_back(WallsVertexCount + 2);
+		// bottom right triangle
+		RoomMesh.Indices.push_back(WallsVertexCount);
+		RoomMesh.Indices.push_back(WallsVertexCount + 2);
+		RoomMesh.Indices.push_back(WallsVertexCount + 3);
+
+		WallsVertexCount += 4;
+		WallsIndexCount += 6; 
 	}
 	*WallsIndexCount_ptr = WallsIndexCount;
 	*WallsIBOffset_ptr = 0;
@@ -859,4 +1665,50 @@ void Room::BuildMeshData(GeometryGenerator::MeshData &RoomMesh,
 	RoomMesh.Indices.push_back(0);
 	RoomMesh.Indices.push_back(1);
 	RoomMesh.Indices.push_back(2);
+}
+
+void Room::CullWalls(const XMFLOAT4 *Planes, UINT PlaneCount, std::vector<IndexRange> &VisibleWallRanges)const
+{
+	const UINT WALL_INDEX_COUNT = 6;	// see BuildMeshData
+
+	IndexRange Range;
+	Range.Start = 0;
+	Range.Count = 0;
+	for (UINT i=0; i<WallEdges.size(); ++i)
+	{
+		// a wall is hidden if all 4 of its corners are outside the same plane.  the y term is
+		// maximized separately since the corners share the same two heights
+		bool Visible = true;
+		for (UINT p=0; p<PlaneCount; ++p)
+		{
+			const XMFLOAT4 &P = Planes[p];
+			float MaxU = P.x*WallEdgeArrays.Ux[i] + P.z*WallEdgeArrays.Uz[i];
+			float MaxV = P.x*WallEdgeArrays.Vx[i] + P.z*WallEdgeArrays.Vz[i];
+			float MaxY = max(P.y*FloorY, P.y*CeilingY);
+			if (max(MaxU, MaxV) + MaxY + P.w < 0.0f)
+			{
+				Visible = false;
+				break;
+			}
+		}
+		
+		if (!Visible)
+			continue;
+
+		// extend the current range, or start a new one
+		UINT Start = i * WALL_INDEX_COUNT;
+		if (Range.Count > 0 && Range.Start + Range.Count == Start)
+		{
+			Range.Count += WALL_INDEX_COUNT;
+		}
+		else
+		{
+			if (Range.Count > 0)
+				VisibleWallRanges.push_back(Range);
+			Range.Start = Start;
+			Range.Count = WALL_INDEX_COUNT;
+		}
+	}
+	if (Range.Count > 0)
+		VisibleWallRanges.push_back(Range);
 }
\ No newline at end of file
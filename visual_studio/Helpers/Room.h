@@ -6,77 +6,253 @@
 #include <vector>
 #include <limits>
 #include "MathFunctions.h"
+#include "SimdMath.h"
 #include "GeometryGenerator.h"
 #include "Portal.h"
+#include "PortalSet.h"
+
+class RoomBinary;
 
 class Room
 {
+	// reads and writes the room's precomputed edge cache, grid and mesh
+	friend class RoomBinary;
+
 private:
+	// an edge UV or a vertex V of a boundary polygon that the disc center can exit through.
+	// stored by value and tagged with its type, so lists of them need no allocations
+	// and no virtual calls
 	class BoundaryElement
 	{
 	public:
-		// must exist so delete can be called on pointers of derived classes
-		// pure destructor, but must have a body
-		virtual ~BoundaryElement() {}
-
-		virtual void PrintInfo()const = 0;
-		virtual bool RayPathExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Dir, XMFLOAT2 *X_ptr, float *XDist_ptr,
-									float *LeftRedCos_ptr, XMFLOAT2 *LeftRedDir_ptr, 
-									XMFLOAT2 *T_ptr, XMFLOAT2 *TNormal_ptr)const = 0;
+		static BoundaryElement Edge(const XMFLOAT2 &U, const XMFLOAT2 &V, const XMFLOAT2 &Normal);
+		static BoundaryElement Vertex(const XMFLOAT2 &V);
+
+		void PrintInfo()const;
+		bool RayPathExit(float DiscRadius, const Vec2 &S, const Vec2 &Dir, Vec2 *X_ptr, float *XDist_ptr,
+									float *LeftRedCos_ptr, Vec2 *LeftRedDir_ptr, 
+									Vec2 *T_ptr, Vec2 *TNormal_ptr)const;
+
+	private:
+		bool EdgeRayPathExit(float DiscRadius, const Vec2 &S, const Vec2 &Dir, Vec2 *X_ptr, float *XDist_ptr,
+									float *LeftRedCos_ptr, Vec2 *LeftRedDir_ptr,
+									Vec2 *T_ptr, Vec2 *TNormal_ptr)const;
+		bool VertexRayPathExit(float DiscRadius, const Vec2 &S, const Vec2 &Dir, Vec2 *X_ptr, float *XDist_ptr,
+									float *LeftRedCos_ptr, Vec2 *LeftRedDir_ptr,
+									Vec2 *T_ptr, Vec2 *TNormal_ptr)const;
+
+	private:
+		bool IsEdge;
+		XMFLOAT2 U;			// unused for vertices
+		XMFLOAT2 V;
+		XMFLOAT2 Normal;	// unit left normal of UV, taken from the room's edge cache. unused for vertices
 	};
 
+	// contiguous list of boundary elements.  Clear() keeps the storage, so a list that is
+	// reused across queries stops allocating once it has grown large enough
 	class BoundaryElementsList
 	{
 	public:
 		BoundaryElementsList();
 		~BoundaryElementsList();
 
-		void AddEdge(const XMFLOAT2 &U, const XMFLOAT2 &V);
+		void Clear();
+		void AddEdge(const XMFLOAT2 &U, const XMFLOAT2 &V, const XMFLOAT2 &Normal);
 		void AddVertex(const XMFLOAT2 &V);
-		void Delete(int Index);
-		BoundaryElement* operator[](const int Index)const;
+		const BoundaryElement& operator[](const int Index)const;
 		unsigned int size()const;
 	private:
-		std::vector<BoundaryElement*> ElementPointers;
+		std::vector<BoundaryElement> Elements;
 	};
 
 
-	class BoundaryEdge : public BoundaryElement
+	// structure-of-arrays copy of a BoundaryElementsList for the SSE exit kernel.  edges also
+	// carry their unit left normal.  Order is the position the element would have in the
+	// BoundaryElementsList, used to break ties the same way FindFirstExit does
+	struct BoundaryElementsSoA
+	{
+		BoundaryElementsSoA();
+		void Clear();
+		void AddEdge(const XMFLOAT2 &U, const XMFLOAT2 &V, const XMFLOAT2 &Normal);
+		void AddVertex(const XMFLOAT2 &V);
+
+		unsigned int EdgeCount;
+		unsigned int VertexCount;
+
+		std::vector<float> EdgeUx, EdgeUz, EdgeVx, EdgeVz, EdgeNx, EdgeNz, EdgeOrder;
+		std::vector<float> VertexX, VertexZ, VertexOrder;
+	};
+
+	// the room's wall edges as structure-of-arrays, with each edge's unit left normal
+	struct WallEdgesSoA
+	{
+		std::vector<float> Ux, Uz, Vx, Vz, Nx, Nz;
+	};
+
+
+	// an edge UV of one of the boundary polygons.  U is also the vertex that this edge
+	// starts at, so each polygon vertex is owned by exactly one wall edge.
+	// the derived geometry is calculated once in SetTopography so queries don't redo the sqrts
+	struct WallEdge
 	{
-	private:
 		XMFLOAT2 U;
 		XMFLOAT2 V;
+		XMFLOAT2 Dir;		// unit direction of UV
+		XMFLOAT2 Normal;	// unit left normal of UV, pointing into the room
+		float Length;
+	};
+
+	// uniform grid over the XZ bounds of the room.  each cell lists the wall edges
+	// that pass through it, so collision queries only visit nearby edges
+	class EdgeGrid
+	{
+		friend class RoomBinary;
+
 	public:
-		BoundaryEdge(XMFLOAT2 U, XMFLOAT2 V);
-		~BoundaryEdge();
+		EdgeGrid();
 
-		void PrintInfo()const;
-		bool RayPathExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Dir, XMFLOAT2 *X_ptr, float *XDist_ptr,
-									float *LeftRedCos_ptr, XMFLOAT2 *LeftRedDir_ptr,
-									XMFLOAT2 *T_ptr, XMFLOAT2 *TNormal_ptr)const;
+		void Build(const std::vector<WallEdge> &Edges, float MinX, float MaxX, float MinZ, float MaxZ);
+
+		// finds every edge that has a point inside the square of half-width HalfWidth
+		// centered at Center.  indices are returned in increasing order
+		void GatherEdges(XMFLOAT2 Center, float HalfWidth, std::vector<UINT> &EdgeIndices)const;
+
+		// index of the cell containing P; points outside the grid map to the nearest border cell
+		UINT CellIndex(XMFLOAT2 P)const;
+
+		// an edge that was nearest, or nearly nearest, to the center of P's cell.  its distance from P is
+		// an upper bound on P's distance to the walls that stays close to it
+		UINT NearbyEdge(XMFLOAT2 P)const;
+
+		// steps through the cells the ray S+t*Dir, t >= 0, passes through, in order of t.  a cell the ray
+		// only grazes at a corner may be skipped; the edges near it are kept by the cells on either side
+		class RayWalk
+		{
+		public:
+			RayWalk(const EdgeGrid &Grid, XMFLOAT2 S, XMFLOAT2 Dir);
+
+			// moves to the next cell and returns its edges, in increasing order, and the t where the ray
+			// enters it.  false once the ray has left the grid
+			bool Next(float *EnterT_ptr, const UINT **Edges_ptr, UINT *EdgeCount_ptr);
+
+		private:
+			const EdgeGrid &Grid;
+			XMFLOAT2 S;
+			XMFLOAT2 Dir;
+			int X, Z;
+			int StepX, StepZ;
+			float EnterT;
+			float ExitT;		// where the ray leaves the grid
+			bool Done;
+		};
+
+	private:
+		int CellX(float x)const;
+		int CellZ(float z)const;
+
+	private:
+		float OriginX;
+		float OriginZ;
+		float CellSize;
+		int CellsX;
+		int CellsZ;
+
+		// edges of cell c are CellEdges[CellStart[c]] to CellEdges[CellStart[c+1]-1]
+		std::vector<UINT> CellStart;
+		std::vector<UINT> CellEdges;
+
+		// NearbyEdge of each cell.  a distance field over the grid: the edges are found by seeding each cell
+		// that has edges with its own nearest one, then sweeping the grid forward and back once, trying each
+		// neighbor's edge on the cell's center
+		std::vector<UINT> CellNearestEdge;
+
+		// used to avoid returning an edge twice when it spans several cells
+		mutable std::vector<UINT> EdgeStamps;
+		mutable UINT CurrentStamp;
 	};
-	
-	class BoundaryVertex : public BoundaryElement
+
+
+public:
+	// the wall edges near one mover, gathered from the grid for a square a little larger than one query
+	// needs.  while the mover's next queries fit inside that square they reuse the edges and skip the grid.
+	// each mover needs its own; a query made through a cache gets the same result as one made without
+	class CandidateCache
 	{
-	private:
-		XMFLOAT2 V;
+		friend class Room;
+
 	public:
-		BoundaryVertex(XMFLOAT2 V);
-		~BoundaryVertex();
+		CandidateCache();
 
-		void PrintInfo()const;
-		bool RayPathExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Dir, XMFLOAT2 *X_ptr, float *XDist_ptr,
-									float *LeftRedCos_ptr, XMFLOAT2 *LeftRedDir_ptr,
-									XMFLOAT2 *T_ptr, XMFLOAT2 *TNormal_ptr)const;
+		void Invalidate();
+
+		// queries answered from the cached edges, and queries that had to gather them again
+		void GetCounters(unsigned int *Hits_ptr, unsigned int *Misses_ptr)const;
+		void ResetCounters();
+
+	private:
+		const Room *Owner;
+		unsigned int OwnerVersion;		// Owner's TopographyVersion when the edges were gathered
+		XMFLOAT2 Center;
+		float HalfWidth;
+		std::vector<UINT> Edges;
+
+		unsigned int Hits;
+		unsigned int Misses;
 	};
 
+	// one sphere path for SpherePathCollisionBatch, and what SpherePathCollision returns for it
+	struct SpherePathQuery
+	{
+		XMFLOAT3 S;
+		XMFLOAT3 Dir;
+		float MoveDist;
+		float SphereRadius;
+	};
+	struct SpherePathResult
+	{
+		XMFLOAT3 X;
+		float XDist;
+		float RedirectRatio;
+		XMFLOAT3 RedirectDir;
+		XMFLOAT3 T;
+		XMFLOAT3 TNormal;
+	};
+
+	// a run of indices in the walls part of the mesh from BuildMeshData
+	struct IndexRange
+	{
+		UINT Start;
+		UINT Count;
+	};
+
+	// how SpherePathWallCollision finds where the disc first exits the room: FindFirstExit tests the
+	// boundary elements one at a time, FindFirstExitSSE 4 at a time from a structure-of-arrays copy.
+	// both give the same results
+	enum ExitKernel
+	{
+		EXIT_KERNEL_SCALAR,
+		EXIT_KERNEL_SSE
+	};
 
 public:
 	Room();
 
+	// shared by all rooms.  starts as ROOM_SSE_EXIT_KERNEL picks; only change it while no collisions are running
+	static void SetExitKernel(ExitKernel Kernel);
+	static ExitKernel GetExitKernel();
+
 	void SetFloorAndCeiling(float FloorHeight, float CeilingHeight);
 	void SetTopography(const std::vector<std::vector<XMFLOAT2>> &PhysicalBoundariesVerticesList);
 	void PrintBoundaries();
+
+	float GetFloorY()const;
+	float GetCeilingY()const;
+	const std::vector<std::vector<XMFLOAT2>>& GetBoundaryPolygons()const;
+
+	// how many wall collision queries were made, how many edges the grid gave them, and how many edges
+	// and vertices were close enough to be tested for an exit
+	void GetWallQueryCounters(unsigned int *Queries_ptr, unsigned int *GridEdges_ptr, unsigned int *Elements_ptr)const;
+	void ResetWallQueryCounters();
 	
 	void BuildMeshData(GeometryGenerator::MeshData &RoomMesh, 
 						UINT *WallsIndexCount_ptr, UINT *WallsIBOffset_ptr, UINT *WallsVBOffset_ptr,
@@ -85,43 +261,100 @@ public:
 
 	XMFLOAT3 SpherePathCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist,
 									float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr,
-									XMFLOAT3 *T_ptr, XMFLOAT3 *TNormal_ptr)const;
+									XMFLOAT3 *T_ptr, XMFLOAT3 *TNormal_ptr, CandidateCache *Cache=NULL)const;
+
+	// runs SpherePathCollision for every query.  queries are processed grouped by the grid cell
+	// they start in, and each group's edges are gathered once, for a square that covers all of its
+	// queries, and shared through a CandidateCache; Results[i] is the answer to Queries[i]
+	void SpherePathCollisionBatch(const std::vector<SpherePathQuery> &Queries, std::vector<SpherePathResult> &Results)const;
 
 	XMFLOAT3 SpherePathVirtualCollision(const XMMATRIX &Virtualize, const XMMATRIX &Unvirtualize,
 									float SphereRadius, XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist,
 									float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr)const;
 
 
-	void PortalRelocate(XMFLOAT3 S, XMFLOAT3 Dir, Portal &ThisPortal, const Portal &OtherPortal)const;
+	// appends the index ranges of the walls that aren't entirely outside one of the planes.  a point P
+	// is inside a plane if dot(Plane.xyz, P) + Plane.w >= 0.  adjacent visible walls share one range
+	void CullWalls(const XMFLOAT4 *Planes, UINT PlaneCount, std::vector<IndexRange> &VisibleWallRanges)const;
+
+	// ThisPortal must be one of the portals of Portals.  it is kept away from the rings of all the others
+	void PortalRelocate(XMFLOAT3 S, XMFLOAT3 Dir, Portal &ThisPortal, const PortalSet &Portals)const;
+
+	// XZ distance from P to the nearest wall edge, or infinity if there are no walls.  the grid's
+	// NearbyEdge bounds it, and only the edges within that bound are measured exactly
+	float DistanceToWalls(XMFLOAT2 P)const;
 
 private:
-	XMFLOAT2 FindFirstExit(float DiscRadius, XMFLOAT2 S, XMFLOAT2 Dir, float MoveDist, 
+	static float DistanceToEdge(const WallEdge &Edge, XMFLOAT2 P);
+
+	Vec2 FindFirstExit(float DiscRadius, const Vec2 &S, const Vec2 &Dir, float MoveDist, 
 							const BoundaryElementsList &DiscCenterBoundaryElements,
-							float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT2 *RedirectDir_ptr,
-							XMFLOAT2 *T_ptr, XMFLOAT2 *TNormal_ptr)const;
+							float *XDist_ptr, float *RedirectRatio_ptr, Vec2 *RedirectDir_ptr,
+							Vec2 *T_ptr, Vec2 *TNormal_ptr)const;
 
+	// same result as FindFirstExit, but tests 4 boundary elements at a time using SSE
+	Vec2 FindFirstExitSSE(float DiscRadius, const Vec2 &S, const Vec2 &Dir, float MoveDist, 
+							const BoundaryElementsSoA &DiscCenterBoundaryElements,
+							float *XDist_ptr, float *RedirectRatio_ptr, Vec2 *RedirectDir_ptr,
+							Vec2 *T_ptr, Vec2 *TNormal_ptr)const;
 
-	XMFLOAT3 SpherePathWallCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist,
-									float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr,
-									XMFLOAT3 *T_ptr, XMFLOAT3 *TNormal_ptr)const;
 
-	XMFLOAT3 SpherePathFloorCeilingCollision(float SphereRadius, XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist,
-									float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr,
-									XMFLOAT3 *T_ptr, XMFLOAT3 *TNormal_ptr)const;
+	// SpherePathCollision, kept in Vec3s from the public version's loads to its stores
+	Vec3 SpherePathCollision(float SphereRadius, const Vec3 &S, const Vec3 &Dir, float MoveDist,
+									float *XDist_ptr, float *RedirectRatio_ptr, Vec3 *RedirectDir_ptr,
+									Vec3 *T_ptr, Vec3 *TNormal_ptr, CandidateCache *Cache)const;
+
+	Vec3 SpherePathWallCollision(float SphereRadius, const Vec3 &S, const Vec3 &Dir, float MoveDist,
+									float *XDist_ptr, float *RedirectRatio_ptr, Vec3 *RedirectDir_ptr,
+									Vec3 *T_ptr, Vec3 *TNormal_ptr, CandidateCache *Cache)const;
+
+	// half-width of the square around S that SpherePathWallCollision needs the edges of
+	static float WallQueryHalfWidth(float SphereRadius, const Vec3 &Dir, float MoveDist);
+
+	// gathers the edges of the square of half-width HalfWidth around Center into Cache
+	void FillCandidateCache(CandidateCache &Cache, XMFLOAT2 Center, float HalfWidth)const;
+
+	Vec3 SpherePathFloorCeilingCollision(float SphereRadius, const Vec3 &S, const Vec3 &Dir, float MoveDist,
+									float *XDist_ptr, float *RedirectRatio_ptr, Vec3 *RedirectDir_ptr,
+									Vec3 *T_ptr, Vec3 *TNormal_ptr)const;
 
 
 private:
+	static ExitKernel Kernel;
+
 	float MinX;
 	float MaxX;
 	float MinZ;
 	float MaxZ;
 	int WallCount;
+	unsigned int TopographyVersion;		// changes whenever the walls do, so CandidateCaches know to regather
 
 	float FloorY;				// height of floor
 	float CeilingY;				// height of ceiling
 	
 	// a vector of vertexlists, each representing a boundary polygon in the room
 	std::vector<std::vector<XMFLOAT2>> BoundaryPolygons;
+
+	// all polygon edges flattened in polygon order, and the grid used to look them up
+	std::vector<WallEdge> WallEdges;
+	EdgeGrid WallEdgeGrid;
+	WallEdgesSoA WallEdgeArrays;
+
+	// scratch lists for SpherePathWallCollision, kept between calls to avoid reallocating
+	mutable std::vector<UINT> CandidateEdges;
+	mutable BoundaryElementsList DiscCenterBoundaryElements;
+	mutable BoundaryElementsSoA DiscCenterBoundaryElementsSoA;
+
+	// (cell, query index) pairs for SpherePathCollisionBatch
+	mutable std::vector<std::pair<UINT, UINT>> BatchOrder;
+	mutable CandidateCache BatchCache;
+
+	// portals near the new location, for PortalRelocate
+	mutable std::vector<UINT> NearbyPortals;
+
+	mutable unsigned int WallQueries;
+	mutable unsigned int WallQueryGridEdges;
+	mutable unsigned int WallQueryElements;
 };
 
 #endif
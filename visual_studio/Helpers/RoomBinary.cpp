@@ -0,0 +1,389 @@
+#include "RoomBinary.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char ROOM_BINARY_MAGIC[4] = { 'P', 'R', 'M', 'B' };
+static const UINT ROOM_BINARY_ALIGNMENT = 16;
+
+// size in bytes of one edge in the wall edges section
+static const UINT ROOM_BINARY_EDGE_SIZE = 9 * sizeof(float);
+
+
+RoomBinary::RoomBinary()
+	: Data(NULL), Size(0)
+#ifdef _WIN32
+	, FileHandle(INVALID_HANDLE_VALUE), MappingHandle(NULL)
+#endif
+{
+}
+
+RoomBinary::~RoomBinary()
+{
+	Close();
+}
+
+bool RoomBinary::IsOpen()const
+{
+	return (Data != NULL);
+}
+
+const RoomBinary::Header& RoomBinary::GetHeader()const
+{
+	return *(const Header*)Data;
+}
+
+const RoomBinary::MeshVertex* RoomBinary::GetMeshVertices()const
+{
+	return Section<MeshVertex>(GetHeader().MeshVerticesOffset);
+}
+
+const UINT* RoomBinary::GetMeshIndices()const
+{
+	return Section<UINT>(GetHeader().MeshIndicesOffset);
+}
+
+bool RoomBinary::IsBinaryPath(const char *Path)
+{
+	size_t Length = strlen(Path);
+	return (Length >= 4 && strcmp(Path + Length - 4, ".bin") == 0);
+}
+
+
+void RoomBinary::Close()
+{
+	if (!Data)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(Data);
+	CloseHandle((HANDLE)MappingHandle);
+	CloseHandle((HANDLE)FileHandle);
+	MappingHandle = NULL;
+	FileHandle = INVALID_HANDLE_VALUE;
+#else
+	munmap((void*)Data, Size);
+#endif
+	Data = NULL;
+	Size = 0;
+}
+
+bool RoomBinary::Open(const char *Path)
+{
+	Close();
+
+	// map the whole file read-only
+#ifdef _WIN32
+	HANDLE File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+	DWORD FileSize = GetFileSize(File, NULL);
+	HANDLE Mapping = (FileSize > 0) ? CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	if (!Mapping)
+	{
+		CloseHandle(File);
+		return false;
+	}
+	const void *View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!View)
+	{
+		CloseHandle(Mapping);
+		CloseHandle(File);
+		return false;
+	}
+	FileHandle = File;
+	MappingHandle = Mapping;
+	Data = (const unsigned char*)View;
+	Size = FileSize;
+#else
+	int fd = open(Path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0)
+	{
+		close(fd);
+		return false;
+	}
+	void *View = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (View == MAP_FAILED)
+		return false;
+	Data = (const unsigned char*)View;
+	Size = (UINT)st.st_size;
+#endif
+
+	// check the header, and that every section lies inside the file
+	const Header &H = *(const Header*)Data;
+	bool Valid = (Size >= sizeof(Header)
+				&& memcmp(H.Magic, ROOM_BINARY_MAGIC, 4) == 0
+				&& H.Version == VERSION
+				&& H.HeaderSize == sizeof(Header)
+				&& H.FileSize == Size);
+
+	// grid dimensions first, since the section sizes depend on them
+	Valid = Valid && H.GridCellsX >= 0 && H.GridCellsZ >= 0
+				&& H.GridCellsX <= ROOM_GRID_MAX_CELLS_PER_AXIS && H.GridCellsZ <= ROOM_GRID_MAX_CELLS_PER_AXIS;
+	if (Valid)
+	{
+		// sizes are worked out in 64 bits, so a huge count can't wrap around to something that fits
+		typedef unsigned long long UINT64;
+		UINT64 GridCells = (UINT64)H.GridCellsX * (UINT64)H.GridCellsZ;
+		struct { UINT Offset; UINT64 Bytes; } Sections[] =
+		{
+			{ H.PolygonStartsOffset, ((UINT64)H.PolygonCount + 1) * sizeof(UINT) },
+			{ H.VerticesOffset, (UINT64)H.VertexCount * sizeof(XMFLOAT2) },
+			{ H.WallEdgesOffset, (UINT64)H.VertexCount * ROOM_BINARY_EDGE_SIZE },
+			{ H.GridCellStartOffset, (GridCells > 0 ? GridCells + 1 : 0) * sizeof(UINT) },
+			{ H.GridCellEdgesOffset, (UINT64)H.GridCellEdgeCount * sizeof(UINT) },
+			{ H.GridCellNearestEdgeOffset, GridCells * sizeof(UINT) },
+			{ H.MeshVerticesOffset, (UINT64)H.MeshVertexCount * sizeof(MeshVertex) },
+			{ H.MeshIndicesOffset, (UINT64)H.MeshIndexCount * sizeof(UINT) }
+		};
+		for (unsigned int i=0; i<sizeof(Sections)/sizeof(Sections[0]) && Valid; ++i)
+		{
+			Valid = (Sections[i].Offset % ROOM_BINARY_ALIGNMENT == 0
+					&& Sections[i].Offset >= sizeof(Header)
+					&& Sections[i].Offset <= Size
+					&& Sections[i].Bytes <= (UINT64)(Size - Sections[i].Offset));
+		}
+
+		// the sub-meshes' index ranges have to lie inside the index section
+		UINT SubMeshes[3][3] =
+		{
+			{ H.WallsIndexCount, H.WallsIBOffset, H.WallsVBOffset },
+			{ H.FloorIndexCount, H.FloorIBOffset, H.FloorVBOffset },
+			{ H.CeilingIndexCount, H.CeilingIBOffset, H.CeilingVBOffset }
+		};
+		for (int i=0; i<3 && Valid; ++i)
+			Valid = ((UINT64)SubMeshes[i][1] + SubMeshes[i][0] <= H.MeshIndexCount);
+
+		// every index has to name a vertex, both on its own and after its sub-mesh's base vertex is added
+		const UINT *Indices = Section<UINT>(H.MeshIndicesOffset);
+		for (UINT i=0; i<H.MeshIndexCount && Valid; ++i)
+			Valid = (Indices[i] < H.MeshVertexCount);
+		for (int i=0; i<3 && Valid; ++i)
+		{
+			for (UINT k=SubMeshes[i][1]; k<SubMeshes[i][1] + SubMeshes[i][0] && Valid; ++k)
+				Valid = ((UINT64)SubMeshes[i][2] + Indices[k] < H.MeshVertexCount);
+		}
+	}
+	if (Valid)
+	{
+		// the polygons have to cover the vertices exactly, since Load splits them up by these
+		const UINT *PolygonStarts = Section<UINT>(H.PolygonStartsOffset);
+		Valid = (PolygonStarts[0] == 0 && PolygonStarts[H.PolygonCount] == H.VertexCount);
+		for (UINT i=0; i<H.PolygonCount && Valid; ++i)
+			Valid = (PolygonStarts[i] <= PolygonStarts[i+1]);
+	}
+	if (Valid && H.GridCellsX * H.GridCellsZ > 0)
+	{
+		// the grid is used without bounds checks, so every cell's edge range has to lie inside
+		// CellEdges, and every edge it names has to exist
+		UINT GridCells = (UINT)(H.GridCellsX * H.GridCellsZ);
+		const UINT *CellStart = Section<UINT>(H.GridCellStartOffset);
+		const UINT *CellEdges = Section<UINT>(H.GridCellEdgesOffset);
+		const UINT *CellNearestEdge = Section<UINT>(H.GridCellNearestEdgeOffset);
+		Valid = (H.GridCellSize > 0.0f && CellStart[0] == 0 && CellStart[GridCells] == H.GridCellEdgeCount);
+		for (UINT i=0; i<GridCells && Valid; ++i)
+			Valid = (CellStart[i] <= CellStart[i+1] && CellNearestEdge[i] < H.VertexCount);
+		for (UINT i=0; i<H.GridCellEdgeCount && Valid; ++i)
+			Valid = (CellEdges[i] < H.VertexCount);
+	}
+
+	if (!Valid)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+
+void RoomBinary::Load(Camera &LeftCamera, FirstPersonObject &Player,
+						Portal &OrangePortal, Portal &BluePortal, Room &Level)const
+{
+	const Header &H = GetHeader();
+
+	LeftCamera.SetPosition(H.LeftCameraPosition);
+	Player.SetBoundingSphereRadius(H.PlayerRadius);
+	Player.SetPosition(H.PlayerPosition);
+
+	const PortalStart *Starts[] = { &H.OrangePortal, &H.BluePortal };
+	Portal *Portals[] = { &OrangePortal, &BluePortal };
+	for (int i=0; i<2; ++i)
+	{
+		Portals[i]->SetIntendedPhysicalRadius(Starts[i]->Radius);
+		Portals[i]->SetPosition(Starts[i]->Position);
+		Portals[i]->SetNormalAndUp(Starts[i]->Normal, Starts[i]->Up);
+	}
+
+	Level.SetFloorAndCeiling(H.FloorY, H.CeilingY);
+
+
+	// the room's topography, copied in blocks instead of rebuilt by SetTopography
+	const UINT *PolygonStarts = Section<UINT>(H.PolygonStartsOffset);
+	const XMFLOAT2 *Vertices = Section<XMFLOAT2>(H.VerticesOffset);
+	Level.BoundaryPolygons.resize(H.PolygonCount);
+	for (UINT i=0; i<H.PolygonCount; ++i)
+		Level.BoundaryPolygons[i].assign(Vertices + PolygonStarts[i], Vertices + PolygonStarts[i+1]);
+
+	Level.MinX = H.MinX;
+	Level.MaxX = H.MaxX;
+	Level.MinZ = H.MinZ;
+	Level.MaxZ = H.MaxZ;
+	Level.WallCount = (int)H.VertexCount;
+
+	const Room::WallEdge *Edges = Section<Room::WallEdge>(H.WallEdgesOffset);
+	Level.WallEdges.assign(Edges, Edges + H.VertexCount);
+
+	Room::WallEdgesSoA &Arrays = Level.WallEdgeArrays;
+	Arrays.Ux.resize(H.VertexCount);
+	Arrays.Uz.resize(H.VertexCount);
+	Arrays.Vx.resize(H.VertexCount);
+	Arrays.Vz.resize(H.VertexCount);
+	Arrays.Nx.resize(H.VertexCount);
+	Arrays.Nz.resize(H.VertexCount);
+	for (UINT i=0; i<H.VertexCount; ++i)
+	{
+		Arrays.Ux[i] = Edges[i].U.x;
+		Arrays.Uz[i] = Edges[i].U.y;
+		Arrays.Vx[i] = Edges[i].V.x;
+		Arrays.Vz[i] = Edges[i].V.y;
+		Arrays.Nx[i] = Edges[i].Normal.x;
+		Arrays.Nz[i] = Edges[i].Normal.y;
+	}
+
+	Room::EdgeGrid &Grid = Level.WallEdgeGrid;
+	Grid.OriginX = H.GridOriginX;
+	Grid.OriginZ = H.GridOriginZ;
+	Grid.CellSize = H.GridCellSize;
+	Grid.CellsX = H.GridCellsX;
+	Grid.CellsZ = H.GridCellsZ;
+	UINT GridCells = (UINT)(H.GridCellsX * H.GridCellsZ);
+	if (GridCells > 0)
+	{
+		const UINT *CellStart = Section<UINT>(H.GridCellStartOffset);
+		const UINT *CellEdges = Section<UINT>(H.GridCellEdgesOffset);
+		const UINT *CellNearestEdge = Section<UINT>(H.GridCellNearestEdgeOffset);
+		Grid.CellStart.assign(CellStart, CellStart + GridCells + 1);
+		Grid.CellEdges.assign(CellEdges, CellEdges + H.GridCellEdgeCount);
+		Grid.CellNearestEdge.assign(CellNearestEdge, CellNearestEdge + GridCells);
+	}
+	else
+	{
+		Grid.CellStart.clear();
+		Grid.CellEdges.clear();
+		Grid.CellNearestEdge.clear();
+	}
+	Grid.EdgeStamps.assign(H.VertexCount, 0);
+	Grid.CurrentStamp = 0;
+
+	++Level.TopographyVersion;
+}
+
+
+// appends Bytes bytes to the file image at the next aligned offset, and returns that offset
+static UINT AppendSection(std::vector<unsigned char> &Image, const void *Source, size_t Bytes)
+{
+	size_t Offset = (Image.size() + ROOM_BINARY_ALIGNMENT - 1) / ROOM_BINARY_ALIGNMENT * ROOM_BINARY_ALIGNMENT;
+	Image.resize(Offset + Bytes, 0);
+	if (Bytes > 0)
+		memcpy(&Image[Offset], Source, Bytes);
+	return (UINT)Offset;
+}
+
+bool RoomBinary::Write(const char *Path, const Camera &LeftCamera, FirstPersonObject &Player,
+						const Portal &OrangePortal, const Portal &BluePortal, const Room &Level)
+{
+	Header H = Header();
+	memcpy(H.Magic, ROOM_BINARY_MAGIC, 4);
+	H.Version = VERSION;
+	H.HeaderSize = sizeof(Header);
+
+	H.LeftCameraPosition = LeftCamera.GetPosition();
+	H.PlayerRadius = Player.GetBoundingSphereRadius();
+	H.PlayerPosition = Player.GetPosition();
+
+	PortalStart *Starts[] = { &H.OrangePortal, &H.BluePortal };
+	const Portal *Portals[] = { &OrangePortal, &BluePortal };
+	for (int i=0; i<2; ++i)
+	{
+		Starts[i]->Radius = Portals[i]->GetIntendedPhysicalRadius();
+		Starts[i]->Position = Portals[i]->GetPosition();
+		Starts[i]->Normal = Portals[i]->GetNormal();
+		Starts[i]->Up = Portals[i]->GetUp();
+	}
+	H.FloorY = Level.FloorY;
+	H.CeilingY = Level.CeilingY;
+
+	H.MinX = Level.MinX;
+	H.MaxX = Level.MaxX;
+	H.MinZ = Level.MinZ;
+	H.MaxZ = Level.MaxZ;
+
+	std::vector<unsigned char> Image(sizeof(Header), 0);
+
+	// polygons, flattened
+	std::vector<UINT> PolygonStarts(1, 0);
+	std::vector<XMFLOAT2> Vertices;
+	for (unsigned int i=0; i<Level.BoundaryPolygons.size(); ++i)
+	{
+		Vertices.insert(Vertices.end(), Level.BoundaryPolygons[i].begin(), Level.BoundaryPolygons[i].end());
+		PolygonStarts.push_back((UINT)Vertices.size());
+	}
+	H.PolygonCount = (UINT)Level.BoundaryPolygons.size();
+	H.VertexCount = (UINT)Vertices.size();
+	H.PolygonStartsOffset = AppendSection(Image, &PolygonStarts[0], PolygonStarts.size() * sizeof(UINT));
+	H.VerticesOffset = AppendSection(Image, Vertices.empty() ? NULL : &Vertices[0], Vertices.size() * sizeof(XMFLOAT2));
+
+	// collision index
+	static_assert(sizeof(Room::WallEdge) == ROOM_BINARY_EDGE_SIZE, "WallEdge no longer matches the file's edge layout");
+	const std::vector<Room::WallEdge> &Edges = Level.WallEdges;
+	H.WallEdgesOffset = AppendSection(Image, Edges.empty() ? NULL : &Edges[0], Edges.size() * ROOM_BINARY_EDGE_SIZE);
+
+	const Room::EdgeGrid &Grid = Level.WallEdgeGrid;
+	H.GridOriginX = Grid.OriginX;
+	H.GridOriginZ = Grid.OriginZ;
+	H.GridCellSize = Grid.CellSize;
+	H.GridCellsX = Grid.CellsX;
+	H.GridCellsZ = Grid.CellsZ;
+	H.GridCellEdgeCount = (UINT)Grid.CellEdges.size();
+	H.GridCellStartOffset = AppendSection(Image, Grid.CellStart.empty() ? NULL : &Grid.CellStart[0],
+											Grid.CellStart.size() * sizeof(UINT));
+	H.GridCellEdgesOffset = AppendSection(Image, Grid.CellEdges.empty() ? NULL : &Grid.CellEdges[0],
+											Grid.CellEdges.size() * sizeof(UINT));
+	H.GridCellNearestEdgeOffset = AppendSection(Image, Grid.CellNearestEdge.empty() ? NULL : &Grid.CellNearestEdge[0],
+											Grid.CellNearestEdge.size() * sizeof(UINT));
+
+	// mesh
+	GeometryGenerator::MeshData Mesh;
+	Level.BuildMeshData(Mesh, &H.WallsIndexCount, &H.WallsIBOffset, &H.WallsVBOffset,
+						&H.FloorIndexCount, &H.FloorIBOffset, &H.FloorVBOffset,
+						&H.CeilingIndexCount, &H.CeilingIBOffset, &H.CeilingVBOffset);
+	std::vector<MeshVertex> MeshVertices(Mesh.Vertices.size());
+	for (unsigned int i=0; i<MeshVertices.size(); ++i)
+	{
+		MeshVertices[i].Position = Mesh.Vertices[i].Position;
+		MeshVertices[i].Normal = Mesh.Vertices[i].Normal;
+		MeshVertices[i].TexCoord = Mesh.Vertices[i].TexCoord;
+	}
+	H.MeshVertexCount = (UINT)MeshVertices.size();
+	H.MeshIndexCount = (UINT)Mesh.Indices.size();
+	H.MeshVerticesOffset = AppendSection(Image, &MeshVertices[0], MeshVertices.size() * sizeof(MeshVertex));
+	H.MeshIndicesOffset = AppendSection(Image, &Mesh.Indices[0], Mesh.Indices.size() * sizeof(UINT));
+
+	H.FileSize = (UINT)Image.size();
+	memcpy(&Image[0], &H, sizeof(H));
+
+	std::ofstream ofs(Path, std::ios::binary);
+	if (!ofs.is_open())
+		return false;
+	ofs.write((const char*)&Image[0], Image.size());
+	return ofs.good();
+}
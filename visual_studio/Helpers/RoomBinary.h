@@ -0,0 +1,127 @@
+#ifndef ROOMBINARY_H
+#define ROOMBINARY_H
+
+#include "d3dUtil.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "Portal.h"
+#include "Room.h"
+
+// a level in the binary .bin format written by portals_roomconv.  it holds the same start state as
+// a room.txt, plus everything Room builds from the polygons in SetTopography and BuildMeshData, so
+// opening one maps the file and loading it is a handful of block copies with nothing to parse or rebuild.
+// all sections are 16-byte aligned and addressed by byte offsets from the start of the file
+class RoomBinary
+{
+public:
+	static const UINT VERSION = 3;
+
+	struct PortalStart
+	{
+		float Radius;
+		XMFLOAT3 Position;
+		XMFLOAT3 Normal;
+		XMFLOAT3 Up;
+	};
+
+	// same layout as Vertex::Basic32, so the mesh can be handed to the vertex buffer as it is
+	struct MeshVertex
+	{
+		XMFLOAT3 Position;
+		XMFLOAT3 Normal;
+		XMFLOAT2 TexCoord;
+	};
+
+	struct Header
+	{
+		char Magic[4];				// "PRMB"
+		UINT Version;
+		UINT HeaderSize;
+		UINT FileSize;
+
+		// start state
+		XMFLOAT3 LeftCameraPosition;
+		float PlayerRadius;
+		XMFLOAT3 PlayerPosition;
+		PortalStart OrangePortal;
+		PortalStart BluePortal;
+		float FloorY;
+		float CeilingY;
+
+		// polygons: polygon i is vertices PolygonStarts[i] to PolygonStarts[i+1]-1
+		float MinX, MaxX, MinZ, MaxZ;
+		UINT PolygonCount;
+		UINT VertexCount;			// also the number of wall edges
+		UINT PolygonStartsOffset;	// PolygonCount+1 UINTs
+		UINT VerticesOffset;		// VertexCount XMFLOAT2s
+
+		// collision index: Room's wall edge cache and edge grid
+		UINT WallEdgesOffset;		// VertexCount edges of 9 floats: U, V, Dir, Normal, Length
+		float GridOriginX;
+		float GridOriginZ;
+		float GridCellSize;
+		int GridCellsX;
+		int GridCellsZ;
+		UINT GridCellEdgeCount;
+		UINT GridCellStartOffset;	// GridCellsX*GridCellsZ+1 UINTs, or none if the grid is empty
+		UINT GridCellEdgesOffset;	// GridCellEdgeCount UINTs
+		UINT GridCellNearestEdgeOffset;	// GridCellsX*GridCellsZ UINTs: the grid's distance field
+
+		// mesh from Room::BuildMeshData
+		UINT MeshVertexCount;
+		UINT MeshIndexCount;
+		UINT MeshVerticesOffset;	// MeshVertexCount MeshVertex
+		UINT MeshIndicesOffset;		// MeshIndexCount UINTs
+		UINT WallsIndexCount, WallsIBOffset, WallsVBOffset;
+		UINT FloorIndexCount, FloorIBOffset, FloorVBOffset;
+		UINT CeilingIndexCount, CeilingIBOffset, CeilingVBOffset;
+	};
+
+public:
+	RoomBinary();
+	~RoomBinary();
+
+	// maps the file and checks its header, its section bounds, and that every index in it (polygon
+	// starts, grid cells, mesh indices) stays inside what it indexes, since Load and the collision code
+	// trust them.  returns false if it can't be mapped or isn't a valid version VERSION level
+	bool Open(const char *Path);
+	void Close();
+	bool IsOpen()const;
+
+	// sets up the level like RoomFile::Load does, from the open file
+	void Load(Camera &LeftCamera, FirstPersonObject &Player,
+				Portal &OrangePortal, Portal &BluePortal, Room &Level)const;
+
+	// the output of Room::BuildMeshData for this level.  the pointers are into the mapped file
+	// and are valid until it is closed
+	const MeshVertex* GetMeshVertices()const;
+	const UINT* GetMeshIndices()const;
+	const Header& GetHeader()const;
+
+	// writes the level as it is now.  Level must have had its topography set
+	static bool Write(const char *Path, const Camera &LeftCamera, FirstPersonObject &Player,
+						const Portal &OrangePortal, const Portal &BluePortal, const Room &Level);
+
+	// true if Path ends in .bin
+	static bool IsBinaryPath(const char *Path);
+
+private:
+	RoomBinary(const RoomBinary&);
+	RoomBinary& operator=(const RoomBinary&);
+
+	template<typename T> const T* Section(UINT Offset)const
+	{
+		return (const T*)(Data + Offset);
+	}
+
+private:
+	const unsigned char *Data;
+	UINT Size;
+
+#ifdef _WIN32
+	void *FileHandle;
+	void *MappingHandle;
+#endif
+};
+
+#endif
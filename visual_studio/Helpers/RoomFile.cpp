@@ -0,0 +1,183 @@
+#include "RoomFile.h"
+#include "RoomBinary.h"
+
+#ifndef _MSC_VER
+#define sscanf_s sscanf
+#endif
+
+bool RoomFile::GetNextDataLine(std::ifstream &ifs, std::string &Line)
+{
+	Line.clear();
+	while (std::getline(ifs, Line))
+	{
+		// find first non-space character.  skip if #
+		size_t StrBegin = Line.find_first_not_of(" \t");
+		if (StrBegin!=std::string::npos && Line[StrBegin]!='#')
+			break;
+	}
+	return (!ifs.eof());
+}
+
+
+bool RoomFile::Load(const char *Path, Camera &LeftCamera, FirstPersonObject &Player,
+					Portal &OrangePortal, Portal &BluePortal, Room &Level)
+{
+	if (RoomBinary::IsBinaryPath(Path))
+	{
+		RoomBinary Binary;
+		if (!Binary.Open(Path))
+			return false;
+		Binary.Load(LeftCamera, Player, OrangePortal, BluePortal, Level);
+		return true;
+	}
+
+	std::ifstream ifs(Path);
+	if (!ifs.is_open())
+		return false;
+
+	std::string Line;
+
+	float a, b, c, d, e, f;
+
+	// left camera start position
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
+	LeftCamera.SetPosition(XMFLOAT3(a, b, c));
+
+	// player 
+	
+	//radius
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f", &a);
+	Player.SetBoundingSphereRadius(a);
+
+	// start position
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
+	Player.SetPosition(XMFLOAT3(a, b, c));
+
+
+	// orange portal 
+	
+	// radius
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f", &a);
+	OrangePortal.SetIntendedPhysicalRadius(a);
+
+	// position
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
+	OrangePortal.SetPosition(XMFLOAT3(a, b, c));
+
+	// normal
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f %f %f", &d, &e, &f);
+	OrangePortal.SetNormalAndUp(XMFLOAT3(a,b,c), XMFLOAT3(d,e,f));
+
+
+	// blue portal 
+	
+	// radius
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f", &a);
+	BluePortal.SetIntendedPhysicalRadius(a);
+
+	// position
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
+	BluePortal.SetPosition(XMFLOAT3(a, b, c));
+
+	// normal
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f %f %f", &d, &e, &f);
+	BluePortal.SetNormalAndUp(XMFLOAT3(a,b,c), XMFLOAT3(d,e,f));
+	
+
+	// floor, ceiling heights
+	GetNextDataLine(ifs, Line);
+	sscanf_s(Line.c_str(), "%f %f", &a, &b);
+	Level.SetFloorAndCeiling(a, b);
+
+
+	// room polygons
+
+	std::vector<std::vector<XMFLOAT2>> PolygonsList;
+	unsigned int Polygons = 0;
+	unsigned int Vertices;
+	while(GetNextDataLine(ifs, Line))
+	{
+		PolygonsList.push_back(std::vector<XMFLOAT2>());
+		
+		// read vertex count for this polygon
+		sscanf_s(Line.c_str(), "%d", &Vertices);
+
+		// resize vertexlist for this polygon
+		PolygonsList[Polygons].resize(Vertices);
+
+		// read vertices for this polygon
+		for (unsigned int i=0; i<Vertices; ++i)
+		{
+			GetNextDataLine(ifs, Line);
+			sscanf_s(Line.c_str(), "%f %f", &a, &b);
+			PolygonsList[Polygons][i] = XMFLOAT2(a, b);
+		}
+		++Polygons;
+	}
+	Level.SetTopography(PolygonsList);
+
+	ifs.close();
+	return true;
+}
+
+
+bool RoomFile::Write(const char *Path, const Camera &LeftCamera, FirstPersonObject &Player,
+					const Portal &OrangePortal, const Portal &BluePortal, const Room &Level)
+{
+	std::ofstream ofs(Path);
+	if (!ofs.is_open())
+		return false;
+
+	// 9 significant digits read back as the same float
+	ofs.precision(9);
+
+	XMFLOAT3 v = LeftCamera.GetPosition();
+	ofs << "# left camera start location\n" << v.x << ' ' << v.y << ' ' << v.z << "\n\n";
+
+	v = Player.GetPosition();
+	ofs << "# player radius, start location\n" << Player.GetBoundingSphereRadius() << '\n'
+		<< v.x << ' ' << v.y << ' ' << v.z << "\n\n";
+
+	const char *Names[] = { "orange", "blue" };
+	const Portal *Portals[] = { &OrangePortal, &BluePortal };
+	for (int i=0; i<2; ++i)
+	{
+		XMFLOAT3 P = Portals[i]->GetPosition();
+		XMFLOAT3 N = Portals[i]->GetNormal();
+		XMFLOAT3 U = Portals[i]->GetUp();
+		ofs << "# " << Names[i] << " portal radius, location, normal, up\n" << Portals[i]->GetIntendedPhysicalRadius() << '\n'
+			<< P.x << ' ' << P.y << ' ' << P.z << '\n'
+			<< N.x << ' ' << N.y << ' ' << N.z << '\n'
+			<< U.x << ' ' << U.y << ' ' << U.z << "\n\n";
+	}
+
+	ofs << "# floor, ceiling\n" << Level.GetFloorY() << ' ' << Level.GetCeilingY() << '\n';
+
+	const std::vector<std::vector<XMFLOAT2>> &Polygons = Level.GetBoundaryPolygons();
+	for (unsigned int i=0; i<Polygons.size(); ++i)
+	{
+		if (i < 2)
+			ofs << (i==0 ? "\n#perimeter\n" : "\n# columns\n");
+		else
+			ofs << '\n';
+		ofs << Polygons[i].size() << '\n';
+		for (unsigned int j=0; j<Polygons[i].size(); ++j)
+			ofs << Polygons[i][j].x << ' ' << Polygons[i][j].y << '\n';
+	}
+
+	ofs.close();
+	return !ofs.fail();
+}
@@ -0,0 +1,28 @@
+#ifndef ROOMFILE_H
+#define ROOMFILE_H
+
+#include "d3dUtil.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "Portal.h"
+#include "Room.h"
+
+// reads a level in the RoomFiles/*/room.txt format: left camera position, player radius and
+// position, orange and blue portal radius/position/normal/up, floor and ceiling heights,
+// then the boundary polygons.  lines starting with # are ignored
+class RoomFile
+{
+public:
+	// returns false if the file can't be opened.  paths ending in .bin are loaded with RoomBinary
+	static bool Load(const char *Path, Camera &LeftCamera, FirstPersonObject &Player,
+					Portal &OrangePortal, Portal &BluePortal, Room &Level);
+
+	// writes the level in the same format.  returns false if the file can't be written
+	static bool Write(const char *Path, const Camera &LeftCamera, FirstPersonObject &Player,
+					const Portal &OrangePortal, const Portal &BluePortal, const Room &Level);
+
+	// reads the next line that isn't blank or a comment.  returns false at the end of the file
+	static bool GetNextDataLine(std::ifstream &ifs, std::string &Line);
+};
+
+#endif
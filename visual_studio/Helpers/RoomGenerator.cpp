@@ -0,0 +1,228 @@
+#include "RoomGenerator.h"
+
+// small xorshift generator, so a seed gives the same level on every platform
+class GeneratorRandom
+{
+public:
+	GeneratorRandom(UINT Seed) : State(Seed * 2654435761u + 1u) {}
+
+	UINT Next()
+	{
+		State ^= State << 13;
+		State ^= State >> 17;
+		State ^= State << 5;
+		return State;
+	}
+
+	// uniform in [0, 1)
+	float Unit()
+	{
+		return (float)(Next() >> 8) / 16777216.0f;
+	}
+
+	float Range(float Lo, float Hi)
+	{
+		return Lo + (Hi - Lo) * Unit();
+	}
+
+private:
+	UINT State;
+};
+
+
+RoomGenerator::Options::Options()
+	: Seed(1), Columns(100), PerimeterVertices(4), PerimeterJitter(0.0f), CellSize(6.0f),
+	ThinWallFraction(0.25f), ThinWallWidth(0.05f), FloorY(0.0f), CeilingY(20.0f),
+	PlayerRadius(1.0f), PortalRadius(3.0f), PortalsOnWalls(false)
+{
+}
+
+
+// a rectangle of half extents HalfX, HalfZ centered at Center and rotated by Angle, with its corners in CW order
+static void AddBox(std::vector<std::vector<XMFLOAT2>> &Polygons, XMFLOAT2 Center, float HalfX, float HalfZ, float Angle)
+{
+	XMFLOAT2 AxisX(cosf(Angle), sinf(Angle));
+	XMFLOAT2 AxisZ = XMFloat2Left90(AxisX);
+
+	Polygons.push_back(std::vector<XMFLOAT2>(4));
+	std::vector<XMFLOAT2> &Box = Polygons.back();
+	Box[0] = Center - HalfX*AxisX + HalfZ*AxisZ;
+	Box[1] = Center + HalfX*AxisX + HalfZ*AxisZ;
+	Box[2] = Center + HalfX*AxisX - HalfZ*AxisZ;
+	Box[3] = Center - HalfX*AxisX - HalfZ*AxisZ;
+}
+
+// portal on the middle of perimeter edge UV, facing into the room
+static RoomGenerator::PortalStart WallPortal(XMFLOAT2 U, XMFLOAT2 V, const RoomGenerator::Options &Opts)
+{
+	XMFLOAT2 Mid = 0.5f*(U + V);
+	XMFLOAT2 Normal = XMFloat2Left90(XMFloat2Normalize(V - U));
+	float Height = Opts.CeilingY - Opts.FloorY;
+
+	RoomGenerator::PortalStart P;
+	P.Radius = min(Opts.PortalRadius, 0.45f*min(XMFloat2Length(V - U), Height));
+	P.Position = XMFLOAT3(Mid.x, Opts.FloorY + 0.5f*Height, Mid.y);
+	P.Normal = XMFLOAT3(Normal.x, 0.0f, Normal.y);
+	P.Up = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	return P;
+}
+
+void RoomGenerator::Generate(const Options &Opts, Level &Out)
+{
+	GeneratorRandom Random(Opts.Seed);
+
+	// enough cells that about half of them are empty, plus the one the player starts in.  an odd count
+	// puts a cell at the center of the room
+	int CellsPerAxis = (int)ceilf(sqrtf(2.0f * Opts.Columns + 1.0f));
+	CellsPerAxis = max(CellsPerAxis | 1, 3);
+	float CellSize = Opts.CellSize;
+	float HalfWidth = 0.5f * CellsPerAxis * CellSize;
+	Out.InteriorHalfWidth = HalfWidth;
+
+	Out.Polygons.clear();
+
+	// perimeter: vertex i is at angle 45 + 360*i/N degrees on the square one cell outside the grid, pushed out by
+	// the jitter.  being star-shaped around the center keeps it simple, and every cell stays inside it
+	UINT PerimeterVertices = max(Opts.PerimeterVertices, 3u);
+	float SquareHalfWidth = HalfWidth + CellSize;
+	Out.Polygons.push_back(std::vector<XMFLOAT2>(PerimeterVertices));
+	for (UINT i=0; i<PerimeterVertices; ++i)
+	{
+		float Angle = 0.25f*PI + 2.0f*PI*i / PerimeterVertices;
+		XMFLOAT2 Dir(cosf(Angle), sinf(Angle));
+		float Radius = SquareHalfWidth / max(fabsf(Dir.x), fabsf(Dir.y));
+		if (Opts.PerimeterJitter > 0.0f)
+			Radius *= 1.0f + Opts.PerimeterJitter * Random.Unit();
+		Out.Polygons[0][i] = Radius * Dir;
+	}
+
+	// pick the column cells, leaving the center one free for the player
+	int CenterCell = (CellsPerAxis/2)*CellsPerAxis + CellsPerAxis/2;
+	std::vector<int> Cells;
+	for (int c=0; c<CellsPerAxis*CellsPerAxis; ++c)
+	{
+		if (c != CenterCell)
+			Cells.push_back(c);
+	}
+	UINT Columns = min(Opts.Columns, (UINT)Cells.size());
+	for (UINT i=0; i<Columns; ++i)
+	{
+		UINT j = i + Random.Next() % (UINT)(Cells.size() - i);
+		std::swap(Cells[i], Cells[j]);
+
+		int x = Cells[i] % CellsPerAxis;
+		int z = Cells[i] / CellsPerAxis;
+		XMFLOAT2 Center(-HalfWidth + (x + 0.5f)*CellSize, -HalfWidth + (z + 0.5f)*CellSize);
+		Center = Center + XMFLOAT2(Random.Range(-0.05f, 0.05f), Random.Range(-0.05f, 0.05f)) * CellSize;
+
+		// both shapes stay within 0.45 cells of the cell's center
+		if (Random.Unit() < Opts.ThinWallFraction)
+		{
+			float HalfLength = Random.Range(0.2f, 0.4f) * CellSize;
+			float HalfThickness = 0.5f * Opts.ThinWallWidth;
+			if (Random.Next() & 1)
+				AddBox(Out.Polygons, Center, HalfLength, HalfThickness, 0.0f);
+			else
+				AddBox(Out.Polygons, Center, HalfThickness, HalfLength, 0.0f);
+		}
+		else
+		{
+			float Half = Random.Range(0.1f, 0.25f) * CellSize;
+			AddBox(Out.Polygons, Center, Half, Random.Range(0.5f, 1.0f) * Half, Random.Range(0.0f, 0.5f*PI));
+		}
+	}
+
+	// the player and the left camera start in the empty center cell
+	Out.FloorY = Opts.FloorY;
+	Out.CeilingY = Opts.CeilingY;
+	Out.PlayerRadius = Opts.PlayerRadius;
+	float StartY = min(Opts.FloorY + 2.0f*Opts.PlayerRadius, 0.5f*(Opts.FloorY + Opts.CeilingY));
+	Out.PlayerPosition = XMFLOAT3(0.25f*CellSize, StartY, 0.0f);
+	Out.LeftCameraPosition = XMFLOAT3(-0.25f*CellSize, StartY, 0.0f);
+
+	// portals on two opposite perimeter edges, or out of the way like the room files have them
+	const std::vector<XMFLOAT2> &Perimeter = Out.Polygons[0];
+	if (Opts.PortalsOnWalls)
+	{
+		UINT k = PerimeterVertices / 2;
+		Out.OrangePortal = WallPortal(Perimeter[0], Perimeter[1], Opts);
+		Out.BluePortal = WallPortal(Perimeter[k], Perimeter[(k + 1) % PerimeterVertices], Opts);
+	}
+	else
+	{
+		Out.OrangePortal.Radius = Opts.PortalRadius;
+		Out.OrangePortal.Position = XMFLOAT3(0.0f, 4000.0f, 0.0f);
+		Out.OrangePortal.Normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
+		Out.OrangePortal.Up = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		Out.BluePortal = Out.OrangePortal;
+		Out.BluePortal.Position = XMFLOAT3(0.0f, 4000.0f, -4.0f*Opts.PortalRadius);
+		Out.BluePortal.Normal = XMFLOAT3(0.0f, 0.0f, 1.0f);
+	}
+}
+
+
+void RoomGenerator::Load(const Level &In, Camera &LeftCamera, FirstPersonObject &Player,
+						Portal &OrangePortal, Portal &BluePortal, Room &Lvl)
+{
+	LeftCamera.SetPosition(In.LeftCameraPosition);
+	Player.SetBoundingSphereRadius(In.PlayerRadius);
+	Player.SetPosition(In.PlayerPosition);
+
+	OrangePortal.SetIntendedPhysicalRadius(In.OrangePortal.Radius);
+	OrangePortal.SetPosition(In.OrangePortal.Position);
+	OrangePortal.SetNormalAndUp(In.OrangePortal.Normal, In.OrangePortal.Up);
+
+	BluePortal.SetIntendedPhysicalRadius(In.BluePortal.Radius);
+	BluePortal.SetPosition(In.BluePortal.Position);
+	BluePortal.SetNormalAndUp(In.BluePortal.Normal, In.BluePortal.Up);
+
+	Lvl.SetFloorAndCeiling(In.FloorY, In.CeilingY);
+	Lvl.SetTopography(In.Polygons);
+}
+
+
+static void WriteFloat3(std::ostream &os, const XMFLOAT3 &v)
+{
+	os << v.x << ' ' << v.y << ' ' << v.z << '\n';
+}
+
+static void WritePortal(std::ostream &os, const char *Name, const RoomGenerator::PortalStart &P)
+{
+	os << "# " << Name << " portal radius, location, normal, up\n" << P.Radius << '\n';
+	WriteFloat3(os, P.Position);
+	WriteFloat3(os, P.Normal);
+	WriteFloat3(os, P.Up);
+	os << '\n';
+}
+
+bool RoomGenerator::Write(const char *Path, const Level &In)
+{
+	std::ofstream ofs(Path);
+	if (!ofs.is_open())
+		return false;
+
+	// 9 significant digits read back as the same float
+	ofs.precision(9);
+
+	ofs << "# left camera start location\n";
+	WriteFloat3(ofs, In.LeftCameraPosition);
+	ofs << "\n# player radius, start location\n" << In.PlayerRadius << '\n';
+	WriteFloat3(ofs, In.PlayerPosition);
+	ofs << '\n';
+	WritePortal(ofs, "orange", In.OrangePortal);
+	WritePortal(ofs, "blue", In.BluePortal);
+	ofs << "# floor, ceiling\n" << In.FloorY << ' ' << In.CeilingY << '\n';
+
+	for (unsigned int i=0; i<In.Polygons.size(); ++i)
+	{
+		if (i < 2)
+			ofs << (i==0 ? "\n#perimeter\n" : "\n# columns\n");
+		else
+			ofs << '\n';
+		ofs << In.Polygons[i].size() << '\n';
+		for (unsigned int j=0; j<In.Polygons[i].size(); ++j)
+			ofs << In.Polygons[i][j].x << ' ' << In.Polygons[i][j].y << '\n';
+	}
+
+	return ofs.good();
+}
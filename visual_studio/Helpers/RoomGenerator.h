@@ -0,0 +1,69 @@
+#ifndef ROOMGENERATOR_H
+#define ROOMGENERATOR_H
+
+#include "d3dUtil.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "Portal.h"
+#include "Room.h"
+
+// makes random levels for stress testing.  the interior is a square grid of cells of CellSize; Columns of them
+// get a column each (a small box, or a thin wall like room.txt's 0.05-unit ones) and the rest stay empty, so
+// the room grows with the column count while its density stays the same.  the perimeter is star-shaped around
+// the grid with PerimeterVertices vertices, pushed out from the bounding square by up to PerimeterJitter
+class RoomGenerator
+{
+public:
+	struct Options
+	{
+		Options();
+
+		UINT Seed;
+		UINT Columns;
+		UINT PerimeterVertices;		// at least 3; 4 with no jitter is the plain square
+		float PerimeterJitter;		// fraction of the square's radius each perimeter vertex may move outward
+		float CellSize;
+		float ThinWallFraction;		// fraction of the columns that are thin walls instead of boxes
+		float ThinWallWidth;
+		float FloorY;
+		float CeilingY;
+		float PlayerRadius;
+		float PortalRadius;
+		bool PortalsOnWalls;		// false puts both portals far above the room, like the shipped room files
+	};
+
+	struct PortalStart
+	{
+		float Radius;
+		XMFLOAT3 Position;
+		XMFLOAT3 Normal;
+		XMFLOAT3 Up;
+	};
+
+	// everything a room.txt holds
+	struct Level
+	{
+		XMFLOAT3 LeftCameraPosition;
+		float PlayerRadius;
+		XMFLOAT3 PlayerPosition;
+		PortalStart OrangePortal;
+		PortalStart BluePortal;
+		float FloorY;
+		float CeilingY;
+		std::vector<std::vector<XMFLOAT2>> Polygons;	// the perimeter (CCW) first, then the columns (CW)
+
+		// half-width of the square around the origin that holds the column cells
+		float InteriorHalfWidth;
+	};
+
+	static void Generate(const Options &Opts, Level &Out);
+
+	// sets up the level like RoomFile::Load does
+	static void Load(const Level &In, Camera &LeftCamera, FirstPersonObject &Player,
+					Portal &OrangePortal, Portal &BluePortal, Room &Lvl);
+
+	// writes the level in the room.txt format.  returns false if the file can't be written
+	static bool Write(const char *Path, const Level &In);
+};
+
+#endif
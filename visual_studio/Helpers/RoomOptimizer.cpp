@@ -0,0 +1,147 @@
+#include "RoomOptimizer.h"
+
+RoomOptimizer::Options::Options()
+	: WeldDistance(0.001f), CollinearTolerance(0.001f), MinArea(0.0f)
+{
+}
+
+
+float RoomOptimizer::SignedArea(const std::vector<XMFLOAT2> &Polygon)
+{
+	float Area = 0.0f;
+	for (unsigned int i=0; i<Polygon.size(); ++i)
+	{
+		const XMFLOAT2 &U = Polygon[i];
+		const XMFLOAT2 &V = Polygon[(i+1) % Polygon.size()];
+		Area += XMFloat2Cross(U, V);
+	}
+	return 0.5f * Area;
+}
+
+
+void RoomOptimizer::Weld(std::vector<XMFLOAT2> &Polygon, float WeldDistance)
+{
+	std::vector<XMFLOAT2> Welded;
+	Welded.reserve(Polygon.size());
+	for (unsigned int i=0; i<Polygon.size(); ++i)
+	{
+		if (Welded.empty() || XMFloat2Length(Polygon[i] - Welded.back()) > WeldDistance)
+			Welded.push_back(Polygon[i]);
+	}
+
+	// the last vertex may also duplicate the first
+	while (Welded.size() > 1 && XMFloat2Length(Welded.back() - Welded[0]) <= WeldDistance)
+		Welded.pop_back();
+
+	Polygon.swap(Welded);
+}
+
+
+bool RoomOptimizer::CanMerge(const std::vector<XMFLOAT2> &Polygon, UINT A, UINT B, float Tolerance)
+{
+	UINT n = Polygon.size();
+	XMFLOAT2 U = Polygon[A];
+	XMFLOAT2 UV = Polygon[B] - U;
+	float LengthSq = XMFloat2LengthSq(UV);
+	if (LengthSq == 0.0f)
+		return false;
+	float Length = sqrtf(LengthSq);
+
+	for (UINT i=(A+1)%n; i!=B; i=(i+1)%n)
+	{
+		XMFLOAT2 UP = Polygon[i] - U;
+
+		// a vertex beyond either end would be the tip of a spike; merging would cut it off
+		float t = XMFloat2Dot(UP, UV) / LengthSq;
+		if (t <= 0.0f || t >= 1.0f)
+			return false;
+		if (fabsf(XMFloat2Cross(UV, UP)) / Length > Tolerance)
+			return false;
+	}
+	return true;
+}
+
+void RoomOptimizer::MergeCollinear(std::vector<XMFLOAT2> &Polygon, float Tolerance)
+{
+	UINT n = Polygon.size();
+	if (n < 3)
+		return;
+
+	// start from a vertex that has to stay.  if there's none, the polygon is flat; it's left for the
+	// area test to drop
+	UINT Start = n;
+	for (UINT i=0; i<n; ++i)
+	{
+		if (!CanMerge(Polygon, (i+n-1)%n, (i+1)%n, Tolerance))
+		{
+			Start = i;
+			break;
+		}
+	}
+	if (Start == n)
+		return;
+
+	// walk around from Start, making each edge reach as far along the chain as it can.  offsets are
+	// counted from Start, so offset n is Start again
+	std::vector<XMFLOAT2> Merged;
+	Merged.push_back(Polygon[Start]);
+	UINT From = 0;
+	while (From < n)
+	{
+		UINT To = From + 1;
+		while (To < n && CanMerge(Polygon, (Start+From)%n, (Start+To+1)%n, Tolerance))
+			++To;
+		if (To < n)
+			Merged.push_back(Polygon[(Start+To)%n]);
+		From = To;
+	}
+
+	Polygon.swap(Merged);
+}
+
+
+void RoomOptimizer::Optimize(std::vector<std::vector<XMFLOAT2>> &Polygons, const Options &Opts, Report *Report_ptr)
+{
+	Report R;
+	memset(&R, 0, sizeof(R));
+	R.PolygonsIn = Polygons.size();
+
+	std::vector<std::vector<XMFLOAT2>> Kept;
+	Kept.reserve(Polygons.size());
+	for (unsigned int i=0; i<Polygons.size(); ++i)
+	{
+		std::vector<XMFLOAT2> &Polygon = Polygons[i];
+		R.VerticesIn += Polygon.size();
+
+		UINT Before = Polygon.size();
+		Weld(Polygon, Opts.WeldDistance);
+		R.WeldedVertices += Before - Polygon.size();
+
+		// merging can't be allowed to turn the polygon inside out
+		float Area = SignedArea(Polygon);
+		std::vector<XMFLOAT2> Merged = Polygon;
+		MergeCollinear(Merged, Opts.CollinearTolerance);
+		float MergedArea = SignedArea(Merged);
+		if (Merged.size() >= 3 && (MergedArea > 0.0f) == (Area > 0.0f))
+		{
+			R.MergedVertices += Polygon.size() - Merged.size();
+			Polygon.swap(Merged);
+		}
+
+		if (Polygon.size() < 2 || fabsf(SignedArea(Polygon)) < Opts.MinArea)
+		{
+			++R.DroppedPolygons;
+			R.DroppedVertices += Polygon.size();
+			continue;
+		}
+
+		R.VerticesOut += Polygon.size();
+		Kept.push_back(std::vector<XMFLOAT2>());
+		Kept.back().swap(Polygon);
+	}
+
+	Polygons.swap(Kept);
+	R.PolygonsOut = Polygons.size();
+	if (Report_ptr)
+		*Report_ptr = R;
+}
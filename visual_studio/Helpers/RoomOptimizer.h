@@ -0,0 +1,53 @@
+#ifndef ROOMOPTIMIZER_H
+#define ROOMOPTIMIZER_H
+
+#include "d3dUtil.h"
+#include "MathFunctions.h"
+#include <vector>
+
+// cleans up boundary polygons before they're given to Room::SetTopography.  within each polygon, vertices
+// closer than WeldDistance to the previous one are welded, and chains of edges that stay within
+// CollinearTolerance of one straight edge are merged into it.  polygons welded down to a single point are
+// dropped, since their zero-length edges have no direction.  every remaining wall is within CollinearTolerance
+// of the original boundary, so collisions against the result agree with the original to within that distance.
+// flat polygons, thin walls and zero-width spikes are kept: they still block movement.  a nonzero MinArea
+// also drops polygons with less area than that, which does change collisions
+class RoomOptimizer
+{
+public:
+	struct Options
+	{
+		Options();
+
+		float WeldDistance;
+		float CollinearTolerance;
+		float MinArea;
+	};
+
+	struct Report
+	{
+		UINT PolygonsIn;
+		UINT PolygonsOut;
+		UINT VerticesIn;
+		UINT VerticesOut;
+		UINT WeldedVertices;		// removed as duplicates of their neighbor
+		UINT MergedVertices;		// removed from the middle of a straight chain
+		UINT DroppedPolygons;
+		UINT DroppedVertices;		// vertices of the dropped polygons, after welding
+	};
+
+	static void Optimize(std::vector<std::vector<XMFLOAT2>> &Polygons, const Options &Opts, Report *Report_ptr);
+
+	// signed area; positive for CCW polygons like the perimeter, negative for CW ones like the columns
+	static float SignedArea(const std::vector<XMFLOAT2> &Polygon);
+
+private:
+	static void Weld(std::vector<XMFLOAT2> &Polygon, float WeldDistance);
+	static void MergeCollinear(std::vector<XMFLOAT2> &Polygon, float Tolerance);
+
+	// true if every vertex strictly between A and B (cyclically) is within Tolerance of segment AB and
+	// projects onto it, so AB can replace them
+	static bool CanMerge(const std::vector<XMFLOAT2> &Polygon, UINT A, UINT B, float Tolerance);
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "SceneInterpolator.h"
+
+SceneInterpolator::SceneInterpolator()
+	: HasSnapshot(false), Aspect(1.0f), PreviousTime(0.0), LatestTime(0.0), Alpha(1.0f)
+{
+}
+
+SceneInterpolator::~SceneInterpolator()
+{
+}
+
+void SceneInterpolator::Push(const SceneSnapshot &Snapshot)
+{
+	// the first snapshot has nothing before it to interpolate from
+	if (HasSnapshot)
+	{
+		PreviousLeftCamera = LatestLeftCamera;
+		PreviousRightCamera = LatestRightCamera;
+		PreviousTime = LatestTime;
+	}
+	else
+	{
+		PreviousLeftCamera = Snapshot.LeftCamera;
+		PreviousRightCamera = Snapshot.RightCamera;
+		PreviousTime = Snapshot.Time;
+		HasSnapshot = true;
+	}
+
+	LatestLeftCamera = Snapshot.LeftCamera;
+	LatestRightCamera = Snapshot.RightCamera;
+	LatestPlayer = Snapshot.Player;
+	LatestTime = Snapshot.Time;
+}
+
+void SceneInterpolator::Interpolate(double Time)
+{
+	Alpha = 1.0f;
+	if (LatestTime > PreviousTime)
+		Alpha = (float)std::min(std::max((Time - PreviousTime) / (LatestTime - PreviousTime), 0.0), 1.0);
+
+	LeftCamera.Interpolate(PreviousLeftCamera, LatestLeftCamera, Alpha);
+	RightCamera.Interpolate(PreviousRightCamera, LatestRightCamera, Alpha);
+	LeftCamera.SetAspect(Aspect);
+	RightCamera.SetAspect(Aspect);
+
+	// the player follows the right camera, like it does in the simulation
+	Player = LatestPlayer;
+	Player.SetPosition(RightCamera.GetPosition());
+	Player.SetOrientation(RightCamera.GetRight(), RightCamera.GetUp(), RightCamera.GetLook());
+	RightCamera.AttachToObject(&Player);
+}
+
+void SceneInterpolator::SetAspect(float Aspect)
+{
+	this->Aspect = Aspect;
+}
+
+const Camera& SceneInterpolator::GetLeftCamera()const
+{
+	return LeftCamera;
+}
+
+const Camera& SceneInterpolator::GetRightCamera()const
+{
+	return RightCamera;
+}
+
+FirstPersonObject& SceneInterpolator::GetPlayer()
+{
+	return Player;
+}
+
+float SceneInterpolator::GetAlpha()const
+{
+	return Alpha;
+}
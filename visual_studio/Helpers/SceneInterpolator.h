@@ -0,0 +1,56 @@
+#ifndef SCENEINTERPOLATOR_H
+#define SCENEINTERPOLATOR_H
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "SceneSnapshot.h"
+
+// the render thread's side of the simulation's snapshots.  keeps the cameras of the last two snapshots it was
+// given, and places the cameras and the player between them for the time being drawn, so motion stays smooth
+// when frames don't line up with simulation ticks.  the portals aren't interpolated; they're drawn from the
+// latest snapshot
+class SceneInterpolator
+{
+public:
+	SceneInterpolator();
+	~SceneInterpolator();
+
+	// a newer snapshot the render thread just acquired
+	void Push(const SceneSnapshot &Snapshot);
+
+	// cameras and player at Time, which is clamped to between the last two snapshots' times
+	void Interpolate(double Time);
+
+	// the render cameras' aspect, which the simulation doesn't know about
+	void SetAspect(float Aspect);
+
+	const Camera& GetLeftCamera()const;
+	const Camera& GetRightCamera()const;
+	FirstPersonObject& GetPlayer();
+
+	// how far between the last two snapshots the last Interpolate was, from 0 to 1
+	float GetAlpha()const;
+
+private:
+	bool HasSnapshot;
+	float Aspect;
+
+	Camera PreviousLeftCamera;
+	Camera PreviousRightCamera;
+	double PreviousTime;
+
+	Camera LatestLeftCamera;
+	Camera LatestRightCamera;
+	FirstPersonObject LatestPlayer;
+	double LatestTime;
+
+	// the results, with RightCamera attached to Player
+	Camera LeftCamera;
+	Camera RightCamera;
+	FirstPersonObject Player;
+	float Alpha;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#include "SceneSnapshot.h"
+
+SceneSnapshot::SceneSnapshot()
+	: Tick(0), Time(0.0), Portals(OrangePortal, BluePortal),
+	PlayerIntersectOrangePortal(false), PlayerIntersectBluePortal(false),
+	OrangeSourceVersion(0), BlueSourceVersion(0)
+{
+}
+
+void SceneSnapshot::Capture(unsigned int Tick, double Time, const Camera &LeftCamera, const Camera &RightCamera,
+				const FirstPersonObject &Player, const Portal &OrangePortal, const Portal &BluePortal,
+				bool PlayerIntersectOrangePortal, bool PlayerIntersectBluePortal)
+{
+	this->Tick = Tick;
+	this->Time = Time;
+
+	this->LeftCamera = LeftCamera;
+	this->LeftCamera.DetachFromObject();
+	this->RightCamera = RightCamera;
+	this->RightCamera.DetachFromObject();
+	this->Player = Player;
+
+	if (OrangePortal.GetVersion() != OrangeSourceVersion)
+	{
+		this->OrangePortal = OrangePortal;
+		OrangeSourceVersion = OrangePortal.GetVersion();
+	}
+	if (BluePortal.GetVersion() != BlueSourceVersion)
+	{
+		this->BluePortal = BluePortal;
+		BlueSourceVersion = BluePortal.GetVersion();
+	}
+
+	// build the matrices here, so the render thread doesn't have to
+	Portals.GetVirtualize(this->OrangePortal);
+
+	this->PlayerIntersectOrangePortal = PlayerIntersectOrangePortal;
+	this->PlayerIntersectBluePortal = PlayerIntersectBluePortal;
+}
@@ -0,0 +1,47 @@
+#ifndef SCENESNAPSHOT_H
+#define SCENESNAPSHOT_H
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Camera.h"
+#include "FirstPersonObject.h"
+#include "Portal.h"
+#include "PortalPair.h"
+
+// everything the renderer needs from one simulation tick.  the simulation thread captures one into the write
+// slot of a TripleBuffer<SceneSnapshot> after every tick, and the render thread reads the latest one without
+// ever seeing it change.  it's updated in place (Portals points at its own portals), so it isn't copyable
+struct SceneSnapshot
+{
+	unsigned int Tick;
+	double Time;			// simulation time, in seconds, this state is from
+
+	Camera LeftCamera;		// both detached
+	Camera RightCamera;
+	FirstPersonObject Player;
+
+	Portal OrangePortal;
+	Portal BluePortal;
+	PortalPair Portals;		// OrangePortal and BluePortal, with their virtualization matrices already built
+
+	bool PlayerIntersectOrangePortal;
+	bool PlayerIntersectBluePortal;
+
+	SceneSnapshot();
+
+	// the portals are only copied if they've changed since they were last captured into this snapshot, so
+	// the matrices cached in Portals stay valid otherwise
+	void Capture(unsigned int Tick, double Time, const Camera &LeftCamera, const Camera &RightCamera,
+				const FirstPersonObject &Player, const Portal &OrangePortal, const Portal &BluePortal,
+				bool PlayerIntersectOrangePortal, bool PlayerIntersectBluePortal);
+
+private:
+	// versions of the simulation's portals when they were last copied
+	unsigned int OrangeSourceVersion;
+	unsigned int BlueSourceVersion;
+
+	SceneSnapshot(const SceneSnapshot&);
+	SceneSnapshot& operator=(const SceneSnapshot&);
+};
+
+#endif
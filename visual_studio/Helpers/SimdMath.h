@@ -0,0 +1,330 @@
+#ifndef SIMDMATH_H
+#define SIMDMATH_H
+
+// 16-byte aligned vector and matrix types for the collision code, so whole routines can work in
+// registers and only load/store XMFLOATs at their ends.  SSE2 when the compiler targets it (and
+// SIMD_MATH_SSE is set), AVX for Mat4Multiply when it targets AVX2, plain C++ otherwise.
+//
+// every function does the same float operations in the same order as its XMFloat counterpart in
+// MathFunctions.h (dots sum x, y, then z; transforms add row 2, 3, 1, then 0), so results are
+// the same bit for bit whichever version is built.
+//
+// Vec2 keeps its unused lanes, and Vec3 its w, at 0.  pass them by const reference: 32-bit MSVC
+// can't pass aligned types by value.  XMFLOAT pairs are loaded thru __m64, not double, which
+// GCC would let reorder around the float stores of the same XMFLOAT
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include <math.h>
+
+#if SIMD_MATH_SSE && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SIMD_MATH_SSE2 1
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define SIMD_MATH_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#define SIMD_MATH_ALIGN16 __declspec(align(16))
+#else
+#define SIMD_MATH_ALIGN16 __attribute__((aligned(16)))
+#endif
+
+
+#if SIMD_MATH_SSE2
+
+struct Vec2 { __m128 v; };
+struct Vec3 { __m128 v; };
+struct Mat4 { __m128 r[4]; };
+
+#define SIMD_MATH_SHUFFLE(V, x, y, z, w) _mm_shuffle_ps((V), (V), _MM_SHUFFLE(w, z, y, x))
+
+
+// VEC2
+
+inline Vec2 Vec2Set(float x, float y) { Vec2 R = { _mm_setr_ps(x, y, 0.0f, 0.0f) }; return R; }
+inline Vec2 Vec2Load(const XMFLOAT2 &v) { Vec2 R = { _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&v) }; return R; }
+inline XMFLOAT2 Vec2Store(const Vec2 &v) { XMFLOAT2 R; _mm_storel_pi((__m64*)&R, v.v); return R; }
+inline float Vec2GetX(const Vec2 &v) { return _mm_cvtss_f32(v.v); }
+inline float Vec2GetY(const Vec2 &v) { return _mm_cvtss_f32(SIMD_MATH_SHUFFLE(v.v, 1, 1, 1, 1)); }
+
+inline Vec2 operator+(const Vec2 &lhs, const Vec2 &rhs) { Vec2 R = { _mm_add_ps(lhs.v, rhs.v) }; return R; }
+inline Vec2 operator-(const Vec2 &lhs, const Vec2 &rhs) { Vec2 R = { _mm_sub_ps(lhs.v, rhs.v) }; return R; }
+inline Vec2 operator-(const Vec2 &rhs) { Vec2 R = { _mm_xor_ps(rhs.v, _mm_setr_ps(-0.0f, -0.0f, 0.0f, 0.0f)) }; return R; }
+inline Vec2 operator*(float lhs, const Vec2 &rhs) { Vec2 R = { _mm_mul_ps(_mm_set1_ps(lhs), rhs.v) }; return R; }
+inline Vec2 operator*(const Vec2 &lhs, float rhs) { Vec2 R = { _mm_mul_ps(lhs.v, _mm_set1_ps(rhs)) }; return R; }
+inline Vec2 operator/(const Vec2 &lhs, float rhs) { Vec2 R = { _mm_div_ps(lhs.v, _mm_setr_ps(rhs, rhs, 1.0f, 1.0f)) }; return R; }
+inline bool operator==(const Vec2 &lhs, const Vec2 &rhs) { return (_mm_movemask_ps(_mm_cmpeq_ps(lhs.v, rhs.v)) & 3) == 3; }
+inline bool operator!=(const Vec2 &lhs, const Vec2 &rhs) { return !(lhs == rhs); }
+
+inline float Vec2Dot(const Vec2 &lhs, const Vec2 &rhs)
+{
+	__m128 P = _mm_mul_ps(lhs.v, rhs.v);
+	return _mm_cvtss_f32(_mm_add_ss(P, SIMD_MATH_SHUFFLE(P, 1, 1, 1, 1)));
+}
+
+inline float Vec2Cross(const Vec2 &lhs, const Vec2 &rhs)
+{
+	// (lhs.x*rhs.y, lhs.y*rhs.x)
+	__m128 P = _mm_mul_ps(lhs.v, SIMD_MATH_SHUFFLE(rhs.v, 1, 0, 2, 3));
+	return _mm_cvtss_f32(_mm_sub_ss(P, SIMD_MATH_SHUFFLE(P, 1, 1, 1, 1)));
+}
+
+inline float Vec2LengthSq(const Vec2 &v) { return Vec2Dot(v, v); }
+inline float Vec2Length(const Vec2 &v) { return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(Vec2Dot(v, v)))); }
+inline Vec2 Vec2Normalize(const Vec2 &v) { return v / Vec2Length(v); }
+
+inline Vec2 Vec2Left90(const Vec2 &v)
+{
+	Vec2 R = { _mm_xor_ps(SIMD_MATH_SHUFFLE(v.v, 1, 0, 2, 3), _mm_setr_ps(-0.0f, 0.0f, 0.0f, 0.0f)) };
+	return R;
+}
+inline Vec2 Vec2Right90(const Vec2 &v)
+{
+	Vec2 R = { _mm_xor_ps(SIMD_MATH_SHUFFLE(v.v, 1, 0, 2, 3), _mm_setr_ps(0.0f, -0.0f, 0.0f, 0.0f)) };
+	return R;
+}
+
+
+// VEC3
+
+inline Vec3 Vec3Set(float x, float y, float z) { Vec3 R = { _mm_setr_ps(x, y, z, 0.0f) }; return R; }
+inline Vec3 Vec3Load(const XMFLOAT3 &v)
+{
+	__m128 XY = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&v);
+	Vec3 R = { _mm_movelh_ps(XY, _mm_load_ss(&v.z)) };
+	return R;
+}
+inline XMFLOAT3 Vec3Store(const Vec3 &v)
+{
+	XMFLOAT3 R;
+	_mm_storel_pi((__m64*)&R, v.v);
+	_mm_store_ss(&R.z, _mm_movehl_ps(v.v, v.v));
+	return R;
+}
+inline float Vec3GetX(const Vec3 &v) { return _mm_cvtss_f32(v.v); }
+inline float Vec3GetY(const Vec3 &v) { return _mm_cvtss_f32(SIMD_MATH_SHUFFLE(v.v, 1, 1, 1, 1)); }
+inline float Vec3GetZ(const Vec3 &v) { return _mm_cvtss_f32(_mm_movehl_ps(v.v, v.v)); }
+
+// (x, z) of v, and back
+inline Vec2 Vec3GetXZ(const Vec3 &v) { Vec2 R = { SIMD_MATH_SHUFFLE(v.v, 0, 2, 3, 3) }; return R; }
+inline Vec3 Vec3FromXZ(const Vec2 &XZ, float y) { Vec3 R = { _mm_unpacklo_ps(XZ.v, _mm_set_ss(y)) }; return R; }
+
+inline Vec3 operator+(const Vec3 &lhs, const Vec3 &rhs) { Vec3 R = { _mm_add_ps(lhs.v, rhs.v) }; return R; }
+inline Vec3 operator-(const Vec3 &lhs, const Vec3 &rhs) { Vec3 R = { _mm_sub_ps(lhs.v, rhs.v) }; return R; }
+inline Vec3 operator-(const Vec3 &rhs) { Vec3 R = { _mm_xor_ps(rhs.v, _mm_setr_ps(-0.0f, -0.0f, -0.0f, 0.0f)) }; return R; }
+inline Vec3 operator*(float lhs, const Vec3 &rhs) { Vec3 R = { _mm_mul_ps(_mm_set1_ps(lhs), rhs.v) }; return R; }
+inline Vec3 operator*(const Vec3 &lhs, float rhs) { Vec3 R = { _mm_mul_ps(lhs.v, _mm_set1_ps(rhs)) }; return R; }
+inline Vec3 operator/(const Vec3 &lhs, float rhs) { Vec3 R = { _mm_div_ps(lhs.v, _mm_setr_ps(rhs, rhs, rhs, 1.0f)) }; return R; }
+inline bool operator==(const Vec3 &lhs, const Vec3 &rhs) { return (_mm_movemask_ps(_mm_cmpeq_ps(lhs.v, rhs.v)) & 7) == 7; }
+inline bool operator!=(const Vec3 &lhs, const Vec3 &rhs) { return !(lhs == rhs); }
+
+inline float Vec3Dot(const Vec3 &lhs, const Vec3 &rhs)
+{
+	__m128 P = _mm_mul_ps(lhs.v, rhs.v);
+	__m128 Sum = _mm_add_ss(P, SIMD_MATH_SHUFFLE(P, 1, 1, 1, 1));
+	return _mm_cvtss_f32(_mm_add_ss(Sum, _mm_movehl_ps(P, P)));
+}
+
+inline Vec3 Vec3Cross(const Vec3 &lhs, const Vec3 &rhs)
+{
+	__m128 A = _mm_mul_ps(SIMD_MATH_SHUFFLE(lhs.v, 1, 2, 0, 3), SIMD_MATH_SHUFFLE(rhs.v, 2, 0, 1, 3));
+	__m128 B = _mm_mul_ps(SIMD_MATH_SHUFFLE(lhs.v, 2, 0, 1, 3), SIMD_MATH_SHUFFLE(rhs.v, 1, 2, 0, 3));
+	Vec3 R = { _mm_sub_ps(A, B) };
+	return R;
+}
+
+inline float Vec3LengthSq(const Vec3 &v) { return Vec3Dot(v, v); }
+inline float Vec3Length(const Vec3 &v) { return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(Vec3Dot(v, v)))); }
+inline Vec3 Vec3Normalize(const Vec3 &v) { return v / Vec3Length(v); }
+
+
+// MAT4
+
+inline Mat4 Mat4Load(CXMMATRIX M)
+{
+	Mat4 R;
+	for (int i=0; i<4; ++i)
+		R.r[i] = _mm_setr_ps(M(i,0), M(i,1), M(i,2), M(i,3));
+	return R;
+}
+inline XMMATRIX Mat4Store(const Mat4 &M)
+{
+	SIMD_MATH_ALIGN16 float m[4][4];
+	for (int i=0; i<4; ++i)
+		_mm_store_ps(m[i], M.r[i]);
+	return XMMATRIX(m[0][0], m[0][1], m[0][2], m[0][3],
+					m[1][0], m[1][1], m[1][2], m[1][3],
+					m[2][0], m[2][1], m[2][2], m[2][3],
+					m[3][0], m[3][1], m[3][2], m[3][3]);
+}
+
+// rows of A times B, summed a0*B.r0 + a1*B.r1 + a2*B.r2 + a3*B.r3 like XMMatrixMultiply
+inline Mat4 Mat4Multiply(const Mat4 &A, const Mat4 &B)
+{
+	Mat4 R;
+#if SIMD_MATH_AVX2
+	// two rows of A at a time
+	__m256 B0 = _mm256_insertf128_ps(_mm256_castps128_ps256(B.r[0]), B.r[0], 1);
+	__m256 B1 = _mm256_insertf128_ps(_mm256_castps128_ps256(B.r[1]), B.r[1], 1);
+	__m256 B2 = _mm256_insertf128_ps(_mm256_castps128_ps256(B.r[2]), B.r[2], 1);
+	__m256 B3 = _mm256_insertf128_ps(_mm256_castps128_ps256(B.r[3]), B.r[3], 1);
+	for (int i=0; i<4; i+=2)
+	{
+		__m256 Rows = _mm256_insertf128_ps(_mm256_castps128_ps256(A.r[i]), A.r[i+1], 1);
+		__m256 Sum = _mm256_mul_ps(_mm256_permute_ps(Rows, _MM_SHUFFLE(0, 0, 0, 0)), B0);
+		Sum = _mm256_add_ps(Sum, _mm256_mul_ps(_mm256_permute_ps(Rows, _MM_SHUFFLE(1, 1, 1, 1)), B1));
+		Sum = _mm256_add_ps(Sum, _mm256_mul_ps(_mm256_permute_ps(Rows, _MM_SHUFFLE(2, 2, 2, 2)), B2));
+		Sum = _mm256_add_ps(Sum, _mm256_mul_ps(_mm256_permute_ps(Rows, _MM_SHUFFLE(3, 3, 3, 3)), B3));
+		R.r[i] = _mm256_castps256_ps128(Sum);
+		R.r[i+1] = _mm256_extractf128_ps(Sum, 1);
+	}
+#else
+	for (int i=0; i<4; ++i)
+	{
+		__m128 Sum = _mm_mul_ps(SIMD_MATH_SHUFFLE(A.r[i], 0, 0, 0, 0), B.r[0]);
+		Sum = _mm_add_ps(Sum, _mm_mul_ps(SIMD_MATH_SHUFFLE(A.r[i], 1, 1, 1, 1), B.r[1]));
+		Sum = _mm_add_ps(Sum, _mm_mul_ps(SIMD_MATH_SHUFFLE(A.r[i], 2, 2, 2, 2), B.r[2]));
+		R.r[i] = _mm_add_ps(Sum, _mm_mul_ps(SIMD_MATH_SHUFFLE(A.r[i], 3, 3, 3, 3), B.r[3]));
+	}
+#endif
+	return R;
+}
+
+inline Vec3 Vec3TransformCoord(const Vec3 &v, const Mat4 &M)
+{
+	__m128 Sum = _mm_add_ps(_mm_mul_ps(SIMD_MATH_SHUFFLE(v.v, 2, 2, 2, 2), M.r[2]), M.r[3]);
+	Sum = _mm_add_ps(Sum, _mm_mul_ps(SIMD_MATH_SHUFFLE(v.v, 1, 1, 1, 1), M.r[1]));
+	Sum = _mm_add_ps(Sum, _mm_mul_ps(SIMD_MATH_SHUFFLE(v.v, 0, 0, 0, 0), M.r[0]));
+	__m128 w = SIMD_MATH_SHUFFLE(Sum, 3, 3, 3, 3);
+	Vec3 R = { _mm_and_ps(_mm_div_ps(Sum, w), _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0))) };
+	return R;
+}
+
+inline Vec3 Vec3TransformNormal(const Vec3 &v, const Mat4 &M)
+{
+	__m128 Sum = _mm_add_ps(_mm_mul_ps(SIMD_MATH_SHUFFLE(v.v, 2, 2, 2, 2), M.r[2]),
+							_mm_mul_ps(SIMD_MATH_SHUFFLE(v.v, 1, 1, 1, 1), M.r[1]));
+	Sum = _mm_add_ps(Sum, _mm_mul_ps(SIMD_MATH_SHUFFLE(v.v, 0, 0, 0, 0), M.r[0]));
+	Vec3 R = { _mm_and_ps(Sum, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0))) };
+	return R;
+}
+
+#undef SIMD_MATH_SHUFFLE
+
+#else
+
+struct SIMD_MATH_ALIGN16 Vec2 { float v[4]; };
+struct SIMD_MATH_ALIGN16 Vec3 { float v[4]; };
+struct SIMD_MATH_ALIGN16 Mat4 { float r[4][4]; };
+
+
+// VEC2
+
+inline Vec2 Vec2Set(float x, float y) { Vec2 R = {{ x, y, 0.0f, 0.0f }}; return R; }
+inline Vec2 Vec2Load(const XMFLOAT2 &v) { return Vec2Set(v.x, v.y); }
+inline XMFLOAT2 Vec2Store(const Vec2 &v) { return XMFLOAT2(v.v[0], v.v[1]); }
+inline float Vec2GetX(const Vec2 &v) { return v.v[0]; }
+inline float Vec2GetY(const Vec2 &v) { return v.v[1]; }
+
+inline Vec2 operator+(const Vec2 &lhs, const Vec2 &rhs) { return Vec2Set(lhs.v[0]+rhs.v[0], lhs.v[1]+rhs.v[1]); }
+inline Vec2 operator-(const Vec2 &lhs, const Vec2 &rhs) { return Vec2Set(lhs.v[0]-rhs.v[0], lhs.v[1]-rhs.v[1]); }
+inline Vec2 operator-(const Vec2 &rhs) { return Vec2Set(-rhs.v[0], -rhs.v[1]); }
+inline Vec2 operator*(float lhs, const Vec2 &rhs) { return Vec2Set(lhs*rhs.v[0], lhs*rhs.v[1]); }
+inline Vec2 operator*(const Vec2 &lhs, float rhs) { return Vec2Set(lhs.v[0]*rhs, lhs.v[1]*rhs); }
+inline Vec2 operator/(const Vec2 &lhs, float rhs) { return Vec2Set(lhs.v[0]/rhs, lhs.v[1]/rhs); }
+inline bool operator==(const Vec2 &lhs, const Vec2 &rhs) { return (lhs.v[0]==rhs.v[0] && lhs.v[1]==rhs.v[1]); }
+inline bool operator!=(const Vec2 &lhs, const Vec2 &rhs) { return !(lhs == rhs); }
+
+inline float Vec2Dot(const Vec2 &lhs, const Vec2 &rhs) { return lhs.v[0]*rhs.v[0] + lhs.v[1]*rhs.v[1]; }
+inline float Vec2Cross(const Vec2 &lhs, const Vec2 &rhs) { return lhs.v[0]*rhs.v[1] - lhs.v[1]*rhs.v[0]; }
+inline float Vec2LengthSq(const Vec2 &v) { return Vec2Dot(v, v); }
+inline float Vec2Length(const Vec2 &v) { return sqrtf(Vec2Dot(v, v)); }
+inline Vec2 Vec2Normalize(const Vec2 &v) { return v / Vec2Length(v); }
+inline Vec2 Vec2Left90(const Vec2 &v) { return Vec2Set(-v.v[1], v.v[0]); }
+inline Vec2 Vec2Right90(const Vec2 &v) { return Vec2Set(v.v[1], -v.v[0]); }
+
+
+// VEC3
+
+inline Vec3 Vec3Set(float x, float y, float z) { Vec3 R = {{ x, y, z, 0.0f }}; return R; }
+inline Vec3 Vec3Load(const XMFLOAT3 &v) { return Vec3Set(v.x, v.y, v.z); }
+inline XMFLOAT3 Vec3Store(const Vec3 &v) { return XMFLOAT3(v.v[0], v.v[1], v.v[2]); }
+inline float Vec3GetX(const Vec3 &v) { return v.v[0]; }
+inline float Vec3GetY(const Vec3 &v) { return v.v[1]; }
+inline float Vec3GetZ(const Vec3 &v) { return v.v[2]; }
+
+// (x, z) of v, and back
+inline Vec2 Vec3GetXZ(const Vec3 &v) { return Vec2Set(v.v[0], v.v[2]); }
+inline Vec3 Vec3FromXZ(const Vec2 &XZ, float y) { return Vec3Set(XZ.v[0], y, XZ.v[1]); }
+
+inline Vec3 operator+(const Vec3 &lhs, const Vec3 &rhs) { return Vec3Set(lhs.v[0]+rhs.v[0], lhs.v[1]+rhs.v[1], lhs.v[2]+rhs.v[2]); }
+inline Vec3 operator-(const Vec3 &lhs, const Vec3 &rhs) { return Vec3Set(lhs.v[0]-rhs.v[0], lhs.v[1]-rhs.v[1], lhs.v[2]-rhs.v[2]); }
+inline Vec3 operator-(const Vec3 &rhs) { return Vec3Set(-rhs.v[0], -rhs.v[1], -rhs.v[2]); }
+inline Vec3 operator*(float lhs, const Vec3 &rhs) { return Vec3Set(lhs*rhs.v[0], lhs*rhs.v[1], lhs*rhs.v[2]); }
+inline Vec3 operator*(const Vec3 &lhs, float rhs) { return Vec3Set(lhs.v[0]*rhs, lhs.v[1]*rhs, lhs.v[2]*rhs); }
+inline Vec3 operator/(const Vec3 &lhs, float rhs) { return Vec3Set(lhs.v[0]/rhs, lhs.v[1]/rhs, lhs.v[2]/rhs); }
+inline bool operator==(const Vec3 &lhs, const Vec3 &rhs) { return (lhs.v[0]==rhs.v[0] && lhs.v[1]==rhs.v[1] && lhs.v[2]==rhs.v[2]); }
+inline bool operator!=(const Vec3 &lhs, const Vec3 &rhs) { return !(lhs == rhs); }
+
+inline float Vec3Dot(const Vec3 &lhs, const Vec3 &rhs) { return lhs.v[0]*rhs.v[0] + lhs.v[1]*rhs.v[1] + lhs.v[2]*rhs.v[2]; }
+inline Vec3 Vec3Cross(const Vec3 &lhs, const Vec3 &rhs)
+{
+	return Vec3Set(lhs.v[1]*rhs.v[2] - lhs.v[2]*rhs.v[1],
+					lhs.v[2]*rhs.v[0] - lhs.v[0]*rhs.v[2],
+					lhs.v[0]*rhs.v[1] - lhs.v[1]*rhs.v[0]);
+}
+inline float Vec3LengthSq(const Vec3 &v) { return Vec3Dot(v, v); }
+inline float Vec3Length(const Vec3 &v) { return sqrtf(Vec3Dot(v, v)); }
+inline Vec3 Vec3Normalize(const Vec3 &v) { return v / Vec3Length(v); }
+
+
+// MAT4
+
+inline Mat4 Mat4Load(CXMMATRIX M)
+{
+	Mat4 R;
+	for (int i=0; i<4; ++i)
+		for (int j=0; j<4; ++j)
+			R.r[i][j] = M(i,j);
+	return R;
+}
+inline XMMATRIX Mat4Store(const Mat4 &M)
+{
+	return XMMATRIX(M.r[0][0], M.r[0][1], M.r[0][2], M.r[0][3],
+					M.r[1][0], M.r[1][1], M.r[1][2], M.r[1][3],
+					M.r[2][0], M.r[2][1], M.r[2][2], M.r[2][3],
+					M.r[3][0], M.r[3][1], M.r[3][2], M.r[3][3]);
+}
+
+// rows of A times B, summed a0*B.r0 + a1*B.r1 + a2*B.r2 + a3*B.r3 like XMMatrixMultiply
+inline Mat4 Mat4Multiply(const Mat4 &A, const Mat4 &B)
+{
+	Mat4 R;
+	for (int i=0; i<4; ++i)
+		for (int j=0; j<4; ++j)
+			R.r[i][j] = A.r[i][0]*B.r[0][j] + A.r[i][1]*B.r[1][j] + A.r[i][2]*B.r[2][j] + A.r[i][3]*B.r[3][j];
+	return R;
+}
+
+inline Vec3 Vec3TransformCoord(const Vec3 &v, const Mat4 &M)
+{
+	float x = ((v.v[2]*M.r[2][0] + M.r[3][0]) + v.v[1]*M.r[1][0]) + v.v[0]*M.r[0][0];
+	float y = ((v.v[2]*M.r[2][1] + M.r[3][1]) + v.v[1]*M.r[1][1]) + v.v[0]*M.r[0][1];
+	float z = ((v.v[2]*M.r[2][2] + M.r[3][2]) + v.v[1]*M.r[1][2]) + v.v[0]*M.r[0][2];
+	float w = ((v.v[2]*M.r[2][3] + M.r[3][3]) + v.v[1]*M.r[1][3]) + v.v[0]*M.r[0][3];
+	return Vec3Set(x/w, y/w, z/w);
+}
+
+inline Vec3 Vec3TransformNormal(const Vec3 &v, const Mat4 &M)
+{
+	return Vec3Set((v.v[2]*M.r[2][0] + v.v[1]*M.r[1][0]) + v.v[0]*M.r[0][0],
+					(v.v[2]*M.r[2][1] + v.v[1]*M.r[1][1]) + v.v[0]*M.r[0][1],
+					(v.v[2]*M.r[2][2] + v.v[1]*M.r[1][2]) + v.v[0]*M.r[0][2]);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,1053 @@
+#include "SoftwareRenderBackend.h"
+#include <stdio.h>
+#if SOFTWARE_RASTER_SSE
+#include <emmintrin.h>
+#endif
+
+#define SUBPIXEL_SCALE (1 << SOFTWARE_RASTER_SUBPIXEL_BITS)
+
+// edge function values are clamped to this before the 32 bit stepping across a row.  a row of a tile steps
+// less than 2^27, so the sign of every pixel's value survives the clamp
+#define EDGE_CLAMP (1 << 28)
+
+// from LightHelper.fx
+#define FOG_START 20.0f
+#define FOG_RANGE 80.0f
+
+// DepthBiasRS in LightHelper.fx, for a 24 bit depth buffer
+#define BOX_DEPTH_BIAS (10.0f / 16777216.0f)
+#define BOX_SLOPE_SCALED_DEPTH_BIAS 0.01f
+
+// RoomPortal.fx's test for a point being in a portal's plane
+#define PORTAL_PLANE_THRESHOLD 0.001f
+
+// clip space planes, as dot(PosH, Plane) + Offset >= 0.  near, far, w > 0, then the guard band
+static const float ClipPlanes[7][5] =
+{
+	{ 0.0f, 0.0f, 1.0f, 0.0f, 0.0f },
+	{ 0.0f, 0.0f, -1.0f, 1.0f, 0.0f },
+	{ 0.0f, 0.0f, 0.0f, 1.0f, -1e-6f },
+	{ -1.0f, 0.0f, 0.0f, SOFTWARE_RASTER_GUARD_BAND, 0.0f },
+	{ 1.0f, 0.0f, 0.0f, SOFTWARE_RASTER_GUARD_BAND, 0.0f },
+	{ 0.0f, -1.0f, 0.0f, SOFTWARE_RASTER_GUARD_BAND, 0.0f },
+	{ 0.0f, 1.0f, 0.0f, SOFTWARE_RASTER_GUARD_BAND, 0.0f },
+};
+
+static inline float ClipDistance(const float PosH[4], UINT Plane)
+{
+	const float *P = ClipPlanes[Plane];
+	return PosH[0]*P[0] + PosH[1]*P[1] + PosH[2]*P[2] + PosH[3]*P[3] + P[4];
+}
+
+// row vector times matrix, like mul(float4(v, w), M) in the effects
+static inline void TransformPoint(const float v[3], float w, const XMFLOAT4X4 &M, float Out[4])
+{
+	for (int j=0; j<4; ++j)
+		Out[j] = v[0]*M.m[0][j] + v[1]*M.m[1][j] + v[2]*M.m[2][j] + w*M.m[3][j];
+}
+
+static inline float Saturate(float x)
+{
+	return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+static inline UINT PackColor(const XMFLOAT4 &C)
+{
+	UINT r = (UINT)(Saturate(C.x) * 255.0f + 0.5f);
+	UINT g = (UINT)(Saturate(C.y) * 255.0f + 0.5f);
+	UINT b = (UINT)(Saturate(C.z) * 255.0f + 0.5f);
+	UINT a = (UINT)(Saturate(C.w) * 255.0f + 0.5f);
+	return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static inline XMFLOAT4 UnpackColor(UINT c)
+{
+	return XMFLOAT4((c & 0xff) / 255.0f, ((c >> 8) & 0xff) / 255.0f, ((c >> 16) & 0xff) / 255.0f, (c >> 24) / 255.0f);
+}
+
+static inline float Dot3(const float *a, const float *b)
+{
+	return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+
+SoftwareRenderBackend::SoftwareRenderBackend()
+	: Width(0), Height(0), ViewportX(0.0f), ViewportY(0.0f), ViewportWidth(0.0f), ViewportHeight(0.0f),
+	ScissorEnabled(false), ScissorLeft(0), ScissorTop(0), ScissorRight(0), ScissorBottom(0),
+	Meshes(), DirLights(), PortalADiffuseMap(0), PortalBDiffuseMap(0), Current(), StateVersion(1),
+	LastStateVersion(0), LastDrawKey(-1), DrawStamp(0), TilesX(0), TilesY(0), WorkGeneration(0),
+	WorkersBusy(0), Quit(false), NextTile(0), PixelsTested(0), PixelsWritten(0)
+{
+	Current.ViewScale = 1.0f;
+	memset(&Stats, 0, sizeof(Stats));
+
+	XMStoreFloat4x4(&World, XMMatrixIdentity());
+	XMStoreFloat4x4(&ViewProj, XMMatrixIdentity());
+	XMStoreFloat4x4(&PortalA, XMMatrixIdentity());
+	XMStoreFloat4x4(&PortalB, XMMatrixIdentity());
+	XMStoreFloat4x4(&PlayerWorld, XMMatrixIdentity());
+}
+
+SoftwareRenderBackend::~SoftwareRenderBackend()
+{
+	{
+		std::lock_guard<std::mutex> Lock(WorkMutex);
+		Quit = true;
+	}
+	WorkReady.notify_all();
+	for (UINT i=0; i<Workers.size(); ++i)
+		Workers[i].join();
+}
+
+
+void SoftwareRenderBackend::Init(UINT Width, UINT Height, UINT ThreadCount)
+{
+	this->Width = Width;
+	this->Height = Height;
+	ColorBuffer.assign(Width * Height, 0);
+	DepthBuffer.assign(Width * Height, 1.0f);
+	StencilBuffer.assign(Width * Height, 0);
+	SetViewport(0.0f, 0.0f, (float)Width, (float)Height);
+
+	TilesX = (Width + SOFTWARE_RASTER_TILE_SIZE - 1) / SOFTWARE_RASTER_TILE_SIZE;
+	TilesY = (Height + SOFTWARE_RASTER_TILE_SIZE - 1) / SOFTWARE_RASTER_TILE_SIZE;
+	TileBins.assign(TilesX * TilesY, std::vector<UINT>());
+
+	if (ThreadCount == 0)
+		ThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	// the thread calling Flush rasterizes too
+	for (UINT i=1; i<ThreadCount; ++i)
+		Workers.push_back(std::thread(&SoftwareRenderBackend::WorkerLoop, this));
+}
+
+void SoftwareRenderBackend::SetMesh(MeshType Mesh, const MeshDesc &Desc)
+{
+	Meshes[Mesh] = Desc;
+	++StateVersion;
+}
+
+void SoftwareRenderBackend::SetDirLights(const DirectionalLight Lights[3])
+{
+	memcpy(DirLights, Lights, 3*sizeof(DirectionalLight));
+	memcpy(Current.Lights, Lights, 3*sizeof(DirectionalLight));
+	++StateVersion;
+}
+
+void SoftwareRenderBackend::SetPortalTextures(const Texture *PortalADiffuseMap, const Texture *PortalBDiffuseMap)
+{
+	this->PortalADiffuseMap = PortalADiffuseMap;
+	this->PortalBDiffuseMap = PortalBDiffuseMap;
+}
+
+void SoftwareRenderBackend::SetViewport(float TopLeftX, float TopLeftY, float Width, float Height)
+{
+	ViewportX = TopLeftX;
+	ViewportY = TopLeftY;
+	ViewportWidth = Width;
+	ViewportHeight = Height;
+}
+
+// clears the whole buffer like the D3D clears, after rasterizing what was drawn before
+void SoftwareRenderBackend::Clear(const XMFLOAT4 &Color)
+{
+	Flush();
+	std::fill(ColorBuffer.begin(), ColorBuffer.end(), PackColor(Color));
+	std::fill(DepthBuffer.begin(), DepthBuffer.end(), 1.0f);
+	std::fill(StencilBuffer.begin(), StencilBuffer.end(), (unsigned char)0);
+}
+
+
+UINT SoftwareRenderBackend::GetIndexCount(MeshType Mesh)const
+{
+	return Meshes[Mesh].IndexCount;
+}
+
+void SoftwareRenderBackend::BeginFrame()
+{
+	memset(&Stats, 0, sizeof(Stats));
+	ScissorEnabled = false;
+	++StateVersion;
+}
+
+void SoftwareRenderBackend::SetStencil(StencilMode Mode, UINT StencilRef)
+{
+	Current.Stencil = Mode;
+	Current.StencilRef = StencilRef;
+	++StateVersion;
+}
+
+// only used by SetupTriangle, so it doesn't need a new PixelState
+void SoftwareRenderBackend::SetScissor(bool Enable, int Left, int Top, int Right, int Bottom)
+{
+	ScissorEnabled = Enable;
+	ScissorLeft = Left;
+	ScissorTop = Top;
+	ScissorRight = Right;
+	ScissorBottom = Bottom;
+}
+
+void SoftwareRenderBackend::SetPortals(const Portal &PortalA, const Portal &PortalB)
+{
+	XMStoreFloat4x4(&this->PortalA, PortalA.GetScaledPortalMatrix());
+	XMStoreFloat4x4(&this->PortalB, PortalB.GetScaledPortalMatrix());
+	Current.PortalATexRadRatio = PortalA.GetTextureRadiusRatio();
+	Current.PortalBTexRadRatio = PortalB.GetTextureRadiusRatio();
+	++StateVersion;
+}
+
+void SoftwareRenderBackend::SetEye(XMFLOAT3 EyePosition, float ViewScale)
+{
+	Current.EyePosition = EyePosition;
+	Current.ViewScale = ViewScale;
+	++StateVersion;
+}
+
+void SoftwareRenderBackend::SetLights(const XMFLOAT3 LightDirections[3])
+{
+	for (UINT i=0; i<3; ++i)
+		Current.Lights[i].Direction = LightDirections[i];
+	++StateVersion;
+}
+
+void SoftwareRenderBackend::SetClipPlane(XMFLOAT3 Position, XMFLOAT3 Normal, float Offset)
+{
+	Current.ClipPlanePosition = Position;
+	Current.ClipPlaneNormal = Normal;
+	Current.ClipPlaneOffset = Offset;
+	++StateVersion;
+}
+
+void SoftwareRenderBackend::SetObjectConstants(const XMFLOAT4X4 &World, const XMFLOAT4X4 &ViewProj)
+{
+	this->World = World;
+	this->ViewProj = ViewProj;
+}
+
+void SoftwareRenderBackend::DrawIndexed(MeshType Mesh, ShadeMode Mode, UINT Start, UINT Count)
+{
+	Current.PlaneClip = (Mode == SHADE_PLANE_CLIP);
+	Current.DrawHoles = (Mode != SHADE_NO_PORTAL_HOLES);
+	Draw(Mesh, Start, Count, false, 0);
+}
+
+void SoftwareRenderBackend::SetLevelSlots(const LevelSlot *Slots, UINT SlotCount, const XMFLOAT4X4 &PlayerWorld)
+{
+	this->Slots.assign(Slots, Slots + SlotCount);
+	this->PlayerWorld = PlayerWorld;
+	++StateVersion;
+}
+
+void SoftwareRenderBackend::DrawLevel(MeshType Mesh, UINT Slot, bool PlaneClip, UINT Start, UINT Count)
+{
+	if (Slot >= Slots.size())
+		return;
+
+	Current.PlaneClip = PlaneClip;
+	Current.DrawHoles = true;
+	Draw(Mesh, Start, Count, true, Slot);
+}
+
+
+void SoftwareRenderBackend::Flush()
+{
+	if (RasterTriangles.empty())
+		return;
+
+	// bin the triangles by the tiles their bounds touch, keeping submission order within each tile
+	for (UINT t=0; t<RasterTriangles.size(); ++t)
+	{
+		const RasterTriangle &T = RasterTriangles[t];
+		UINT TX0 = T.MinX / SOFTWARE_RASTER_TILE_SIZE;
+		UINT TY0 = T.MinY / SOFTWARE_RASTER_TILE_SIZE;
+		UINT TX1 = T.MaxX / SOFTWARE_RASTER_TILE_SIZE;
+		UINT TY1 = T.MaxY / SOFTWARE_RASTER_TILE_SIZE;
+		for (UINT ty=TY0; ty<=TY1; ++ty)
+			for (UINT tx=TX0; tx<=TX1; ++tx)
+				TileBins[ty*TilesX + tx].push_back(t);
+	}
+
+	NextTile = 0;
+	PixelsTested = 0;
+	PixelsWritten = 0;
+	{
+		std::lock_guard<std::mutex> Lock(WorkMutex);
+		WorkersBusy = (UINT)Workers.size();
+		++WorkGeneration;
+	}
+	WorkReady.notify_all();
+
+	RasterizeTiles();
+
+	{
+		std::unique_lock<std::mutex> Lock(WorkMutex);
+		while (WorkersBusy > 0)
+			WorkDone.wait(Lock);
+	}
+
+	Stats.PixelsTested += PixelsTested;
+	Stats.PixelsWritten += PixelsWritten;
+
+	for (UINT i=0; i<TileBins.size(); ++i)
+		TileBins[i].clear();
+	RasterTriangles.clear();
+	RasterVertices.clear();
+	States.clear();
+	LastDrawKey = -1;
+}
+
+
+UINT SoftwareRenderBackend::GetWidth()const
+{
+	return Width;
+}
+
+UINT SoftwareRenderBackend::GetHeight()const
+{
+	return Height;
+}
+
+const std::vector<UINT>& SoftwareRenderBackend::GetColorBuffer()
+{
+	Flush();
+	return ColorBuffer;
+}
+
+const std::vector<unsigned char>& SoftwareRenderBackend::GetStencilBuffer()
+{
+	Flush();
+	return StencilBuffer;
+}
+
+const SoftwareRenderBackend::FrameStats& SoftwareRenderBackend::GetFrameStats()const
+{
+	return Stats;
+}
+
+
+bool SoftwareRenderBackend::WritePPM(const char *Path)
+{
+	Flush();
+
+	FILE *f = fopen(Path, "wb");
+	if (!f)
+		return false;
+
+	fprintf(f, "P6\n%u %u\n255\n", Width, Height);
+	std::vector<unsigned char> Row(3 * Width);
+	for (UINT y=0; y<Height; ++y)
+	{
+		for (UINT x=0; x<Width; ++x)
+		{
+			UINT c = ColorBuffer[y*Width + x];
+			Row[3*x] = (unsigned char)(c & 0xff);
+			Row[3*x+1] = (unsigned char)((c >> 8) & 0xff);
+			Row[3*x+2] = (unsigned char)((c >> 16) & 0xff);
+		}
+		fwrite(&Row[0], 1, Row.size(), f);
+	}
+	return fclose(f) == 0;
+}
+
+bool SoftwareRenderBackend::LoadPPM(const char *Path, UINT *Width_ptr, UINT *Height_ptr, std::vector<UINT> &Pixels)
+{
+	FILE *f = fopen(Path, "rb");
+	if (!f)
+		return false;
+
+	UINT W, H, MaxValue;
+	if (fscanf(f, "P6 %u %u %u", &W, &H, &MaxValue) != 3 || MaxValue != 255 || fgetc(f) == EOF)
+	{
+		fclose(f);
+		return false;
+	}
+
+	std::vector<unsigned char> Data(3 * W * H);
+	bool Complete = (fread(&Data[0], 1, Data.size(), f) == Data.size());
+	fclose(f);
+	if (!Complete)
+		return false;
+
+	Pixels.resize(W * H);
+	for (UINT i=0; i<W*H; ++i)
+		Pixels[i] = Data[3*i] | (Data[3*i+1] << 8) | (Data[3*i+2] << 16) | 0xff000000;
+	*Width_ptr = W;
+	*Height_ptr = H;
+	return true;
+}
+
+
+void SoftwareRenderBackend::BuildRingTexture(Texture &Tex, UINT Size, float InnerRadius, const XMFLOAT4 &Color)
+{
+	Tex.Width = Size;
+	Tex.Height = Size;
+	Tex.Texels.resize(Size * Size);
+
+	XMFLOAT4 Clear(0.0f, 0.0f, 0.0f, 0.0f);
+	for (UINT y=0; y<Size; ++y)
+	{
+		for (UINT x=0; x<Size; ++x)
+		{
+			float u = 2.0f * (x + 0.5f) / Size - 1.0f;
+			float v = 2.0f * (y + 0.5f) / Size - 1.0f;
+			float r = sqrtf(u*u + v*v);
+			Tex.Texels[y*Size + x] = PackColor((r >= InnerRadius && r <= 1.0f) ? Color : Clear);
+		}
+	}
+}
+
+void SoftwareRenderBackend::BuildCheckerTexture(Texture &Tex, UINT Size, UINT Squares, const XMFLOAT4 &ColorA,
+													const XMFLOAT4 &ColorB)
+{
+	Tex.Width = Size;
+	Tex.Height = Size;
+	Tex.Texels.resize(Size * Size);
+
+	UINT SquareSize = std::max(1u, Size / Squares);
+	for (UINT y=0; y<Size; ++y)
+		for (UINT x=0; x<Size; ++x)
+			Tex.Texels[y*Size + x] = PackColor(((x / SquareSize + y / SquareSize) & 1) ? ColorB : ColorA);
+}
+
+
+UINT SoftwareRenderBackend::AddState()
+{
+	States.push_back(Current);
+	return (UINT)States.size() - 1;
+}
+
+// transforms the indices like the mesh's vertex shader, then clips and sets up each triangle
+void SoftwareRenderBackend::Draw(MeshType Mesh, UINT Start, UINT Count, bool Level, UINT Slot)
+{
+	const MeshDesc &M = Meshes[Mesh];
+	if (!M.Data || Start + Count > M.IndexCount)
+		return;
+
+	ShaderType Shader;
+	if (Mesh == MESH_WALLS || Mesh == MESH_FLOOR || Mesh == MESH_CEILING)
+		Shader = SHADER_ROOM;
+	else if (Mesh == MESH_PLAYER)
+		Shader = SHADER_BASIC;
+	else
+		Shader = SHADER_BOX;
+	bool ClearDepth = (Mesh == MESH_PORTAL_BOX_CLEAR_DEPTH);
+
+	// the object's matrices
+	XMMATRIX ObjectWorld, NormalMatrix;
+	XMFLOAT4X4 ObjectViewProj;
+	if (!Level)
+	{
+		ObjectWorld = XMLoadFloat4x4(&World);
+		NormalMatrix = MathFunctions::InverseTranspose(ObjectWorld);
+		ObjectViewProj = ViewProj;
+	}
+	else
+	{
+		const LevelSlot &S = Slots[Slot];
+		if (Shader == SHADER_BOX)
+		{
+			ObjectWorld = XMLoadFloat4x4(&S.PortalBoxWorld);
+			ObjectViewProj = ClearDepth ? Slots[0].ViewProj : S.ViewProj;
+		}
+		else
+		{
+			ObjectWorld = XMLoadFloat4x4(&S.WorldToVirtual);
+			if (Shader == SHADER_BASIC)
+				ObjectWorld = XMLoadFloat4x4(&PlayerWorld) * ObjectWorld;
+			ObjectViewProj = S.ViewProj;
+		}
+		// virtualizing only rotates, translates and scales uniformly
+		NormalMatrix = ObjectWorld;
+	}
+	XMFLOAT4X4 ObjectWorldF, NormalMatrixF;
+	XMStoreFloat4x4(&ObjectWorldF, ObjectWorld);
+	XMStoreFloat4x4(&NormalMatrixF, NormalMatrix);
+
+
+	// reuse the last state unless something it holds changed
+	int DrawKey = (((Level ? (int)Slot + 1 : 0) * MESH_COUNT + Mesh) * 2 + Current.PlaneClip) * 2 + Current.DrawHoles;
+	if (States.empty() || StateVersion != LastStateVersion || DrawKey != LastDrawKey)
+	{
+		PixelState Saved = Current;
+		Current.Shader = Shader;
+		Current.Mat = M.Mat;
+		Current.DiffuseMap = M.DiffuseMap;
+		if (Level)
+		{
+			const LevelSlot &S = Slots[Slot];
+			for (UINT i=0; i<3; ++i)
+				Current.Lights[i].Direction = S.LightDirections[i];
+			Current.ClipPlanePosition = S.ClipPlanePosition;
+			Current.ClipPlaneNormal = S.ClipPlaneNormal;
+			Current.ClipPlaneOffset = S.ClipPlaneOffset;
+		}
+		AddState();
+		Current = Saved;
+
+		LastStateVersion = StateVersion;
+		LastDrawKey = DrawKey;
+	}
+	UINT State = (UINT)States.size() - 1;
+
+
+	// transform each vertex once per draw
+	UINT VertexCount = (UINT)M.Data->Vertices.size();
+	if (Transformed.size() < VertexCount)
+	{
+		Transformed.resize(VertexCount);
+		TransformStamp.resize(VertexCount, 0);
+	}
+	if (++DrawStamp == 0)
+	{
+		std::fill(TransformStamp.begin(), TransformStamp.end(), 0);
+		DrawStamp = 1;
+	}
+
+	const UINT *Indices = &M.Data->Indices[M.IBOffset + Start];
+	for (UINT i=0; i+2<Count; i+=3)
+	{
+		const ClipVertex *V[3];
+		for (UINT k=0; k<3; ++k)
+		{
+			UINT Index = Indices[i+k] + M.VBOffset;
+			if (TransformStamp[Index] != DrawStamp)
+			{
+				TransformVertex(M.Data->Vertices[Index], Shader, ObjectWorldF, NormalMatrixF, ObjectViewProj,
+								ClearDepth, M.TexTransform, &Transformed[Index]);
+				TransformStamp[Index] = DrawStamp;
+			}
+			V[k] = &Transformed[Index];
+		}
+		AddTriangle(V[0], V[1], V[2], State, Mesh == MESH_PORTAL_BOX);
+	}
+}
+
+// VS, VS_Level, VS_Box and VS_BoxLevel
+void SoftwareRenderBackend::TransformVertex(const GeometryGenerator::Vertex &V, ShaderType Shader,
+					const XMFLOAT4X4 &ObjectWorld, const XMFLOAT4X4 &NormalMatrix, const XMFLOAT4X4 &ObjectViewProj,
+					bool ClearDepth, const XMFLOAT4X4 &TexTransform, ClipVertex *Out_ptr)const
+{
+	const float *PosL = &V.Position.x;
+	float PosW[4];
+	TransformPoint(PosL, 1.0f, ObjectWorld, PosW);
+	TransformPoint(PosW, 1.0f, ObjectViewProj, Out_ptr->PosH);
+	if (ClearDepth)
+		Out_ptr->PosH[2] = Out_ptr->PosH[3];
+
+	float *Var = Out_ptr->Varyings;
+	memset(Var, 0, sizeof(Out_ptr->Varyings));
+	Var[VARYING_POS_W] = PosW[0];
+	Var[VARYING_POS_W+1] = PosW[1];
+	Var[VARYING_POS_W+2] = PosW[2];
+	if (Shader == SHADER_BOX)
+		return;
+
+	float Normal[4];
+	TransformPoint(&V.Normal.x, 0.0f, NormalMatrix, Normal);
+	Var[VARYING_NORMAL_W] = Normal[0];
+	Var[VARYING_NORMAL_W+1] = Normal[1];
+	Var[VARYING_NORMAL_W+2] = Normal[2];
+
+	float Tex[3] = { V.TexCoord.x, V.TexCoord.y, 0.0f };
+	float TexT[4];
+	TransformPoint(Tex, 1.0f, TexTransform, TexT);
+	Var[VARYING_TEX] = TexT[0];
+	Var[VARYING_TEX+1] = TexT[1];
+
+	// the room's position in both portals' spaces, from its object space position
+	if (Shader == SHADER_ROOM)
+	{
+		float PosP[4];
+		TransformPoint(PosL, 1.0f, PortalA, PosP);
+		Var[VARYING_POS_PA] = PosP[0] / PosP[3];
+		Var[VARYING_POS_PA+1] = PosP[1] / PosP[3];
+		Var[VARYING_POS_PA+2] = PosP[2] / PosP[3];
+		TransformPoint(PosL, 1.0f, PortalB, PosP);
+		Var[VARYING_POS_PB] = PosP[0] / PosP[3];
+		Var[VARYING_POS_PB+1] = PosP[1] / PosP[3];
+		Var[VARYING_POS_PB+2] = PosP[2] / PosP[3];
+	}
+}
+
+// clips against the near and far planes, w > 0 and the guard band.  triangles inside all of them skip clipping
+void SoftwareRenderBackend::AddTriangle(const ClipVertex *A, const ClipVertex *B, const ClipVertex *C, UINT State,
+											bool DepthBias)
+{
+	++Stats.Triangles;
+
+	const ClipVertex *V[3] = { A, B, C };
+	UINT Outside[3] = { 0, 0, 0 };
+	for (UINT p=0; p<7; ++p)
+		for (UINT k=0; k<3; ++k)
+			if (ClipDistance(V[k]->PosH, p) < 0.0f)
+				Outside[k] |= (1 << p);
+
+	if (Outside[0] & Outside[1] & Outside[2])
+		return;
+	if ((Outside[0] | Outside[1] | Outside[2]) == 0)
+	{
+		SetupTriangle(A, B, C, State, DepthBias);
+		return;
+	}
+
+	++Stats.ClippedTriangles;
+
+	// Sutherland-Hodgman, one plane at a time.  every plane adds at most one vertex
+	ClipVertex Buffers[2][3+7];
+	UINT Counts[2] = { 3, 0 };
+	Buffers[0][0] = *A;
+	Buffers[0][1] = *B;
+	Buffers[0][2] = *C;
+	UINT In = 0;
+	UINT ClipMask = Outside[0] | Outside[1] | Outside[2];
+	for (UINT p=0; p<7 && Counts[In] >= 3; ++p)
+	{
+		if (!(ClipMask & (1 << p)))
+			continue;
+
+		UINT Out = 1 - In;
+		Counts[Out] = 0;
+		for (UINT i=0; i<Counts[In]; ++i)
+		{
+			const ClipVertex &P = Buffers[In][i];
+			const ClipVertex &Q = Buffers[In][(i+1) % Counts[In]];
+			float dP = ClipDistance(P.PosH, p);
+			float dQ = ClipDistance(Q.PosH, p);
+			if (dP >= 0.0f)
+				Buffers[Out][Counts[Out]++] = P;
+			if ((dP >= 0.0f) != (dQ >= 0.0f))
+			{
+				float t = dP / (dP - dQ);
+				ClipVertex &X = Buffers[Out][Counts[Out]++];
+				for (UINT j=0; j<4; ++j)
+					X.PosH[j] = P.PosH[j] + t * (Q.PosH[j] - P.PosH[j]);
+				for (UINT j=0; j<VARYING_COUNT; ++j)
+					X.Varyings[j] = P.Varyings[j] + t * (Q.Varyings[j] - P.Varyings[j]);
+			}
+		}
+		In = Out;
+	}
+
+	for (UINT i=1; i+1<Counts[In]; ++i)
+		SetupTriangle(&Buffers[In][0], &Buffers[In][i], &Buffers[In][i+1], State, DepthBias);
+}
+
+// projects to the viewport, snaps to the subpixel grid and culls back faces (clockwise is front, like the
+// effects' rasterizer states)
+void SoftwareRenderBackend::SetupTriangle(const ClipVertex *A, const ClipVertex *B, const ClipVertex *C, UINT State,
+											bool DepthBias)
+{
+	const ClipVertex *V[3] = { A, B, C };
+	RasterVertex R[3];
+	float SX[3], SY[3];
+	for (UINT k=0; k<3; ++k)
+	{
+		const float *PosH = V[k]->PosH;
+		float InvW = 1.0f / PosH[3];
+		SX[k] = ViewportX + (PosH[0] * InvW + 1.0f) * 0.5f * ViewportWidth;
+		SY[k] = ViewportY + (1.0f - PosH[1] * InvW) * 0.5f * ViewportHeight;
+		R[k].X = (int)floorf(SX[k] * SUBPIXEL_SCALE + 0.5f);
+		R[k].Y = (int)floorf(SY[k] * SUBPIXEL_SCALE + 0.5f);
+		R[k].Z = PosH[2] * InvW;
+		R[k].InvW = InvW;
+		for (UINT j=0; j<VARYING_COUNT; ++j)
+			R[k].Varyings[j] = V[k]->Varyings[j] * InvW;
+	}
+
+	long long Area2 = (long long)(R[1].X - R[0].X) * (R[2].Y - R[0].Y) -
+						(long long)(R[1].Y - R[0].Y) * (R[2].X - R[0].X);
+	if (Area2 <= 0)
+		return;
+
+	// pixels whose centers might be covered, within the viewport and the buffer
+	int MinFX = std::min(R[0].X, std::min(R[1].X, R[2].X));
+	int MinFY = std::min(R[0].Y, std::min(R[1].Y, R[2].Y));
+	int MaxFX = std::max(R[0].X, std::max(R[1].X, R[2].X));
+	int MaxFY = std::max(R[0].Y, std::max(R[1].Y, R[2].Y));
+
+	RasterTriangle T;
+	T.MinX = std::max(MinFX >> SOFTWARE_RASTER_SUBPIXEL_BITS, std::max((int)ViewportX, 0));
+	T.MinY = std::max(MinFY >> SOFTWARE_RASTER_SUBPIXEL_BITS, std::max((int)ViewportY, 0));
+	T.MaxX = std::min(MaxFX >> SOFTWARE_RASTER_SUBPIXEL_BITS, std::min((int)(ViewportX + ViewportWidth), (int)Width) - 1);
+	T.MaxY = std::min(MaxFY >> SOFTWARE_RASTER_SUBPIXEL_BITS, std::min((int)(ViewportY + ViewportHeight), (int)Height) - 1);
+	T.OriginX = T.MinX;
+	T.OriginY = T.MinY;
+	if (ScissorEnabled)
+	{
+		// the tiles are binned and rasterized by these bounds, so this is all the scissor test takes
+		T.MinX = std::max(T.MinX, ScissorLeft);
+		T.MinY = std::max(T.MinY, ScissorTop);
+		T.MaxX = std::min(T.MaxX, ScissorRight - 1);
+		T.MaxY = std::min(T.MaxY, ScissorBottom - 1);
+	}
+	if (T.MinX > T.MaxX || T.MinY > T.MaxY)
+		return;
+
+	T.State = State;
+	T.Area2 = Area2;
+
+	// DepthBias + SlopeScaledDepthBias * MaxDepthSlope
+	T.DepthBias = 0.0f;
+	if (DepthBias)
+	{
+		float Area = (SX[1] - SX[0]) * (SY[2] - SY[0]) - (SY[1] - SY[0]) * (SX[2] - SX[0]);
+		float dZdX = ((R[1].Z - R[0].Z) * (SY[2] - SY[0]) - (R[2].Z - R[0].Z) * (SY[1] - SY[0])) / Area;
+		float dZdY = ((R[2].Z - R[0].Z) * (SX[1] - SX[0]) - (R[1].Z - R[0].Z) * (SX[2] - SX[0])) / Area;
+		T.DepthBias = BOX_DEPTH_BIAS + BOX_SLOPE_SCALED_DEPTH_BIAS * std::max(fabsf(dZdX), fabsf(dZdY));
+	}
+
+	T.FirstVertex = (UINT)RasterVertices.size();
+	RasterVertices.push_back(R[0]);
+	RasterVertices.push_back(R[1]);
+	RasterVertices.push_back(R[2]);
+	RasterTriangles.push_back(T);
+	++Stats.RasterTriangles;
+}
+
+
+void SoftwareRenderBackend::WorkerLoop()
+{
+	UINT SeenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> Lock(WorkMutex);
+			while (!Quit && WorkGeneration == SeenGeneration)
+				WorkReady.wait(Lock);
+			if (Quit)
+				return;
+			SeenGeneration = WorkGeneration;
+		}
+
+		RasterizeTiles();
+
+		{
+			std::lock_guard<std::mutex> Lock(WorkMutex);
+			--WorkersBusy;
+		}
+		WorkDone.notify_one();
+	}
+}
+
+// takes tiles until there are none left.  a tile is only ever touched by the thread that took it
+void SoftwareRenderBackend::RasterizeTiles()
+{
+	UINT TileCount = TilesX * TilesY;
+	for (;;)
+	{
+		UINT Tile = NextTile++;
+		if (Tile >= TileCount)
+			return;
+		if (!TileBins[Tile].empty())
+			RasterizeTile(Tile % TilesX, Tile / TilesX);
+	}
+}
+
+void SoftwareRenderBackend::RasterizeTile(UINT TileX, UINT TileY)
+{
+	int MinX = TileX * SOFTWARE_RASTER_TILE_SIZE;
+	int MinY = TileY * SOFTWARE_RASTER_TILE_SIZE;
+	int MaxX = std::min(MinX + SOFTWARE_RASTER_TILE_SIZE, (int)Width) - 1;
+	int MaxY = std::min(MinY + SOFTWARE_RASTER_TILE_SIZE, (int)Height) - 1;
+
+	UINT Tested = 0, Written = 0;
+	const std::vector<UINT> &Bin = TileBins[TileY*TilesX + TileX];
+	for (UINT i=0; i<Bin.size(); ++i)
+		RasterizeTriangle(RasterTriangles[Bin[i]], MinX, MinY, MaxX, MaxY, &Tested, &Written);
+
+	PixelsTested += Tested;
+	PixelsWritten += Written;
+}
+
+// covers the pixel centers inside all three edges, with the top-left rule on the edges themselves.  the edge
+// functions are exact: 64 bit at the start of each row, then stepped 4 pixels at a time in 32 bits
+void SoftwareRenderBackend::RasterizeTriangle(const RasterTriangle &T, int TileMinX, int TileMinY,
+					int TileMaxX, int TileMaxY, UINT *Tested_ptr, UINT *Written_ptr)
+{
+	int X0 = std::max(T.MinX, TileMinX);
+	int Y0 = std::max(T.MinY, TileMinY);
+	int X1 = std::min(T.MaxX, TileMaxX);
+	int Y1 = std::min(T.MaxY, TileMaxY);
+	if (X0 > X1 || Y0 > Y1)
+		return;
+
+	const RasterVertex *V = &RasterVertices[T.FirstVertex];
+	const PixelState &S = States[T.State];
+
+	// edge i runs from vertex i to vertex i+1, and weighs the vertex opposite it
+	int EdgeDX[3], EdgeDY[3], EdgeBias[3];
+	for (int i=0; i<3; ++i)
+	{
+		const RasterVertex &A = V[i];
+		const RasterVertex &B = V[(i+1) % 3];
+		EdgeDX[i] = B.X - A.X;
+		EdgeDY[i] = B.Y - A.Y;
+		bool TopLeft = (EdgeDY[i] < 0) || (EdgeDY[i] == 0 && EdgeDX[i] > 0);
+		EdgeBias[i] = TopLeft ? 0 : -1;
+	}
+
+	// barycentric weights in floating point, for interpolation only, relative to pixel (IX, IY).  that is where
+	// X0, Y0 would be without the scissor, so a pixel's depth comes out the same bits either way
+	int IX = std::max(T.OriginX, TileMinX);
+	int IY = std::max(T.OriginY, TileMinY);
+	double InvArea = 1.0 / (double)T.Area2;
+	float WeightDX[3], WeightDY[3], WeightC[3];
+	for (int i=0; i<3; ++i)
+	{
+		const RasterVertex &A = V[i];
+		int Opposite = (i + 2) % 3;
+		long long PX = (long long)IX * SUBPIXEL_SCALE + SUBPIXEL_SCALE/2;
+		long long PY = (long long)IY * SUBPIXEL_SCALE + SUBPIXEL_SCALE/2;
+		WeightDX[Opposite] = (float)(-EdgeDY[i] * SUBPIXEL_SCALE * InvArea);
+		WeightDY[Opposite] = (float)(EdgeDX[i] * SUBPIXEL_SCALE * InvArea);
+		WeightC[Opposite] = (float)(((long long)EdgeDX[i] * (PY - A.Y) - (long long)EdgeDY[i] * (PX - A.X)) * InvArea);
+	}
+
+	int StepX[3];
+	for (int i=0; i<3; ++i)
+		StepX[i] = -EdgeDY[i] * SUBPIXEL_SCALE;
+
+	UINT Tested = 0, Written = 0;
+	for (int y=Y0; y<=Y1; ++y)
+	{
+		long long PY = (long long)y * SUBPIXEL_SCALE + SUBPIXEL_SCALE/2;
+		long long PX = (long long)X0 * SUBPIXEL_SCALE + SUBPIXEL_SCALE/2;
+		int RowE[3];
+		for (int i=0; i<3; ++i)
+		{
+			long long E = (long long)EdgeDX[i] * (PY - V[i].Y) - (long long)EdgeDY[i] * (PX - V[i].X) + EdgeBias[i];
+			RowE[i] = (int)std::max((long long)-EDGE_CLAMP, std::min((long long)EDGE_CLAMP, E));
+		}
+
+#if SOFTWARE_RASTER_SSE
+		// lane k holds the edge function at pixel x+k
+		__m128i E0 = _mm_add_epi32(_mm_set1_epi32(RowE[0]), _mm_setr_epi32(0, StepX[0], 2*StepX[0], 3*StepX[0]));
+		__m128i E1 = _mm_add_epi32(_mm_set1_epi32(RowE[1]), _mm_setr_epi32(0, StepX[1], 2*StepX[1], 3*StepX[1]));
+		__m128i E2 = _mm_add_epi32(_mm_set1_epi32(RowE[2]), _mm_setr_epi32(0, StepX[2], 2*StepX[2], 3*StepX[2]));
+		__m128i Step0 = _mm_set1_epi32(4*StepX[0]);
+		__m128i Step1 = _mm_set1_epi32(4*StepX[1]);
+		__m128i Step2 = _mm_set1_epi32(4*StepX[2]);
+#endif
+
+		for (int x=X0; x<=X1; x+=4)
+		{
+			// bit k set if pixel x+k is covered
+			int Covered;
+#if SOFTWARE_RASTER_SSE
+			__m128i Any = _mm_or_si128(E0, _mm_or_si128(E1, E2));
+			Covered = ~_mm_movemask_ps(_mm_castsi128_ps(Any)) & 0xf;
+			E0 = _mm_add_epi32(E0, Step0);
+			E1 = _mm_add_epi32(E1, Step1);
+			E2 = _mm_add_epi32(E2, Step2);
+#else
+			Covered = 0;
+			for (int k=0; k<4; ++k)
+			{
+				int e0 = RowE[0] + k*StepX[0];
+				int e1 = RowE[1] + k*StepX[1];
+				int e2 = RowE[2] + k*StepX[2];
+				if ((e0 | e1 | e2) >= 0)
+					Covered |= (1 << k);
+			}
+			for (int i=0; i<3; ++i)
+				RowE[i] += 4*StepX[i];
+#endif
+			if (X1 - x < 3)
+				Covered &= (1 << (X1 - x + 1)) - 1;
+
+			while (Covered)
+			{
+				int k = 0;
+				while (!(Covered & (1 << k)))
+					++k;
+				Covered &= ~(1 << k);
+				int px = x + k;
+
+				UINT Index = y*Width + px;
+				++Tested;
+
+				// stencil test, all fail ops are KEEP
+				unsigned char Stencil = StencilBuffer[Index];
+				if (S.Stencil != STENCIL_DEFAULT && S.Stencil != STENCIL_SET && Stencil != (unsigned char)S.StencilRef)
+					continue;
+
+				float W[3];
+				for (int i=0; i<3; ++i)
+					W[i] = WeightC[i] + WeightDX[i] * (px - IX) + WeightDY[i] * (y - IY);
+
+				float Z = W[0]*V[0].Z + W[1]*V[1].Z + W[2]*V[2].Z + T.DepthBias;
+				Z = Saturate(Z);
+				if (S.Stencil != STENCIL_EQUAL_DEPTH_ALWAYS && !(Z < DepthBuffer[Index]))
+					continue;
+
+				float PixelW = 1.0f / (W[0]*V[0].InvW + W[1]*V[1].InvW + W[2]*V[2].InvW);
+				float Varyings[VARYING_COUNT];
+				for (int j=0; j<VARYING_COUNT; ++j)
+					Varyings[j] = (W[0]*V[0].Varyings[j] + W[1]*V[1].Varyings[j] + W[2]*V[2].Varyings[j]) * PixelW;
+
+				XMFLOAT4 Color;
+				if (!ShadePixel(S, Varyings, &Color))
+					continue;
+
+				ColorBuffer[Index] = PackColor(Color);
+				DepthBuffer[Index] = Z;
+				if (S.Stencil == STENCIL_SET)
+					StencilBuffer[Index] = (unsigned char)S.StencilRef;
+				else if (S.Stencil == STENCIL_EQUAL_INCREMENT)
+					StencilBuffer[Index] = (unsigned char)(Stencil + 1);
+				++Written;
+			}
+		}
+	}
+
+	*Tested_ptr += Tested;
+	*Written_ptr += Written;
+}
+
+// PS and PS_Level of RoomPortal.fx and Basic.fx, PS_Box and PS_BoxLevel of Portal.fx.  returns false for clip()
+bool SoftwareRenderBackend::ShadePixel(const PixelState &S, const float *Varyings, XMFLOAT4 *Color_ptr)const
+{
+	const float *PosW = &Varyings[VARYING_POS_W];
+	const XMFLOAT4 FogColor(0.7f, 0.7f, 0.7f, 1.0f);
+
+	if (S.PlaneClip)
+	{
+		float d[3] = { PosW[0] - S.ClipPlanePosition.x, PosW[1] - S.ClipPlanePosition.y, PosW[2] - S.ClipPlanePosition.z };
+		if (Dot3(d, &S.ClipPlaneNormal.x) - S.ClipPlaneOffset < 0.0f)
+			return false;
+	}
+
+	if (S.Shader == SHADER_BOX)
+	{
+		*Color_ptr = FogColor;
+		return true;
+	}
+
+	// the portals' holes and rings
+	XMFLOAT4 PortalColor(0.0f, 0.0f, 0.0f, 0.0f);
+	if (S.Shader == SHADER_ROOM)
+	{
+		const float *PosP[2] = { &Varyings[VARYING_POS_PA], &Varyings[VARYING_POS_PB] };
+		const Texture *PortalTex[2] = { PortalADiffuseMap, PortalBDiffuseMap };
+		float TexRadRatio[2] = { S.PortalATexRadRatio, S.PortalBTexRadRatio };
+		for (int p=0; p<2; ++p)
+		{
+			if (fabsf(PosP[p][2]) > PORTAL_PLANE_THRESHOLD)
+				continue;
+			if (S.DrawHoles && sqrtf(PosP[p][0]*PosP[p][0] + PosP[p][1]*PosP[p][1]) - 1.0f < 0.0f)
+				return false;
+
+			float u = (1.0f - PosP[p][0] / TexRadRatio[p]) / 2.0f;
+			float v = (1.0f - PosP[p][1] / TexRadRatio[p]) / 2.0f;
+			XMFLOAT4 c = Sample(PortalTex[p], u, v, false);
+			if (!PortalTex[p])
+				c = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+			PortalColor.x += c.x;
+			PortalColor.y += c.y;
+			PortalColor.z += c.z;
+			PortalColor.w += c.w;
+		}
+	}
+
+	float Normal[3] = { Varyings[VARYING_NORMAL_W], Varyings[VARYING_NORMAL_W+1], Varyings[VARYING_NORMAL_W+2] };
+	float NormalLength = sqrtf(Dot3(Normal, Normal));
+	if (NormalLength > 0.0f)
+		for (int i=0; i<3; ++i)
+			Normal[i] /= NormalLength;
+
+	float ToEye[3] = { S.EyePosition.x - PosW[0], S.EyePosition.y - PosW[1], S.EyePosition.z - PosW[2] };
+	float DistToEye = sqrtf(Dot3(ToEye, ToEye));
+	if (DistToEye > 0.0f)
+		for (int i=0; i<3; ++i)
+			ToEye[i] /= DistToEye;
+
+	XMFLOAT4 TexColor = Sample(S.DiffuseMap, Varyings[VARYING_TEX], Varyings[VARYING_TEX+1], true);
+
+	// ComputeDirectionalLight for each light
+	float Ambient[4] = { 0, 0, 0, 0 }, Diffuse[4] = { 0, 0, 0, 0 }, Spec[4] = { 0, 0, 0, 0 };
+	const float *MatAmbient = &S.Mat.Ambient.x;
+	const float *MatDiffuse = &S.Mat.Diffuse.x;
+	const float *MatSpecular = &S.Mat.Specular.x;
+	for (int l=0; l<3; ++l)
+	{
+		const DirectionalLight &L = S.Lights[l];
+		const float *LightAmbient = &L.Ambient.x;
+		const float *LightDiffuse = &L.Diffuse.x;
+		const float *LightSpecular = &L.Specular.x;
+		for (int i=0; i<4; ++i)
+			Ambient[i] += MatAmbient[i] * LightAmbient[i];
+
+		float LightVec[3] = { -L.Direction.x, -L.Direction.y, -L.Direction.z };
+		float DiffuseFactor = Dot3(LightVec, Normal);
+		if (DiffuseFactor > 0.0f)
+		{
+			// reflect(-LightVec, Normal)
+			float d = -Dot3(LightVec, Normal);
+			float R[3] = { -LightVec[0] - 2.0f*d*Normal[0], -LightVec[1] - 2.0f*d*Normal[1], -LightVec[2] - 2.0f*d*Normal[2] };
+			float SpecFactor = powf(std::max(Dot3(R, ToEye), 0.0f), S.Mat.Specular.w);
+			for (int i=0; i<4; ++i)
+			{
+				Diffuse[i] += DiffuseFactor * MatDiffuse[i] * LightDiffuse[i];
+				Spec[i] += SpecFactor * MatSpecular[i] * LightSpecular[i];
+			}
+		}
+	}
+
+	const float *Tex = &TexColor.x;
+	float Lit[4];
+	for (int i=0; i<4; ++i)
+		Lit[i] = Tex[i] * (Ambient[i] + Diffuse[i]) + Spec[i];
+
+	if (S.Shader == SHADER_ROOM)
+	{
+		const float *PC = &PortalColor.x;
+		for (int i=0; i<3; ++i)
+			Lit[i] = PortalColor.w * PC[i] + (1.0f - PortalColor.w) * Lit[i];
+	}
+
+	float FogT = Saturate((DistToEye / S.ViewScale - FOG_START) / FOG_RANGE);
+	const float *Fog = &FogColor.x;
+	for (int i=0; i<3; ++i)
+		Lit[i] = Lit[i] + FogT * (Fog[i] - Lit[i]);
+
+	*Color_ptr = XMFLOAT4(Lit[0], Lit[1], Lit[2], S.Mat.Diffuse.w * TexColor.w);
+	return true;
+}
+
+// bilinear.  Wrap is samAnisotropic's addressing, otherwise samAnisotropicBlackBorder's.  no texture is white
+XMFLOAT4 SoftwareRenderBackend::Sample(const Texture *Tex, float u, float v, bool Wrap)
+{
+	if (!Tex || Tex->Texels.empty())
+		return XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+
+	float x = u * Tex->Width - 0.5f;
+	float y = v * Tex->Height - 0.5f;
+	float fx = floorf(x), fy = floorf(y);
+	float tx = x - fx, ty = y - fy;
+	int x0 = (int)fx, y0 = (int)fy;
+
+	float Sum[4] = { 0, 0, 0, 0 };
+	for (int j=0; j<2; ++j)
+	{
+		for (int i=0; i<2; ++i)
+		{
+			int sx = x0 + i, sy = y0 + j;
+			XMFLOAT4 c(0.0f, 0.0f, 0.0f, 0.0f);
+			if (Wrap)
+			{
+				sx = ((sx % (int)Tex->Width) + Tex->Width) % Tex->Width;
+				sy = ((sy % (int)Tex->Height) + Tex->Height) % Tex->Height;
+				c = UnpackColor(Tex->Texels[sy*Tex->Width + sx]);
+			}
+			else if (sx >= 0 && sy >= 0 && sx < (int)Tex->Width && sy < (int)Tex->Height)
+				c = UnpackColor(Tex->Texels[sy*Tex->Width + sx]);
+
+			float w = (i ? tx : 1.0f - tx) * (j ? ty : 1.0f - ty);
+			Sum[0] += w * c.x;
+			Sum[1] += w * c.y;
+			Sum[2] += w * c.z;
+			Sum[3] += w * c.w;
+		}
+	}
+	return XMFLOAT4(Sum[0], Sum[1], Sum[2], Sum[3]);
+}
@@ -0,0 +1,221 @@
+#ifndef SOFTWARERENDERBACKEND_H
+#define SOFTWARERENDERBACKEND_H
+
+#include "d3dUtil.h"
+#include "Macros.h"
+#include "Light.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "GeometryGenerator.h"
+#include "RenderBackend.h"
+
+// RenderBackend that rasterizes on the CPU into its own color, depth and 8-bit stencil buffers, with the same
+// depth-stencil states as RenderStates, the same culling and depth bias as the effects' rasterizer states, and
+// the pixel logic of RoomPortal.fx, Basic.fx and Portal.fx.  draws are transformed, clipped and set up as they
+// come in; the triangles are rasterized when the frame is read (or cleared), in screen tiles spread across
+// threads.  every tile draws its triangles in submission order, so the result doesn't depend on the thread count.
+// needs C++11 threads, so it's only built headless
+class SoftwareRenderBackend : public RenderBackend
+{
+public:
+	// RGBA8 texels, 0xAABBGGRR like DXGI_FORMAT_R8G8B8A8_UNORM
+	struct Texture
+	{
+		UINT Width;
+		UINT Height;
+		std::vector<UINT> Texels;
+	};
+
+	// where a mesh is in its MeshData, and what it's drawn with.  a null DiffuseMap samples as white
+	struct MeshDesc
+	{
+		const GeometryGenerator::MeshData *Data;
+		UINT IndexCount;
+		UINT IBOffset;
+		UINT VBOffset;
+		Material Mat;
+		XMFLOAT4X4 TexTransform;
+		const Texture *DiffuseMap;
+	};
+
+	// counted since BeginFrame
+	struct FrameStats
+	{
+		UINT Triangles;			// submitted
+		UINT ClippedTriangles;	// that needed clipping against the near, far or guard-band planes
+		UINT RasterTriangles;	// left after clipping and culling
+		UINT PixelsTested;		// covered pixels that went through the stencil and depth tests
+		UINT PixelsWritten;
+	};
+
+	SoftwareRenderBackend();
+	~SoftwareRenderBackend();
+
+	// ThreadCount 0 uses one thread per core
+	void Init(UINT Width, UINT Height, UINT ThreadCount);
+	void SetMesh(MeshType Mesh, const MeshDesc &Desc);
+
+	// light colors; SetLights only changes the directions.  a null portal texture draws no ring
+	void SetDirLights(const DirectionalLight Lights[3]);
+	void SetPortalTextures(const Texture *PortalADiffuseMap, const Texture *PortalBDiffuseMap);
+
+	// like RSSetViewports and ClearRenderTargetView/ClearDepthStencilView
+	void SetViewport(float TopLeftX, float TopLeftY, float Width, float Height);
+	void Clear(const XMFLOAT4 &Color);
+
+	UINT GetIndexCount(MeshType Mesh)const;
+	void BeginFrame();
+	void SetStencil(StencilMode Mode, UINT StencilRef);
+	void SetScissor(bool Enable, int Left, int Top, int Right, int Bottom);
+	void SetPortals(const Portal &PortalA, const Portal &PortalB);
+	void SetEye(XMFLOAT3 EyePosition, float ViewScale);
+	void SetLights(const XMFLOAT3 LightDirections[3]);
+	void SetClipPlane(XMFLOAT3 Position, XMFLOAT3 Normal, float Offset);
+	void SetObjectConstants(const XMFLOAT4X4 &World, const XMFLOAT4X4 &ViewProj);
+	void DrawIndexed(MeshType Mesh, ShadeMode Mode, UINT Start, UINT Count);
+	void SetLevelSlots(const LevelSlot *Slots, UINT SlotCount, const XMFLOAT4X4 &PlayerWorld);
+	void DrawLevel(MeshType Mesh, UINT Slot, bool PlaneClip, UINT Start, UINT Count);
+
+	// rasterizes everything drawn so far.  the buffer getters and WritePPM flush first
+	void Flush();
+
+	UINT GetWidth()const;
+	UINT GetHeight()const;
+	const std::vector<UINT>& GetColorBuffer();
+	const std::vector<unsigned char>& GetStencilBuffer();
+	const FrameStats& GetFrameStats()const;
+
+	// binary PPM of the color buffer, for golden images
+	bool WritePPM(const char *Path);
+	static bool LoadPPM(const char *Path, UINT *Width_ptr, UINT *Height_ptr, std::vector<UINT> &Pixels);
+
+	// stand-ins for the textures PortalsApp loads: a ring between InnerRadius and 1 (in texture radii), and a
+	// two-tone checkerboard
+	static void BuildRingTexture(Texture &Tex, UINT Size, float InnerRadius, const XMFLOAT4 &Color);
+	static void BuildCheckerTexture(Texture &Tex, UINT Size, UINT Squares, const XMFLOAT4 &ColorA, const XMFLOAT4 &ColorB);
+
+private:
+	enum ShaderType { SHADER_ROOM = 0, SHADER_BASIC, SHADER_BOX };
+
+	// everything a pixel of a draw needs.  a new one is only added when a Set* call or the draw's mesh or
+	// shader changed it
+	struct PixelState
+	{
+		ShaderType Shader;
+		StencilMode Stencil;
+		UINT StencilRef;
+		bool PlaneClip;
+		bool DrawHoles;
+		XMFLOAT3 ClipPlanePosition;
+		XMFLOAT3 ClipPlaneNormal;
+		float ClipPlaneOffset;
+		DirectionalLight Lights[3];
+		XMFLOAT3 EyePosition;
+		float ViewScale;
+		Material Mat;
+		const Texture *DiffuseMap;
+		float PortalATexRadRatio;
+		float PortalBTexRadRatio;
+	};
+
+	// interpolated per vertex, premultiplied by 1/w once set up
+	enum { VARYING_POS_W = 0, VARYING_NORMAL_W = 3, VARYING_TEX = 6, VARYING_POS_PA = 8, VARYING_POS_PB = 11,
+			VARYING_COUNT = 14 };
+
+	struct ClipVertex
+	{
+		float PosH[4];
+		float Varyings[VARYING_COUNT];
+	};
+
+	struct RasterVertex
+	{
+		int X, Y;				// fixed point, SOFTWARE_RASTER_SUBPIXEL_BITS fraction bits
+		float Z;
+		float InvW;
+		float Varyings[VARYING_COUNT];
+	};
+
+	struct RasterTriangle
+	{
+		UINT State;
+		UINT FirstVertex;		// into RasterVertices, 3 in a row
+		int MinX, MinY, MaxX, MaxY;		// pixel bounds, inclusive, within the viewport and the scissor rect
+		int OriginX, OriginY;			// MinX and MinY before the scissor, where interpolation is anchored
+		long long Area2;		// twice the fixed point area, always positive
+		float DepthBias;
+	};
+
+	UINT Width;
+	UINT Height;
+	std::vector<UINT> ColorBuffer;
+	std::vector<float> DepthBuffer;
+	std::vector<unsigned char> StencilBuffer;
+	float ViewportX, ViewportY, ViewportWidth, ViewportHeight;
+	bool ScissorEnabled;
+	int ScissorLeft, ScissorTop, ScissorRight, ScissorBottom;		// Right and Bottom exclusive
+
+	MeshDesc Meshes[MESH_COUNT];
+	DirectionalLight DirLights[3];
+	const Texture *PortalADiffuseMap;
+	const Texture *PortalBDiffuseMap;
+
+	// current state, from the Set* calls.  StateVersion changes with every one of them, so a draw can tell
+	// whether the last PixelState still holds
+	PixelState Current;
+	UINT StateVersion;
+	UINT LastStateVersion;
+	int LastDrawKey;
+	XMFLOAT4X4 World;
+	XMFLOAT4X4 ViewProj;
+	XMFLOAT4X4 PortalA;
+	XMFLOAT4X4 PortalB;
+	std::vector<LevelSlot> Slots;
+	XMFLOAT4X4 PlayerWorld;
+
+	// work waiting for Flush
+	std::vector<PixelState> States;
+	std::vector<RasterVertex> RasterVertices;
+	std::vector<RasterTriangle> RasterTriangles;
+	FrameStats Stats;
+
+	// per draw transform cache: Transformed[i] holds vertex i if TransformStamp[i] == DrawStamp
+	std::vector<ClipVertex> Transformed;
+	std::vector<UINT> TransformStamp;
+	UINT DrawStamp;
+
+	// tiles and the threads that rasterize them
+	UINT TilesX, TilesY;
+	std::vector<std::vector<UINT> > TileBins;
+	std::vector<std::thread> Workers;
+	std::mutex WorkMutex;
+	std::condition_variable WorkReady;
+	std::condition_variable WorkDone;
+	UINT WorkGeneration;
+	UINT WorkersBusy;
+	bool Quit;
+	std::atomic<UINT> NextTile;
+	std::atomic<UINT> PixelsTested;
+	std::atomic<UINT> PixelsWritten;
+
+	UINT AddState();
+	void Draw(MeshType Mesh, UINT Start, UINT Count, bool Level, UINT Slot);
+	void TransformVertex(const GeometryGenerator::Vertex &V, ShaderType Shader, const XMFLOAT4X4 &ObjectWorld,
+				const XMFLOAT4X4 &NormalMatrix, const XMFLOAT4X4 &ObjectViewProj, bool ClearDepth,
+				const XMFLOAT4X4 &TexTransform, ClipVertex *Out_ptr)const;
+	void AddTriangle(const ClipVertex *A, const ClipVertex *B, const ClipVertex *C, UINT State, bool DepthBias);
+	void SetupTriangle(const ClipVertex *A, const ClipVertex *B, const ClipVertex *C, UINT State, bool DepthBias);
+
+	void WorkerLoop();
+	void RasterizeTiles();
+	void RasterizeTile(UINT TileX, UINT TileY);
+	void RasterizeTriangle(const RasterTriangle &T, int TileMinX, int TileMinY, int TileMaxX, int TileMaxY,
+				UINT *Tested_ptr, UINT *Written_ptr);
+	bool ShadePixel(const PixelState &S, const float *Varyings, XMFLOAT4 *Color_ptr)const;
+	static XMFLOAT4 Sample(const Texture *Tex, float u, float v, bool Wrap);
+};
+
+#endif
@@ -3,7 +3,7 @@
 
 
 void SpherePath::MoveCameraAlongPathIterative(Camera &Cam, XMFLOAT3 Dir, float MoveDist,
-									const Room &Level, const Portal &OrangePortal, const Portal &BluePortal)
+									const Room &Level, const PortalSet &Portals, Room::CandidateCache *Cache)
 {
 	float XDist;
 	float RedirectRatio;
@@ -13,7 +13,7 @@ void SpherePath::MoveCameraAlongPathIterative(Camera &Cam, XMFLOAT3 Dir, float M
 	bool RedirectNecessary;
 
 	// primary path
-	RedirectNecessary = MoveCameraAlongPath(Cam, Dir, MoveDist, Level, OrangePortal, BluePortal, &XDist, &RedirectRatio, &RedirectDir);
+	RedirectNecessary = MoveCameraAlongPath(Cam, Dir, MoveDist, Level, Portals, Cache, &XDist, &RedirectRatio, &RedirectDir);
 
 	// check if secondary path is necessary
 	if (!RedirectNecessary)
@@ -21,7 +21,7 @@ void SpherePath::MoveCameraAlongPathIterative(Camera &Cam, XMFLOAT3 Dir, float M
 
 	// calculate secondary path
 	float MoveDist2 = (MoveDist - XDist) * RedirectRatio;
-	RedirectNecessary = MoveCameraAlongPath(Cam, RedirectDir, MoveDist2, Level, OrangePortal, BluePortal, &XDist, &RedirectRatio, &RedirectDir);
+	RedirectNecessary = MoveCameraAlongPath(Cam, RedirectDir, MoveDist2, Level, Portals, Cache, &XDist, &RedirectRatio, &RedirectDir);
 	
 	// check if tertiary path is necessary
 	if (!RedirectNecessary)
@@ -29,7 +29,24 @@ void SpherePath::MoveCameraAlongPathIterative(Camera &Cam, XMFLOAT3 Dir, float M
 
 	// calculate teriary path
 	float MoveDist3 = (MoveDist2 - XDist) * RedirectRatio;
-	MoveCameraAlongPath(Cam, RedirectDir, MoveDist3, Level, OrangePortal, BluePortal, &XDist, &RedirectRatio, &RedirectDir);
+	MoveCameraAlongPath(Cam, RedirectDir, MoveDist3, Level, Portals, Cache, &XDist, &RedirectRatio, &RedirectDir);
+}
+
+UINT SpherePath::MoveCameraSubstepped(Camera &Cam, float ForwardSteps, float RightSteps, float UpSteps,
+									float MoveDist, UINT Substeps, const Room &Level, const PortalSet &Portals,
+									Room::CandidateCache *Cache)
+{
+	for (UINT i=0; i<Substeps; ++i)
+	{
+		Vec3 Dir = 	ForwardSteps*Vec3Load(Cam.GetLook()) +
+					RightSteps*Vec3Load(Cam.GetRight()) +
+					UpSteps*Vec3Load(Cam.GetBodyUp());
+		if (Vec3LengthSq(Dir)==0.0f)
+			return i;
+
+		MoveCameraAlongPathIterative(Cam, Vec3Store(Vec3Normalize(Dir)), MoveDist / Substeps, Level, Portals, Cache);
+	}
+	return Substeps;
 }
 
 
@@ -39,7 +56,7 @@ void SpherePath::MoveCameraAlongPathIterative(Camera &Cam, XMFLOAT3 Dir, float M
 
 
 bool SpherePath::MoveCameraAlongPath(Camera &Cam, XMFLOAT3 Dir, float MoveDist,
-										const Room &Level, const Portal &OrangePortal, const Portal &BluePortal,
+										const Room &Level, const PortalSet &Portals, Room::CandidateCache *Cache,
 										float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr)
 {
 	// get some info about the path
@@ -48,18 +65,14 @@ bool SpherePath::MoveCameraAlongPath(Camera &Cam, XMFLOAT3 Dir, float MoveDist,
 	MoveDist *= Cam.GetViewScale();
 
 
-	// is the camera currently clipping the portal?
+	// is the camera currently clipping a portal?
 
-	// SPHERE CLIPPING ORANGE PORTAL
-	if (OrangePortal.DiscIntersectSphere(S, SphereRadius))
+	// SPHERE CLIPPING A PORTAL
+	int ClipIndex = Portals.FindPortalIntersectingSphere(S, SphereRadius);
+	if (ClipIndex >= 0)
 	{
-		return MoveClippedCamera(Cam, Dir, MoveDist, Level, OrangePortal, BluePortal, XDist_ptr, RedirectRatio_ptr, RedirectDir_ptr);
-	}
-	
-	// SPHERE CLIPPING BLUE PORTAL
-	if (BluePortal.DiscIntersectSphere(S, SphereRadius))
-	{
-		return MoveClippedCamera(Cam, Dir, MoveDist, Level, BluePortal, OrangePortal, XDist_ptr, RedirectRatio_ptr, RedirectDir_ptr);
+		return MoveClippedCamera(Cam, Dir, MoveDist, Level, Portals.GetPairOfPortal(ClipIndex), Portals.GetPortal(ClipIndex),
+									Cache, XDist_ptr, RedirectRatio_ptr, RedirectDir_ptr);
 	}
 	
 	// SPHERE NOT CLIPPING A PORTAL
@@ -71,7 +84,7 @@ bool SpherePath::MoveCameraAlongPath(Camera &Cam, XMFLOAT3 Dir, float MoveDist,
 	XMFLOAT3 RedirectDir;
 	XMFLOAT3 RoomT;
 	XMFLOAT3 RoomTNormal;
-	X = Level.SpherePathCollision(SphereRadius, S, Dir, MoveDist, &XDist, &RedirectRatio, &RedirectDir, &RoomT, &RoomTNormal);
+	X = Level.SpherePathCollision(SphereRadius, S, Dir, MoveDist, &XDist, &RedirectRatio, &RedirectDir, &RoomT, &RoomTNormal, Cache);
 
 	// if no room collision occurs, simply move the camera to the pathend and we're done
 	if (XDist == MoveDist)
@@ -81,18 +94,11 @@ bool SpherePath::MoveCameraAlongPath(Camera &Cam, XMFLOAT3 Dir, float MoveDist,
 	}
 		
 	// check if the tangent point T is inside a portal disc
-	XMFLOAT3 TtoPortalCenter;
-	TtoPortalCenter = OrangePortal.GetPosition() - RoomT;
-	if ( abs(XMFloat3Dot(TtoPortalCenter, OrangePortal.GetNormal())) < PORTALS_SAME_PLANE_THRESHOLD &&
-			XMFloat3Length(TtoPortalCenter) < OrangePortal.GetPhysicalRadius() )				// T is inside orange disc
-	{
-		return MoveClippedCamera(Cam, Dir, MoveDist, Level, OrangePortal, BluePortal, XDist_ptr, RedirectRatio_ptr, RedirectDir_ptr);
-	}
-	TtoPortalCenter = BluePortal.GetPosition() - RoomT;
-	if ( abs(XMFloat3Dot(TtoPortalCenter, BluePortal.GetNormal())) < PORTALS_SAME_PLANE_THRESHOLD &&
-			XMFloat3Length(TtoPortalCenter) < BluePortal.GetPhysicalRadius() )					// T is inside blue disc
+	ClipIndex = Portals.FindPortalContainingTangentPoint(RoomT);
+	if (ClipIndex >= 0)
 	{
-		return MoveClippedCamera(Cam, Dir, MoveDist, Level, BluePortal, OrangePortal, XDist_ptr, RedirectRatio_ptr, RedirectDir_ptr);
+		return MoveClippedCamera(Cam, Dir, MoveDist, Level, Portals.GetPairOfPortal(ClipIndex), Portals.GetPortal(ClipIndex),
+									Cache, XDist_ptr, RedirectRatio_ptr, RedirectDir_ptr);
 	}
 
 
@@ -137,16 +143,18 @@ void SpherePath::UpdateClosestCollision(XMFLOAT3 *ClosestX_ptr, float *ClosestXD
 // returns whether or not a redirect is possible afterwards
 
 bool SpherePath::MoveClippedCamera(Camera &Cam, XMFLOAT3 Dir, float MoveDist,
-										const Room &Level, const Portal &ClipPortal, const Portal &OtherPortal,
-										float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr)
+										const Room &Level, const PortalPair &Portals, const Portal &ClipPortal,
+										Room::CandidateCache *Cache, float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr)
 {
+	const Portal &OtherPortal = Portals.GetOther(ClipPortal);
+
 	// fetch some necessary values about path
 	float SphereRadius = Cam.GetBoundingSphereRadius();
 	XMFLOAT3 S = Cam.GetPosition();
 	
 
 	// default values
-	XMFLOAT3 ClosestX = S + MoveDist*Dir;
+	XMFLOAT3 ClosestX = Vec3Store(Vec3Load(S) + MoveDist*Vec3Load(Dir));
 	float ClosestXDist = MoveDist;
 	float ClosestRedirectRatio = 1.0f;
 	XMFLOAT3 ClosestRedirectDir = Dir;
@@ -165,21 +173,21 @@ bool SpherePath::MoveClippedCamera(Camera &Cam, XMFLOAT3 Dir, float MoveDist,
 	UpdateClosestCollision(&ClosestX, &ClosestXDist, &ClosestRedirectRatio, &ClosestRedirectDir, X, XDist, RedirectRatio, RedirectDir);
 
 
-	XMMATRIX Virtualize = Portal::CalculateVirtualizationMatrix(OtherPortal, ClipPortal);
+	const XMMATRIX &Virtualize = Portals.GetVirtualize(OtherPortal);
 
 
 	// check if this path is heading into or away from the portal
-	if (XMFloat3Dot(Dir, ClipPortal.GetNormal()) < 0.0f)	// heading into
+	if (Vec3Dot(Vec3Load(Dir), Vec3Load(ClipPortal.GetNormal())) < 0.0f)	// heading into
 	{
 		// collision with the virtual room on the other side of ClipPortal
-		XMMATRIX Unvirtualize = Portal::CalculateVirtualizationMatrix(ClipPortal, OtherPortal);
+		const XMMATRIX &Unvirtualize = Portals.GetUnvirtualize(OtherPortal);
 		X = Level.SpherePathVirtualCollision(Virtualize, Unvirtualize, SphereRadius, S, Dir, MoveDist, &XDist, &RedirectRatio, &RedirectDir);
 	}
 	else		// heading out of
 	{
 		// collision with room
 		XMFLOAT3 T, TNormal;
-		X = Level.SpherePathCollision(SphereRadius, S, Dir, MoveDist, &XDist, &RedirectRatio, &RedirectDir, &T, &TNormal);
+		X = Level.SpherePathCollision(SphereRadius, S, Dir, MoveDist, &XDist, &RedirectRatio, &RedirectDir, &T, &TNormal, Cache);
 	}
 	UpdateClosestCollision(&ClosestX, &ClosestXDist, &ClosestRedirectRatio, &ClosestRedirectDir, X, XDist, RedirectRatio, RedirectDir);
 
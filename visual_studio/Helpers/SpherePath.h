@@ -5,13 +5,23 @@
 #include "Camera.h"
 #include "Room.h"
 #include "Portal.h"
+#include "PortalPair.h"
+#include "PortalSet.h"
 #include "FirstPersonObject.h"
 
 class SpherePath
 {
 public:
+	// Cache, if given, holds the wall edges near Cam between calls; keep one per camera
 	static void MoveCameraAlongPathIterative(Camera &Cam, XMFLOAT3 Dir, float MoveDist,
-									const Room &Level, const Portal &OrangePortal, const Portal &BluePortal);
+									const Room &Level, const PortalSet &Portals, Room::CandidateCache *Cache=NULL);
+
+	// moves Cam MoveDist along its look, right and body-up axes weighted by the steps, in Substeps equal sweeps.
+	// the direction is taken from the camera's axes again before every sweep, since going through a portal
+	// turns them.  returns the sweeps made, 0 if the steps add up to no direction
+	static UINT MoveCameraSubstepped(Camera &Cam, float ForwardSteps, float RightSteps, float UpSteps,
+									float MoveDist, UINT Substeps, const Room &Level, const PortalSet &Portals,
+									Room::CandidateCache *Cache=NULL);
 
 	/*
 	static XMFLOAT3 SpherePathNoSelfClipFindEnd(const FirstPersonObject &Player, XMFLOAT3 S, XMFLOAT3 Dir, float MoveDist,
@@ -22,7 +32,7 @@ private:
 
 	// returns whether or not a redirect is necessary
 	static bool MoveCameraAlongPath(Camera &Cam, XMFLOAT3 Dir, float MoveDist,
-										const Room &Level, const Portal &OrangePortal, const Portal &BluePortal,
+										const Room &Level, const PortalSet &Portals, Room::CandidateCache *Cache,
 										float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr);
 
 	static void UpdateClosestCollision(XMFLOAT3 *ClosestX_ptr, float *ClosestXDist_ptr,
@@ -33,8 +43,8 @@ private:
 	// computes collision for a camera that's already clipping a portal that moves
 	// against the portal normal (heading into portal)
 	static bool MoveClippedCamera(Camera &Cam, XMFLOAT3 Dir, float MoveDist,
-										const Room &Level, const Portal &ClipPortal, const Portal &OtherPortal,
-										float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr);
+										const Room &Level, const PortalPair &Portals, const Portal &ClipPortal,
+										Room::CandidateCache *Cache, float *XDist_ptr, float *RedirectRatio_ptr, XMFLOAT3 *RedirectDir_ptr);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+// hands the latest of a stream of T from one writer thread to one reader thread without locks.  the writer
+// fills GetWriteSlot() and calls Publish(); the reader calls Acquire() and reads GetReadSlot() until its next
+// Acquire().  each side only ever touches its own slot, and the third is swapped between them with a single
+// atomic exchange, so neither side ever waits on the other.  the reader skips any T published while it was
+// holding its slot, and keeps its slot if nothing new was published.
+// T is updated in place, never copied, so it may hold pointers into itself
+template <class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+		: Back(0), Middle(1), Front(2)
+	{
+	}
+
+	T& GetWriteSlot()
+	{
+		return Slots[Back];
+	}
+
+	// makes the write slot the latest, and takes the middle one to write next
+	void Publish()
+	{
+		Back = Exchange(Back | FRESH) & INDEX_MASK;
+	}
+
+	// returns whether a newer T was published since the last Acquire; if so, it's now the read slot
+	bool Acquire()
+	{
+		if (!(Load() & FRESH))
+			return false;
+		Front = Exchange(Front) & INDEX_MASK;
+		return true;
+	}
+
+	const T& GetReadSlot()const
+	{
+		return Slots[Front];
+	}
+
+	// only for before the reader and writer start, e.g. to set up pointers into each slot
+	T& GetSlot(int i)
+	{
+		return Slots[i];
+	}
+
+private:
+	enum { INDEX_MASK = 3, FRESH = 4 };
+
+	// the middle slot's index, and FRESH if it's newer than the read slot
+	long Exchange(long Value)
+	{
+#ifdef _MSC_VER
+		return InterlockedExchange(&Middle, Value);
+#else
+		return __atomic_exchange_n(&Middle, Value, __ATOMIC_ACQ_REL);
+#endif
+	}
+
+	long Load()const
+	{
+#ifdef _MSC_VER
+		return Middle;		// volatile reads have acquire semantics in MSVC
+#else
+		return __atomic_load_n(&Middle, __ATOMIC_ACQUIRE);
+#endif
+	}
+
+private:
+	T Slots[3];
+	long Back;				// only the writer touches this
+	volatile long Middle;
+	long Front;				// only the reader touches this
+
+	// not copyable, since T may point into itself
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "Vertex.h"
 
 ID3D11InputLayout* InputLayouts::Basic32 = 0;
+ID3D11InputLayout* InputLayouts::Basic32Level = 0;
 
 
 void InputLayouts::InitAll(ID3D11Device* device)
@@ -17,10 +18,23 @@ void InputLayouts::InitAll(ID3D11Device* device)
 	Effects::BasicFX->Light3Tech->GetPassByIndex(0)->GetDesc(&passDesc);
 	HR(device->CreateInputLayout(Basic32InputLayoutDesc, 3, passDesc.pIAInputSignature, 
 		passDesc.IAInputSignatureSize, &Basic32));
+
+	const D3D11_INPUT_ELEMENT_DESC Basic32LevelInputLayoutDesc[4] = 
+	{
+		{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"LEVELSLOT", 0, DXGI_FORMAT_R32_UINT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1}
+	};
+
+	Effects::BasicFX->Light3TexLevelTech->GetPassByIndex(0)->GetDesc(&passDesc);
+	HR(device->CreateInputLayout(Basic32LevelInputLayoutDesc, 4, passDesc.pIAInputSignature, 
+		passDesc.IAInputSignatureSize, &Basic32Level));
 }
 
 void InputLayouts::DestroyAll()
 {
 	ReleaseCOM(Basic32);
+	ReleaseCOM(Basic32Level);
 }
 
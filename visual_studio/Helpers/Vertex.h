@@ -22,6 +22,7 @@ public:
 	static void DestroyAll();
 
 	static ID3D11InputLayout* Basic32;
+	static ID3D11InputLayout* Basic32Level;	// Basic32, plus a per-instance level slot index in input slot 1
 };
 
 #endif
\ No newline at end of file
@@ -14,6 +14,18 @@
 #include "Camera.h"
 #include "RenderStates.h"
 #include "SpherePath.h"
+#include "PortalPair.h"
+#include "PortalSet.h"
+#include "PortalRecursionPlanner.h"
+#include "PortalSceneRenderer.h"
+#include "D3D11RenderBackend.h"
+#include "RoomFile.h"
+#include "RoomBinary.h"
+#include "InputScript.h"
+#include "SceneSnapshot.h"
+#include "SceneInterpolator.h"
+#include "TripleBuffer.h"
+#include "FixedTimestep.h"
 #include "Macros.h"
 
 
@@ -35,42 +47,21 @@ public:
 
 private:
 
-	bool GetNextDataLine(std::ifstream &ifs, std::string &Line);
+	// one tick of the simulation thread.  returns the movement sweeps made
+	UINT StepSimulation(float dt);
+	static DWORD WINAPI SimulationThreadProc(LPVOID App_ptr);
+	DWORD RunSimulation();
 
 	void BuildRoomGeometryBuffers();
 	void BuildPlayerGeometryBuffers();
 	void BuildPortalGeometryBuffers();
 
-	void DrawRoomBothPortals(bool PlaneClip, const XMMATRIX &World, const XMMATRIX &ViewProj, float ViewScale);
-	void DrawPlayer(bool PlaneClip, const XMMATRIX &World, const XMMATRIX &ViewProj, float ViewScale);
-	
-	void DrawPortalBox(bool PlaneClip, const XMMATRIX &World, const XMMATRIX &ViewProj);
-	void DrawPortalBoxClearDepth(const XMMATRIX &World, const XMMATRIX &ViewProj);
-
-	void DrawRoomBothPortalsNoHoles(const XMMATRIX &World, const XMMATRIX &ViewProj, float ViewScale);
-
-
-	void RenderPortalInsidesPlayerNoClip(const Portal &LookThruPortal, const XMMATRIX &Virtualize,
-						const XMMATRIX &InitialWorldToVirtual, UINT InitialStencilRef, int Levels,
-						const XMMATRIX &ViewProj, float ViewScale);
-
-	
-	void RenderPortalInsidesPlayerClip(const Portal &LookThruPortal, const XMMATRIX &Virtualize,
-						const XMMATRIX &InitialWorldToVirtual, const XMMATRIX &InitialPlayerWorldToVirtual,
-						UINT InitialStencilRef, int Levels,
-						const XMMATRIX &ViewProj, float ViewScale);
 	
 
 private:
 	
 	DirectionalLight mDirLights[3];
 
-	// added so we don't have to keep redeclaring them inside draw functions
-	const UINT mStride;
-	const UINT mOffset;
-	ID3DX11EffectTechnique* mTech;
-	D3DX11_TECHNIQUE_DESC mTechDesc;
-
 	
 	Camera *mCurrentCamera_ptr;
 
@@ -81,22 +72,48 @@ private:
 
 	// MOUSE STUFF ****************************************
 	POINT mLastMousePos;
-	bool mRightButtonIsDown;
+	volatile bool mRightButtonIsDown;
+
+	// mouse rotation since the last tick, added by the window thread and taken by the simulation thread
+	CRITICAL_SECTION mInputLock;
+	float mPendingRotateUp;
+	float mPendingRotateRight;
+
+
+	// SIMULATION THREAD STUFF ****************************************
+	// the simulation runs on its own thread at SIMULATION_TICK_RATE, and owns the cameras, player, portals and
+	// portal set once it's started.  after every tick it publishes a snapshot of them, which the render thread
+	// draws from without ever waiting on it
+	HANDLE mSimulationThread;
+	volatile bool mQuitSimulation;
+	TripleBuffer<SceneSnapshot> mSnapshots;
+
+	// the cameras and player drawn, between the last two snapshots
+	SceneInterpolator mInterpolator;
+	double mSnapshotAcquiredTime;	// mTimer time the latest snapshot was acquired at
+
+#if RECORD_INPUT
+	// input of the current frame, written to INPUT_RECORDING_FILE_PATH for the headless simulation to replay
+	std::ofstream mInputRecording;
+	InputFrame mRecordedFrame;
+#endif
 
 
 	// CAMERA STUFF ******************************************************************
 	Camera mLeftCamera;
 	Camera mRightCamera;
 
-	XMMATRIX mLeftViewProj;
-	float mLeftViewScale;
-	XMMATRIX mRightViewProj;
-	float mRightViewScale;
+	// wall edges near each camera, reused across ticks while the camera stays among them
+	Room::CandidateCache mLeftCameraCache;
+	Room::CandidateCache mRightCameraCache;
 
 	
 	// ROOM STUFF ***********************************************************************
 	Room mRoom;
 
+	// mapped level file when ROOM_FILE_PATH is a .bin, kept open until its mesh is in the buffers
+	RoomBinary mRoomBinary;
+
 	// room geometry (walls, floor, ceiling)
 	ID3D11Buffer* mRoomVB;
 	ID3D11Buffer* mRoomIB;
@@ -129,9 +146,19 @@ private:
 	Portal mBluePortal;
 	ID3D11ShaderResourceView* mBluePortalSRV;
 
+	// caches the virtualization matrices between the two portals
+	PortalPair mPortalPair;
+
+	// every portal pair in the level, for collision and portal placement.  only mPortalPair is rendered
+	PortalSet mPortalSet;
+
 	bool mPlayerIntersectOrangePortal;
 	bool mPlayerIntersectBluePortal;
 
+	// draws both viewports as commands to mRenderBackend
+	PortalSceneRenderer mSceneRenderer;
+	D3D11RenderBackend mRenderBackend;
+
 
 	// portal geometry (face, box)
 	// use same buffers for both portals, only changing the world transformation and face texture
@@ -178,14 +205,19 @@ PortalsApp::PortalsApp(HINSTANCE hInstance)
 	mFloorIndexCount(0), mFloorIBOffset(0), mFloorVBOffset(0), 
 	mCeilingIndexCount(0), mCeilingIBOffset(0), mCeilingVBOffset(0), 
 	mPlayerIntersectOrangePortal(false), mPlayerIntersectBluePortal(false), 
-	mRightButtonIsDown(false),
-	mStride(sizeof(Vertex::Basic32)), mOffset(0)
+	mPortalPair(mOrangePortal, mBluePortal),
+	mRightButtonIsDown(false), mPendingRotateUp(0.0f), mPendingRotateRight(0.0f),
+	mSimulationThread(0), mQuitSimulation(false), mSnapshotAcquiredTime(0.0)
 {
+	InitializeCriticalSection(&mInputLock);
+
 	mMainWndCaption = L"PortalsApp";
 
 	mLastMousePos.x = 0;
 	mLastMousePos.y = 0;
 
+	mPortalSet.AddPair(mPortalPair);
+
 	// initialize fields and matrices etc
 
 	// 3 directional lights
@@ -240,6 +272,15 @@ PortalsApp::PortalsApp(HINSTANCE hInstance)
 
 PortalsApp::~PortalsApp()
 {
+	// stop the simulation before anything it uses goes away
+	if (mSimulationThread)
+	{
+		mQuitSimulation = true;
+		WaitForSingleObject(mSimulationThread, INFINITE);
+		CloseHandle(mSimulationThread);
+	}
+	DeleteCriticalSection(&mInputLock);
+
 	// release all resources
 	ReleaseCOM(mRoomVB);
 	ReleaseCOM(mRoomIB);
@@ -262,19 +303,6 @@ PortalsApp::~PortalsApp()
 }
 
 
-bool PortalsApp::GetNextDataLine(std::ifstream &ifs, std::string &Line)
-{
-	Line.clear();
-	while (std::getline(ifs, Line))
-	{
-		// find first non-space character.  skip if #
-		size_t StrBegin = Line.find_first_not_of(" \t");
-		if (StrBegin!=std::string::npos && Line[StrBegin]!='#')
-			break;
-	}
-	return (!ifs.eof());
-}
-
 bool PortalsApp::Init()
 {
 	if(!D3DApp::Init())
@@ -286,106 +314,12 @@ bool PortalsApp::Init()
 	RenderStates::InitAll(md3dDevice);
 
 	// read in room polygons from file
-	
-	std::ifstream ifs(ROOM_FILE_PATH);
-	std::string Line;
-
-	float a, b, c, d, e, f;
-
-	// left camera start position
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
-	mLeftCamera.SetPosition(XMFLOAT3(a, b, c));
-
-	// player 
-	
-	//radius
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f", &a);
-	mPlayer.SetBoundingSphereRadius(a);
-
-	// start position
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
-	mPlayer.SetPosition(XMFLOAT3(a, b, c));
-
-
-	// orange portal 
-	
-	// radius
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f", &a);
-	mOrangePortal.SetIntendedPhysicalRadius(a);
-
-	// position
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
-	mOrangePortal.SetPosition(XMFLOAT3(a, b, c));
-
-	// normal
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f %f %f", &d, &e, &f);
-	mOrangePortal.SetNormalAndUp(XMFLOAT3(a,b,c), XMFLOAT3(d,e,f));
-
-
-	// blue portal 
-	
-	// radius
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f", &a);
-	mBluePortal.SetIntendedPhysicalRadius(a);
-
-	// position
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
-	mBluePortal.SetPosition(XMFLOAT3(a, b, c));
-
-	// normal
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f %f %f", &a, &b, &c);
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f %f %f", &d, &e, &f);
-	mBluePortal.SetNormalAndUp(XMFLOAT3(a,b,c), XMFLOAT3(d,e,f));
-	
-
-	// floor, ceiling heights
-	GetNextDataLine(ifs, Line);
-	sscanf_s(Line.c_str(), "%f %f", &a, &b);
-	mRoom.SetFloorAndCeiling(a, b);
-
-
-	// room polygons
-
-	std::vector<std::vector<XMFLOAT2>> PolygonsList;
-	unsigned int Polygons = 0;
-	unsigned int Vertices;
-	while(GetNextDataLine(ifs, Line))
-	{
-		PolygonsList.push_back(std::vector<XMFLOAT2>());
-		
-		// read vertex count for this polygon
-		sscanf_s(Line.c_str(), "%d", &Vertices);
-
-		// resize vertexlist for this polygon
-		PolygonsList[Polygons].resize(Vertices);
-
-		// read vertices for this polygon
-		for (unsigned int i=0; i<Vertices; ++i)
-		{
-			GetNextDataLine(ifs, Line);
-			sscanf_s(Line.c_str(), "%f %f", &a, &b);
-			PolygonsList[Polygons][i] = XMFLOAT2(a, b);
-		}
-		++Polygons;
-	}
-	mRoom.SetTopography(PolygonsList);
+	if (RoomBinary::IsBinaryPath(ROOM_FILE_PATH) && mRoomBinary.Open(ROOM_FILE_PATH))
+		mRoomBinary.Load(mLeftCamera, mPlayer, mOrangePortal, mBluePortal, mRoom);
+	else
+		RoomFile::Load(ROOM_FILE_PATH, mLeftCamera, mPlayer, mOrangePortal, mBluePortal, mRoom);
 	mRoom.PrintBoundaries();
 
-	ifs.close();
-	PolygonsList.clear();
-
 	// set cameras' lenses
 	mLeftCamera.SetLens(0.01f, 500.0f, PI/4.0f);
 	mRightCamera.SetLens(0.01f, 500.0f, PI/4.0f);
@@ -393,6 +327,10 @@ bool PortalsApp::Init()
 	// attach right camera to player
 	mRightCamera.AttachToObject(&mPlayer);
 
+#if RECORD_INPUT
+	mInputRecording.open(INPUT_RECORDING_FILE_PATH);
+#endif
+
 
 	// room
 	HR(D3DX11CreateShaderResourceViewFromFile(md3dDevice, 
@@ -420,6 +358,66 @@ bool PortalsApp::Init()
 	BuildRoomGeometryBuffers();
 	BuildPortalGeometryBuffers();
 	BuildPlayerGeometryBuffers();
+
+	// meshes drawn by the render backend
+	mRenderBackend.Init(md3dDevice, md3dImmediateContext);
+
+	D3D11RenderBackend::MeshDesc Mesh;
+	Mesh.VB = mRoomVB;
+	Mesh.IB = mRoomIB;
+	Mesh.IndexCount = mWallsIndexCount;
+	Mesh.IBOffset = mWallsIBOffset;
+	Mesh.VBOffset = mWallsVBOffset;
+	Mesh.Mat = mWallsMaterial;
+	XMStoreFloat4x4(&Mesh.TexTransform, mWallsTexTransform);
+	Mesh.DiffuseMap = mWallsSRV;
+	mRenderBackend.SetMesh(RenderBackend::MESH_WALLS, Mesh);
+
+	Mesh.IndexCount = mFloorIndexCount;
+	Mesh.IBOffset = mFloorIBOffset;
+	Mesh.VBOffset = mFloorVBOffset;
+	Mesh.Mat = mFloorMaterial;
+	XMStoreFloat4x4(&Mesh.TexTransform, mFloorTexTransform);
+	Mesh.DiffuseMap = mFloorSRV;
+	mRenderBackend.SetMesh(RenderBackend::MESH_FLOOR, Mesh);
+
+	Mesh.IndexCount = mCeilingIndexCount;
+	Mesh.IBOffset = mCeilingIBOffset;
+	Mesh.VBOffset = mCeilingVBOffset;
+	Mesh.Mat = mCeilingMaterial;
+	XMStoreFloat4x4(&Mesh.TexTransform, mCeilingTexTransform);
+	Mesh.DiffuseMap = mCeilingSRV;
+	mRenderBackend.SetMesh(RenderBackend::MESH_CEILING, Mesh);
+
+	Mesh.VB = mPlayerVB;
+	Mesh.IB = mPlayerIB;
+	Mesh.IndexCount = mPlayerIndexCount;
+	Mesh.IBOffset = 0;
+	Mesh.VBOffset = 0;
+	Mesh.Mat = mPlayerMaterial;
+	XMStoreFloat4x4(&Mesh.TexTransform, mPlayerTexTransform);
+	Mesh.DiffuseMap = mPlayerSRV;
+	mRenderBackend.SetMesh(RenderBackend::MESH_PLAYER, Mesh);
+
+	Mesh.VB = mPortalVB;
+	Mesh.IB = mPortalIB;
+	Mesh.IndexCount = mPortalBoxIndexCount;
+	Mesh.DiffuseMap = 0;
+	mRenderBackend.SetMesh(RenderBackend::MESH_PORTAL_BOX, Mesh);
+	mRenderBackend.SetMesh(RenderBackend::MESH_PORTAL_BOX_CLEAR_DEPTH, Mesh);
+
+	mRenderBackend.SetDirLights(mDirLights);
+	mRenderBackend.SetPortalTextures(mOrangePortalSRV, mBluePortalSRV);
+
+	// the initial state is drawn until the first tick is published
+	mPortalSet.Refresh();
+	mSnapshots.GetWriteSlot().Capture(0, 0.0, mLeftCamera, mRightCamera, mPlayer, mOrangePortal, mBluePortal,
+							mPlayerIntersectOrangePortal, mPlayerIntersectBluePortal);
+	mSnapshots.Publish();
+
+	mSimulationThread = CreateThread(0, 0, SimulationThreadProc, this, 0, 0);
+	if (!mSimulationThread)
+		return false;
 	
 	return true;
 }
@@ -429,8 +427,8 @@ void PortalsApp::OnResize()
 {
 	D3DApp::OnResize();
 
-	mLeftCamera.SetAspect(AspectRatio());
-	mRightCamera.SetAspect(AspectRatio());
+	// only the drawn cameras have an aspect; the simulation's don't need one
+	mInterpolator.SetAspect(AspectRatio());
 }
 
 void PortalsApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -460,8 +458,10 @@ void PortalsApp::OnMouseMove(WPARAM btnState, int x, int y)
 		float dx = XMConvertToRadians(0.25f*static_cast<float>(x - mLastMousePos.x));
 		float dy = XMConvertToRadians(0.25f*static_cast<float>(y - mLastMousePos.y));
 
-		mCurrentCamera_ptr->RotateUp(-dy);
-		mCurrentCamera_ptr->RotateRight(dx);
+		EnterCriticalSection(&mInputLock);
+		mPendingRotateUp += -dy;
+		mPendingRotateRight += dx;
+		LeaveCriticalSection(&mInputLock);
 	}
 
 	mLastMousePos.x = x;
@@ -469,8 +469,100 @@ void PortalsApp::OnMouseMove(WPARAM btnState, int x, int y)
 }
 
 
+// runs on the render thread: takes the latest snapshot, and places the cameras one tick behind it so there's
+// always a later tick to interpolate towards
 void PortalsApp::UpdateScene(float dt)
 {
+	if (mSnapshots.Acquire())
+	{
+		mInterpolator.Push(mSnapshots.GetReadSlot());
+		mSnapshotAcquiredTime = mTimer.TotalTime();
+	}
+
+	double SinceAcquired = mTimer.TotalTime() - mSnapshotAcquiredTime;
+	mInterpolator.Interpolate(mSnapshots.GetReadSlot().Time - 1.0/SIMULATION_TICK_RATE + SinceAcquired);
+}
+
+DWORD WINAPI PortalsApp::SimulationThreadProc(LPVOID App_ptr)
+{
+	return static_cast<PortalsApp*>(App_ptr)->RunSimulation();
+}
+
+// runs fixed ticks of 1/SIMULATION_TICK_RATE s to keep up with the clock until the app quits, publishing a
+// snapshot after each batch.  tick costs are written to the debug output at the end
+DWORD PortalsApp::RunSimulation()
+{
+	FixedTimestep Clock(1.0 / SIMULATION_TICK_RATE, SIMULATION_MAX_TICKS_PER_ADVANCE);
+
+	__int64 CountsPerSecond;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&CountsPerSecond);
+
+	GameTimer Timer;
+	Timer.Reset();
+
+	while (!mQuitSimulation)
+	{
+		// time spent paused isn't owed to the simulation
+		if (mAppPaused)
+		{
+			Sleep(100);
+			Timer.Tick();
+			continue;
+		}
+
+		Timer.Tick();
+		UINT Ticks = Clock.Advance(Timer.DeltaTime());
+		for (UINT i=0; i<Ticks; ++i)
+		{
+			__int64 Start, End;
+			QueryPerformanceCounter((LARGE_INTEGER*)&Start);
+			UINT Substeps = StepSimulation((float)Clock.GetStep());
+			QueryPerformanceCounter((LARGE_INTEGER*)&End);
+			Clock.RecordTick((End - Start) * 1e6 / CountsPerSecond, Substeps);
+		}
+
+		if (Ticks > 0)
+		{
+			mSnapshots.GetWriteSlot().Capture(Clock.GetTicks(), Clock.GetTime(), mLeftCamera, mRightCamera, mPlayer,
+								mOrangePortal, mBluePortal, mPlayerIntersectOrangePortal, mPlayerIntersectBluePortal);
+			mSnapshots.Publish();
+		}
+
+		Sleep((DWORD)(Clock.GetTimeToNextTick() * 1000.0));
+	}
+
+	const FixedTimestep::TickStats &Stats = Clock.GetStats();
+	dprintf("simulation: %u ticks, %u dropped, %u sweeps, us/tick avg %.1f p99 <%.0f max %.1f\n", Stats.Ticks,
+		Stats.DroppedTicks, Stats.Substeps, Stats.Ticks > 0 ? Stats.TotalMicroseconds / Stats.Ticks : 0.0,
+		Clock.GetPercentileMicroseconds(0.99), Stats.MaxMicroseconds);
+
+	unsigned int Hits[2], Misses[2];
+	mLeftCameraCache.GetCounters(&Hits[0], &Misses[0]);
+	mRightCameraCache.GetCounters(&Hits[1], &Misses[1]);
+	dprintf("candidate caches: %u hits, %u misses\n", Hits[0] + Hits[1], Misses[0] + Misses[1]);
+	return 0;
+}
+
+UINT PortalsApp::StepSimulation(float dt)
+{
+	// portals may have been moved/resized last tick
+	mPortalSet.Refresh();
+
+	// mouse rotation since the last tick
+	EnterCriticalSection(&mInputLock);
+	float RotateUp = mPendingRotateUp;
+	float RotateRight = mPendingRotateRight;
+	mPendingRotateUp = 0.0f;
+	mPendingRotateRight = 0.0f;
+	LeaveCriticalSection(&mInputLock);
+
+	mCurrentCamera_ptr->RotateUp(RotateUp);
+	mCurrentCamera_ptr->RotateRight(RotateRight);
+
+#if RECORD_INPUT
+	mRecordedFrame.RotateUp += RotateUp;
+	mRecordedFrame.RotateRight += RotateRight;
+#endif
 
 	// see if the portals can be modified (e.g. do they intersect the player or the camera?)
 	bool PortalsCanBeModified = (!mPlayerIntersectOrangePortal && !mPlayerIntersectBluePortal);
@@ -528,20 +620,24 @@ void PortalsApp::UpdateScene(float dt)
 	if (GetAsyncKeyState(VK_CONTROL) & 0x8000)
 		UpSteps -= 1.0f;
 	
-	XMFLOAT3 Dir = 		ForwardSteps*mCurrentCamera_ptr->GetLook() +
-						RightSteps*mCurrentCamera_ptr->GetRight() +
-						UpSteps*mCurrentCamera_ptr->GetBodyUp();
+#if RECORD_INPUT
+	mRecordedFrame.dt = dt;
+	mRecordedFrame.ForwardSteps = ForwardSteps;
+	mRecordedFrame.RightSteps = RightSteps;
+	mRecordedFrame.UpSteps = UpSteps;
+	mRecordedFrame.Sprint = ((GetAsyncKeyState(VK_SHIFT) & 0x8000) != 0);
+	mRecordedFrame.Camera = (mCurrentCamera_ptr == &mRightCamera ? 1 : 0);
+	InputScript::WriteFrame(mInputRecording, mRecordedFrame);
+	mRecordedFrame = InputFrame();
+#endif
 
-	if (XMFloat3LengthSq(Dir)!=0.0f)
-	{
-		float speed = CAMERA_MOVEMENT_SPEED;
-		if (GetAsyncKeyState(VK_SHIFT) & 0x8000)
-			speed *= CAMERA_MOVEMENT_SPRINT_MULTIPLIER;
+	float speed = CAMERA_MOVEMENT_SPEED;
+	if (GetAsyncKeyState(VK_SHIFT) & 0x8000)
+		speed *= CAMERA_MOVEMENT_SPRINT_MULTIPLIER;
 
-		Dir = XMFloat3Normalize(Dir);
-		SpherePath::MoveCameraAlongPathIterative(*mCurrentCamera_ptr, Dir, speed*dt,
-												mRoom, mOrangePortal, mBluePortal);
-	}
+	Room::CandidateCache &Cache = (mCurrentCamera_ptr == &mRightCamera ? mRightCameraCache : mLeftCameraCache);
+	UINT Substeps = SpherePath::MoveCameraSubstepped(*mCurrentCamera_ptr, ForwardSteps, RightSteps, UpSteps, speed*dt,
+												SIMULATION_SUBSTEPS, mRoom, mPortalSet, &Cache);
 
 
 	// level camera
@@ -568,7 +664,7 @@ void PortalsApp::UpdateScene(float dt)
 		if (mRightButtonIsDown)
 		{
 			mRoom.PortalRelocate(mCurrentCamera_ptr->GetPosition(), mCurrentCamera_ptr->GetLook(), 
-				*mCurrentPortal_ptr, *mCurrentOtherPortal_ptr);
+				*mCurrentPortal_ptr, mPortalSet);
 		}
 
 		// rotate
@@ -604,209 +700,11 @@ void PortalsApp::UpdateScene(float dt)
 	mPlayerIntersectOrangePortal = mOrangePortal.DiscIntersectSphere(mPlayer.GetPosition(), mPlayer.GetBoundingSphereRadius()+0.01f);
 	mPlayerIntersectBluePortal = mBluePortal.DiscIntersectSphere(mPlayer.GetPosition(), mPlayer.GetBoundingSphereRadius()+0.01f);
 
-
-	// update camera ViewProj matrices and ViewScale values
-	XMMATRIX View, Proj;
-
-	View = mLeftCamera.GetViewMatrix();
-	Proj = mLeftCamera.GetProjMatrix();
-	mLeftViewProj = View * Proj;
-	mLeftViewScale = mLeftCamera.GetViewScale();
-
-	View = mRightCamera.GetViewMatrix();
-	Proj = mRightCamera.GetProjMatrix();
-	mRightViewProj = View * Proj;
-	mRightViewScale = mRightCamera.GetViewScale();
-}
-
-
-
-
-
-
-#pragma region DRAW_FUNCTIONS
-
-void PortalsApp::DrawRoomBothPortals(bool PlaneClip, const XMMATRIX &World, const XMMATRIX &ViewProj, float ViewScale)
-{	
-	XMMATRIX WorldInvTranspose, WorldViewProj;
-
-	mTech = PlaneClip ? Effects::RoomPortalFX->Light3TexPortalAPortalBClipTech : 
-						Effects::RoomPortalFX->Light3TexPortalAPortalBTech;
-	mTech->GetDesc(&mTechDesc);
-	for (UINT p=0; p < mTechDesc.Passes; ++p)
-	{
-		ID3DX11EffectPass* Pass = mTech->GetPassByIndex(p);
-		// set room buffers
-		md3dImmediateContext->IASetVertexBuffers(0, 1, &mRoomVB, &mStride, &mOffset);
-		md3dImmediateContext->IASetIndexBuffer(mRoomIB, DXGI_FORMAT_R32_UINT, 0);
-
-		WorldInvTranspose = MathFunctions::InverseTranspose(World);
-		WorldViewProj = World * ViewProj;
-
-		Effects::RoomPortalFX->SetWorld(World);
-		Effects::RoomPortalFX->SetWorldInvTranspose(WorldInvTranspose);
-		Effects::RoomPortalFX->SetWorldViewProj(WorldViewProj);
-			Effects::RoomPortalFX->SetViewScale(ViewScale);
-		
-		// portal-related settings are set once before drawing anything
-
-		// draw the walls
-		Effects::RoomPortalFX->SetTexTransform(mWallsTexTransform);
-		Effects::RoomPortalFX->SetMaterial(mWallsMaterial);
-		Effects::RoomPortalFX->SetDiffuseMap(mWallsSRV);
-
-		Pass->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mWallsIndexCount, mWallsIBOffset, mWallsVBOffset);
-
-		// draw floor
-		Effects::RoomPortalFX->SetTexTransform(mFloorTexTransform);
-		Effects::RoomPortalFX->SetMaterial(mFloorMaterial);
-		Effects::RoomPortalFX->SetDiffuseMap(mFloorSRV);
-
-		Pass->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mFloorIndexCount, mFloorIBOffset, mFloorVBOffset);
-
-
-		// draw ceiling
-		Effects::RoomPortalFX->SetTexTransform(mCeilingTexTransform);
-		Effects::RoomPortalFX->SetMaterial(mCeilingMaterial);
-		Effects::RoomPortalFX->SetDiffuseMap(mCeilingSRV);
-
-		Pass->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mCeilingIndexCount, mCeilingIBOffset, mCeilingVBOffset);
-	}
-}
-
-void PortalsApp::DrawPlayer(bool PlaneClip, const XMMATRIX &World, const XMMATRIX &ViewProj, float ViewScale)
-{
-	XMMATRIX WorldInvTranspose, WorldViewProj;
-
-	mTech = PlaneClip ? Effects::BasicFX->Light3TexClipTech : Effects::BasicFX->Light3TexTech;
-	mTech->GetDesc(&mTechDesc);
-	for (UINT p=0; p < mTechDesc.Passes; ++p)
-	{
-		ID3DX11EffectPass* Pass = mTech->GetPassByIndex(p);
-		// set room buffers
-		md3dImmediateContext->IASetVertexBuffers(0, 1, &mPlayerVB, &mStride, &mOffset);
-		md3dImmediateContext->IASetIndexBuffer(mPlayerIB, DXGI_FORMAT_R32_UINT, 0);
-
-		// draw the player
-		WorldInvTranspose = MathFunctions::InverseTranspose(World);
-		WorldViewProj = World * ViewProj;
-
-		Effects::BasicFX->SetWorld(World);
-		Effects::BasicFX->SetWorldInvTranspose(WorldInvTranspose);
-		Effects::BasicFX->SetWorldViewProj(WorldViewProj);
-			Effects::BasicFX->SetViewScale(ViewScale);
-		Effects::BasicFX->SetTexTransform(mPlayerTexTransform);
-		Effects::BasicFX->SetMaterial(mPlayerMaterial);
-		Effects::BasicFX->SetDiffuseMap(mPlayerSRV);
-
-		Pass->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mPlayerIndexCount, 0, 0);
-	}
+	return Substeps;
 }
 
 
 
-void PortalsApp::DrawPortalBox(bool PlaneClip, const XMMATRIX &World, const XMMATRIX &ViewProj)
-{
-	XMMATRIX WorldViewProj;
-
-	mTech = PlaneClip ? Effects::PortalFX->PortalBoxClipTech : Effects::PortalFX->PortalBoxTech;
-	mTech->GetDesc(&mTechDesc);
-	for (UINT p=0; p < mTechDesc.Passes; ++p)
-	{
-		ID3DX11EffectPass* Pass = mTech->GetPassByIndex(p);
-		// set portal buffers
-		md3dImmediateContext->IASetVertexBuffers(0, 1, &mPortalVB, &mStride, &mOffset);
-		md3dImmediateContext->IASetIndexBuffer(mPortalIB, DXGI_FORMAT_R32_UINT, 0);
-
-		// draw portal box
-		WorldViewProj = World * ViewProj;
-		Effects::PortalFX->SetWorld(World);
-		Effects::PortalFX->SetWorldViewProj(WorldViewProj);
-
-		Pass->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mPortalBoxIndexCount, 0, 0);
-	}
-}
-
-void PortalsApp::DrawPortalBoxClearDepth(const XMMATRIX &World, const XMMATRIX &ViewProj)
-{
-	XMMATRIX WorldViewProj;
-
-	mTech = Effects::PortalFX->PortalBoxClearDepthTech;
-	mTech->GetDesc(&mTechDesc);
-	for (UINT p=0; p < mTechDesc.Passes; ++p)
-	{
-		ID3DX11EffectPass* Pass = mTech->GetPassByIndex(p);
-		// set portal buffers
-		md3dImmediateContext->IASetVertexBuffers(0, 1, &mPortalVB, &mStride, &mOffset);
-		md3dImmediateContext->IASetIndexBuffer(mPortalIB, DXGI_FORMAT_R32_UINT, 0);
-
-		// draw portal box
-		WorldViewProj = World * ViewProj;
-		Effects::PortalFX->SetWorld(World);
-		Effects::PortalFX->SetWorldViewProj(WorldViewProj);
-
-		Pass->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mPortalBoxIndexCount, 0, 0);
-	}
-}
-
-
-void PortalsApp::DrawRoomBothPortalsNoHoles(const XMMATRIX &World, const XMMATRIX &ViewProj, float ViewScale)
-{	
-	XMMATRIX WorldInvTranspose, WorldViewProj;
-
-	mTech = Effects::RoomPortalFX->Light3TexPortalAPortalBNoHolesTech;
-	mTech->GetDesc(&mTechDesc);
-	for (UINT p=0; p < mTechDesc.Passes; ++p)
-	{
-		ID3DX11EffectPass* Pass = mTech->GetPassByIndex(p);
-		// set room buffers
-		md3dImmediateContext->IASetVertexBuffers(0, 1, &mRoomVB, &mStride, &mOffset);
-		md3dImmediateContext->IASetIndexBuffer(mRoomIB, DXGI_FORMAT_R32_UINT, 0);
-
-		WorldInvTranspose = MathFunctions::InverseTranspose(World);
-		WorldViewProj = World * ViewProj;
-
-		Effects::RoomPortalFX->SetWorld(World);
-		Effects::RoomPortalFX->SetWorldInvTranspose(WorldInvTranspose);
-		Effects::RoomPortalFX->SetWorldViewProj(WorldViewProj);
-			Effects::RoomPortalFX->SetViewScale(ViewScale);
-		
-		// portal-related settings are set once before drawing anything
-
-		// draw the walls
-		Effects::RoomPortalFX->SetTexTransform(mWallsTexTransform);
-		Effects::RoomPortalFX->SetMaterial(mWallsMaterial);
-		Effects::RoomPortalFX->SetDiffuseMap(mWallsSRV);
-
-		Pass->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mWallsIndexCount, mWallsIBOffset, mWallsVBOffset);
-
-		// draw floor
-		Effects::RoomPortalFX->SetTexTransform(mFloorTexTransform);
-		Effects::RoomPortalFX->SetMaterial(mFloorMaterial);
-		Effects::RoomPortalFX->SetDiffuseMap(mFloorSRV);
-
-		Pass->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mFloorIndexCount, mFloorIBOffset, mFloorVBOffset);
-
-
-		// draw ceiling
-		Effects::RoomPortalFX->SetTexTransform(mCeilingTexTransform);
-		Effects::RoomPortalFX->SetMaterial(mCeilingMaterial);
-		Effects::RoomPortalFX->SetDiffuseMap(mCeilingSRV);
-
-		Pass->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mCeilingIndexCount, mCeilingIBOffset, mCeilingVBOffset);
-	}
-}
-
-#pragma endregion DRAW_FUNCTIONS
 
 
 
@@ -815,423 +713,112 @@ void PortalsApp::DrawScene()
 	md3dImmediateContext->ClearRenderTargetView(mRenderTargetView, reinterpret_cast<const float*>(&Colors::Fog));
 	md3dImmediateContext->ClearDepthStencilView(mDepthStencilView, D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL, 1.0f, 0);
 
-	md3dImmediateContext->IASetInputLayout(InputLayouts::Basic32);
     md3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+	XMFLOAT3 LightDirections[3];
+	for (int i=0; i<3; ++i)
+		LightDirections[i] = mDirLights[i].Direction;
 
-	
-	// calculate how many iterations the world should be virtualized inside each portal
-	int OrangePortalIterations = 1;
-	int BluePortalIterations = 1;
-
-	bool OrangePortalInFrustum = mLeftCamera.FrustumContainsDisc(mOrangePortal.GetPosition(), mOrangePortal.GetNormal(), 
-															mOrangePortal.GetPhysicalRadius());
-	bool BluePortalInFrustum = mLeftCamera.FrustumContainsDisc(mBluePortal.GetPosition(), mBluePortal.GetNormal(), 
-															mBluePortal.GetPhysicalRadius());
-	float OrangePortalVisibility = mLeftCamera.SurfaceVisibilityFactor(mOrangePortal.GetPosition(), mOrangePortal.GetNormal());
-	float BluePortalVisibility  = mLeftCamera.SurfaceVisibilityFactor(mBluePortal.GetPosition(), mBluePortal.GetNormal());
-	
-	bool CanSeeOrange = OrangePortalInFrustum && (OrangePortalVisibility >= 0.0f);
-	bool CanSeeBlue = BluePortalInFrustum && (BluePortalVisibility >= 0.0f);
-
-	if (CanSeeOrange && CanSeeBlue)
-	{
-		OrangePortalIterations = PORTAL_ITERATIONS / 2;
-		BluePortalIterations = PORTAL_ITERATIONS - OrangePortalIterations;
-	}
-	else if (CanSeeOrange)
-		OrangePortalIterations = PORTAL_ITERATIONS-1;
-	else if (CanSeeBlue)
-		BluePortalIterations = PORTAL_ITERATIONS-1;
-
-
-	
-
-
-	// set camera-independent per-frame variables (these don't change when rendering either viewport)
-
-	// portal-related
-	Effects::RoomPortalFX->SetPortalA(mOrangePortal.GetScaledPortalMatrix());
-	Effects::RoomPortalFX->SetPortalATexRadRatio(mOrangePortal.GetTextureRadiusRatio());
-	Effects::RoomPortalFX->SetPortalADiffuseMap(mOrangePortalSRV);
-	Effects::RoomPortalFX->SetPortalB(mBluePortal.GetScaledPortalMatrix());
-	Effects::RoomPortalFX->SetPortalBTexRadRatio(mBluePortal.GetTextureRadiusRatio());
-	Effects::RoomPortalFX->SetPortalBDiffuseMap(mBluePortalSRV);
-
+	mRenderBackend.BeginFrame();
 
 
 	// RENDER TO LEFT VIEWPORT *************************************************************************************************************
 	md3dImmediateContext->RSSetViewports(1, &mScreenViewports[0]);
 
+	PortalRecursionPlanner::ScreenRect LeftViewportRect(mScreenViewports[0].TopLeftX, mScreenViewports[0].TopLeftY,
+					mScreenViewports[0].TopLeftX + mScreenViewports[0].Width,
+					mScreenViewports[0].TopLeftY + mScreenViewports[0].Height);
 
-	// set per-frame variables (none of these should change for this whole frame)
-	
-	// eyepos
-	Effects::RoomPortalFX->SetEyePosW(mLeftCamera.GetPosition());
-	Effects::BasicFX->SetEyePosW(mLeftCamera.GetPosition());
-
-
-	// render room and both portals
-	
-	Effects::RoomPortalFX->SetDirLights(mDirLights);
-
-	md3dImmediateContext->OMSetDepthStencilState(0, 0);
-	DrawRoomBothPortals(false, XMMatrixIdentity(), mLeftViewProj, mLeftViewScale);
-
-
-
-	// ***************************************************************************************************************************************************
-	// ***************************************************************************************************************************************************
-	// rest of rendering steps depends on whether or not the player intersects the portal
-
-
-	if (mPlayerIntersectOrangePortal || mPlayerIntersectBluePortal)
-	{
-		Portal *ThisPortal_ptr;
-		int ThisPortalIterations;
-		UINT ThisPortalStencilRef;
-
-		Portal *OtherPortal_ptr;
-		int OtherPortalIterations;
-		UINT OtherPortalStencilRef;
-		
-		if (mPlayerIntersectOrangePortal)
-		{
-			ThisPortal_ptr = &mOrangePortal;
-			ThisPortalIterations = OrangePortalIterations;
-			ThisPortalStencilRef = ORANGE_STENCIL_REF;
-			OtherPortal_ptr = &mBluePortal;
-			OtherPortalIterations = BluePortalIterations;
-			OtherPortalStencilRef = BLUE_STENCIL_REF;
-		}
-		else
-		{
-			ThisPortal_ptr = &mBluePortal;
-			ThisPortalIterations = BluePortalIterations;
-			ThisPortalStencilRef = BLUE_STENCIL_REF;
-			OtherPortal_ptr = &mOrangePortal;
-			OtherPortalIterations = OrangePortalIterations;
-			OtherPortalStencilRef =  ORANGE_STENCIL_REF;
-		}
-
-
-		// virtualization matrices
-		XMMATRIX ThisVirtualize = Portal::CalculateVirtualizationMatrix(*ThisPortal_ptr, *OtherPortal_ptr);
-		XMMATRIX OtherVirtualize = Portal::CalculateVirtualizationMatrix(*OtherPortal_ptr, *ThisPortal_ptr);
-
-		Effects::BasicFX->SetDirLights(mDirLights);
-		
-
-		// render portion of player outside of ThisPortal
-
-		Effects::BasicFX->SetClipPlanePosition(ThisPortal_ptr->GetPosition());
-		Effects::BasicFX->SetClipPlaneNormal(ThisPortal_ptr->GetNormal());
-		Effects::BasicFX->SetClipPlaneOffset(-0.01f);
-
-		//md3dImmediateContext->OMSetDepthStencilState(0, 0);
-		DrawPlayer(true, mPlayer.GetWorldMatrix(), mLeftViewProj, mLeftViewScale);
-
-
-		// render portion of player outside of OtherPortal
-
-		Effects::BasicFX->SetClipPlanePosition(OtherPortal_ptr->GetPosition());
-		Effects::BasicFX->SetClipPlaneNormal(OtherPortal_ptr->GetNormal());
-		//Effects::BasicFX->SetClipPlaneOffset(-0.01f);
-
-		//md3dImmediateContext->OMSetDepthStencilState(0, 0);
-		DrawPlayer(true, mPlayer.GetWorldMatrix() * OtherVirtualize, mLeftViewProj, mLeftViewScale);
-
-		
-		// render portal boxes to stencil, and to cover up the hole
-
-		md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilSetToDSS, ORANGE_STENCIL_REF);
-		DrawPortalBox(false, mOrangePortal.GetBoxWorldMatrix(), mLeftViewProj);
-
-		md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilSetToDSS, BLUE_STENCIL_REF);
-		DrawPortalBox(false, mBluePortal.GetBoxWorldMatrix(), mLeftViewProj);
-
-
-		// render portal insides
-
-		RenderPortalInsidesPlayerClip(*ThisPortal_ptr, ThisVirtualize, XMMatrixIdentity(), XMMatrixIdentity(), ThisPortalStencilRef,
-									ThisPortalIterations, mLeftViewProj, mLeftViewScale);
-
-
-		RenderPortalInsidesPlayerClip(*OtherPortal_ptr, OtherVirtualize, XMMatrixIdentity(), OtherVirtualize, OtherPortalStencilRef,
-									OtherPortalIterations, mLeftViewProj, mLeftViewScale);
-
-	}
-	// ***************************************************************************************************************************************************
-	// ***************************************************************************************************************************************************
-	else
-	{
-		// render player
-
-		Effects::BasicFX->SetDirLights(mDirLights);
-		
-		//md3dImmediateContext->OMSetDepthStencilState(0, 0);
-		DrawPlayer(false, mPlayer.GetWorldMatrix(), mLeftViewProj, mLeftViewScale);
-
-		
-		// render portal boxes to stencil, and to cover up the hole
-
-		md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilSetToDSS, ORANGE_STENCIL_REF);
-		DrawPortalBox(false, mOrangePortal.GetBoxWorldMatrix(), mLeftViewProj);
-
-		md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilSetToDSS, BLUE_STENCIL_REF);
-		DrawPortalBox(false, mBluePortal.GetBoxWorldMatrix(), mLeftViewProj);
-		
-		
-		// render orange portal insides
-
-		XMMATRIX OrangeVirtualize = Portal::CalculateVirtualizationMatrix(mOrangePortal, mBluePortal);
-		
-		RenderPortalInsidesPlayerNoClip(mOrangePortal, OrangeVirtualize, XMMatrixIdentity(), ORANGE_STENCIL_REF,
-									OrangePortalIterations, mLeftViewProj, mLeftViewScale);
-
-
-		// render blue portal insides
-
-		XMMATRIX BlueVirtualize = Portal::CalculateVirtualizationMatrix(mBluePortal, mOrangePortal);
-		
-		RenderPortalInsidesPlayerNoClip(mBluePortal, BlueVirtualize, XMMatrixIdentity(), BLUE_STENCIL_REF,
-									BluePortalIterations, mLeftViewProj, mLeftViewScale);
-		
-		
-	}
-	// ***************************************************************************************************************************************************
-	// ***************************************************************************************************************************************************
-	
-
-
-
-
+	const SceneSnapshot &Snapshot = mSnapshots.GetReadSlot();
+	mSceneRenderer.RenderPortalView(mRoom, Snapshot.Portals, mInterpolator.GetPlayer(),
+					Snapshot.PlayerIntersectOrangePortal, Snapshot.PlayerIntersectBluePortal,
+					mInterpolator.GetLeftCamera(), LeftViewportRect, LightDirections, mRenderBackend);
 
 
 	// RENDER TO RIGHT VIEWPORT *********************************************************************************************************
 	md3dImmediateContext->RSSetViewports(1, &mScreenViewports[1]);
 
 	// draw room with both portals, but without their holes
-
-	Effects::RoomPortalFX->SetEyePosW(mRightCamera.GetPosition());	
-	Effects::RoomPortalFX->SetDirLights(mDirLights);
-
-	md3dImmediateContext->OMSetDepthStencilState(0, 0);
-	DrawRoomBothPortalsNoHoles(XMMatrixIdentity(), mRightViewProj, mRightViewScale);
-
-
+	mSceneRenderer.RenderOverview(Snapshot.Portals, mInterpolator.GetRightCamera(), LightDirections, mRenderBackend);
 
 
 	HR(mSwapChain->Present(0, 0));
 }
 
-void PortalsApp::RenderPortalInsidesPlayerNoClip(const Portal &LookThruPortal, const XMMATRIX &Virtualize,
-						const XMMATRIX &InitialWorldToVirtual, UINT InitialStencilRef, int Levels,
-						const XMMATRIX &ViewProj, float ViewScale)
-{
-	DirectionalLight VirtualDirLights[3];
-	memcpy(VirtualDirLights, mDirLights, 3*sizeof(DirectionalLight));
-	XMMATRIX WorldToVirtual = InitialWorldToVirtual;
-	Portal CurrentPortal = LookThruPortal;
-	UINT StencilRef = InitialStencilRef;
-
-	for (int i=0; i<Levels; ++i)
-	{
-		// computer worldtovirtual transform for this realm
-		WorldToVirtual *= Virtualize;
-
-		// computer dir lights for this realm
-		for (unsigned int i=0; i<3; ++i)
-		{
-			XMVECTOR D;
-			D = XMLoadFloat3(&(VirtualDirLights[i].Direction));
-			D = XMVector3Normalize(XMVector3TransformNormal(D, Virtualize));
-			XMStoreFloat3(&(VirtualDirLights[i].Direction), D);
-		}
-
-		// everything in this realm uses the same set of virtual lights
-		Effects::RoomPortalFX->SetDirLights(VirtualDirLights);
-		Effects::BasicFX->SetDirLights(VirtualDirLights);
-
-		// everything in this realm must be clipped using the plane of the CurrentPortal
-		Effects::RoomPortalFX->SetClipPlanePosition(CurrentPortal.GetPosition());
-		Effects::RoomPortalFX->SetClipPlaneNormal(-CurrentPortal.GetNormal());
-		Effects::RoomPortalFX->SetClipPlaneOffset(0.0f);
-		Effects::BasicFX->SetClipPlanePosition(CurrentPortal.GetPosition());
-		Effects::BasicFX->SetClipPlaneNormal(-CurrentPortal.GetNormal());
-		Effects::BasicFX->SetClipPlaneOffset(0.0f);
-		Effects::PortalFX->SetClipPlanePosition(CurrentPortal.GetPosition());
-		Effects::PortalFX->SetClipPlaneNormal(-CurrentPortal.GetNormal());
-		Effects::PortalFX->SetClipPlaneOffset(0.0f);
-
-
-		// render current portal box to clear depth of this portal's insides
-	
-		md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilEqualDepthAlwaysDSS, StencilRef);
-		DrawPortalBoxClearDepth(CurrentPortal.GetBoxWorldMatrix(), ViewProj);
-	
-
-		// render virtual room with both portals, even though we only need CurrentPortal
-
-		md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilEqualDSS, StencilRef);
-		DrawRoomBothPortals(true, WorldToVirtual, ViewProj, ViewScale);
-
-	
-		// render virtual player
-	
-		//md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilEqualDSS, StencilRef);
-		DrawPlayer(true, mPlayer.GetWorldMatrix() * WorldToVirtual, ViewProj, ViewScale);
-
-	
-		// calculate next portal
-		CurrentPortal.Transform(Virtualize);
-
-	
-		// render next portal box to increment stencil, and to cover up hole
-
-		md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilEqualIncrementDSS, StencilRef);
-		DrawPortalBox(true, CurrentPortal.GetBoxWorldMatrix(), ViewProj);
-
-
-		++StencilRef;		
-	}
-}
-
-
-
-
-void PortalsApp::RenderPortalInsidesPlayerClip(const Portal &LookThruPortal, const XMMATRIX &Virtualize,
-						const XMMATRIX &InitialWorldToVirtual, const XMMATRIX &InitialPlayerWorldToVirtual,
-						UINT InitialStencilRef, int Levels,
-						const XMMATRIX &ViewProj, float ViewScale)
-{
-	DirectionalLight VirtualDirLights[3];
-	memcpy(VirtualDirLights, mDirLights, 3*sizeof(DirectionalLight));
-	XMMATRIX WorldToVirtual = InitialWorldToVirtual;
-	XMMATRIX OldPlayerWorldToVirtual;
-	XMMATRIX PlayerWorldToVirtual = InitialPlayerWorldToVirtual;
-	Portal CurrentPortal = LookThruPortal;
-	UINT StencilRef = InitialStencilRef;
-
-	for (int i=0; i<Levels; ++i)
-	{
-		// computer worldtovirtual transform for this realm
-		WorldToVirtual *= Virtualize;
-		OldPlayerWorldToVirtual = PlayerWorldToVirtual;
-		PlayerWorldToVirtual *= Virtualize;
-
-		// computer dir lights for this realm
-		for (unsigned int i=0; i<3; ++i)
-		{
-			XMVECTOR D;
-			D = XMLoadFloat3(&(VirtualDirLights[i].Direction));
-			D = XMVector3Normalize(XMVector3TransformNormal(D, Virtualize));
-			XMStoreFloat3(&(VirtualDirLights[i].Direction), D);
-		}
-
-		// everything in this realm uses the same set of virtual lights
-		Effects::RoomPortalFX->SetDirLights(VirtualDirLights);
-		Effects::BasicFX->SetDirLights(VirtualDirLights);
-
-		// everything in this realm must be clipped using the plane of the CurrentPortal
-		Effects::RoomPortalFX->SetClipPlanePosition(CurrentPortal.GetPosition());
-		Effects::RoomPortalFX->SetClipPlaneNormal(-CurrentPortal.GetNormal());
-		Effects::RoomPortalFX->SetClipPlaneOffset(0.0f);
-		Effects::BasicFX->SetClipPlanePosition(CurrentPortal.GetPosition());
-		Effects::BasicFX->SetClipPlaneNormal(-CurrentPortal.GetNormal());
-		Effects::BasicFX->SetClipPlaneOffset(0.0f);
-		Effects::PortalFX->SetClipPlanePosition(CurrentPortal.GetPosition());
-		Effects::PortalFX->SetClipPlaneNormal(-CurrentPortal.GetNormal());
-		Effects::PortalFX->SetClipPlaneOffset(0.0f);
-
-
-		// render current portal box to clear depth of this portal's insides
-	
-		md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilEqualDepthAlwaysDSS, StencilRef);
-		DrawPortalBoxClearDepth(CurrentPortal.GetBoxWorldMatrix(), ViewProj);
-	
-
-		// render virtual room with both portals, even though we only need CurrentPortal
-
-		md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilEqualDSS, StencilRef);
-		DrawRoomBothPortals(true, WorldToVirtual, ViewProj, ViewScale);
-
-	
-		// render portion of previous virtual player that's in this realm
-	
-		Effects::BasicFX->SetClipPlanePosition(CurrentPortal.GetPosition());
-		Effects::BasicFX->SetClipPlaneNormal(-CurrentPortal.GetNormal());
-		Effects::BasicFX->SetClipPlaneOffset(-0.01f);
-
-		//md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilEqualDSS, StencilRef);
-		DrawPlayer(true, mPlayer.GetWorldMatrix() * OldPlayerWorldToVirtual, ViewProj, ViewScale);
-
-
-		// calculate next portal
-		CurrentPortal.Transform(Virtualize);
-
-
-		// render portion of current virtual player that's in this realm
-
-		Effects::BasicFX->SetClipPlanePosition(CurrentPortal.GetPosition());
-		Effects::BasicFX->SetClipPlaneNormal(CurrentPortal.GetNormal());
-		//Effects::BasicFX->SetClipPlaneOffset(-0.01f);
-
-		//md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilEqualDSS, StencilRef);
-		DrawPlayer(true, mPlayer.GetWorldMatrix() * PlayerWorldToVirtual, ViewProj, ViewScale);
-
-	
-		// render next portal box to increment stencil, and to cover up hole
-
-		md3dImmediateContext->OMSetDepthStencilState(RenderStates::StencilEqualIncrementDSS, StencilRef);
-		DrawPortalBox(true, CurrentPortal.GetBoxWorldMatrix(), ViewProj);
-
-
-		++StencilRef;		
-	}
-}
-
 
 
 void PortalsApp::BuildRoomGeometryBuffers()
 {
-	// get mesh data from room
 	GeometryGenerator::MeshData RoomMesh;
-	mRoom.BuildMeshData(RoomMesh,
-					&mWallsIndexCount, &mWallsIBOffset, &mWallsVBOffset,
-					&mFloorIndexCount, &mFloorIBOffset, &mFloorVBOffset, 
-					&mCeilingIndexCount, &mCeilingIBOffset, &mCeilingVBOffset);
-
-	// copy info over to list of Basic32 vertices
-	std::vector<Vertex::Basic32> Basic32Vertices(RoomMesh.Vertices.size());
-	for (unsigned int i=0; i<Basic32Vertices.size(); ++i)
+	std::vector<Vertex::Basic32> Basic32Vertices;
+	const void *Vertices;
+	const void *Indices;
+	UINT VertexCount;
+	UINT IndexCount;
+	if (mRoomBinary.IsOpen())
+	{
+		// a binary level has the mesh built already, laid out as Basic32 vertices
+		const RoomBinary::Header &H = mRoomBinary.GetHeader();
+		mWallsIndexCount = H.WallsIndexCount;
+		mWallsIBOffset = H.WallsIBOffset;
+		mWallsVBOffset = H.WallsVBOffset;
+		mFloorIndexCount = H.FloorIndexCount;
+		mFloorIBOffset = H.FloorIBOffset;
+		mFloorVBOffset = H.FloorVBOffset;
+		mCeilingIndexCount = H.CeilingIndexCount;
+		mCeilingIBOffset = H.CeilingIBOffset;
+		mCeilingVBOffset = H.CeilingVBOffset;
+		Vertices = mRoomBinary.GetMeshVertices();
+		Indices = mRoomBinary.GetMeshIndices();
+		VertexCount = H.MeshVertexCount;
+		IndexCount = H.MeshIndexCount;
+	}
+	else
 	{
-		Basic32Vertices[i].normal = RoomMesh.Vertices[i].Normal;
-		Basic32Vertices[i].pos = RoomMesh.Vertices[i].Position;
-		Basic32Vertices[i].tex = RoomMesh.Vertices[i].TexCoord;
+		// get mesh data from room
+		mRoom.BuildMeshData(RoomMesh,
+						&mWallsIndexCount, &mWallsIBOffset, &mWallsVBOffset,
+						&mFloorIndexCount, &mFloorIBOffset, &mFloorVBOffset, 
+						&mCeilingIndexCount, &mCeilingIBOffset, &mCeilingVBOffset);
+
+		// copy info over to list of Basic32 vertices
+		Basic32Vertices.resize(RoomMesh.Vertices.size());
+		for (unsigned int i=0; i<Basic32Vertices.size(); ++i)
+		{
+			Basic32Vertices[i].normal = RoomMesh.Vertices[i].Normal;
+			Basic32Vertices[i].pos = RoomMesh.Vertices[i].Position;
+			Basic32Vertices[i].tex = RoomMesh.Vertices[i].TexCoord;
+		}
+		Vertices = &Basic32Vertices[0];
+		Indices = &RoomMesh.Indices[0];
+		VertexCount = Basic32Vertices.size();
+		IndexCount = RoomMesh.Indices.size();
 	}
 
 	// create vertex buffer
 	D3D11_BUFFER_DESC vbd;
     vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex::Basic32) * RoomMesh.Vertices.size();
+	vbd.ByteWidth = sizeof(Vertex::Basic32) * VertexCount;
     vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
     vbd.CPUAccessFlags = 0;
     vbd.MiscFlags = 0;
     D3D11_SUBRESOURCE_DATA vinitData;
-    vinitData.pSysMem = &Basic32Vertices[0];
+    vinitData.pSysMem = Vertices;
     HR(md3dDevice->CreateBuffer(&vbd, &vinitData, &mRoomVB));
 
 	// create index buffer
 	D3D11_BUFFER_DESC ibd;
     ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * RoomMesh.Indices.size();
+	ibd.ByteWidth = sizeof(UINT) * IndexCount;
     ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
     ibd.CPUAccessFlags = 0;
     ibd.MiscFlags = 0;
     D3D11_SUBRESOURCE_DATA iinitData;
-	iinitData.pSysMem = &RoomMesh.Indices[0];
+	iinitData.pSysMem = Indices;
     HR(md3dDevice->CreateBuffer(&ibd, &iinitData, &mRoomIB));
+
+	// the buffers have their own copies now
+	mRoomBinary.Close();
 }
 
 void PortalsApp::BuildPlayerGeometryBuffers()